@@ -0,0 +1,52 @@
+/**
+ * 智能备份文件系统 - 模块A：以映射文件为后备的块数据容器
+ *
+ * 默认情况下块数据缓冲全部是匿名内存，挂载规模受物理内存限制。配置 storage.container_dir 后，
+ * slab 的数据尺寸类别改从容器中取 1MB 的 span：容器是该目录下的大文件（创建后立即删除目录项，
+ * 只作为进程内的后备存储，持久化由段存储负责），整体以 MAP_SHARED 映射，
+ * data_block_t.data 直接指向映射；哪些页常驻由内核页缓存决定，冷页写回容器文件后被回收。
+ *
+ * 每个容器以位图记录 span 的占用，首次适配分配；span 释放或整页空闲时在文件中打洞，
+ * 归还磁盘空间与页缓存。容器一经打开在进程内一直保留（slab 可能仍缓存着其中的空闲对象），
+ * 进程退出时随映射一并释放。块头、块映射节点等定长元数据仍使用匿名内存。
+ *
+ * 访问提示只作用于容器内的地址，匿名内存上调用时直接忽略：
+ * - BLOCK_CONTAINER_WILLNEED：顺序读时对即将读到的块发起预读；
+ * - BLOCK_CONTAINER_COLD：版本快照等很少再读的数据，优先被回收。
+ */
+
+#ifndef BLOCK_CONTAINER_H
+#define BLOCK_CONTAINER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLOCK_CONTAINER_SPAN ((size_t)1 << 20)          // 分配单位，与 slab 的对齐单位一致
+#define BLOCK_CONTAINER_DEFAULT_SIZE (1ULL << 30)       // 单个容器文件 1GB，用尽时再建下一个
+#define BLOCK_CONTAINER_MAX 256
+
+typedef enum {
+    BLOCK_CONTAINER_WILLNEED,
+    BLOCK_CONTAINER_COLD,
+} block_container_hint_t;
+
+/* 在 dir 下建立容器（首个容器立即创建）；已打开时返回-EBUSY */
+int block_container_open(const char *dir, uint64_t container_size);
+bool block_container_enabled(void);
+
+/* 分配 len 字节（BLOCK_CONTAINER_SPAN 的倍数），起点按 BLOCK_CONTAINER_SPAN 对齐；容器已满且无法新建时返回NULL */
+void *block_container_map(size_t len);
+/* 归还 block_container_map 取得的区域，内容作废 */
+void block_container_unmap(void *ptr, size_t len);
+/* ptr 是否位于某个容器内 */
+bool block_container_owns(const void *ptr);
+/* 区间内完整覆盖的页内容作废：在容器文件中打洞，释放磁盘空间与页缓存，再次访问读出零 */
+void block_container_discard(void *ptr, size_t len);
+/* 访问提示；不在容器内的地址忽略 */
+void block_container_advise(const void *ptr, size_t len, block_container_hint_t hint);
+
+/* 格式化为 "enabled=;containers=;mapped_bytes=;spans=;spans_used=;..." */
+int block_container_format_stats(char *buf, size_t size);
+
+#endif // BLOCK_CONTAINER_H
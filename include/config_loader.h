@@ -0,0 +1,28 @@
+/**
+ * 智能备份文件系统 - 配置文件加载
+ *
+ * 只解析 config.yaml 中的映射与标量（列表项被跳过），
+ * 以点分路径访问，例如 "logging.file"。
+ */
+
+#ifndef CONFIG_LOADER_H
+#define CONFIG_LOADER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 加载配置文件，成功返回0，失败返回负的errno；重复加载会替换之前的内容
+int config_load(const char *path);
+void config_free(void);
+
+// 未配置时返回NULL
+const char *config_get(const char *key);
+
+const char *config_get_string(const char *key, const char *def);
+long config_get_int(const char *key, long def);
+bool config_get_bool(const char *key, bool def);
+
+// 解析带单位的大小（"4KB"、"100MB"、"16TB"），单位按1024进制
+uint64_t config_get_size(const char *key, uint64_t def);
+
+#endif // CONFIG_LOADER_H
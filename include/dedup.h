@@ -26,9 +26,8 @@ typedef struct {
 } dedup_config_t;
 
 typedef struct {
-    hash_table_t *block_hash_index;
-    pthread_rwlock_t global_lock;
-    size_t total_unique_blocks;
+    shard_map_t *block_hash_index;   /* SHA-256前8字节 -> data_block_t*，分片加锁 */
+    size_t total_unique_blocks;      /* 统计计数，原子更新 */
     size_t saved_space;
 } global_dedup_state_t;
 
@@ -47,9 +46,16 @@ data_block_t *dedup_find_duplicate(const uint8_t hash[32]);
 int dedup_index_block(data_block_t *block);
 int dedup_remove_block(data_block_t *block);
 void dedup_release_block(data_block_t *block);
+/* 写时复制：块被多处引用（去重命中或克隆共享）时换成私有副本，写入块数据前调用 */
+int dedup_cow_block(data_block_t **slot);
 
 int block_compress(data_block_t *block, dedup_config_t *config);
 int block_decompress(data_block_t *block, char **out_data, size_t *out_size);
+/* 解压到调用方缓冲（cap 不小于 block->size），不分配内存 */
+int block_decompress_into(data_block_t *block, char *out, size_t cap, size_t *out_size);
+/* 解压块内 [offset, offset+len) 到 out，返回拷出的字节数（到块尾为止），失败返回-1；
+ * offset 为0且 len 不小于 block->size 时直接解压到 out，否则经线程私有缓冲，均不分配内存 */
+int block_decompress_range(data_block_t *block, char *out, size_t offset, size_t len);
 void dedup_set_compression(dedup_config_t *config, compression_algorithm_t algo, int level);
 
 int dedup_process_block_on_write(data_block_t **slot, dedup_config_t *config);
@@ -0,0 +1,34 @@
+/**
+ * 智能备份文件系统 - 模块A：基于纪元的延迟回收
+ *
+ * 读路径（路径解析、块映射读取）不取锁，直接沿指针遍历目录名称索引与块指针数组；
+ * 写者仍在各自的写锁内修改结构，把摘下的旧对象（旧数组、目录项、数据块等）
+ * 交给 epoch_retire，等所有可能看到它的读者离开临界区后才真正释放。
+ *
+ * 全局纪元只在所有活跃读者都已观察到当前纪元时前进；
+ * 在纪元 e 退休的对象于全局纪元到达 e+2 后释放。
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+
+typedef void (*epoch_free_fn)(void *ptr);
+
+/* 进入/离开读侧临界区，可嵌套；临界区内不得阻塞等待写者。
+ * epoch_enter 返回false表示无法登记本线程（内存不足），此时不得调用 epoch_exit，应改走加锁路径
+ */
+bool epoch_enter(void);
+void epoch_exit(void);
+
+/* 延迟释放：ptr 已从共享结构摘除，待现有读者全部离开后调用 fn(ptr)；ptr 为NULL时忽略 */
+void epoch_retire(void *ptr, epoch_free_fn fn);
+
+/* 等待调用前已进入临界区的读者全部离开（调用方自身不得处于临界区内） */
+void epoch_synchronize(void);
+
+/* 卸载时调用：此时不应再有读者，释放所有线程尚未回收的对象 */
+void epoch_shutdown(void);
+
+#endif // EPOCH_H
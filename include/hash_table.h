@@ -0,0 +1,110 @@
+/**
+ * 智能备份文件系统 - 模块A：64位键哈希表
+ *
+ * 开放寻址（Robin Hood）哈希表，键值内联存放在槽数组中，插入不再逐个分配节点。
+ * 负载超过 7/8 时容量翻倍；旧槽数组不一次性搬迁，而是由后续每次写操作顺带迁移一段，
+ * 迁移期间查找依次检查新、旧两个数组。
+ *
+ * 表自带读写锁，单个操作内部加锁；遍历（hash_table_iter_*）不加锁，
+ * 由调用方持有 table->lock 或自身的外部锁保证遍历期间没有插入和删除。
+ *
+ * shard_map_t 是供全局索引使用的并发版本：按键散列分成若干分片，每个分片是一张
+ * 独立加锁的哈希表，互不相关的键在不同分片上的写操作不会互相等待；
+ * 读取先在纪元临界区内按写序号做乐观无锁探测，期间遇到写者才退回分片读锁。
+ */
+
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// 槽：dist 为探测距离加一，0 表示空槽；旧数组中已迁出/删除的槽保留 dist、value 置 NULL（墓碑）
+typedef struct hash_slot {
+    uint64_t key;
+    void *value;
+    uint32_t dist;
+} hash_slot_t;
+
+typedef struct hash_table {
+    hash_slot_t *slots;          // 当前槽数组（容量为2的幂）
+    size_t size;                 // 当前槽数组容量
+    size_t used;                 // 当前槽数组中的条目数
+    size_t count;                // 总条目数（含尚未迁移的旧条目）
+    hash_slot_t *old_slots;      // 扩容前的槽数组，迁移完成后释放
+    size_t old_size;
+    size_t old_pos;              // 下一个待迁移的旧槽下标
+    uint32_t seq;                // 写序号：写锁内为奇数，供乐观读者校验
+    bool concurrent;             // 允许乐观读取：旧槽数组经纪元延迟释放
+    pthread_rwlock_t lock;
+} hash_table_t;
+
+// 遍历游标：先遍历当前数组，再遍历未迁移的旧数组
+typedef struct hash_table_iter {
+    hash_table_t *table;
+    size_t pos;
+    int in_old;
+} hash_table_iter_t;
+
+// 64位整数混合函数（murmur3 fmix64）
+static inline uint64_t hash_mix64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/* size 为初始容量，向上取整为2的幂；之后随负载自动扩容 */
+hash_table_t *hash_table_create(size_t size);
+void hash_table_destroy(hash_table_t *table);
+
+/* value 不得为NULL；键已存在时覆盖 */
+int hash_table_set(hash_table_t *table, uint64_t key, void *value);
+void *hash_table_get(hash_table_t *table, uint64_t key);
+int hash_table_remove(hash_table_t *table, uint64_t key);
+void hash_table_clear(hash_table_t *table);
+size_t hash_table_size(hash_table_t *table);
+
+/* 复合操作：hash_table_write_lock 取得写锁后，用 *_locked 函数在锁内完成多步读改写 */
+void hash_table_write_lock(hash_table_t *table);
+void hash_table_write_unlock(hash_table_t *table);
+void *hash_table_get_locked(hash_table_t *table, uint64_t key);
+int hash_table_set_locked(hash_table_t *table, uint64_t key, void *value);
+int hash_table_remove_locked(hash_table_t *table, uint64_t key);
+
+/* 遍历：hash_table_iter_next 返回下一条目的值槽指针（可原地改写为非NULL值），遍历结束返回NULL */
+void hash_table_iter_init(hash_table_iter_t *iter, hash_table_t *table);
+void **hash_table_iter_next(hash_table_iter_t *iter, uint64_t *key);
+
+#define SHARD_MAP_SHARD_BITS 6
+#define SHARD_MAP_SHARDS (1u << SHARD_MAP_SHARD_BITS)
+
+typedef struct shard_map {
+    hash_table_t *shards[SHARD_MAP_SHARDS];
+} shard_map_t;
+
+typedef void (*shard_map_visit_fn)(uint64_t key, void *value, void *arg);
+
+/* size 为整张表的初始容量，平均分给各分片 */
+shard_map_t *shard_map_create(size_t size);
+void shard_map_destroy(shard_map_t *map);
+
+/* 单键操作：get 多数情况下不取锁；返回的值由调用方保证其生命周期 */
+void *shard_map_get(shard_map_t *map, uint64_t key);
+int shard_map_set(shard_map_t *map, uint64_t key, void *value);
+int shard_map_remove(shard_map_t *map, uint64_t key);
+size_t shard_map_size(shard_map_t *map);
+
+/* 查找或创建等复合操作：锁住 key 所在分片，对返回的分片使用 hash_table_*_locked */
+hash_table_t *shard_map_lock(shard_map_t *map, uint64_t key);
+void shard_map_unlock(hash_table_t *shard);
+
+/* 逐分片持读锁遍历；fn 内不得再访问同一张表 */
+void shard_map_foreach(shard_map_t *map, shard_map_visit_fn fn, void *arg);
+
+#endif // HASH_TABLE_H
@@ -0,0 +1,35 @@
+/**
+ * 智能备份文件系统 - 模块A：按inode编号直接索引的inode表
+ *
+ * inode编号由 inode_alloc_ino 按批单调分配、不回收，因此编号本身就是下标：
+ * 表是一个页目录，每页覆盖 1024 个连续编号，页在第一个inode插入时分配，
+ * 页内inode全部释放后摘下并经纪元回收，空洞区间不占内存。
+ * 表是权威索引：已发布的inode在释放前一直可查，从不淘汰。
+ *
+ * 查找与遍历不取锁（页与页目录经纪元回收）；插入/删除按页分条加锁，
+ * 只有装上或摘下整页、扩展页目录时才取全局锁。
+ * 返回的 file_metadata_t* 的生命期与以往 lookup_inode 相同：inode 经 free_inode
+ * 延迟回收，调用方须处于纪元临界区内，或以其他方式保证inode不被删除。
+ */
+
+#ifndef INODE_TABLE_H
+#define INODE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "smartbackupfs.h"
+
+/* 登记inode；同一编号已有其他inode返回-EEXIST，内存不足返回-ENOMEM */
+int inode_table_insert(file_metadata_t *meta);
+/* 注销inode（仅当表中登记的正是 meta 时）；未登记时忽略 */
+void inode_table_remove(file_metadata_t *meta);
+/* O(1) 查找，不存在返回NULL */
+file_metadata_t *inode_table_get(uint64_t ino);
+/* 按编号顺序遍历：从 *ino 起找下一个已登记的inode，找到时把其编号写回 *ino，整页空洞直接跳过 */
+file_metadata_t *inode_table_next(uint64_t *ino);
+/* 已登记的inode数 */
+size_t inode_table_count(void);
+/* 卸载时调用：释放页与页目录（不释放inode本身），此时不应再有读者 */
+void inode_table_destroy(void);
+
+#endif // INODE_TABLE_H
@@ -0,0 +1,70 @@
+/**
+ * 智能备份文件系统 - 异步分级日志
+ *
+ * 每个线程写入自己的无锁环形缓冲（单生产者/单消费者），后台线程批量落盘。
+ * 级别在编译期与运行期两级过滤：编译期关闭的级别整条语句被删除，
+ * 运行期关闭的级别只有一次整数比较，参数不会被求值、也不做格式化。
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 日志级别（数值越大越详细）
+typedef enum {
+    SBFS_LOG_LEVEL_ERROR = 0,
+    SBFS_LOG_LEVEL_WARN,
+    SBFS_LOG_LEVEL_INFO,
+    SBFS_LOG_LEVEL_DEBUG,
+} sbfs_log_level_t;
+
+// 编译期日志级别，可通过 -DSBFS_LOG_COMPILE_LEVEL=N 调整
+#ifndef SBFS_LOG_COMPILE_LEVEL
+#define SBFS_LOG_COMPILE_LEVEL SBFS_LOG_LEVEL_DEBUG
+#endif
+
+// 运行期日志级别（由 sbfs_log_init/sbfs_log_set_level 设置）
+extern int sbfs_log_runtime_level;
+
+#define SBFS_LOG_ENABLED(level)                    \
+    ((level) <= SBFS_LOG_COMPILE_LEVEL &&          \
+     (level) <= __atomic_load_n(&sbfs_log_runtime_level, __ATOMIC_RELAXED))
+
+#define SBFS_LOG(level, ...)                                           \
+    do {                                                               \
+        if (SBFS_LOG_ENABLED(level))                                   \
+            sbfs_log_write((level), __FILE__, __LINE__, __VA_ARGS__);  \
+    } while (0)
+
+#define SBFS_LOG_ERROR(...) SBFS_LOG(SBFS_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define SBFS_LOG_WARN(...) SBFS_LOG(SBFS_LOG_LEVEL_WARN, __VA_ARGS__)
+#define SBFS_LOG_INFO(...) SBFS_LOG(SBFS_LOG_LEVEL_INFO, __VA_ARGS__)
+#define SBFS_LOG_DEBUG(...) SBFS_LOG(SBFS_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/* 初始化日志输出
+ * level 为级别名（ERROR/WARN/INFO/DEBUG，NULL表示INFO），
+ * path 为NULL或空串时输出到stderr；max_size 为0表示不轮转。
+ * 初始化后处于同步模式，调用 sbfs_log_start 后切换为异步模式。
+ */
+int sbfs_log_init(const char *level, const char *path, uint64_t max_size, int backup_count);
+
+/* 启动后台落盘线程（幂等）
+ * 须在 fuse 守护进程化之后调用（两个前端在 init 回调中调用），否则线程不会随 fork 保留
+ */
+int sbfs_log_start(void);
+
+// 排空所有缓冲、停止后台线程并关闭输出
+void sbfs_log_shutdown(void);
+
+void sbfs_log_set_level(int level);
+int sbfs_log_level_from_string(const char *name);
+
+// 因环形缓冲满被丢弃的日志条数
+uint64_t sbfs_log_dropped(void);
+
+void sbfs_log_write(int level, const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#endif // LOGGER_H
@@ -0,0 +1,61 @@
+/**
+ * 智能备份文件系统 - 模块A：自适应替换缓存（ARC）
+ *
+ * lru_cache_t 按 ARC 策略淘汰：T1 存放只访问过一次的条目，T2 存放被再次访问的条目；
+ * B1/B2 为两者淘汰后只留键的"幽灵"记录，命中幽灵时调整 T1 的目标容量 p，
+ * 顺序扫描只会冲刷 T1，不会挤掉反复访问的热点条目。所有操作 O(1)。
+ *
+ * 容量以"份额"计：lru_cache_put 每条计 1 份，lru_cache_put_sized 可按字节等自定义份额计。
+ * 缓存只保存值指针，不负责释放值。
+ */
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "hash_table.h"
+
+typedef struct lru_entry lru_entry_t;
+
+// 双向链表：head 为最近使用端，tail 为最久未用端；bytes 为表内条目份额之和
+typedef struct lru_list {
+    lru_entry_t *head;
+    lru_entry_t *tail;
+    size_t bytes;
+} lru_list_t;
+
+typedef struct lru_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;          // 因容量不足被淘汰的条目数（不含幽灵记录的丢弃）
+    size_t entries;              // 当前缓存的条目数（不含幽灵）
+    size_t used;                 // 当前占用份额
+    size_t capacity;
+} lru_cache_stats_t;
+
+typedef struct lru_cache {
+    hash_table_t *table;         // key -> lru_entry_t（含幽灵记录）
+    lru_list_t t1, t2, b1, b2;
+    size_t max_size;             // 容量（份额）
+    size_t target_t1;            // ARC 自适应参数 p：T1 的目标份额
+    size_t current_size;         // 缓存条目数（T1 + T2）
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    pthread_mutex_t mutex;
+} lru_cache_t;
+
+lru_cache_t *lru_cache_create(size_t max_size);
+void lru_cache_destroy(lru_cache_t *cache);
+int lru_cache_put(lru_cache_t *cache, uint64_t key, void *value);
+/* charge 为该条目占用的份额（>0）；超过整个容量的条目不缓存 */
+int lru_cache_put_sized(lru_cache_t *cache, uint64_t key, void *value, size_t charge);
+/* 命中即视为一次访问，条目提升到 T2 */
+void *lru_cache_get(lru_cache_t *cache, uint64_t key);
+int lru_cache_remove(lru_cache_t *cache, uint64_t key);
+void lru_cache_clear(lru_cache_t *cache);
+void lru_cache_get_stats(lru_cache_t *cache, lru_cache_stats_t *out);
+
+#endif // LRU_CACHE_H
@@ -56,6 +56,7 @@ typedef struct
 int cache_system_init(size_t l1_bytes, size_t l2_bytes, size_t l3_bytes);
 void cache_system_shutdown(void);
 
+/* 返回的块可能是 L2 副本，摘除后经纪元延迟释放：调用方须处于纪元临界区内使用 */
 data_block_t *cache_get_block(uint64_t block_id);
 void cache_put_block(data_block_t *block);
 void cache_invalidate_block(uint64_t block_id);
@@ -1,6 +1,7 @@
 #ifndef MODULE_C_DEDUP_CORE_H
 #define MODULE_C_DEDUP_CORE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "smartbackupfs.h"
@@ -9,11 +10,15 @@
 /* 基础哈希计算与索引管理 */
 void dedup_core_calculate_hash(data_block_t *block, uint8_t out_hash[32]);
 data_block_t *dedup_core_find(global_dedup_state_t *state, const uint8_t hash[32]);
+/* 同一哈希尚未登记时登记该块，已有登记返回 -EEXIST */
 int dedup_core_index(global_dedup_state_t *state, data_block_t *block);
-int dedup_core_remove(global_dedup_state_t *state, const uint8_t hash[32]);
+/* 仅当索引仍指向该块时摘除，否则返回 -ENOENT */
+int dedup_core_remove(global_dedup_state_t *state, const data_block_t *block);
 
 /* 引用计数管理 */
 void dedup_core_inc_ref(data_block_t *block);
+/* 引用计数非零时加一并返回true；已归零（正在释放）的块返回false */
+bool dedup_core_try_ref(data_block_t *block);
 void dedup_core_dec_ref(data_block_t *block);
 
 #endif /* MODULE_C_DEDUP_CORE_H */
@@ -0,0 +1,97 @@
+/**
+ * 智能备份文件系统 - 模块C：日志结构的持久块存储
+ *
+ * 封存后的块（已去重、已压缩）追加写入存储目录下的段文件 seg-XXXXXXXX.sbs：
+ * - DATA 记录按内容指纹（SHA-256）存放块载荷，同一内容只存一份；
+ * - MAP 记录把块ID映射到指纹；
+ * - 检查点（CKPT_BEGIN、若干 NODE/BLOCKS、CKPT_END）记录目录树与每个文件的块ID，
+ *   挂载时按最新的完整检查点重建命名空间。
+ * 追加先进入内存批缓冲，攒满或同步时一次顺序写出；挂载时按段号重放全部记录重建索引，
+ * 段尾不完整或校验失败的记录被截掉。
+ *
+ * 块ID在内存中的块被释放、且不被最新检查点引用后失效；指纹的引用数归零后其 DATA 记录成为垃圾。
+ * 段写满时只换到新段；旧段的 fdatasync 与段清理（存活比例低于阈值的旧段：存活记录搬到当前段，
+ * 旧段删除）由后台线程完成，追加者不等待磁盘。
+ * 索引与追加由一把互斥锁串行化，fdatasync 与清理时读旧段在锁外进行；未打开存储时各接口直接返回。
+ */
+
+#ifndef MODULE_C_SEGMENT_STORE_H
+#define MODULE_C_SEGMENT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "smartbackupfs.h"
+
+#define SEGMENT_DEFAULT_SIZE (64ULL * 1024 * 1024)
+#define SEGMENT_DEFAULT_CLEAN_PERCENT 50
+#define SEGMENT_CKPT_BATCH 4096           /* 每次 checkpoint_blocks 建议的块位置数（每条 BLOCKS 记录的上限） */
+
+// 检查点中的一个目录项（硬链接的inode会出现多次，块列表只随第一次出现）
+typedef struct segment_node {
+    uint64_t ino;
+    uint64_t parent_ino;
+    uint64_t nlink;
+    int64_t size;
+    int64_t blocks;
+    uint32_t type;               // file_type_t
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    struct timespec atime;
+    struct timespec mtime;
+    struct timespec ctime;
+    const char *name;            // 目录项名称，根为空串
+    const char *link_target;     // 符号链接目标，其他类型为NULL
+} segment_node_t;
+
+// 文件中的一个有数据的块位置
+typedef struct segment_block_ref {
+    uint64_t index;
+    uint64_t block_id;
+} segment_block_ref_t;
+
+// 已落盘块的描述：stored 为载荷长度（压缩块为压缩后长度）
+typedef struct segment_block_info {
+    uint32_t size;
+    uint32_t stored;
+    uint32_t checksum;
+    uint8_t compression;
+    uint8_t hash[32];
+} segment_block_info_t;
+
+/* 打开（必要时创建）存储目录并重放已有的段；clean_percent 为段清理的存活比例阈值（%） */
+int segment_store_open(const char *dir, uint64_t segment_size, unsigned clean_percent);
+/* 停止后台线程，写出批缓冲并落盘后关闭，释放内存索引 */
+void segment_store_close(void);
+bool segment_store_enabled(void);
+
+/* 记录块的当前内容（块已封存，hash 为原始数据的指纹）；内容未变时不写任何记录。
+ * 可能写出批缓冲，调用方不应持有块映射锁 */
+int segment_store_put(const data_block_t *block);
+/* 内存中的块已释放 */
+void segment_store_release(uint64_t block_id);
+/* 读取块的载荷：info 非NULL时填写描述；cap 不足时只填描述并返回-ERANGE，成功返回载荷长度 */
+int segment_store_read(uint64_t block_id, char *buf, size_t cap, segment_block_info_t *info);
+/* 写出批缓冲，把当前段与滚动后尚未落盘的旧段落盘 */
+int segment_store_sync(void);
+/* 清理存活比例低于阈值的旧段，返回清理的段数 */
+int segment_store_clean(void);
+/* 已分配过的最大块ID（挂载后块ID从其后继续分配） */
+uint64_t segment_store_max_block_id(void);
+
+/* 检查点：begin，按先父后子的顺序逐个 node（文件随后以 blocks 给出块列表，可多次调用），end 落盘后生效 */
+int segment_store_checkpoint_begin(void);
+int segment_store_checkpoint_node(const segment_node_t *node);
+int segment_store_checkpoint_blocks(const segment_block_ref_t *refs, size_t count);
+int segment_store_checkpoint_end(void);
+
+/* 按最新完整检查点回放：每个 NODE 以 node 非NULL 调用一次，其后的块列表以 node 为NULL 分批调用；
+ * 回调返回负值时中止。回放出的块ID被视为重新在用 */
+typedef int (*segment_restore_fn)(void *arg, const segment_node_t *node,
+                                  const segment_block_ref_t *refs, size_t count);
+int segment_store_restore(segment_restore_fn fn, void *arg);
+
+int segment_store_format_stats(char *buf, size_t buf_size);
+
+#endif /* MODULE_C_SEGMENT_STORE_H */
@@ -0,0 +1,54 @@
+/**
+ * 智能备份文件系统 - 模块A：数据块内存的slab分配器
+ *
+ * 块头（data_block_t）与块数据缓冲数量巨大、尺寸集中，逐个 malloc 的额外开销与碎片
+ * 会显著放大常驻内存。这里按尺寸类别从 1MB 对齐的 slab 中切分对象：
+ * - 数据缓冲按尺寸分类（64B～64KB，每个2的幂区间再分4档，取整浪费不超过1/4），
+ *   压缩后的短缓冲落入更小的类别；更大的请求单独映射；
+ * - 块头等定长对象用 slab_class_create 建立专属类别，不向上取整浪费空间；
+ * - 每个线程为每个类别保留一个小"弹匣"，分配与释放多数情况下不取锁，
+ *   弹匣空/满时才批量与类别的共享仓库交换对象。
+ *
+ * 启用块容器（block_container.h）时，数据尺寸类别的 slab 取自映射的容器文件，
+ * 块数据的常驻由内核页缓存管理；块头等专属类别与超大对象仍使用匿名内存。
+ *
+ * 对象头部不带元数据：slab_free 按地址对齐到所属 slab 找回类别，因此可直接作为
+ * epoch_retire 的回收函数。以 AddressSanitizer 或 SBFS_SLAB_DISABLE 构建时退化为 malloc/free，
+ * 便于内存错误检测。
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+typedef struct slab_class slab_class_t;
+
+// 单个类别的占用统计：objects 为已切分出的 slab 总容量，live 为调用方持有的对象数
+typedef struct slab_class_stats {
+    const char *name;
+    size_t obj_size;
+    size_t slabs;
+    size_t objects;
+    size_t live;
+    size_t cached;               // 停留在各线程弹匣中的空闲对象
+} slab_class_stats_t;
+
+/* 建立定长对象类别（进程内常驻，不销毁）；类别已满或尺寸超出上限返回NULL */
+slab_class_t *slab_class_create(const char *name, size_t obj_size);
+void *slab_class_alloc(slab_class_t *cls);
+
+/* 按尺寸分配，容量向上取整到所属类别；slab_zalloc 返回清零的内存 */
+void *slab_alloc(size_t size);
+void *slab_zalloc(size_t size);
+
+/* 释放 slab_alloc/slab_zalloc/slab_class_alloc 返回的内存；ptr 为NULL时忽略 */
+void slab_free(void *ptr);
+
+/* 按类别填写统计（最后一项为超大对象），返回写入项数 */
+size_t slab_get_stats(slab_class_stats_t *out, size_t max);
+
+/* 格式化为 "名称=live/objects;..."（略过未使用的类别），缓冲不足返回-1 */
+int slab_format_stats(char *buf, size_t size);
+
+#endif // SLAB_H
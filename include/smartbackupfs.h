@@ -5,7 +5,7 @@
 #ifndef SMARTBACKUPFS_H
 #define SMARTBACKUPFS_H
 
-#define FUSE_USE_VERSION 31
+#define FUSE_USE_VERSION 312
 
 #include <fuse3/fuse.h>
 #include <stdbool.h>
@@ -13,9 +13,12 @@
 #include <pthread.h>
 #include <time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "hash_table.h"
+#include "lru_cache.h"
 
 /* 前向声明 */
-typedef struct hash_table hash_table_t;
 typedef struct l1_cache l1_cache_t;
 typedef struct l2_cache l2_cache_t;
 typedef struct l3_cache l3_cache_t;
@@ -25,6 +28,7 @@ typedef struct l3_cache l3_cache_t;
 #define MAX_INODES 1000000
 #define MAX_BLOCKS 10000000
 #define MAX_CACHE_SIZE 128 * 1024 * 1024  // 128MB
+#define SMARTBACKUPFS_MAX_WRITE (1024 * 1024) // 单次写请求上限（libfuse按缓冲区大小再行截取）
 
 // 文件类型
 typedef enum {
@@ -32,9 +36,22 @@ typedef enum {
     FT_DIRECTORY,      // 目录
     FT_SYMLINK,        // 符号链接
     FT_VERSIONED,      // 版本文件
+    FT_CONTROL,        // 控制文件（/.smartbackup/ctl）
 } file_type_t;
 
-// 文件元数据
+// 文件元数据冷区：版本记账与扩展属性。多数inode从不触及，首次写入时才分配（见 file_meta_ext_get）
+typedef struct file_meta_ext {
+    uint64_t version_count;     // 版本总数（模块B扩展，支持长链）
+    uint64_t latest_version_id; // 最新版本ID（模块B维护）
+    time_t last_version_time;   // 最近一次创建版本的时间戳
+    void *version_handle;       // 指向版本节点的句柄（仅FT_VERSIONED有效）
+    char *link_target;          // 符号链接目标
+    char *comment;              // user.comment 扩展属性
+    bool version_pinned;        // 是否标记为重要版本，清理时跳过
+    bool version_pinned_set;    // 是否显式设置过 pinned xattr
+} file_meta_ext_t;
+
+// 文件元数据（常驻热区）：getattr/lookup 读取的字段排在第一个缓存行，其余状态在冷区
 typedef struct {
     uint64_t ino;               // inode编号
     file_type_t type;           // 文件类型
@@ -44,25 +61,16 @@ typedef struct {
     gid_t gid;                  // 组ID
     off_t size;                 // 文件大小
     blkcnt_t blocks;            // 块数
-    struct timespec atime;      // 访问时间
     struct timespec mtime;      // 修改时间
     struct timespec ctime;      // 状态改变时间
-    uint32_t version;           // 版本号
-    uint64_t version_count;     // 版本总数（模块B扩展，支持长链）
-    uint64_t latest_version_id; // 最新版本ID（模块B维护）
-    time_t last_version_time;   // 最近一次创建版本的时间戳
-    bool version_pinned;        // 是否标记为重要版本，清理时跳过
-    bool version_pinned_set;    // 是否显式设置过 pinned xattr
-    void *version_handle;       // 指向版本节点的句柄（仅FT_VERSIONED有效）
+    struct timespec atime;      // 访问时间
     uint64_t parent_ino;        // 父目录inode
-    char *xattr;               // 扩展属性
-    size_t xattr_size;         // 扩展属性大小
-    /* 模块B/模块C 协同字段 */
-    struct block_map *current_block_map; // 当前版本的块映射
-    uint64_t data_hash;         // 文件整体哈希（模块C可覆盖）
-    pthread_rwlock_t version_lock; // 版本/块映射读写锁
+    struct block_map *current_block_map; // 当前版本的块映射（模块B/模块C 协同）
+    file_meta_ext_t *ext;       // 冷区，未分配为NULL；分配后直到inode释放不再改变
 } file_metadata_t;
 
+_Static_assert(sizeof(file_metadata_t) <= 128, "file_metadata_t hot part exceeds two cache lines");
+
 // 文件数据块
 typedef struct data_block {
     uint64_t block_id;          // 块唯一标识
@@ -72,20 +80,41 @@ typedef struct data_block {
     uint8_t file_type;          // 文件类型标识（模块C自适应压缩）
     uint8_t hash[32];           // SHA-256哈希（模块C使用）
     uint8_t compression;        // 压缩算法标识（与模块C枚举兼容）
+    uint8_t dirty;              // 写回缓冲中：内容已改，校验和/去重/压缩尚未处理（块为私有）
     uint32_t ref_count;         // 引用计数
     pthread_mutex_t ref_lock;   // 引用计数锁
     /* 兼容模块A现有字段 */
     uint64_t file_ino;
     uint64_t offset;
     uint32_t checksum;
+    uint32_t data_seq;          // 切换 data 与压缩字段期间为奇数，无锁读者据此取一致的快照
     struct data_block *next;
 } data_block_t;
 
+// 块映射基数树节点：每层按块索引的6位分叉，叶子（shift为0）的槽直接存放块指针。
+// 全空的子树不分配节点，空洞不占空间；摘下的节点经纪元回收
+#define BLOCK_MAP_NODE_SHIFT 6
+#define BLOCK_MAP_NODE_SLOTS (1u << BLOCK_MAP_NODE_SHIFT)
+
+typedef struct block_map_node {
+    uint32_t shift;            // 每个槽覆盖 2^shift 个块，创建后不变
+    union {
+        struct block_map_node *child;
+        data_block_t *block;
+    } slots[BLOCK_MAP_NODE_SLOTS];
+} block_map_node_t;
+
 // 文件块映射表（支持大文件）
 typedef struct block_map {
     uint64_t file_ino;
-    uint64_t block_count;
-    data_block_t **blocks;     // 动态数组，支持间接块
+    uint64_t block_count;      // 块位置数（最后一个有数据的块之后可能还有空洞）
+    block_map_node_t *root;    // 基数树根，按需增高；空映射为NULL
+    uint64_t *dirty;           // 写回缓冲：尚未封存的块索引，按写入先后排列（可能含已封存/已释放的旧项）
+    size_t dirty_count;
+    size_t dirty_capacity;
+    time_t dirty_since;        // 最早一个未封存块的写入时间
+    bool writeback_queued;     // 已登记到后台写回线程的待查队列
+    uint64_t seq;              // 写序号：写者持写锁期间为奇数，无锁读者据此校验读到的内容
     size_t direct_blocks;      // 直接块数量
     size_t indirect_blocks;    // 间接块数量
     uint64_t *version_block_ids; // 版本间块映射（模块B增量存储预留）
@@ -99,44 +128,96 @@ typedef struct block_map {
 typedef struct dir_entry {
     char *name;
     file_metadata_t *meta;
-    struct dir_entry *next;
+    struct dir_entry *next;      // 按插入顺序的遍历链表
+    struct dir_entry *prev;
+    struct dir_entry *hash_next; // 名称索引桶内链
+    uint64_t name_hash;          // 名称哈希（缓存）
+    size_t name_len;             // 名称长度（缓存）
+    uint64_t cookie;             // readdir续读偏移，插入时分配，目录内单调递增
 } dir_entry_t;
 
 // 目录结构
 typedef struct {
     file_metadata_t meta;
-    dir_entry_t *entries;
+    dir_entry_t *entries;        // 遍历链表头（插入顺序，重命名不改变位置）
     pthread_rwlock_t lock;
     uint64_t entry_count;
+    dir_entry_t *entries_tail;   // 遍历链表尾，O(1)追加
+    dir_entry_t **buckets;       // 名称哈希索引（桶数为2的幂，按负载翻倍），路径解析无锁读取
+    size_t bucket_count;
+    uint64_t next_cookie;        // 下一个分配的目录项cookie
+    uint64_t remove_gen;         // 删除代数，摘除目录项时递增，用于校验readdir游标
 } directory_t;
 
-// 前向声明（供fs_state引用）
-typedef struct lru_cache lru_cache_t;
+// readdir偏移：1、2保留给'.'和'..'，目录项cookie从3开始
+#define DIR_COOKIE_DOT 1
+#define DIR_COOKIE_DOTDOT 2
+#define DIR_COOKIE_FIRST 3
+
+// readdir游标（opendir时分配，记录上次返回的位置以便O(1)续读）
+typedef struct {
+    directory_t *dir;
+    dir_entry_t *last;           // 上次返回的最后一个目录项（NULL表示尚未返回目录项）
+    uint64_t last_cookie;        // 对应的续读偏移
+    uint64_t remove_gen;         // 记录时目录的删除代数
+    bool valid;
+} dir_cursor_t;
+
+// 打开文件句柄（存放于 fi->fh）
+// 缓存元数据与块映射，读写时不再解析路径、不再经过全局 block_maps 表；
+// 两个前端都保证句柄存活期间inode不被释放（高层前端隐藏删除，低层前端lookup计数）
+typedef struct {
+    file_metadata_t *meta;
+    block_map_t *map;            // 普通文件的块映射，其他类型为NULL
+    int flags;                   // open时的标志
+    off_t next_read_offset;      // 顺序读游标：上次读结束的位置
+    uint32_t seq_reads;          // 连续顺序读次数（启发式，并发读时允许不精确）
+    uint64_t advised_until;      // 块容器：已提示预读到的块索引（不含）
+    struct ctl_session *ctl;     // 控制文件的请求/响应会话，其他类型为NULL
+} file_handle_t;
+
+// 数据块填充函数：向 dst 写入恰好 len 字节，成功返回0，失败返回负errno
+typedef int (*block_fill_fn)(void *ctx, char *dst, size_t len);
+
+// write_buf 的填充上下文：从 fuse_bufvec（内存或splice管道）直接拷入块存储，
+// 同时保留开头若干字节供WAL记录
+#define BUFVEC_FILL_HEAD 1024
+typedef struct {
+    struct fuse_bufvec *src;
+    char head[BUFVEC_FILL_HEAD];
+    size_t head_len;
+} bufvec_fill_ctx_t;
+
+// 零拷贝读取向量（见 file_handle_read_vec）
+#define FILE_READ_VEC_MAX 512
+typedef struct {
+    struct iovec iov[FILE_READ_VEC_MAX]; // 指向块存储、全零区或线程私有的解压区
+    size_t count;
+    size_t total;
+    block_map_t *map;            // 持有读锁的块映射
+} file_read_vec_t;
 
 // 文件系统状态
 typedef struct {
     directory_t *root;
-    uint64_t next_ino;
-    pthread_mutex_t ino_mutex;
-    
-    // 缓存系统
-    struct hash_table *inode_cache;
-    struct hash_table *block_cache;
-    pthread_rwlock_t cache_lock;
+    uint64_t next_ino;           // 下一批inode编号的起点，经 inode_alloc_ino 按批领取
+    uint64_t next_block_id;      // 下一个数据块ID（原子递增，从1开始，0表示无效）
+    pthread_mutex_t comment_lock; // 串行化 user.comment 的替换与删除
     
-    // 统计信息
+    // 统计信息（多线程并发增减，一律经 FS_STAT_ADD/FS_STAT_SUB）
     uint64_t total_files;
     uint64_t total_dirs;
     uint64_t total_blocks;
     uint64_t used_blocks;
+    uint64_t dirty_blocks;       // 写回缓冲中尚未封存的块数
+    uint64_t meta_ext_count;     // 已分配的元数据冷区数
     
     // 配置
     size_t block_size;
     size_t max_cache_size;
     bool enable_compression;
     bool enable_deduplication;
-    // 版本管理配置与缓存（模块B）
-    lru_cache_t *version_cache; /* 版本元数据缓存，独立于inode/block缓存 */
+    // 版本管理配置（模块B；版本视图缓存见 version_manager.c）
     pthread_t version_cleaner_thread; /* 版本清理后台线程 */
     uint32_t version_time_interval; /* 定时创建版本的时间间隔（秒） */
     uint32_t version_retention_count; /* 保留最近版本数量 */
@@ -155,51 +236,86 @@ typedef struct {
     l3_cache_t *l3_cache;
 } fs_state_t;
 
-// 哈希表结构定义
-typedef struct hash_node {
-    uint64_t key;
-    void *value;
-    struct hash_node *next;
-    time_t access_time;
-} hash_node_t;
-
-typedef struct hash_table {
-    hash_node_t **buckets;
-    size_t size;
-    size_t count;
-    pthread_rwlock_t lock;
-} hash_table_t;
-
-// LRU缓存结构
-typedef struct lru_cache {
-    hash_table_t *table;
-    size_t max_size;
-    size_t current_size;
-    pthread_mutex_t mutex;
-} lru_cache_t;
-
 // 全局文件系统状态
 extern fs_state_t fs_state;
 
+// 统计计数器原子增减（只用于统计，不与其他字段构成一致性约束）
+#define FS_STAT_ADD(field, n) __atomic_add_fetch(&fs_state.field, (n), __ATOMIC_RELAXED)
+#define FS_STAT_SUB(field, n) __atomic_sub_fetch(&fs_state.field, (n), __ATOMIC_RELAXED)
+
 // 初始化函数
-void fs_init(void);
+int fs_init(void);
 void fs_destroy(void);
+/* 把目录树与各文件的块列表写入段存储的检查点（未启用段存储时直接返回） */
+int fs_checkpoint(void);
 
 // 元数据管理
+uint64_t inode_alloc_ino(void);
 file_metadata_t *create_inode(file_type_t type, mode_t mode);
 void free_inode(file_metadata_t *meta);
 file_metadata_t *lookup_path(const char *path);
+file_metadata_t *lookup_path_ref(const char *path);
+void lookup_path_put(file_metadata_t *meta);
 file_metadata_t *lookup_inode(uint64_t ino);
+void fill_stat_from_meta(const file_metadata_t *meta, struct stat *stbuf);
+/* 读取元数据冷区：未分配时返回全零的共享只读实例，不分配内存 */
+const file_meta_ext_t *file_meta_ext(const file_metadata_t *meta);
+/* 取得可写的元数据冷区，按需分配（并发首次分配只保留一份），内存不足返回NULL */
+file_meta_ext_t *file_meta_ext_get(file_metadata_t *meta);
+/* 释放元数据冷区（inode回收时调用，调用方保证已无读者） */
+void file_meta_ext_free(file_metadata_t *meta);
+void destroy_detached_inode(file_metadata_t *meta);
+block_map_t *file_block_map(file_metadata_t *meta);
+// 块映射写锁：取写锁并使写序号变为奇数，释放时恢复偶数（修改块指针或块内容的写者都须使用）
+void block_map_write_lock(block_map_t *map);
+void block_map_write_unlock(block_map_t *map);
+// 块映射查找：读者持读锁，或处于纪元临界区并用写序号校验
+data_block_t *block_map_get(block_map_t *map, uint64_t index);
+/* 从 *index 起找下一个有数据的块，找到时把其索引写回 *index，整段空洞在树上直接跳过 */
+data_block_t *block_map_next(block_map_t *map, uint64_t *index);
+/* 块指针所在的槽（持写锁）；create 为真时按需建立路径上的节点，失败或不存在返回NULL */
+data_block_t **block_map_slot(block_map_t *map, uint64_t index, bool create);
+
+// 打开文件句柄
+file_handle_t *file_handle_open(file_metadata_t *meta, int flags);
+void file_handle_release(file_handle_t *fh);
+int file_handle_read(file_handle_t *fh, char *buf, size_t size, off_t offset);
+int file_handle_write(file_handle_t *fh, const char *buf, size_t size, off_t offset);
+int file_handle_write_fill(file_handle_t *fh, size_t size, off_t offset,
+                           block_fill_fn fill, void *ctx);
+int file_handle_read_vec(file_handle_t *fh, size_t size, off_t offset, file_read_vec_t *vec);
+void file_read_vec_release(file_read_vec_t *vec);
+ssize_t file_clone_range(file_metadata_t *src, off_t src_off, file_metadata_t *dst, off_t dst_off,
+                         size_t len);
+int file_truncate(file_metadata_t *meta, off_t size);
+int file_fallocate(file_metadata_t *meta, int mode, off_t offset, off_t length);
+off_t file_seek_data(file_metadata_t *meta, off_t offset, int whence);
+/* 封存文件写回缓冲中的全部脏块（flush/fsync/release 时调用） */
+int file_writeback(file_metadata_t *meta);
+/* fsync：封存脏块，并把段存储中已追加的记录落盘 */
+int file_sync(file_metadata_t *meta);
 
 // 目录操作
 int add_directory_entry(directory_t *dir, const char *name, file_metadata_t *meta);
 int remove_directory_entry(directory_t *dir, const char *name);
 dir_entry_t *find_directory_entry(directory_t *dir, const char *name);
+uint64_t dir_name_hash(const char *name, size_t len);
+dir_entry_t *dir_entry_create(const char *name, file_metadata_t *meta);
+void dir_entry_free(dir_entry_t *entry);
+int directory_insert_entry_locked(directory_t *dir, dir_entry_t *entry);
+void directory_unlink_entry_locked(directory_t *dir, dir_entry_t *entry);
+int directory_rename_entry_locked(directory_t *dir, dir_entry_t *entry, const char *new_name);
+void directory_destroy_index(directory_t *dir);
+dir_entry_t *directory_seek_locked(directory_t *dir, const dir_cursor_t *cursor, uint64_t offset);
+void directory_cursor_save_locked(dir_cursor_t *cursor, directory_t *dir,
+                                  dir_entry_t *last, uint64_t last_cookie);
 
 // 数据块操作
 data_block_t *allocate_block(size_t size);
 void free_block(data_block_t *block);
 int read_block(data_block_t *block, char *buf, size_t size, off_t offset);
+void block_data_update_begin(data_block_t *block);
+void block_data_update_end(data_block_t *block);
 int write_block(data_block_t *block, const char *buf, size_t size, off_t offset);
 
 // 缓存管理
@@ -207,5 +323,9 @@ void cache_set(uint64_t key, void *value);
 void *cache_get(uint64_t key);
 void cache_remove(uint64_t key);
 void cache_clear(void);
+/* 格式化 inode/块缓存的命中统计，返回写入长度，缓冲不足返回-1 */
+int cache_format_stats(char *buf, size_t buf_size);
+/* 格式化每inode内存占用（热区/目录/冷区大小与冷区分配数），返回写入长度，缓冲不足返回-1 */
+int inode_format_stats(char *buf, size_t buf_size);
 
 #endif // SMARTBACKUPFS_H
\ No newline at end of file
@@ -0,0 +1,144 @@
+/**
+ * 智能备份文件系统 - 模块A：批量二进制控制通道
+ *
+ * 挂载点下的 /.smartbackup/ctl 为控制文件：客户端以 O_RDWR 打开后，
+ * 先 write() 一个完整请求（可分多次写入），再 read() 取回整批结果。
+ * 控制文件不可定位（pread/pwrite 返回 ESPIPE），同一句柄可反复发起请求。
+ *
+ * 请求：sbfs_ctl_header + count 个命令；每个命令为 sbfs_ctl_cmd + 载荷，
+ * 命令长度包含命令头并按 8 字节对齐。响应：sbfs_ctl_header + count 个
+ * sbfs_ctl_result，每个结果后跟逐目标的记录。所有整数均为本机字节序。
+ */
+
+#ifndef SMARTBACKUPFS_CTL_H
+#define SMARTBACKUPFS_CTL_H
+
+#include "smartbackupfs.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SBFS_CTL_DIR_NAME ".smartbackup"
+#define SBFS_CTL_FILE_NAME "ctl"
+
+#define SBFS_CTL_MAGIC 0x4C544353u /* "SCTL" */
+#define SBFS_CTL_VERSION 1
+#define SBFS_CTL_ALIGN 8
+#define SBFS_CTL_MAX_REQUEST (16u * 1024 * 1024)
+
+// 命令操作码
+enum {
+    SBFS_CTL_OP_SNAPSHOT = 1,  /* 为目标创建手动版本；目录需带 RECURSIVE 标志，对整棵子树建版 */
+    SBFS_CTL_OP_PIN = 2,       /* 设置/清除目标的 pinned 标记 */
+    SBFS_CTL_OP_STATS = 3,     /* 批量取文件元数据与版本统计 */
+    SBFS_CTL_OP_XATTR_GET = 4, /* 对每个目标读取同一扩展属性 */
+    SBFS_CTL_OP_XATTR_SET = 5, /* 对每个目标设置同一扩展属性 */
+    SBFS_CTL_OP_CLONE = 6,     /* 按 (源, 目标) 成对克隆文件区间，块对齐部分共享数据块 */
+    SBFS_CTL_OP_MAX
+};
+
+// 命令标志
+#define SBFS_CTL_F_RECURSIVE 0x0001 /* SNAPSHOT：递归处理目录 */
+#define SBFS_CTL_F_UNPIN 0x0002     /* PIN：清除 pinned 标记 */
+
+// 请求/响应头（响应中 count 为结果个数，length 为响应总长）
+struct sbfs_ctl_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t length; /* 含本头的总长度 */
+    uint32_t count;  /* 命令（结果）个数 */
+};
+
+// 命令头，载荷紧随其后
+struct sbfs_ctl_cmd {
+    uint16_t op;
+    uint16_t flags;
+    uint32_t length; /* 含本头，8 字节对齐 */
+};
+
+// 目标：ino 非0时按inode编号定位，否则按 path（不含结尾NUL，补齐到 8 字节）定位
+struct sbfs_ctl_target {
+    uint64_t ino;
+    uint32_t path_len;
+    uint32_t reserved;
+};
+
+// XATTR_GET/XATTR_SET 载荷开头：属性名与值（补齐到 8 字节）之后是目标列表
+struct sbfs_ctl_xattr {
+    uint32_t name_len;
+    uint32_t value_len; /* GET 时忽略 */
+};
+
+// CLONE 载荷开头：之后的目标两两成对（源、目标）；length 为0表示拷到源文件末尾
+struct sbfs_ctl_clone {
+    uint64_t src_off;
+    uint64_t dst_off;
+    uint64_t length;
+};
+
+// 结果头，逐目标记录紧随其后
+struct sbfs_ctl_result {
+    uint16_t op;
+    uint16_t flags;
+    uint32_t length; /* 含本头，8 字节对齐 */
+    int32_t status;  /* 0 或负errno（命令格式错误/不支持等） */
+    uint32_t count;  /* 记录个数 */
+};
+
+// SNAPSHOT/PIN/XATTR_* 的逐目标记录
+// value：SNAPSHOT 为创建的版本数，XATTR_GET 为随后属性值的字节数（补齐到 8 字节）
+struct sbfs_ctl_status {
+    uint64_t ino;
+    int32_t status;
+    uint32_t value;
+};
+
+// CLONE 的逐对记录（ino 为目标文件）
+struct sbfs_ctl_clone_status {
+    uint64_t ino;
+    int32_t status;
+    uint32_t reserved;
+    uint64_t bytes; /* 实际克隆的字节数 */
+};
+
+// STATS 的逐目标记录
+struct sbfs_ctl_stat {
+    uint64_t ino;
+    uint64_t size;
+    uint64_t blocks;
+    uint64_t version_count;
+    uint64_t latest_version_id;
+    int64_t last_version_time;
+    int64_t mtime_sec;
+    uint32_t mtime_nsec;
+    uint32_t mode;
+    int32_t status;
+    uint8_t type;
+    uint8_t pinned;
+    uint16_t reserved;
+};
+
+#define SBFS_CTL_PAD(n) (((n) + SBFS_CTL_ALIGN - 1) & ~(size_t)(SBFS_CTL_ALIGN - 1))
+
+typedef struct ctl_session ctl_session_t;
+
+/* 在根目录下建立 /.smartbackup/ctl（fs_init 调用） */
+int ctl_init(void);
+
+/* 控制目录与控制文件不可删除、重命名 */
+bool ctl_is_reserved(const file_metadata_t *meta);
+
+/* 打开控制文件时创建会话，释放句柄时销毁 */
+ctl_session_t *ctl_session_create(void);
+void ctl_session_destroy(ctl_session_t *session);
+
+/* 追加请求数据；请求收齐后立即执行，返回接受的字节数或负errno */
+int ctl_session_write(ctl_session_t *session, const char *buf, size_t size);
+
+/* 读取上一请求的响应（顺序消费），无待读响应时返回0 */
+int ctl_session_read(ctl_session_t *session, char *buf, size_t size);
+
+/* 执行一个完整请求，响应由调用者 free */
+int ctl_execute(const char *req, size_t len, char **out, size_t *out_len);
+
+#endif // SMARTBACKUPFS_CTL_H
@@ -0,0 +1,20 @@
+/**
+ * 智能备份文件系统 - 模块A：FUSE低层（inode）前端
+ */
+
+#ifndef SMARTBACKUPFS_LL_H
+#define SMARTBACKUPFS_LL_H
+
+#include "smartbackupfs.h"
+#include <fuse3/fuse_lowlevel.h>
+
+/* inode前端属性/目录项缓存超时（秒） */
+#define LL_ATTR_TIMEOUT 1.0
+#define LL_ENTRY_TIMEOUT 1.0
+
+/* 运行基于 fuse_lowlevel_ops 的会话
+ * args 为已剔除程序私有选项的FUSE参数，返回进程退出码
+ */
+int smartbackupfs_ll_main(struct fuse_args *args);
+
+#endif // SMARTBACKUPFS_LL_H
@@ -42,6 +42,28 @@ typedef struct version_chain {
     pthread_rwlock_t lock;
 } version_chain_t;
 
+/* 版本视图的虚拟inode：最高位置1，中间为文件ino，低 VERSION_INO_VID_BITS 位为版本ID，
+ * 版本ID为0表示该文件的 @versions 目录。编号只由 (ino, version_id) 决定，与真实inode不重叠。
+ */
+#define VERSION_INO_FLAG (1ULL << 63)
+#define VERSION_INO_VID_BITS 24
+#define VERSION_INO_VID_MAX ((1ULL << VERSION_INO_VID_BITS) - 1)
+#define VERSION_INO_BASE_MAX ((1ULL << (63 - VERSION_INO_VID_BITS)) - 1)
+#define VERSION_INO(ino, vid) \
+    (VERSION_INO_FLAG | ((uint64_t)(ino) << VERSION_INO_VID_BITS) | (uint64_t)(vid))
+#define VERSION_INO_VALID(ino, vid) \
+    ((uint64_t)(ino) <= VERSION_INO_BASE_MAX && (uint64_t)(vid) <= VERSION_INO_VID_MAX)
+#define VERSION_INO_IS_VIRTUAL(vino) (((uint64_t)(vino) & VERSION_INO_FLAG) != 0)
+#define VERSION_INO_BASE(vino) (((uint64_t)(vino) & ~VERSION_INO_FLAG) >> VERSION_INO_VID_BITS)
+#define VERSION_INO_VID(vino) ((uint64_t)(vino) & VERSION_INO_VID_MAX)
+
+/* @versions 目录项名称上限（"v<ID> | <时间> | <描述>"，超长描述被截断） */
+#define VERSION_ENTRY_NAME_MAX 128
+
+/* 版本遍历回调：返回非0停止遍历 */
+typedef int (*version_visit_fn)(void *ctx, const char *name, uint64_t vino, uint64_t version_id,
+                                off_t size, time_t create_time);
+
 typedef struct version_history_sample
 {
     time_t create_time;
@@ -66,17 +88,26 @@ int version_manager_create_manual(file_metadata_t *meta, const char *reason);
 /* 创建版本：在写入、重命名前/删除前调用 */
 int version_manager_create_version(file_metadata_t *meta, const char *reason);
 
-/* 获取某个文件的指定版本元数据（解析 v<num> / latest）
- * 返回新分配的 file_metadata_t*（由调用者通过 free_inode/相应接口释放）
+/* 获取某个文件的指定版本视图（解析 v<num> / latest / 时间表达式）
+ * 返回缓存中的只读元数据并持有一个引用，调用者用 version_manager_put_version_meta 释放；
+ * 视图的 ino 为 VERSION_INO(文件ino, 版本ID)
  */
 file_metadata_t *version_manager_get_version_meta(file_metadata_t *meta, const char *verstr);
+void version_manager_put_version_meta(file_metadata_t *vmeta);
+
+/* 按版本ID降序遍历（持有链读锁，不分配内存）；below_id 非0时只遍历ID小于它的版本 */
+int version_manager_for_each_version(file_metadata_t *meta, uint64_t below_id,
+                                     version_visit_fn fn, void *ctx);
 
 /* 根据时间戳查找不晚于目标时间的最新版本ID，返回0表示不存在 */
 uint64_t version_manager_get_version_by_time(uint64_t ino, time_t target_time);
 
-/* 读取指定版本的快照数据 */
+/* 读取版本视图的快照数据；版本已被删除时返回 -ESTALE */
 int version_manager_read_version_data(file_metadata_t *vmeta, char *buf, size_t size, off_t offset);
 
+/* 直接读取版本节点的快照数据（调用方保证节点存活） */
+int version_manager_read_node_data(const version_node_t *vn, char *buf, size_t size, off_t offset);
+
 /* 删除指定版本 */
 int version_manager_delete_version(uint64_t ino, uint64_t version_id);
 
@@ -0,0 +1,35 @@
+/**
+ * 智能备份文件系统 - 模块A：FUSE工作线程池与线程私有缓冲
+ *
+ * 两个前端共用同一套多线程会话配置：线程上限、空闲线程数、clone_fd
+ * 与CPU绑定均来自配置文件 performance 段，未配置时沿用命令行
+ * （-o max_threads/max_idle_threads/clone_fd）或libfuse默认值。
+ * 每个工作线程首次处理请求时分配自己的缓冲（路径解析、块解压），线程退出时释放。
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "smartbackupfs.h"
+#include <fuse3/fuse_lowlevel.h>
+
+// 线程私有缓冲：只在单次FUSE请求内部使用，不跨请求保留内容
+typedef struct worker_scratch {
+    char path[MAX_PATH_LEN];   /* 路径解析（resolve_path） */
+    char parent[MAX_PATH_LEN]; /* 父目录路径（get_parent_directory） */
+    char *block;               /* 块解压缓冲，按需扩大 */
+    size_t block_cap;
+} worker_scratch_t;
+
+/* 取当前线程的缓冲（首次调用时分配，块缓冲预分配一个块大小），内存不足返回NULL */
+worker_scratch_t *worker_scratch(void);
+
+/* 取至少 size 字节的解压缓冲，内存不足返回NULL */
+char *worker_scratch_block(size_t size);
+
+/* 按配置与命令行生成多线程循环配置，并把当前线程绑定到 performance.cpu_set
+ * （之后由libfuse创建的工作线程继承该CPU集合）；返回值用 fuse_loop_cfg_destroy 释放
+ */
+struct fuse_loop_config *worker_pool_loop_config(const struct fuse_cmdline_opts *opts);
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,351 @@
+#!/bin/bash
+# 存储子系统挂载测试：段存储重挂载持久化与 fsync 后崩溃恢复、稀疏文件（SEEK_HOLE/打洞）、超大偏移块映射、克隆写时复制、压缩块经L3缓存往返
+# 自带私有挂载点与配置，不影响 run.sh 的 /tmp/smartbackup；L2/L3 缓存文件全局共享，勿与 test_all.sh 并发运行
+
+set -uo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_DIR="${SCRIPT_DIR}/.."
+BUILD_DIR="${PROJECT_DIR}/build"
+BIN="${BUILD_DIR}/bin/smartbackup-fs"
+MOUNT_POINT="${MOUNT_POINT:-/tmp/smartbackup_storage}"
+WORK_DIR="$(mktemp -d /tmp/smartbackup_storage_test.XXXXXX)"
+CONFIG="${WORK_DIR}/config.yaml"
+SEGMENT_DIR="${WORK_DIR}/segments"
+DEDUP_CONF="/tmp/smartbackupfs_dedup.conf"
+L3_DIR="/tmp/smartbackupfs_l3"
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+TOTAL_TESTS=0
+PASSED_TESTS=0
+STARTED_PID=0
+
+log() { echo -e "[test_storage] $*"; }
+
+run_test() {
+    local name="$1"; shift
+    local cmd="$*"
+    TOTAL_TESTS=$((TOTAL_TESTS+1))
+    echo -n "测试：$name ... "
+    if eval "$cmd" >/dev/null 2>&1; then
+        echo -e "${GREEN}通过${NC}"
+        PASSED_TESTS=$((PASSED_TESTS+1))
+        return 0
+    else
+        echo -e "${RED}失败${NC}"
+        return 1
+    fi
+}
+
+start_fs() {
+    "$BIN" -f --config="$CONFIG" "$MOUNT_POINT" 2>>"${WORK_DIR}/fs.log" &
+    STARTED_PID=$!
+    for _ in $(seq 1 50); do
+        mountpoint -q "$MOUNT_POINT" && return 0
+        sleep 0.1
+    done
+    log "挂载失败，日志见 ${WORK_DIR}/fs.log"
+    return 1
+}
+
+# 卸载并等待进程退出：卸载时写出检查点，进程退出后段文件才完整
+stop_fs() {
+    [[ $STARTED_PID -ne 0 ]] || return 0
+    fusermount -u "$MOUNT_POINT" 2>/dev/null || umount "$MOUNT_POINT" 2>/dev/null || true
+    wait $STARTED_PID 2>/dev/null || true
+    STARTED_PID=0
+}
+
+# 模拟崩溃：不经卸载直接杀掉进程（不写卸载检查点），再摘掉残留的挂载
+crash_fs() {
+    [[ $STARTED_PID -ne 0 ]] || return 0
+    kill -9 $STARTED_PID 2>/dev/null
+    wait $STARTED_PID 2>/dev/null || true
+    STARTED_PID=0
+    fusermount -u "$MOUNT_POINT" 2>/dev/null || umount -l "$MOUNT_POINT" 2>/dev/null || true
+}
+
+cleanup() {
+    stop_fs
+    # 压缩配置经 xattr 持久化到全局文件，恢复为测试前的状态
+    if [[ -f "${WORK_DIR}/dedup.conf.orig" ]]; then
+        cp "${WORK_DIR}/dedup.conf.orig" "$DEDUP_CONF"
+    else
+        rm -f "$DEDUP_CONF"
+    fi
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT
+
+if [[ ! -x "$BIN" ]]; then
+    log "未找到 $BIN，请先运行 scripts/build.sh"
+    exit 1
+fi
+if mountpoint -q "$MOUNT_POINT"; then
+    log "挂载点 $MOUNT_POINT 已被占用"
+    exit 1
+fi
+mkdir -p "$MOUNT_POINT"
+[[ -f "$DEDUP_CONF" ]] && cp "$DEDUP_CONF" "${WORK_DIR}/dedup.conf.orig"
+rm -f "$DEDUP_CONF"
+
+cat > "$CONFIG" <<EOF
+storage:
+  segment_dir: "${SEGMENT_DIR}"
+  segment_size: "4MB"
+  # 关闭定期检查点：崩溃恢复测试只依赖 fsync 写出的检查点
+  checkpoint_interval: 0
+EOF
+
+# 稀疏文件：0 与 16MB 处各写 64KB，中间为空洞（64KB 为任意块大小的整数倍）
+sparse_layout_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+fd = os.open(sys.argv[1], os.O_RDONLY)
+ok = (os.lseek(fd, 0, os.SEEK_HOLE) == 65536 and
+      os.lseek(fd, 65536, os.SEEK_DATA) == 16 << 20 and
+      os.lseek(fd, 16 << 20, os.SEEK_HOLE) == (16 << 20) + 65536 and
+      os.pread(fd, 65536, 1 << 20) == bytes(65536))
+os.close(fd)
+raise SystemExit(0 if ok else 1)
+PY
+}
+
+punched_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+fd = os.open(sys.argv[1], os.O_RDONLY)
+ok = (os.fstat(fd).st_size == (16 << 20) + 65536 and
+      os.pread(fd, 65536, 0) == bytes(65536) and
+      os.lseek(fd, 0, os.SEEK_DATA) == 16 << 20 and
+      os.pread(fd, 65536, 16 << 20) == b'S' * 65536)
+os.close(fd)
+raise SystemExit(0 if ok else 1)
+PY
+}
+
+# 超大偏移：1TB 与 4EB 处各写一块，块映射需增长出多层内部节点
+huge_offset_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+fd = os.open(sys.argv[1], os.O_CREAT | os.O_TRUNC | os.O_RDWR, 0o644)
+os.pwrite(fd, b'F' * 4096, 0)
+os.pwrite(fd, b'H' * 4096, 1 << 40)
+os.pwrite(fd, b'T' * 4096, 1 << 62)
+os.fsync(fd)
+os.close(fd)
+PY
+    huge_layout_ok "$1"
+}
+
+huge_layout_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+fd = os.open(sys.argv[1], os.O_RDONLY)
+ok = (os.fstat(fd).st_size == (1 << 62) + 4096 and
+      os.pread(fd, 4096, 0) == b'F' * 4096 and
+      os.pread(fd, 4096, 1 << 40) == b'H' * 4096 and
+      os.pread(fd, 4096, 1 << 62) == b'T' * 4096 and
+      os.pread(fd, 4096, 1 << 50) == bytes(4096) and
+      os.lseek(fd, 4096, os.SEEK_DATA) == 1 << 40 and
+      os.lseek(fd, (1 << 40) + 4096, os.SEEK_DATA) == 1 << 62)
+os.close(fd)
+raise SystemExit(0 if ok else 1)
+PY
+}
+
+# 截断回小文件后块映射收缩：旧的远端数据不能在重新扩展后复现
+truncate_back_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+path = sys.argv[1]
+os.truncate(path, 4096)
+fd = os.open(path, os.O_RDWR)
+ok = (os.fstat(fd).st_size == 4096 and
+      os.pread(fd, 8192, 0) == b'F' * 4096 and
+      os.lseek(fd, 0, os.SEEK_HOLE) == 4096)
+os.ftruncate(fd, (1 << 62) + 4096)
+ok = ok and (os.pread(fd, 4096, 1 << 40) == bytes(4096) and
+             os.pread(fd, 4096, 1 << 62) == bytes(4096))
+os.close(fd)
+raise SystemExit(0 if ok else 1)
+PY
+}
+
+# 逐条追加：块映射随文件末尾逐块增长
+append_growth_ok() {
+    python3 - "$1" <<'PY'
+import os, sys
+fd = os.open(sys.argv[1], os.O_CREAT | os.O_TRUNC | os.O_WRONLY | os.O_APPEND, 0o644)
+expect = bytearray()
+for i in range(3000):
+    rec = bytes([i % 251]) * 1000
+    os.write(fd, rec)
+    expect += rec
+os.close(fd)
+with open(sys.argv[1], 'rb') as f:
+    raise SystemExit(0 if f.read() == expect else 1)
+PY
+}
+
+# 克隆后改写目标：源文件必须保持不变
+clone_cow_ok() {
+    python3 - "$1" "$2" <<'PY'
+import os, sys
+src, dst = sys.argv[1], sys.argv[2]
+data = os.urandom(256 * 1024)
+with open(src, 'wb') as f:
+    f.write(data)
+fi = os.open(src, os.O_RDONLY)
+fo = os.open(dst, os.O_CREAT | os.O_TRUNC | os.O_RDWR, 0o644)
+done = 0
+while done < len(data):
+    n = os.copy_file_range(fi, fo, len(data) - done)
+    if n <= 0:
+        raise SystemExit(1)
+    done += n
+os.pwrite(fo, b'X' * 8192, 4096)
+os.fsync(fo)
+os.close(fi)
+os.close(fo)
+with open(src, 'rb') as f:
+    if f.read() != data:
+        raise SystemExit(1)
+with open(dst, 'rb') as f:
+    got = f.read()
+expect = data[:4096] + b'X' * 8192 + data[4096 + 8192:]
+raise SystemExit(0 if got == expect else 1)
+PY
+}
+
+# 可压缩的整块内容（含进程号，避免命中旧的 L3 文件），同时在本地留一份期望内容
+write_compressible() {
+    python3 - "$1" "$2" <<'PY'
+import os, sys
+unit = ('L3-%d-' % os.getpid()).encode()
+block = (unit * (4096 // len(unit) + 1))[:4096]
+for path in sys.argv[1:]:
+    fd = os.open(path, os.O_CREAT | os.O_TRUNC | os.O_WRONLY, 0o644)
+    for _ in range(16):
+        os.write(fd, block)
+    os.fsync(fd)
+    os.close(fd)
+PY
+}
+
+# L3 文件存放解压后的原始块：应有一个文件与首块逐字节相同
+l3_holds_plain_block() {
+    python3 - "$1" "$L3_DIR" <<'PY'
+import glob, os, sys
+with open(sys.argv[1], 'rb') as f:
+    block = f.read(4096)
+for path in glob.glob(os.path.join(sys.argv[2], '*.bin')):
+    try:
+        with open(path, 'rb') as f:
+            if f.read() == block:
+                raise SystemExit(0)
+    except OSError:
+        pass
+raise SystemExit(1)
+PY
+}
+
+# 以 src 的内容覆盖写 path 并 fsync
+write_fsync() {
+    python3 - "$1" "$2" <<'PY'
+import os, sys
+with open(sys.argv[2], 'rb') as f:
+    data = f.read()
+fd = os.open(sys.argv[1], os.O_CREAT | os.O_TRUNC | os.O_WRONLY, 0o644)
+os.write(fd, data)
+os.fsync(fd)
+os.close(fd)
+PY
+}
+
+# 记录目录树与内容摘要，用于重挂载前后比较（只含普通大小的文件，超大稀疏文件单独校验）
+tree_digest() {
+    (cd "$1" && find . \( -type d -printf '%y %p\n' \) -o -printf '%y %p %n %l\n' | sort &&
+        find . -type f -print0 | sort -z | xargs -0 md5sum)
+}
+
+echo -e "${GREEN}=== 存储子系统挂载测试 ===${NC}"
+start_fs || exit 1
+TEST_DIR="${MOUNT_POINT}/storage_$(date +%s)"
+mkdir -p "$TEST_DIR"
+
+echo -e "${BLUE}【段存储】${NC}"
+run_test "段存储已启用" "getfattr -n user.segment.stats --only-values '$MOUNT_POINT' | grep -q 'enabled=1'"
+
+echo -e "${BLUE}【稀疏文件】${NC}"
+head -c 65536 /dev/zero | tr '\0' S > "${WORK_DIR}/s.bin"
+for f in sparse.bin punched.bin; do
+    run_test "写入稀疏文件 $f" "dd if='${WORK_DIR}/s.bin' of='$TEST_DIR/$f' bs=65536 count=1 2>/dev/null && dd if='${WORK_DIR}/s.bin' of='$TEST_DIR/$f' bs=65536 seek=256 conv=notrunc 2>/dev/null"
+done
+run_test "SEEK_DATA/SEEK_HOLE" "sparse_layout_ok '$TEST_DIR/sparse.bin'"
+run_test "打洞后读回零" "fallocate -p -o 0 -l 65536 '$TEST_DIR/punched.bin' && punched_ok '$TEST_DIR/punched.bin'"
+
+echo -e "${BLUE}【块映射：超大偏移】${NC}"
+run_test "1TB与4EB偏移写入" "huge_offset_ok '$TEST_DIR/huge.bin'"
+run_test "截断回小文件" "huge_offset_ok '$TEST_DIR/shrink.bin' && truncate_back_ok '$TEST_DIR/shrink.bin'"
+run_test "逐条追加增长" "append_growth_ok '$TEST_DIR/append.bin'"
+
+echo -e "${BLUE}【克隆写时复制】${NC}"
+run_test "克隆后改写不影响源文件" "clone_cow_ok '$TEST_DIR/clone_src.bin' '$TEST_DIR/clone_dst.bin'"
+
+echo -e "${BLUE}【压缩块与L3缓存】${NC}"
+run_test "开启压缩" "setfattr -n user.compression.algo -v gzip '$MOUNT_POINT' && getfattr -n user.compression.algo --only-values '$MOUNT_POINT' | grep -q gzip"
+run_test "写入可压缩文件" "write_compressible '$TEST_DIR/compressed.bin' '${WORK_DIR}/compressed.bin'"
+run_test "L3保存解压后的块" "l3_holds_plain_block '$TEST_DIR/compressed.bin'"
+run_test "压缩文件读回" "cmp '$TEST_DIR/compressed.bin' '${WORK_DIR}/compressed.bin'"
+run_test "关闭压缩" "setfattr -x user.compression.algo '$MOUNT_POINT'"
+
+echo -e "${BLUE}【重挂载持久化】${NC}"
+mkdir -p "$TEST_DIR/tree/a/b"
+for i in $(seq 1 20); do
+    head -c $((i * 3000)) /dev/urandom > "$TEST_DIR/tree/a/b/f$i.bin"
+done
+echo "persist" > "$TEST_DIR/tree/a/note.txt"
+ln -s a/note.txt "$TEST_DIR/tree/link"
+ln "$TEST_DIR/tree/a/note.txt" "$TEST_DIR/tree/hard.txt"
+tree_digest "$TEST_DIR/tree" > "${WORK_DIR}/before.txt"
+stop_fs
+run_test "重新挂载" "start_fs"
+run_test "目录树与内容一致" "tree_digest '$TEST_DIR/tree' | cmp - '${WORK_DIR}/before.txt'"
+run_test "硬链接计数保留" "test \$(stat -c %h '$TEST_DIR/tree/hard.txt') -eq 2"
+run_test "符号链接保留" "test \"\$(readlink '$TEST_DIR/tree/link')\" = a/note.txt"
+run_test "空洞布局保留" "sparse_layout_ok '$TEST_DIR/sparse.bin'"
+run_test "超大偏移布局保留" "huge_layout_ok '$TEST_DIR/huge.bin'"
+run_test "压缩块重挂载后读回" "cmp '$TEST_DIR/compressed.bin' '${WORK_DIR}/compressed.bin'"
+run_test "重挂载后可继续写入" "echo more >> '$TEST_DIR/tree/a/note.txt' && tail -n1 '$TEST_DIR/tree/hard.txt' | grep -q more"
+
+echo -e "${BLUE}【崩溃恢复】${NC}"
+head -c 20000 /dev/urandom > "${WORK_DIR}/new.bin"
+head -c 5000 /dev/urandom > "${WORK_DIR}/rewrite.bin"
+mkdir -p "$TEST_DIR/crash"
+run_test "新建文件并fsync" "write_fsync '$TEST_DIR/crash/new.bin' '${WORK_DIR}/new.bin'"
+run_test "改写已有文件并fsync" "write_fsync '$TEST_DIR/tree/a/b/f1.bin' '${WORK_DIR}/rewrite.bin'"
+crash_fs
+run_test "崩溃后重新挂载" "start_fs"
+run_test "fsync过的新文件保留" "cmp '$TEST_DIR/crash/new.bin' '${WORK_DIR}/new.bin'"
+run_test "改写的内容与大小保留" "cmp '$TEST_DIR/tree/a/b/f1.bin' '${WORK_DIR}/rewrite.bin'"
+run_test "未改动的文件保留" "(cd '$TEST_DIR/tree' && grep ' ./a/b/f2.bin\$' '${WORK_DIR}/before.txt' | md5sum -c --status -)"
+rm -rf "$TEST_DIR"
+
+echo -e "${GREEN}=== 测试总结 ===${NC}"
+echo "总测试数: $TOTAL_TESTS"
+echo "通过测试: $PASSED_TESTS"
+echo "失败测试: $((TOTAL_TESTS - PASSED_TESTS))"
+
+if [[ $PASSED_TESTS -eq $TOTAL_TESTS ]]; then
+    echo -e "${GREEN}🎉 所有测试通过${NC}"
+    exit 0
+else
+    echo -e "${RED}❌ 存在失败项${NC}"
+    exit 1
+fi
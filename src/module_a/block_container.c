@@ -0,0 +1,315 @@
+/**
+ * 智能备份文件系统 - 模块A：以映射文件为后备的块数据容器
+ */
+
+#include "block_container.h"
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+// 较新的内核支持 MADV_COLD（只降低页的回收优先级）；否则退回 MADV_DONTNEED，
+// 对共享文件映射它只解除页表映射，数据仍在页缓存与文件中
+#ifdef MADV_COLD
+#define CONTAINER_MADV_COLD MADV_COLD
+#else
+#define CONTAINER_MADV_COLD MADV_DONTNEED
+#endif
+
+typedef struct container {
+    char *base;                  // 映射起点，按 BLOCK_CONTAINER_SPAN 对齐
+    size_t size;
+    int fd;
+    size_t spans;
+    size_t used;
+    size_t hint;                 // 下次查找的起点（首次适配，从上次分配处继续）
+    uint64_t *bitmap;            // 置位表示 span 已分配
+} container_t;
+
+static struct {
+    pthread_mutex_t lock;        // 保护位图与容器的新建
+    bool enabled;
+    char dir[PATH_MAX];
+    size_t container_size;
+    container_t *containers[BLOCK_CONTAINER_MAX];
+    unsigned count;              // 已发布的容器数，无锁读取
+    size_t page_size;
+    uint64_t discards;
+    uint64_t willneed;
+    uint64_t cold;
+    uint64_t map_failures;
+} g_bc = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static bool bit_get(const uint64_t *bm, size_t i)
+{
+    return (bm[i / 64] >> (i % 64)) & 1;
+}
+
+static void bits_set(uint64_t *bm, size_t start, size_t n, bool on)
+{
+    for (size_t i = start; i < start + n; i++)
+    {
+        if (on)
+            bm[i / 64] |= 1ULL << (i % 64);
+        else
+            bm[i / 64] &= ~(1ULL << (i % 64));
+    }
+}
+
+// 映射一个新容器：先保留对齐的地址区间，再把文件固定映射到对齐起点
+static container_t *container_create(void)
+{
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/sbfs-container-XXXXXX", g_bc.dir);
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return NULL;
+    // 容器只是进程内的后备存储，不留目录项，进程退出（或崩溃）后自动回收
+    unlink(path);
+
+    size_t size = g_bc.container_size;
+    container_t *c = calloc(1, sizeof(container_t));
+    uint64_t *bitmap = calloc((size / BLOCK_CONTAINER_SPAN + 63) / 64, sizeof(uint64_t));
+    char *raw = MAP_FAILED;
+    if (c && bitmap && ftruncate(fd, (off_t)size) == 0)
+        raw = mmap(NULL, size + BLOCK_CONTAINER_SPAN, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                   -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        free(bitmap);
+        free(c);
+        close(fd);
+        return NULL;
+    }
+    char *base = (char *)(((uintptr_t)raw + BLOCK_CONTAINER_SPAN - 1) & ~(uintptr_t)(BLOCK_CONTAINER_SPAN - 1));
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(raw, size + BLOCK_CONTAINER_SPAN);
+        free(bitmap);
+        free(c);
+        close(fd);
+        return NULL;
+    }
+    if (base > raw)
+        munmap(raw, (size_t)(base - raw));
+    size_t tail = (size_t)(raw + size + BLOCK_CONTAINER_SPAN - (base + size));
+    if (tail > 0)
+        munmap(base + size, tail);
+
+    c->base = base;
+    c->size = size;
+    c->fd = fd;
+    c->spans = size / BLOCK_CONTAINER_SPAN;
+    c->bitmap = bitmap;
+    return c;
+}
+
+// 在容器中找 n 个连续空闲 span（持锁），找不到返回 SIZE_MAX
+static size_t container_find(container_t *c, size_t n)
+{
+    if (c->spans - c->used < n)
+        return SIZE_MAX;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t start = pass == 0 ? c->hint : 0;
+        size_t end = pass == 0 ? c->spans : c->hint;
+        size_t run = 0;
+        for (size_t i = start; i < end; i++)
+        {
+            if (!(i % 64) && c->bitmap[i / 64] == UINT64_MAX)
+            {
+                run = 0;
+                i += 63;
+                continue;
+            }
+            run = bit_get(c->bitmap, i) ? 0 : run + 1;
+            if (run == n)
+                return i + 1 - n;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static container_t *container_of(const void *ptr)
+{
+    unsigned n = __atomic_load_n(&g_bc.count, __ATOMIC_ACQUIRE);
+    for (unsigned i = 0; i < n; i++)
+    {
+        container_t *c = g_bc.containers[i];
+        if ((const char *)ptr >= c->base && (const char *)ptr < c->base + c->size)
+            return c;
+    }
+    return NULL;
+}
+
+int block_container_open(const char *dir, uint64_t container_size)
+{
+    if (!dir || !*dir || strlen(dir) >= sizeof(g_bc.dir))
+        return -EINVAL;
+
+    pthread_mutex_lock(&g_bc.lock);
+    if (g_bc.enabled)
+    {
+        pthread_mutex_unlock(&g_bc.lock);
+        return -EBUSY;
+    }
+    strcpy(g_bc.dir, dir);
+    g_bc.page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (container_size < 64 * BLOCK_CONTAINER_SPAN)
+        container_size = 64 * BLOCK_CONTAINER_SPAN;
+    g_bc.container_size = (size_t)(container_size & ~(uint64_t)(BLOCK_CONTAINER_SPAN - 1));
+
+    container_t *c = container_create();
+    if (!c)
+    {
+        int err = errno ? -errno : -ENOMEM;
+        pthread_mutex_unlock(&g_bc.lock);
+        SBFS_LOG_ERROR("块容器：在 %s 建立容器失败: %s", dir, strerror(-err));
+        return err;
+    }
+    g_bc.containers[0] = c;
+    __atomic_store_n(&g_bc.count, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_bc.enabled, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_bc.lock);
+    SBFS_LOG_INFO("块容器：%s，每个容器 %zu MB", dir, g_bc.container_size >> 20);
+    return 0;
+}
+
+bool block_container_enabled(void)
+{
+    return __atomic_load_n(&g_bc.enabled, __ATOMIC_ACQUIRE);
+}
+
+void *block_container_map(size_t len)
+{
+    if (!block_container_enabled() || len == 0 || len % BLOCK_CONTAINER_SPAN)
+        return NULL;
+    size_t n = len / BLOCK_CONTAINER_SPAN;
+
+    pthread_mutex_lock(&g_bc.lock);
+    void *ptr = NULL;
+    for (unsigned i = 0; i <= g_bc.count && !ptr; i++)
+    {
+        container_t *c;
+        if (i == g_bc.count)
+        {
+            // 现有容器都放不下：新建一个
+            if (i == BLOCK_CONTAINER_MAX || n > g_bc.container_size / BLOCK_CONTAINER_SPAN ||
+                !(c = container_create()))
+                break;
+            g_bc.containers[i] = c;
+            __atomic_store_n(&g_bc.count, i + 1, __ATOMIC_RELEASE);
+        }
+        c = g_bc.containers[i];
+        size_t start = container_find(c, n);
+        if (start == SIZE_MAX)
+            continue;
+        bits_set(c->bitmap, start, n, true);
+        c->used += n;
+        c->hint = start + n < c->spans ? start + n : 0;
+        ptr = c->base + start * BLOCK_CONTAINER_SPAN;
+    }
+    if (!ptr)
+        g_bc.map_failures++;
+    pthread_mutex_unlock(&g_bc.lock);
+    return ptr;
+}
+
+void block_container_unmap(void *ptr, size_t len)
+{
+    container_t *c = ptr ? container_of(ptr) : NULL;
+    if (!c)
+        return;
+    size_t start = (size_t)((char *)ptr - c->base) / BLOCK_CONTAINER_SPAN;
+    size_t n = (len + BLOCK_CONTAINER_SPAN - 1) / BLOCK_CONTAINER_SPAN;
+
+    // 先打洞再标记空闲：span 被重新分配时读出的一定是零
+    block_container_discard(ptr, n * BLOCK_CONTAINER_SPAN);
+    pthread_mutex_lock(&g_bc.lock);
+    bits_set(c->bitmap, start, n, false);
+    c->used -= n;
+    pthread_mutex_unlock(&g_bc.lock);
+}
+
+bool block_container_owns(const void *ptr)
+{
+    return container_of(ptr) != NULL;
+}
+
+void block_container_discard(void *ptr, size_t len)
+{
+    container_t *c = container_of(ptr);
+    if (!c)
+        return;
+    uintptr_t mask = (uintptr_t)(g_bc.page_size - 1);
+    uintptr_t start = ((uintptr_t)ptr + mask) & ~mask;
+    uintptr_t end = ((uintptr_t)ptr + len) & ~mask;
+    if (end <= start)
+        return;
+    off_t off = (off_t)((char *)start - c->base);
+    if (fallocate(c->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, (off_t)(end - start)) != 0)
+        madvise((void *)start, end - start, MADV_REMOVE);
+    __atomic_add_fetch(&g_bc.discards, 1, __ATOMIC_RELAXED);
+}
+
+void block_container_advise(const void *ptr, size_t len, block_container_hint_t hint)
+{
+    if (!ptr || len == 0 || !container_of(ptr))
+        return;
+    uintptr_t mask = (uintptr_t)(g_bc.page_size - 1);
+    uintptr_t start, end;
+    if (hint == BLOCK_CONTAINER_WILLNEED)
+    {
+        // 预读覆盖对象所在的全部页
+        start = (uintptr_t)ptr & ~mask;
+        end = ((uintptr_t)ptr + len + mask) & ~mask;
+        madvise((void *)start, end - start, MADV_WILLNEED);
+        __atomic_add_fetch(&g_bc.willneed, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        // 只降级对象独占的整页，不波及同页的其他对象
+        start = ((uintptr_t)ptr + mask) & ~mask;
+        end = ((uintptr_t)ptr + len) & ~mask;
+        if (end <= start)
+            return;
+        madvise((void *)start, end - start, CONTAINER_MADV_COLD);
+        __atomic_add_fetch(&g_bc.cold, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int block_container_format_stats(char *buf, size_t size)
+{
+    if (!buf || size == 0)
+        return -1;
+    pthread_mutex_lock(&g_bc.lock);
+    size_t spans = 0, used = 0;
+    for (unsigned i = 0; i < g_bc.count; i++)
+    {
+        spans += g_bc.containers[i]->spans;
+        used += g_bc.containers[i]->used;
+    }
+    int n = snprintf(buf, size,
+                     "enabled=%d;containers=%u;mapped_bytes=%zu;spans=%zu;spans_used=%zu;discards=%llu;"
+                     "willneed=%llu;cold=%llu;map_failures=%llu",
+                     g_bc.enabled ? 1 : 0, g_bc.count, spans * BLOCK_CONTAINER_SPAN, spans, used,
+                     (unsigned long long)__atomic_load_n(&g_bc.discards, __ATOMIC_RELAXED),
+                     (unsigned long long)__atomic_load_n(&g_bc.willneed, __ATOMIC_RELAXED),
+                     (unsigned long long)__atomic_load_n(&g_bc.cold, __ATOMIC_RELAXED),
+                     (unsigned long long)g_bc.map_failures);
+    pthread_mutex_unlock(&g_bc.lock);
+    return (n >= 0 && (size_t)n < size) ? n : -1;
+}
@@ -0,0 +1,246 @@
+/**
+ * 智能备份文件系统 - 配置文件加载
+ */
+
+#include "config_loader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+
+#define CONFIG_MAX_DEPTH 8
+#define CONFIG_LINE_MAX 1024
+
+typedef struct {
+    char *key;
+    char *value;
+} config_entry_t;
+
+static config_entry_t *g_entries = NULL;
+static size_t g_entry_count = 0;
+
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+// 去掉行内注释（引号内的#保留）
+static void strip_comment(char *s)
+{
+    char quote = 0;
+    for (char *p = s; *p; p++)
+    {
+        if (quote)
+        {
+            if (*p == quote)
+                quote = 0;
+        }
+        else if (*p == '"' || *p == '\'')
+        {
+            quote = *p;
+        }
+        else if (*p == '#' && (p == s || isspace((unsigned char)p[-1])))
+        {
+            *p = '\0';
+            return;
+        }
+    }
+}
+
+static char *unquote(char *s)
+{
+    size_t len = strlen(s);
+    if (len >= 2 && (s[0] == '"' || s[0] == '\'') && s[len - 1] == s[0])
+    {
+        s[len - 1] = '\0';
+        return s + 1;
+    }
+    return s;
+}
+
+static int config_set(const char *key, const char *value)
+{
+    for (size_t i = 0; i < g_entry_count; i++)
+    {
+        if (strcmp(g_entries[i].key, key) == 0)
+        {
+            char *copy = strdup(value);
+            if (!copy)
+                return -ENOMEM;
+            free(g_entries[i].value);
+            g_entries[i].value = copy;
+            return 0;
+        }
+    }
+
+    config_entry_t *grown = realloc(g_entries, (g_entry_count + 1) * sizeof(config_entry_t));
+    if (!grown)
+        return -ENOMEM;
+    g_entries = grown;
+    g_entries[g_entry_count].key = strdup(key);
+    g_entries[g_entry_count].value = strdup(value);
+    if (!g_entries[g_entry_count].key || !g_entries[g_entry_count].value)
+    {
+        free(g_entries[g_entry_count].key);
+        free(g_entries[g_entry_count].value);
+        return -ENOMEM;
+    }
+    g_entry_count++;
+    return 0;
+}
+
+void config_free(void)
+{
+    for (size_t i = 0; i < g_entry_count; i++)
+    {
+        free(g_entries[i].key);
+        free(g_entries[i].value);
+    }
+    free(g_entries);
+    g_entries = NULL;
+    g_entry_count = 0;
+}
+
+int config_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -errno;
+
+    config_free();
+
+    // 每层缩进对应的键名，用于拼接点分路径
+    int indents[CONFIG_MAX_DEPTH];
+    char *names[CONFIG_MAX_DEPTH];
+    int depth = 0;
+    int ret = 0;
+    char line[CONFIG_LINE_MAX];
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        strip_comment(line);
+        int indent = 0;
+        while (line[indent] == ' ')
+            indent++;
+        char *text = trim(line);
+        if (*text == '\0' || *text == '-')
+            continue;   // 空行与列表项
+
+        char *colon = strchr(text, ':');
+        if (!colon)
+            continue;
+        *colon = '\0';
+        char *name = trim(text);
+        char *value = unquote(trim(colon + 1));
+
+        while (depth > 0 && indents[depth - 1] >= indent)
+            free(names[--depth]);
+
+        if (*value == '\0')
+        {
+            // 嵌套映射的起始键
+            if (depth < CONFIG_MAX_DEPTH)
+            {
+                indents[depth] = indent;
+                names[depth] = strdup(name);
+                if (!names[depth])
+                {
+                    ret = -ENOMEM;
+                    break;
+                }
+                depth++;
+            }
+            continue;
+        }
+
+        char key[CONFIG_LINE_MAX];
+        size_t used = 0;
+        key[0] = '\0';
+        for (int i = 0; i < depth; i++)
+            used += (size_t)snprintf(key + used, sizeof(key) - used, "%s.", names[i]);
+        snprintf(key + used, sizeof(key) - used, "%s", name);
+
+        ret = config_set(key, value);
+        if (ret != 0)
+            break;
+    }
+
+    while (depth > 0)
+        free(names[--depth]);
+    fclose(fp);
+    if (ret != 0)
+        config_free();
+    return ret;
+}
+
+const char *config_get(const char *key)
+{
+    for (size_t i = 0; i < g_entry_count; i++)
+    {
+        if (strcmp(g_entries[i].key, key) == 0)
+            return g_entries[i].value;
+    }
+    return NULL;
+}
+
+const char *config_get_string(const char *key, const char *def)
+{
+    const char *value = config_get(key);
+    return value ? value : def;
+}
+
+long config_get_int(const char *key, long def)
+{
+    const char *value = config_get(key);
+    if (!value)
+        return def;
+    char *end;
+    long n = strtol(value, &end, 10);
+    return (end == value) ? def : n;
+}
+
+bool config_get_bool(const char *key, bool def)
+{
+    const char *value = config_get(key);
+    if (!value)
+        return def;
+    if (strcasecmp(value, "true") == 0 || strcasecmp(value, "yes") == 0 || strcmp(value, "1") == 0)
+        return true;
+    if (strcasecmp(value, "false") == 0 || strcasecmp(value, "no") == 0 || strcmp(value, "0") == 0)
+        return false;
+    return def;
+}
+
+uint64_t config_get_size(const char *key, uint64_t def)
+{
+    const char *value = config_get(key);
+    if (!value)
+        return def;
+
+    char *end;
+    unsigned long long n = strtoull(value, &end, 10);
+    if (end == value)
+        return def;
+    while (isspace((unsigned char)*end))
+        end++;
+
+    uint64_t mult = 1;
+    switch (toupper((unsigned char)*end))
+    {
+    case 'K': mult = 1ULL << 10; break;
+    case 'M': mult = 1ULL << 20; break;
+    case 'G': mult = 1ULL << 30; break;
+    case 'T': mult = 1ULL << 40; break;
+    case 'B':
+    case '\0': break;
+    default: return def;
+    }
+    return (uint64_t)n * mult;
+}
@@ -0,0 +1,750 @@
+/**
+ * 智能备份文件系统 - 模块A：批量二进制控制通道
+ * 请求格式见 smartbackupfs_ctl.h。命令按操作码查表分发；
+ * 按inode编号给出的目标经inode表直接查找，不遍历目录树。
+ */
+
+#include "smartbackupfs_ctl.h"
+#include "version_manager.h"
+#include "logger.h"
+#include "inode_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// 全局文件系统状态
+extern fs_state_t fs_state;
+
+// 扩展属性（按名称查表分发，见 smartbackupfs_basic.c）
+extern int smartbackupfs_xattr_get(file_metadata_t *meta, const char *name, char *value, size_t size);
+extern int smartbackupfs_xattr_set(file_metadata_t *meta, const char *name, const char *value, size_t size, int flags);
+extern int smartbackupfs_xattr_remove(file_metadata_t *meta, const char *name);
+
+#define CTL_XATTR_NAME_MAX 255
+
+static directory_t *ctl_dir = NULL;
+static file_metadata_t *ctl_file = NULL;
+
+// 控制文件会话：请求收齐后执行，响应缓存在会话中供顺序读取
+struct ctl_session {
+    pthread_mutex_t lock;
+    char *req;
+    size_t req_len;
+    size_t req_cap;
+    char *resp;
+    size_t resp_len;
+    size_t resp_pos;
+};
+
+// 响应缓冲（追加的每段都补齐到 8 字节）
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int err;
+} ctl_buf_t;
+
+// 请求游标（各段按 8 字节对齐）
+typedef struct {
+    const char *data;
+    size_t len;
+    size_t pos;
+} ctl_reader_t;
+
+// 解析后的目标
+typedef struct {
+    uint64_t ino;
+    const char *path;
+    uint32_t path_len;
+} ctl_target_t;
+
+typedef int (*ctl_op_fn)(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                         ctl_buf_t *out, uint32_t *count);
+
+typedef struct {
+    const char *name;
+    ctl_op_fn run;
+} ctl_op_t;
+
+// ---------------------------------------------------------------------------
+// 控制目录
+
+static void ctl_init_meta(file_metadata_t *meta, file_type_t type, mode_t mode, nlink_t nlink)
+{
+    meta->ino = inode_alloc_ino();
+    meta->type = type;
+    meta->mode = mode;
+    meta->nlink = nlink;
+    meta->uid = getuid();
+    meta->gid = getgid();
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+    meta->mtime = meta->atime;
+    meta->ctime = meta->atime;
+}
+
+int ctl_init(void)
+{
+    directory_t *dir = calloc(1, sizeof(directory_t));
+    file_metadata_t *file = calloc(1, sizeof(file_metadata_t));
+    if (!dir || !file)
+    {
+        free(dir);
+        free(file);
+        return -ENOMEM;
+    }
+
+    ctl_init_meta(&dir->meta, FT_DIRECTORY, S_IFDIR | 0555, 2);
+    dir->meta.size = DEFAULT_BLOCK_SIZE;
+    dir->meta.blocks = 1;
+    dir->meta.parent_ino = fs_state.root->meta.ino;
+    pthread_rwlock_init(&dir->lock, NULL);
+
+    // 仅挂载用户可读写：经控制文件设置扩展属性不再逐文件检查权限
+    ctl_init_meta(file, FT_CONTROL, S_IFREG | 0600, 1);
+    file->parent_ino = dir->meta.ino;
+
+    dir_entry_t *file_entry = dir_entry_create(SBFS_CTL_FILE_NAME, file);
+    dir_entry_t *dir_entry = dir_entry_create(SBFS_CTL_DIR_NAME, &dir->meta);
+    int ret = (file_entry && dir_entry) ? 0 : -ENOMEM;
+    if (ret == 0)
+        ret = inode_table_insert(&dir->meta);
+    if (ret == 0)
+        ret = inode_table_insert(file);
+
+    if (ret == 0)
+    {
+        pthread_rwlock_wrlock(&dir->lock);
+        ret = directory_insert_entry_locked(dir, file_entry);
+        pthread_rwlock_unlock(&dir->lock);
+    }
+    if (ret == 0)
+    {
+        file_entry = NULL;
+        pthread_rwlock_wrlock(&fs_state.root->lock);
+        ret = directory_insert_entry_locked(fs_state.root, dir_entry);
+        pthread_rwlock_unlock(&fs_state.root->lock);
+    }
+    if (ret != 0)
+    {
+        dir_entry_free(dir_entry);
+        dir_entry_free(file_entry);
+        inode_table_remove(&dir->meta);
+        inode_table_remove(file);
+        directory_destroy_index(dir);
+        pthread_rwlock_destroy(&dir->lock);
+        free(dir);
+        free(file);
+        return ret;
+    }
+
+    ctl_dir = dir;
+    ctl_file = file;
+    FS_STAT_ADD(total_dirs, 1);
+    return 0;
+}
+
+bool ctl_is_reserved(const file_metadata_t *meta)
+{
+    return meta && (meta == ctl_file || (ctl_dir && meta == &ctl_dir->meta));
+}
+
+// ---------------------------------------------------------------------------
+// 请求解析与响应构造
+
+static const void *ctl_take(ctl_reader_t *r, size_t n)
+{
+    size_t need = SBFS_CTL_PAD(n);
+    if (need < n || r->len - r->pos < need)
+        return NULL;
+    const void *p = r->data + r->pos;
+    r->pos += need;
+    return p;
+}
+
+// 读取下一个目标：返回1取到，0已结束，负errno为格式错误
+static int ctl_next_target(ctl_reader_t *r, ctl_target_t *t)
+{
+    if (r->pos == r->len)
+        return 0;
+
+    struct sbfs_ctl_target raw;
+    const void *p = ctl_take(r, sizeof(raw));
+    if (!p)
+        return -EINVAL;
+    memcpy(&raw, p, sizeof(raw));
+
+    t->ino = raw.ino;
+    t->path_len = raw.path_len;
+    t->path = NULL;
+    if (raw.path_len > 0)
+    {
+        t->path = ctl_take(r, raw.path_len);
+        if (!t->path)
+            return -EINVAL;
+    }
+    return 1;
+}
+
+// 取 XATTR 命令的属性名与值
+static int ctl_take_xattr(ctl_reader_t *r, char *name, const char **value, uint32_t *value_len)
+{
+    struct sbfs_ctl_xattr raw;
+    const void *p = ctl_take(r, sizeof(raw));
+    if (!p)
+        return -EINVAL;
+    memcpy(&raw, p, sizeof(raw));
+
+    if (raw.name_len == 0 || raw.name_len > CTL_XATTR_NAME_MAX)
+        return -ERANGE;
+    const char *n = ctl_take(r, raw.name_len);
+    if (!n)
+        return -EINVAL;
+    memcpy(name, n, raw.name_len);
+    name[raw.name_len] = '\0';
+
+    *value = NULL;
+    *value_len = raw.value_len;
+    if (raw.value_len > 0)
+    {
+        *value = ctl_take(r, raw.value_len);
+        if (!*value)
+            return -EINVAL;
+    }
+    return 0;
+}
+
+// 取 CLONE 命令的区间参数
+static int ctl_take_clone(ctl_reader_t *r, struct sbfs_ctl_clone *clone)
+{
+    const void *p = ctl_take(r, sizeof(*clone));
+    if (!p)
+        return -EINVAL;
+    memcpy(clone, p, sizeof(*clone));
+    if (clone->src_off > INT64_MAX || clone->dst_off > INT64_MAX)
+        return -EINVAL;
+    return 0;
+}
+
+// 追加 n 字节（补齐并清零），返回该段在缓冲中的偏移；失败返回 SIZE_MAX
+static size_t ctl_buf_reserve(ctl_buf_t *b, size_t n)
+{
+    size_t need = SBFS_CTL_PAD(n);
+    if (b->err)
+        return SIZE_MAX;
+    if (b->len + need > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + need)
+            cap *= 2;
+        char *p = realloc(b->data, cap);
+        if (!p)
+        {
+            b->err = -ENOMEM;
+            return SIZE_MAX;
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    size_t off = b->len;
+    memset(b->data + off, 0, need);
+    b->len += need;
+    return off;
+}
+
+static void ctl_put_status(ctl_buf_t *out, uint64_t ino, int status, uint32_t value)
+{
+    struct sbfs_ctl_status rec = {.ino = ino, .status = status, .value = value};
+    size_t off = ctl_buf_reserve(out, sizeof(rec));
+    if (off != SIZE_MAX)
+        memcpy(out->data + off, &rec, sizeof(rec));
+}
+
+// ---------------------------------------------------------------------------
+// 目标解析：inode编号经inode表O(1)查找，路径经路径解析
+
+static file_metadata_t *ctl_resolve(const ctl_target_t *t, int *err)
+{
+    if (t->ino)
+    {
+        // 已删除但仍被打开的文件还登记在表中，不再作为目标
+        file_metadata_t *meta = inode_table_get(t->ino);
+        if (meta && meta->nlink == 0)
+            meta = NULL;
+        if (!meta)
+            *err = -ENOENT;
+        return meta;
+    }
+
+    if (t->path_len == 0 || t->path_len >= MAX_PATH_LEN)
+    {
+        *err = -EINVAL;
+        return NULL;
+    }
+    char path[MAX_PATH_LEN];
+    memcpy(path, t->path, t->path_len);
+    path[t->path_len] = '\0';
+
+    file_metadata_t *meta = lookup_path(path);
+    if (!meta)
+        *err = -ENOENT;
+    return meta;
+}
+
+// ---------------------------------------------------------------------------
+// 命令实现
+
+// 对子树内所有普通文件建版（持有目录读锁，与 unlink/rename 的“目录锁→版本链锁”顺序一致）
+static void ctl_snapshot_tree(directory_t *dir, uint32_t *created, int *err)
+{
+    pthread_rwlock_rdlock(&dir->lock);
+    for (dir_entry_t *e = dir->entries; e; e = e->next)
+    {
+        file_metadata_t *meta = e->meta;
+        if (meta->type == FT_DIRECTORY)
+        {
+            ctl_snapshot_tree((directory_t *)meta, created, err);
+        }
+        else if (meta->type == FT_REGULAR)
+        {
+            int r = version_manager_create_manual(meta, "ctl-snapshot");
+            if (r == 0)
+                (*created)++;
+            else if (*err == 0)
+                *err = r;
+        }
+    }
+    pthread_rwlock_unlock(&dir->lock);
+}
+
+static int ctl_op_snapshot(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                           ctl_buf_t *out, uint32_t *count)
+{
+    ctl_target_t t;
+    int r;
+    while ((r = ctl_next_target(payload, &t)) > 0)
+    {
+        int status = 0;
+        uint32_t created = 0;
+        file_metadata_t *meta = ctl_resolve(&t, &status);
+        if (meta && meta->type == FT_DIRECTORY)
+        {
+            if (cmd->flags & SBFS_CTL_F_RECURSIVE)
+                ctl_snapshot_tree((directory_t *)meta, &created, &status);
+            else
+                status = -EISDIR;
+        }
+        else if (meta && meta->type == FT_REGULAR)
+        {
+            status = version_manager_create_manual(meta, "ctl-snapshot");
+            created = status == 0 ? 1 : 0;
+        }
+        else if (meta)
+        {
+            status = -EINVAL;
+        }
+        ctl_put_status(out, meta ? meta->ino : t.ino, status, created);
+        (*count)++;
+    }
+    return r;
+}
+
+static int ctl_op_pin(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                      ctl_buf_t *out, uint32_t *count)
+{
+    ctl_target_t t;
+    int r;
+    while ((r = ctl_next_target(payload, &t)) > 0)
+    {
+        int status = 0;
+        file_metadata_t *meta = ctl_resolve(&t, &status);
+        if (meta && ctl_is_reserved(meta))
+        {
+            status = -EPERM;
+        }
+        else if (meta && (cmd->flags & SBFS_CTL_F_UNPIN))
+        {
+            status = smartbackupfs_xattr_remove(meta, "user.version.pinned");
+            if (status == -ENODATA)
+                status = 0;
+        }
+        else if (meta)
+        {
+            status = smartbackupfs_xattr_set(meta, "user.version.pinned", "1", 1, 0);
+        }
+        ctl_put_status(out, meta ? meta->ino : t.ino, status, 0);
+        (*count)++;
+    }
+    return r;
+}
+
+static int ctl_op_stats(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                        ctl_buf_t *out, uint32_t *count)
+{
+    (void)cmd;
+
+    ctl_target_t t;
+    int r;
+    while ((r = ctl_next_target(payload, &t)) > 0)
+    {
+        struct sbfs_ctl_stat rec;
+        memset(&rec, 0, sizeof(rec));
+        int status = 0;
+        file_metadata_t *meta = ctl_resolve(&t, &status);
+        rec.ino = t.ino;
+        rec.status = status;
+        if (meta)
+        {
+            rec.ino = meta->ino;
+            rec.size = (uint64_t)meta->size;
+            rec.blocks = (uint64_t)meta->blocks;
+            const file_meta_ext_t *ext = file_meta_ext(meta);
+            rec.version_count = ext->version_count;
+            rec.latest_version_id = ext->latest_version_id;
+            rec.last_version_time = (int64_t)ext->last_version_time;
+            rec.mtime_sec = (int64_t)meta->mtime.tv_sec;
+            rec.mtime_nsec = (uint32_t)meta->mtime.tv_nsec;
+            rec.mode = (uint32_t)meta->mode;
+            rec.type = (uint8_t)meta->type;
+            rec.pinned = ext->version_pinned ? 1 : 0;
+        }
+        size_t off = ctl_buf_reserve(out, sizeof(rec));
+        if (off != SIZE_MAX)
+            memcpy(out->data + off, &rec, sizeof(rec));
+        (*count)++;
+    }
+    return r;
+}
+
+static int ctl_op_xattr_get(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                            ctl_buf_t *out, uint32_t *count)
+{
+    (void)cmd;
+
+    char name[CTL_XATTR_NAME_MAX + 1];
+    const char *value;
+    uint32_t value_len;
+    int r = ctl_take_xattr(payload, name, &value, &value_len);
+    if (r != 0)
+        return r;
+
+    ctl_target_t t;
+    while ((r = ctl_next_target(payload, &t)) > 0)
+    {
+        int status = 0;
+        file_metadata_t *meta = ctl_resolve(&t, &status);
+        uint64_t ino = meta ? meta->ino : t.ino;
+        (*count)++;
+
+        int len = meta ? smartbackupfs_xattr_get(meta, name, NULL, 0) : status;
+        if (len < 0)
+        {
+            ctl_put_status(out, ino, len, 0);
+            continue;
+        }
+
+        // 先占位记录，值紧随其后直接写入响应缓冲
+        size_t rec_off = ctl_buf_reserve(out, sizeof(struct sbfs_ctl_status));
+        size_t val_off = ctl_buf_reserve(out, (size_t)len);
+        if (rec_off == SIZE_MAX || val_off == SIZE_MAX)
+            continue;
+        int got = smartbackupfs_xattr_get(meta, name, out->data + val_off, (size_t)len);
+        if (got < 0)
+            out->len = val_off;
+        else if ((size_t)got < (size_t)len)
+            out->len = val_off + SBFS_CTL_PAD((size_t)got);
+
+        struct sbfs_ctl_status rec = {.ino = ino,
+                                      .status = got < 0 ? got : 0,
+                                      .value = got < 0 ? 0 : (uint32_t)got};
+        memcpy(out->data + rec_off, &rec, sizeof(rec));
+    }
+    return r;
+}
+
+static int ctl_op_xattr_set(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                            ctl_buf_t *out, uint32_t *count)
+{
+    (void)cmd;
+
+    char name[CTL_XATTR_NAME_MAX + 1];
+    const char *value;
+    uint32_t value_len;
+    int r = ctl_take_xattr(payload, name, &value, &value_len);
+    if (r != 0)
+        return r;
+
+    ctl_target_t t;
+    while ((r = ctl_next_target(payload, &t)) > 0)
+    {
+        int status = 0;
+        file_metadata_t *meta = ctl_resolve(&t, &status);
+        if (meta && ctl_is_reserved(meta))
+            status = -EPERM;
+        else if (meta)
+            status = smartbackupfs_xattr_set(meta, name, value ? value : "", value_len, 0);
+        ctl_put_status(out, meta ? meta->ino : t.ino, status, 0);
+        (*count)++;
+    }
+    return r;
+}
+
+// 成对克隆：块对齐部分只增加数据块引用，整批请求不拷贝文件数据
+static int ctl_op_clone(const struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload,
+                        ctl_buf_t *out, uint32_t *count)
+{
+    (void)cmd;
+
+    struct sbfs_ctl_clone clone;
+    int r = ctl_take_clone(payload, &clone);
+    if (r != 0)
+        return r;
+
+    ctl_target_t src_t, dst_t;
+    while ((r = ctl_next_target(payload, &src_t)) > 0)
+    {
+        r = ctl_next_target(payload, &dst_t);
+        if (r <= 0)
+            return -EINVAL;
+
+        int status = 0;
+        int64_t bytes = 0;
+        file_metadata_t *src = ctl_resolve(&src_t, &status);
+        file_metadata_t *dst = ctl_resolve(&dst_t, &status);
+        if (src && dst)
+        {
+            size_t len = clone.length ? (size_t)clone.length : SIZE_MAX;
+            ssize_t n = file_clone_range(src, (off_t)clone.src_off, dst, (off_t)clone.dst_off, len);
+            if (n < 0)
+                status = (int)n;
+            else
+                bytes = n;
+            if (n > 0)
+                version_manager_maybe_change_snapshot(dst);
+        }
+
+        struct sbfs_ctl_clone_status rec = {.ino = dst ? dst->ino : dst_t.ino,
+                                            .status = status,
+                                            .bytes = (uint64_t)bytes};
+        size_t off = ctl_buf_reserve(out, sizeof(rec));
+        if (off != SIZE_MAX)
+            memcpy(out->data + off, &rec, sizeof(rec));
+        (*count)++;
+    }
+    return r;
+}
+
+// 操作码分发表
+static const ctl_op_t ctl_ops[SBFS_CTL_OP_MAX] = {
+    [SBFS_CTL_OP_SNAPSHOT] = {"snapshot", ctl_op_snapshot},
+    [SBFS_CTL_OP_PIN] = {"pin", ctl_op_pin},
+    [SBFS_CTL_OP_STATS] = {"stats", ctl_op_stats},
+    [SBFS_CTL_OP_XATTR_GET] = {"xattr_get", ctl_op_xattr_get},
+    [SBFS_CTL_OP_XATTR_SET] = {"xattr_set", ctl_op_xattr_set},
+    [SBFS_CTL_OP_CLONE] = {"clone", ctl_op_clone},
+};
+
+static const ctl_op_t *ctl_lookup_op(uint16_t op)
+{
+    return (op < SBFS_CTL_OP_MAX && ctl_ops[op].run) ? &ctl_ops[op] : NULL;
+}
+
+// ---------------------------------------------------------------------------
+// 请求执行
+
+// 逐个取命令；返回1取到，0已结束，负errno为格式错误
+static int ctl_next_cmd(ctl_reader_t *r, struct sbfs_ctl_cmd *cmd, ctl_reader_t *payload)
+{
+    if (r->pos == r->len)
+        return 0;
+    if (r->len - r->pos < sizeof(*cmd))
+        return -EINVAL;
+    memcpy(cmd, r->data + r->pos, sizeof(*cmd));
+    if (cmd->length < sizeof(*cmd) || cmd->length % SBFS_CTL_ALIGN != 0 ||
+        cmd->length > r->len - r->pos)
+        return -EINVAL;
+
+    payload->data = r->data + r->pos + sizeof(*cmd);
+    payload->len = cmd->length - sizeof(*cmd);
+    payload->pos = 0;
+    r->pos += cmd->length;
+    return 1;
+}
+
+int ctl_execute(const char *req, size_t len, char **out, size_t *out_len)
+{
+    if (!req || !out || !out_len)
+        return -EINVAL;
+
+    struct sbfs_ctl_header hdr;
+    if (len < sizeof(hdr) || len > SBFS_CTL_MAX_REQUEST)
+        return -EINVAL;
+    memcpy(&hdr, req, sizeof(hdr));
+    if (hdr.magic != SBFS_CTL_MAGIC || hdr.version != SBFS_CTL_VERSION || hdr.length != len)
+        return -EINVAL;
+
+    ctl_reader_t cmds = {.data = req + sizeof(hdr), .len = len - sizeof(hdr), .pos = 0};
+    ctl_buf_t buf;
+    memset(&buf, 0, sizeof(buf));
+    ctl_buf_reserve(&buf, sizeof(hdr));
+
+    struct sbfs_ctl_cmd cmd;
+    ctl_reader_t payload;
+    uint32_t results = 0;
+    while (ctl_next_cmd(&cmds, &cmd, &payload) > 0)
+    {
+        size_t res_off = ctl_buf_reserve(&buf, sizeof(struct sbfs_ctl_result));
+        if (res_off == SIZE_MAX)
+            break;
+
+        struct sbfs_ctl_result result = {.op = cmd.op, .flags = cmd.flags};
+        const ctl_op_t *op = ctl_lookup_op(cmd.op);
+        result.status = op ? op->run(&cmd, &payload, &buf, &result.count) : -EOPNOTSUPP;
+        if (result.status != 0)
+            SBFS_LOG_DEBUG("控制命令 %s(%u) 失败: %d", op ? op->name : "unknown",
+                           (unsigned)cmd.op, result.status);
+        if (buf.err)
+            break;
+
+        result.length = (uint32_t)(buf.len - res_off);
+        memcpy(buf.data + res_off, &result, sizeof(result));
+        results++;
+    }
+
+    if (buf.err || buf.len > UINT32_MAX)
+    {
+        free(buf.data);
+        return buf.err ? buf.err : -E2BIG;
+    }
+
+    hdr.length = (uint32_t)buf.len;
+    hdr.count = results;
+    hdr.flags = 0;
+    memcpy(buf.data, &hdr, sizeof(hdr));
+    *out = buf.data;
+    *out_len = buf.len;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 会话
+
+ctl_session_t *ctl_session_create(void)
+{
+    ctl_session_t *session = calloc(1, sizeof(ctl_session_t));
+    if (!session)
+        return NULL;
+    pthread_mutex_init(&session->lock, NULL);
+    return session;
+}
+
+void ctl_session_destroy(ctl_session_t *session)
+{
+    if (!session)
+        return;
+    pthread_mutex_destroy(&session->lock);
+    free(session->req);
+    free(session->resp);
+    free(session);
+}
+
+static void ctl_session_reset_req(ctl_session_t *session)
+{
+    free(session->req);
+    session->req = NULL;
+    session->req_len = 0;
+    session->req_cap = 0;
+}
+
+int ctl_session_write(ctl_session_t *session, const char *buf, size_t size)
+{
+    if (!session || (!buf && size))
+        return -EINVAL;
+
+    pthread_mutex_lock(&session->lock);
+
+    // 新请求开始时丢弃上一请求未读完的响应
+    if (session->req_len == 0 && session->resp)
+    {
+        free(session->resp);
+        session->resp = NULL;
+        session->resp_len = 0;
+        session->resp_pos = 0;
+    }
+
+    if (size > SBFS_CTL_MAX_REQUEST - session->req_len)
+    {
+        ctl_session_reset_req(session);
+        pthread_mutex_unlock(&session->lock);
+        return -E2BIG;
+    }
+    if (session->req_len + size > session->req_cap)
+    {
+        size_t cap = session->req_cap ? session->req_cap : 4096;
+        while (cap < session->req_len + size)
+            cap *= 2;
+        char *p = realloc(session->req, cap);
+        if (!p)
+        {
+            pthread_mutex_unlock(&session->lock);
+            return -ENOMEM;
+        }
+        session->req = p;
+        session->req_cap = cap;
+    }
+    memcpy(session->req + session->req_len, buf, size);
+    session->req_len += size;
+
+    int ret = (int)size;
+    if (session->req_len >= sizeof(struct sbfs_ctl_header))
+    {
+        struct sbfs_ctl_header hdr;
+        memcpy(&hdr, session->req, sizeof(hdr));
+        if (hdr.magic != SBFS_CTL_MAGIC || hdr.length < sizeof(hdr) ||
+            hdr.length > SBFS_CTL_MAX_REQUEST || session->req_len > hdr.length)
+        {
+            ctl_session_reset_req(session);
+            ret = -EINVAL;
+        }
+        else if (session->req_len == hdr.length)
+        {
+            int r = ctl_execute(session->req, session->req_len, &session->resp, &session->resp_len);
+            ctl_session_reset_req(session);
+            if (r < 0)
+                ret = r;
+        }
+    }
+
+    pthread_mutex_unlock(&session->lock);
+    return ret;
+}
+
+int ctl_session_read(ctl_session_t *session, char *buf, size_t size)
+{
+    if (!session || (!buf && size))
+        return -EINVAL;
+
+    pthread_mutex_lock(&session->lock);
+    size_t n = 0;
+    if (session->resp)
+    {
+        n = session->resp_len - session->resp_pos;
+        if (n > size)
+            n = size;
+        memcpy(buf, session->resp + session->resp_pos, n);
+        session->resp_pos += n;
+        if (session->resp_pos == session->resp_len)
+        {
+            free(session->resp);
+            session->resp = NULL;
+            session->resp_len = 0;
+            session->resp_pos = 0;
+        }
+    }
+    pthread_mutex_unlock(&session->lock);
+    return (int)n;
+}
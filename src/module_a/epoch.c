@@ -0,0 +1,266 @@
+/**
+ * 智能备份文件系统 - 模块A：基于纪元的延迟回收
+ */
+
+#include "epoch.h"
+#include "logger.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+// 每个线程累积多少个退休对象后尝试推进纪元并回收
+#define EPOCH_RECLAIM_BATCH 64
+
+typedef struct epoch_node {
+    void *ptr;
+    epoch_free_fn fn;
+    uint64_t epoch;              // 退休时的全局纪元
+    struct epoch_node *next;
+} epoch_node_t;
+
+// 线程记录：挂在全局链表上不释放，线程退出后由新线程复用
+typedef struct epoch_record {
+    uint64_t state;              // (纪元 << 1) | 1 表示处于临界区，0 表示不在
+    unsigned int nest;           // 嵌套深度，仅本线程访问
+    int in_use;
+    epoch_node_t *limbo;         // 本线程退休、尚未释放的对象
+    size_t limbo_count;
+    size_t reclaim_at;           // 待回收数达到该值时尝试回收
+    struct epoch_record *next;
+} epoch_record_t;
+
+static uint64_t g_epoch = 1;
+static epoch_record_t *g_records;
+static pthread_mutex_t g_orphan_lock = PTHREAD_MUTEX_INITIALIZER;
+static epoch_node_t *g_orphans;  // 已退出线程遗留的待回收对象
+
+static _Thread_local epoch_record_t *tls_record;
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+// 线程退出：未回收的对象转入全局遗留链表，记录交还复用
+static void record_release(void *arg)
+{
+    epoch_record_t *rec = arg;
+    if (rec->limbo)
+    {
+        epoch_node_t *tail = rec->limbo;
+        while (tail->next)
+            tail = tail->next;
+        pthread_mutex_lock(&g_orphan_lock);
+        tail->next = g_orphans;
+        __atomic_store_n(&g_orphans, rec->limbo, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_orphan_lock);
+    }
+    rec->limbo = NULL;
+    rec->limbo_count = 0;
+    rec->reclaim_at = EPOCH_RECLAIM_BATCH;
+    rec->nest = 0;
+    __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&rec->in_use, 0, __ATOMIC_RELEASE);
+    tls_record = NULL;
+}
+
+static void record_key_create(void)
+{
+    pthread_key_create(&record_key, record_release);
+}
+
+static epoch_record_t *epoch_record(void)
+{
+    if (tls_record)
+        return tls_record;
+
+    pthread_once(&record_key_once, record_key_create);
+
+    epoch_record_t *rec = __atomic_load_n(&g_records, __ATOMIC_ACQUIRE);
+    for (; rec; rec = rec->next)
+    {
+        int expected = 0;
+        if (__atomic_load_n(&rec->in_use, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&rec->in_use, &expected, 1, false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (!rec)
+    {
+        rec = calloc(1, sizeof(epoch_record_t));
+        if (!rec)
+            return NULL;
+        rec->in_use = 1;
+        rec->reclaim_at = EPOCH_RECLAIM_BATCH;
+        rec->next = __atomic_load_n(&g_records, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&g_records, &rec->next, rec, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    pthread_setspecific(record_key, rec);
+    tls_record = rec;
+    return rec;
+}
+
+bool epoch_enter(void)
+{
+    epoch_record_t *rec = epoch_record();
+    if (!rec)
+        return false;
+    if (rec->nest++ > 0)
+        return true;
+
+    // 登记后复查全局纪元：登记前纪元若已前进，按新纪元重新登记，
+    // 保证登记生效时全局纪元至多比登记值大一
+    uint64_t e = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+    for (;;)
+    {
+        __atomic_store_n(&rec->state, (e << 1) | 1, __ATOMIC_SEQ_CST);
+        uint64_t now = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+        if (now == e)
+            break;
+        e = now;
+    }
+    return true;
+}
+
+void epoch_exit(void)
+{
+    epoch_record_t *rec = tls_record;
+    if (rec && rec->nest > 0 && --rec->nest == 0)
+        __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+// 所有处于临界区的线程都已观察到当前纪元时推进一步，返回推进后（或当前）的纪元
+static uint64_t epoch_try_advance(void)
+{
+    uint64_t e = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+    for (epoch_record_t *rec = __atomic_load_n(&g_records, __ATOMIC_ACQUIRE); rec; rec = rec->next)
+    {
+        uint64_t s = __atomic_load_n(&rec->state, __ATOMIC_SEQ_CST);
+        if ((s & 1) && (s >> 1) != e)
+            return e;
+    }
+    if (__atomic_compare_exchange_n(&g_epoch, &e, e + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        return e + 1;
+    return e;
+}
+
+// 从链表摘下在纪元 epoch 时已可释放的对象（退休纪元 + 2 <= epoch）
+static epoch_node_t *limbo_detach_ready(epoch_node_t **head, uint64_t epoch, size_t *count)
+{
+    epoch_node_t *ready = NULL;
+    epoch_node_t **pp = head;
+    while (*pp)
+    {
+        epoch_node_t *node = *pp;
+        if (node->epoch + 2 <= epoch)
+        {
+            *pp = node->next;
+            node->next = ready;
+            ready = node;
+            if (count)
+                (*count)--;
+        }
+        else
+        {
+            pp = &node->next;
+        }
+    }
+    return ready;
+}
+
+// 释放函数可能再次退休对象，因此先整体摘下再逐个调用
+static void limbo_free(epoch_node_t *node)
+{
+    while (node)
+    {
+        epoch_node_t *next = node->next;
+        node->fn(node->ptr);
+        free(node);
+        node = next;
+    }
+}
+
+static void epoch_reclaim(epoch_record_t *rec)
+{
+    epoch_try_advance();
+    uint64_t e = epoch_try_advance();
+
+    epoch_node_t *ready = limbo_detach_ready(&rec->limbo, e, &rec->limbo_count);
+    rec->reclaim_at = rec->limbo_count + EPOCH_RECLAIM_BATCH;
+
+    epoch_node_t *orphans = NULL;
+    if (__atomic_load_n(&g_orphans, __ATOMIC_RELAXED) && pthread_mutex_trylock(&g_orphan_lock) == 0)
+    {
+        orphans = limbo_detach_ready(&g_orphans, e, NULL);
+        pthread_mutex_unlock(&g_orphan_lock);
+    }
+
+    limbo_free(ready);
+    limbo_free(orphans);
+}
+
+void epoch_retire(void *ptr, epoch_free_fn fn)
+{
+    if (!ptr)
+        return;
+
+    epoch_record_t *rec = epoch_record();
+    epoch_node_t *node = rec ? malloc(sizeof(epoch_node_t)) : NULL;
+    if (!node)
+    {
+        // 无法登记：同步等待现有读者离开后直接释放；自身处于临界区时无法等待，只能放弃回收
+        if (rec && rec->nest > 0)
+        {
+            SBFS_LOG_WARN("纪元回收登记失败，对象 %p 未释放", ptr);
+            return;
+        }
+        epoch_synchronize();
+        fn(ptr);
+        return;
+    }
+
+    node->ptr = ptr;
+    node->fn = fn;
+    node->epoch = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+    node->next = rec->limbo;
+    rec->limbo = node;
+    if (++rec->limbo_count >= rec->reclaim_at)
+        epoch_reclaim(rec);
+}
+
+void epoch_synchronize(void)
+{
+    uint64_t target = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST) + 2;
+    while (epoch_try_advance() < target)
+        sched_yield();
+}
+
+void epoch_shutdown(void)
+{
+    bool pending = true;
+    while (pending)
+    {
+        pending = false;
+        for (epoch_record_t *rec = __atomic_load_n(&g_records, __ATOMIC_ACQUIRE); rec; rec = rec->next)
+        {
+            epoch_node_t *list = rec->limbo;
+            rec->limbo = NULL;
+            rec->limbo_count = 0;
+            rec->reclaim_at = EPOCH_RECLAIM_BATCH;
+            if (list)
+                pending = true;
+            limbo_free(list);
+        }
+
+        pthread_mutex_lock(&g_orphan_lock);
+        epoch_node_t *orphans = g_orphans;
+        __atomic_store_n(&g_orphans, NULL, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_orphan_lock);
+        if (orphans)
+            pending = true;
+        limbo_free(orphans);
+    }
+}
@@ -0,0 +1,515 @@
+/**
+ * 智能备份文件系统 - 模块A：64位键哈希表（Robin Hood 开放寻址，渐进式扩容）
+ */
+
+#include "hash_table.h"
+#include "epoch.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define HASH_TABLE_MIN_SIZE 16
+// 每次写操作顺带迁移的旧槽数
+#define HASH_MIGRATE_STEP 32
+
+// 并发表的槽数组可能仍被乐观读者访问，经纪元延迟释放
+static void table_free_slots(hash_table_t *table, hash_slot_t *slots)
+{
+    if (table->concurrent)
+        epoch_retire(slots, free);
+    else
+        free(slots);
+}
+
+static inline bool slot_live(const hash_slot_t *slot)
+{
+    return slot->dist != 0 && slot->value != NULL;
+}
+
+// 在槽数组中查找键：遇到空槽或探测距离更短的槽即可停止（Robin Hood 不变式）
+static hash_slot_t *slots_find(hash_slot_t *slots, size_t size, uint64_t key, uint64_t hash)
+{
+    size_t mask = size - 1;
+    size_t idx = hash & mask;
+    for (uint32_t dist = 1;; dist++)
+    {
+        hash_slot_t *slot = &slots[idx];
+        if (slot->dist < dist)
+            return NULL;
+        if (slot->value && slot->key == key)
+            return slot;
+        idx = (idx + 1) & mask;
+    }
+}
+
+// 插入调用方确认不存在的键；探测距离更长的条目抢占较短者的位置
+static void slots_insert(hash_slot_t *slots, size_t size, uint64_t key, void *value, uint64_t hash)
+{
+    size_t mask = size - 1;
+    size_t idx = hash & mask;
+    hash_slot_t cur = {.key = key, .value = value, .dist = 1};
+    for (;;)
+    {
+        hash_slot_t *slot = &slots[idx];
+        if (slot->dist == 0)
+        {
+            *slot = cur;
+            return;
+        }
+        if (slot->dist < cur.dist)
+        {
+            hash_slot_t tmp = *slot;
+            *slot = cur;
+            cur = tmp;
+        }
+        idx = (idx + 1) & mask;
+        cur.dist++;
+    }
+}
+
+// 删除后把后继条目逐个前移，保持探测序列连续，不留墓碑
+static void slots_erase(hash_slot_t *slots, size_t size, hash_slot_t *slot)
+{
+    size_t mask = size - 1;
+    size_t idx = (size_t)(slot - slots);
+    for (;;)
+    {
+        size_t next = (idx + 1) & mask;
+        if (slots[next].dist <= 1)
+        {
+            memset(&slots[idx], 0, sizeof(hash_slot_t));
+            return;
+        }
+        slots[idx] = slots[next];
+        slots[idx].dist--;
+        idx = next;
+    }
+}
+
+// 从旧数组迁移至多 steps 个槽；迁出的槽留作墓碑，使旧数组上的探测仍然成立
+static void table_migrate(hash_table_t *table, size_t steps)
+{
+    while (table->old_slots && steps-- > 0)
+    {
+        if (table->old_pos == table->old_size)
+        {
+            table_free_slots(table, table->old_slots);
+            table->old_slots = NULL;
+            table->old_size = 0;
+            table->old_pos = 0;
+            break;
+        }
+        hash_slot_t *slot = &table->old_slots[table->old_pos++];
+        if (slot_live(slot))
+        {
+            slots_insert(table->slots, table->size, slot->key, slot->value, hash_mix64(slot->key));
+            slot->value = NULL;
+            table->used++;
+        }
+    }
+}
+
+// 当前数组负载将超过 7/8 时翻倍；上一轮迁移未完成则先全部迁完
+static int table_grow_if_needed(hash_table_t *table)
+{
+    if (table->used + 1 <= table->size - table->size / 8)
+        return 0;
+
+    table_migrate(table, (size_t)-1);
+
+    size_t new_size = table->size * 2;
+    hash_slot_t *slots = calloc(new_size, sizeof(hash_slot_t));
+    if (!slots)
+        return table->used + 1 < table->size ? 0 : -ENOMEM;
+
+    table->old_slots = table->slots;
+    table->old_size = table->size;
+    table->old_pos = 0;
+    table->slots = slots;
+    table->size = new_size;
+    table->used = 0;
+    table_migrate(table, HASH_MIGRATE_STEP);
+    return 0;
+}
+
+static hash_table_t *table_create(size_t size, bool concurrent)
+{
+    hash_table_t *table = calloc(1, sizeof(hash_table_t));
+    if (!table)
+        return NULL;
+
+    size_t cap = HASH_TABLE_MIN_SIZE;
+    while (cap < size)
+        cap <<= 1;
+
+    table->slots = calloc(cap, sizeof(hash_slot_t));
+    if (!table->slots)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->size = cap;
+    table->concurrent = concurrent;
+    pthread_rwlock_init(&table->lock, NULL);
+
+    return table;
+}
+
+// 创建哈希表
+hash_table_t *hash_table_create(size_t size)
+{
+    return table_create(size, false);
+}
+
+// 销毁哈希表（此时不应再有并发访问）
+void hash_table_destroy(hash_table_t *table)
+{
+    if (!table)
+        return;
+
+    free(table->slots);
+    free(table->old_slots);
+    pthread_rwlock_destroy(&table->lock);
+    free(table);
+}
+
+void hash_table_write_lock(hash_table_t *table)
+{
+    pthread_rwlock_wrlock(&table->lock);
+    __atomic_store_n(&table->seq, table->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void hash_table_write_unlock(hash_table_t *table)
+{
+    __atomic_store_n(&table->seq, table->seq + 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&table->lock);
+}
+
+// 以下 *_locked 函数要求调用方已用 hash_table_write_lock 取得写锁
+void *hash_table_get_locked(hash_table_t *table, uint64_t key)
+{
+    uint64_t hash = hash_mix64(key);
+    hash_slot_t *slot = slots_find(table->slots, table->size, key, hash);
+    if (!slot && table->old_slots)
+        slot = slots_find(table->old_slots, table->old_size, key, hash);
+    return slot ? slot->value : NULL;
+}
+
+int hash_table_set_locked(hash_table_t *table, uint64_t key, void *value)
+{
+    if (!value)
+        return -EINVAL;
+
+    uint64_t hash = hash_mix64(key);
+    table_migrate(table, HASH_MIGRATE_STEP);
+
+    hash_slot_t *slot = slots_find(table->slots, table->size, key, hash);
+    // 尚未迁移的旧条目：原地改写，由后续迁移带入新数组
+    if (!slot && table->old_slots)
+        slot = slots_find(table->old_slots, table->old_size, key, hash);
+    if (slot)
+    {
+        slot->value = value;
+        return 0;
+    }
+
+    int ret = table_grow_if_needed(table);
+    if (ret == 0)
+    {
+        slots_insert(table->slots, table->size, key, value, hash);
+        table->used++;
+        table->count++;
+    }
+    return ret;
+}
+
+int hash_table_remove_locked(hash_table_t *table, uint64_t key)
+{
+    uint64_t hash = hash_mix64(key);
+    table_migrate(table, HASH_MIGRATE_STEP);
+
+    hash_slot_t *slot = slots_find(table->slots, table->size, key, hash);
+    if (slot)
+    {
+        slots_erase(table->slots, table->size, slot);
+        table->used--;
+        table->count--;
+        return 0;
+    }
+    if (table->old_slots && (slot = slots_find(table->old_slots, table->old_size, key, hash)) != NULL)
+    {
+        slot->value = NULL;
+        table->count--;
+        return 0;
+    }
+    return -ENOENT;
+}
+
+// 设置哈希表值
+int hash_table_set(hash_table_t *table, uint64_t key, void *value)
+{
+    if (!table || !value)
+        return -EINVAL;
+
+    hash_table_write_lock(table);
+    int ret = hash_table_set_locked(table, key, value);
+    hash_table_write_unlock(table);
+    return ret;
+}
+
+// 乐观无锁读取时的探测：槽内容可能被写者改动，逐字段原子读取，探测长度以容量为界
+static void *slots_find_relaxed(const hash_slot_t *slots, size_t size, uint64_t key, uint64_t hash)
+{
+    size_t mask = size - 1;
+    size_t idx = hash & mask;
+    for (uint32_t dist = 1; dist <= size; dist++)
+    {
+        const hash_slot_t *slot = &slots[idx];
+        if (__atomic_load_n(&slot->dist, __ATOMIC_RELAXED) < dist)
+            return NULL;
+        void *value = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+        if (value && __atomic_load_n(&slot->key, __ATOMIC_RELAXED) == key)
+            return value;
+        idx = (idx + 1) & mask;
+    }
+    return NULL;
+}
+
+// 无锁读取的尝试次数，期间一直有写者时改走加锁路径
+#define HASH_OPTIMISTIC_ATTEMPTS 2
+
+// 乐观读取：调用方处于纪元读侧临界区（槽数组不会被释放）。
+// 先在写序号保护下取得一致的数组指针与容量，探测后再次校验写序号；成功时置 *ok
+static void *table_get_optimistic(hash_table_t *table, uint64_t key, uint64_t hash, bool *ok)
+{
+    for (int attempt = 0; attempt < HASH_OPTIMISTIC_ATTEMPTS; attempt++)
+    {
+        uint32_t seq = __atomic_load_n(&table->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        hash_slot_t *slots = __atomic_load_n(&table->slots, __ATOMIC_RELAXED);
+        size_t size = __atomic_load_n(&table->size, __ATOMIC_RELAXED);
+        hash_slot_t *old_slots = __atomic_load_n(&table->old_slots, __ATOMIC_RELAXED);
+        size_t old_size = __atomic_load_n(&table->old_size, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&table->seq, __ATOMIC_RELAXED) != seq)
+            continue;
+
+        void *value = slots_find_relaxed(slots, size, key, hash);
+        if (!value && old_slots)
+            value = slots_find_relaxed(old_slots, old_size, key, hash);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&table->seq, __ATOMIC_RELAXED) == seq)
+        {
+            *ok = true;
+            return value;
+        }
+    }
+    *ok = false;
+    return NULL;
+}
+
+// 获取哈希表值（并发表先尝试不取锁的乐观读取）
+void *hash_table_get(hash_table_t *table, uint64_t key)
+{
+    if (!table)
+        return NULL;
+
+    uint64_t hash = hash_mix64(key);
+    if (table->concurrent && epoch_enter())
+    {
+        bool ok;
+        void *value = table_get_optimistic(table, key, hash, &ok);
+        epoch_exit();
+        if (ok)
+            return value;
+    }
+
+    pthread_rwlock_rdlock(&table->lock);
+
+    hash_slot_t *slot = slots_find(table->slots, table->size, key, hash);
+    if (!slot && table->old_slots)
+        slot = slots_find(table->old_slots, table->old_size, key, hash);
+    void *value = slot ? slot->value : NULL;
+
+    pthread_rwlock_unlock(&table->lock);
+    return value;
+}
+
+// 移除哈希表键值对
+int hash_table_remove(hash_table_t *table, uint64_t key)
+{
+    if (!table)
+        return -EINVAL;
+
+    hash_table_write_lock(table);
+    int ret = hash_table_remove_locked(table, key);
+    hash_table_write_unlock(table);
+    return ret;
+}
+
+// 清空哈希表（保留当前容量）
+void hash_table_clear(hash_table_t *table)
+{
+    if (!table)
+        return;
+
+    hash_table_write_lock(table);
+
+    table_free_slots(table, table->old_slots);
+    table->old_slots = NULL;
+    table->old_size = 0;
+    table->old_pos = 0;
+    memset(table->slots, 0, table->size * sizeof(hash_slot_t));
+    table->used = 0;
+    table->count = 0;
+
+    hash_table_write_unlock(table);
+}
+
+// 获取哈希表大小
+size_t hash_table_size(hash_table_t *table)
+{
+    if (!table)
+        return 0;
+    return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
+
+void hash_table_iter_init(hash_table_iter_t *iter, hash_table_t *table)
+{
+    iter->table = table;
+    iter->pos = 0;
+    iter->in_old = 0;
+}
+
+void **hash_table_iter_next(hash_table_iter_t *iter, uint64_t *key)
+{
+    hash_table_t *table = iter->table;
+    if (!table)
+        return NULL;
+
+    if (!iter->in_old)
+    {
+        while (iter->pos < table->size)
+        {
+            hash_slot_t *slot = &table->slots[iter->pos++];
+            if (slot_live(slot))
+            {
+                if (key)
+                    *key = slot->key;
+                return &slot->value;
+            }
+        }
+        iter->in_old = 1;
+        iter->pos = table->old_pos;
+    }
+
+    while (table->old_slots && iter->pos < table->old_size)
+    {
+        hash_slot_t *slot = &table->old_slots[iter->pos++];
+        if (slot_live(slot))
+        {
+            if (key)
+                *key = slot->key;
+            return &slot->value;
+        }
+    }
+    return NULL;
+}
+
+// 分片选择用散列值高位，分片内部定位用低位，两者互不相关
+static inline hash_table_t *shard_of(shard_map_t *map, uint64_t key)
+{
+    return map->shards[hash_mix64(key) >> (64 - SHARD_MAP_SHARD_BITS)];
+}
+
+shard_map_t *shard_map_create(size_t size)
+{
+    shard_map_t *map = calloc(1, sizeof(shard_map_t));
+    if (!map)
+        return NULL;
+
+    for (size_t i = 0; i < SHARD_MAP_SHARDS; i++)
+    {
+        map->shards[i] = table_create(size / SHARD_MAP_SHARDS, true);
+        if (!map->shards[i])
+        {
+            shard_map_destroy(map);
+            return NULL;
+        }
+    }
+    return map;
+}
+
+void shard_map_destroy(shard_map_t *map)
+{
+    if (!map)
+        return;
+
+    for (size_t i = 0; i < SHARD_MAP_SHARDS; i++)
+        hash_table_destroy(map->shards[i]);
+    free(map);
+}
+
+void *shard_map_get(shard_map_t *map, uint64_t key)
+{
+    return map ? hash_table_get(shard_of(map, key), key) : NULL;
+}
+
+int shard_map_set(shard_map_t *map, uint64_t key, void *value)
+{
+    return map ? hash_table_set(shard_of(map, key), key, value) : -EINVAL;
+}
+
+int shard_map_remove(shard_map_t *map, uint64_t key)
+{
+    return map ? hash_table_remove(shard_of(map, key), key) : -EINVAL;
+}
+
+size_t shard_map_size(shard_map_t *map)
+{
+    if (!map)
+        return 0;
+
+    size_t total = 0;
+    for (size_t i = 0; i < SHARD_MAP_SHARDS; i++)
+        total += hash_table_size(map->shards[i]);
+    return total;
+}
+
+hash_table_t *shard_map_lock(shard_map_t *map, uint64_t key)
+{
+    hash_table_t *shard = shard_of(map, key);
+    hash_table_write_lock(shard);
+    return shard;
+}
+
+void shard_map_unlock(hash_table_t *shard)
+{
+    hash_table_write_unlock(shard);
+}
+
+void shard_map_foreach(shard_map_t *map, shard_map_visit_fn fn, void *arg)
+{
+    if (!map)
+        return;
+
+    for (size_t i = 0; i < SHARD_MAP_SHARDS; i++)
+    {
+        hash_table_t *shard = map->shards[i];
+        hash_table_iter_t it;
+        uint64_t key;
+        void **value;
+
+        pthread_rwlock_rdlock(&shard->lock);
+        hash_table_iter_init(&it, shard);
+        while ((value = hash_table_iter_next(&it, &key)) != NULL)
+            fn(key, *value, arg);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,253 @@
+/**
+ * 智能备份文件系统 - 模块A：按inode编号直接索引的inode表
+ */
+
+#include "inode_table.h"
+#include "epoch.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INODE_PAGE_SHIFT 10
+#define INODE_PAGE_SLOTS (1u << INODE_PAGE_SHIFT)
+#define INODE_PAGE_MASK (INODE_PAGE_SLOTS - 1)
+#define INODE_TABLE_STRIPES 64                 // 页锁分条数（2的幂）
+#define INODE_TABLE_MIN_PAGES 64
+#define INODE_TABLE_MAX_PAGES (1ULL << 30)     // 编号上限 2^40，超出的inode不登记
+
+typedef struct inode_page {
+    uint32_t live;               // 页内已登记的inode数（持页锁修改）
+    file_metadata_t *slots[INODE_PAGE_SLOTS];
+} inode_page_t;
+
+// 页目录：扩展时整体复制替换，旧目录经纪元回收
+typedef struct inode_dir {
+    size_t page_count;
+    inode_page_t *pages[];
+} inode_dir_t;
+
+static struct {
+    inode_dir_t *dir;
+    size_t count;
+    pthread_mutex_t dir_lock;    // 装上/摘下页、扩展页目录
+    pthread_mutex_t stripes[INODE_TABLE_STRIPES]; // 页内槽位与 live 由所属分条锁保护
+} itab;
+
+static pthread_once_t itab_once = PTHREAD_ONCE_INIT;
+
+static void itab_init(void)
+{
+    pthread_mutex_init(&itab.dir_lock, NULL);
+    for (size_t i = 0; i < INODE_TABLE_STRIPES; i++)
+        pthread_mutex_init(&itab.stripes[i], NULL);
+}
+
+static pthread_mutex_t *itab_stripe(uint64_t page)
+{
+    return &itab.stripes[page & (INODE_TABLE_STRIPES - 1)];
+}
+
+// 读侧保护：优先进入纪元临界区，无法登记本线程时退回持有页目录锁
+static bool itab_read_begin(void)
+{
+    if (epoch_enter())
+        return true;
+    pthread_mutex_lock(&itab.dir_lock);
+    return false;
+}
+
+static void itab_read_end(bool in_epoch)
+{
+    if (in_epoch)
+        epoch_exit();
+    else
+        pthread_mutex_unlock(&itab.dir_lock);
+}
+
+static inode_page_t *itab_load_page(const inode_dir_t *dir, uint64_t page)
+{
+    if (!dir || page >= dir->page_count)
+        return NULL;
+    return __atomic_load_n(&dir->pages[page], __ATOMIC_ACQUIRE);
+}
+
+static inode_page_t *itab_page(uint64_t page)
+{
+    bool in_epoch = itab_read_begin();
+    inode_page_t *p = itab_load_page(__atomic_load_n(&itab.dir, __ATOMIC_ACQUIRE), page);
+    itab_read_end(in_epoch);
+    return p;
+}
+
+// 扩展页目录使之至少容纳 need 页（持页目录锁）
+static inode_dir_t *itab_grow_locked(size_t need)
+{
+    inode_dir_t *old = itab.dir;
+    size_t n = old ? old->page_count : 0;
+    size_t cap = n ? n : INODE_TABLE_MIN_PAGES;
+    while (cap < need)
+        cap *= 2;
+    inode_dir_t *dir = calloc(1, sizeof(inode_dir_t) + cap * sizeof(inode_page_t *));
+    if (!dir)
+        return NULL;
+    dir->page_count = cap;
+    if (old)
+        memcpy(dir->pages, old->pages, n * sizeof(inode_page_t *));
+    __atomic_store_n(&itab.dir, dir, __ATOMIC_RELEASE);
+    epoch_retire(old, free);
+    return dir;
+}
+
+// 取得编号所在页，不存在时分配并装上（持该页的分条锁）
+static inode_page_t *itab_page_create(uint64_t page)
+{
+    inode_page_t *p = itab_page(page);
+    if (p)
+        return p;
+    p = calloc(1, sizeof(inode_page_t));
+    if (!p)
+        return NULL;
+
+    pthread_mutex_lock(&itab.dir_lock);
+    inode_dir_t *dir = itab.dir;
+    if (!dir || page >= dir->page_count)
+        dir = itab_grow_locked(page + 1);
+    if (dir)
+        __atomic_store_n(&dir->pages[page], p, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&itab.dir_lock);
+    if (!dir)
+    {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+int inode_table_insert(file_metadata_t *meta)
+{
+    if (!meta)
+        return -EINVAL;
+    uint64_t page = meta->ino >> INODE_PAGE_SHIFT;
+    if (page >= INODE_TABLE_MAX_PAGES)
+        return -EOVERFLOW;
+    pthread_once(&itab_once, itab_init);
+
+    pthread_mutex_t *lock = itab_stripe(page);
+    pthread_mutex_lock(lock);
+    int ret = 0;
+    inode_page_t *p = itab_page_create(page);
+    if (!p)
+    {
+        ret = -ENOMEM;
+    }
+    else
+    {
+        file_metadata_t **slot = &p->slots[meta->ino & INODE_PAGE_MASK];
+        if (*slot)
+        {
+            ret = (*slot == meta) ? 0 : -EEXIST;
+        }
+        else
+        {
+            p->live++;
+            __atomic_store_n(slot, meta, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&itab.count, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(lock);
+    return ret;
+}
+
+void inode_table_remove(file_metadata_t *meta)
+{
+    if (!meta)
+        return;
+    uint64_t page = meta->ino >> INODE_PAGE_SHIFT;
+    if (page >= INODE_TABLE_MAX_PAGES)
+        return;
+    pthread_once(&itab_once, itab_init);
+
+    pthread_mutex_t *lock = itab_stripe(page);
+    pthread_mutex_lock(lock);
+    inode_page_t *p = itab_page(page);
+    file_metadata_t **slot = p ? &p->slots[meta->ino & INODE_PAGE_MASK] : NULL;
+    if (slot && *slot == meta)
+    {
+        __atomic_store_n(slot, NULL, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&itab.count, 1, __ATOMIC_RELAXED);
+        if (--p->live == 0)
+        {
+            // 整页已空：摘下，无锁读者离开后释放
+            pthread_mutex_lock(&itab.dir_lock);
+            __atomic_store_n(&itab.dir->pages[page], NULL, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&itab.dir_lock);
+            epoch_retire(p, free);
+        }
+    }
+    pthread_mutex_unlock(lock);
+}
+
+file_metadata_t *inode_table_get(uint64_t ino)
+{
+    pthread_once(&itab_once, itab_init);
+
+    bool in_epoch = itab_read_begin();
+    file_metadata_t *meta = NULL;
+    inode_page_t *p = itab_load_page(__atomic_load_n(&itab.dir, __ATOMIC_ACQUIRE),
+                                     ino >> INODE_PAGE_SHIFT);
+    if (p)
+        meta = __atomic_load_n(&p->slots[ino & INODE_PAGE_MASK], __ATOMIC_ACQUIRE);
+    itab_read_end(in_epoch);
+    return meta;
+}
+
+file_metadata_t *inode_table_next(uint64_t *ino)
+{
+    pthread_once(&itab_once, itab_init);
+
+    bool in_epoch = itab_read_begin();
+    file_metadata_t *meta = NULL;
+    const inode_dir_t *dir = __atomic_load_n(&itab.dir, __ATOMIC_ACQUIRE);
+    uint64_t page = *ino >> INODE_PAGE_SHIFT;
+    uint32_t slot = (uint32_t)(*ino & INODE_PAGE_MASK);
+    for (; dir && page < dir->page_count && !meta; page++, slot = 0)
+    {
+        inode_page_t *p = itab_load_page(dir, page);
+        if (!p)
+            continue;
+        for (; slot < INODE_PAGE_SLOTS; slot++)
+        {
+            meta = __atomic_load_n(&p->slots[slot], __ATOMIC_ACQUIRE);
+            if (meta)
+            {
+                *ino = (page << INODE_PAGE_SHIFT) | slot;
+                break;
+            }
+        }
+    }
+    itab_read_end(in_epoch);
+    return meta;
+}
+
+size_t inode_table_count(void)
+{
+    return __atomic_load_n(&itab.count, __ATOMIC_RELAXED);
+}
+
+void inode_table_destroy(void)
+{
+    pthread_once(&itab_once, itab_init);
+
+    pthread_mutex_lock(&itab.dir_lock);
+    inode_dir_t *dir = itab.dir;
+    itab.dir = NULL;
+    itab.count = 0;
+    pthread_mutex_unlock(&itab.dir_lock);
+    if (!dir)
+        return;
+    for (size_t i = 0; i < dir->page_count; i++)
+        free(dir->pages[i]);
+    free(dir);
+}
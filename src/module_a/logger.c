@@ -0,0 +1,423 @@
+/**
+ * 智能备份文件系统 - 异步分级日志
+ */
+
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// 每线程环形缓冲的条目数（2的幂）与单条日志正文上限
+#define LOG_RING_SLOTS 512
+#define LOG_TEXT_MAX 224
+
+// 后台线程的轮询间隔与单批写出缓冲
+#define LOG_DRAIN_INTERVAL_MS 20
+#define LOG_BATCH_SIZE 65536
+
+typedef struct {
+    struct timespec ts;
+    int level;
+    uint32_t len;
+    char text[LOG_TEXT_MAX];
+} log_record_t;
+
+// 单生产者（所属线程）/单消费者（后台线程）环形缓冲
+typedef struct log_ring {
+    log_record_t slots[LOG_RING_SLOTS];
+    uint64_t head;          // 下一个写入位置，仅所属线程修改
+    uint64_t tail;          // 下一个读取位置，仅后台线程修改
+    long tid;
+    int orphaned;           // 所属线程已退出，排空后回收
+    struct log_ring *next;
+} log_ring_t;
+
+int sbfs_log_runtime_level = SBFS_LOG_LEVEL_INFO;
+
+static struct {
+    pthread_mutex_t io_lock;        // 保护输出文件与轮转
+    int fd;
+    char *path;
+    uint64_t max_size;
+    int backup_count;
+    uint64_t cur_size;
+
+    pthread_mutex_t rings_lock;     // 仅在线程首次写日志/回收时使用
+    log_ring_t *rings;
+
+    pthread_t thread;
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+    int async;                      // 后台线程运行中，写日志进入环形缓冲
+    int stop;
+    uint64_t dropped;
+} g_log = {
+    .io_lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd = STDERR_FILENO,
+    .rings_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local log_ring_t *tls_ring;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static const char *const level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+
+// 线程退出：标记缓冲为孤儿，由后台线程排空后释放
+static void ring_release(void *arg)
+{
+    log_ring_t *ring = arg;
+    __atomic_store_n(&ring->orphaned, 1, __ATOMIC_RELEASE);
+}
+
+static void ring_key_create(void)
+{
+    pthread_key_create(&ring_key, ring_release);
+}
+
+static log_ring_t *ring_get(void)
+{
+    if (tls_ring)
+        return tls_ring;
+
+    pthread_once(&ring_key_once, ring_key_create);
+    log_ring_t *ring = calloc(1, sizeof(log_ring_t));
+    if (!ring)
+        return NULL;
+    ring->tid = (long)syscall(SYS_gettid);
+
+    pthread_mutex_lock(&g_log.rings_lock);
+    ring->next = g_log.rings;
+    g_log.rings = ring;
+    pthread_mutex_unlock(&g_log.rings_lock);
+
+    pthread_setspecific(ring_key, ring);
+    tls_ring = ring;
+    return ring;
+}
+
+// 格式化一条完整日志行，返回长度
+static size_t format_line(char *out, size_t cap, const struct timespec *ts, int level,
+                          long tid, const char *text, size_t len)
+{
+    struct tm tm;
+    time_t sec = ts->tv_sec;
+    localtime_r(&sec, &tm);
+    int n = snprintf(out, cap, "%04d-%02d-%02d %02d:%02d:%02d.%03ld %-5s [%ld] ",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+                     tm.tm_sec, ts->tv_nsec / 1000000, level_names[level], tid);
+    if (n < 0)
+        return 0;
+    size_t used = (size_t)n < cap ? (size_t)n : cap;
+    if (len > cap - used - 1)
+        len = cap - used - 1;
+    memcpy(out + used, text, len);
+    used += len;
+    out[used++] = '\n';
+    return used;
+}
+
+static int open_output(void)
+{
+    if (!g_log.path)
+    {
+        g_log.fd = STDERR_FILENO;
+        g_log.cur_size = 0;
+        return 0;
+    }
+    int fd = open(g_log.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -errno;
+    struct stat st;
+    g_log.cur_size = fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    g_log.fd = fd;
+    return 0;
+}
+
+// 按大小轮转：file -> file.1 -> ... -> file.N，超出 backup_count 的删除
+static void rotate_locked(void)
+{
+    if (!g_log.path || g_log.fd == STDERR_FILENO)
+        return;
+
+    close(g_log.fd);
+    g_log.fd = STDERR_FILENO;
+
+    size_t plen = strlen(g_log.path) + 16;
+    char *from = malloc(plen);
+    char *to = malloc(plen);
+    if (from && to)
+    {
+        if (g_log.backup_count > 0)
+        {
+            for (int i = g_log.backup_count - 1; i >= 1; i--)
+            {
+                snprintf(from, plen, "%s.%d", g_log.path, i);
+                snprintf(to, plen, "%s.%d", g_log.path, i + 1);
+                rename(from, to);
+            }
+            snprintf(to, plen, "%s.1", g_log.path);
+            rename(g_log.path, to);
+        }
+        else
+        {
+            unlink(g_log.path);
+        }
+    }
+    free(from);
+    free(to);
+
+    if (open_output() != 0)
+        g_log.fd = STDERR_FILENO;
+}
+
+static void emit_locked(const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(g_log.fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+        g_log.cur_size += (uint64_t)n;
+    }
+    if (g_log.max_size && g_log.cur_size >= g_log.max_size)
+        rotate_locked();
+}
+
+// 排空所有线程的环形缓冲，批量写出；顺带回收孤儿缓冲
+static void drain_rings(void)
+{
+    static char batch[LOG_BATCH_SIZE];
+    size_t used = 0;
+
+    pthread_mutex_lock(&g_log.rings_lock);
+    log_ring_t **link = &g_log.rings;
+    while (*link)
+    {
+        log_ring_t *ring = *link;
+        int orphaned = __atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+
+        while (tail < head)
+        {
+            const log_record_t *rec = &ring->slots[tail & (LOG_RING_SLOTS - 1)];
+            if (LOG_BATCH_SIZE - used < LOG_TEXT_MAX + 64)
+            {
+                pthread_mutex_lock(&g_log.io_lock);
+                emit_locked(batch, used);
+                pthread_mutex_unlock(&g_log.io_lock);
+                used = 0;
+            }
+            used += format_line(batch + used, LOG_BATCH_SIZE - used, &rec->ts, rec->level,
+                                ring->tid, rec->text, rec->len);
+            tail++;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        if (orphaned)
+        {
+            *link = ring->next;
+            free(ring);
+            continue;
+        }
+        link = &ring->next;
+    }
+    pthread_mutex_unlock(&g_log.rings_lock);
+
+    if (used)
+    {
+        pthread_mutex_lock(&g_log.io_lock);
+        emit_locked(batch, used);
+        pthread_mutex_unlock(&g_log.io_lock);
+    }
+}
+
+static void *drain_thread_fn(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&g_log.wake_lock);
+    while (!g_log.stop)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_DRAIN_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_log.wake, &g_log.wake_lock, &deadline);
+
+        pthread_mutex_unlock(&g_log.wake_lock);
+        drain_rings();
+        pthread_mutex_lock(&g_log.wake_lock);
+    }
+    pthread_mutex_unlock(&g_log.wake_lock);
+
+    drain_rings();
+    return NULL;
+}
+
+int sbfs_log_level_from_string(const char *name)
+{
+    if (!name)
+        return SBFS_LOG_LEVEL_INFO;
+    for (int i = SBFS_LOG_LEVEL_ERROR; i <= SBFS_LOG_LEVEL_DEBUG; i++)
+    {
+        if (strcasecmp(name, level_names[i]) == 0)
+            return i;
+    }
+    if (strcasecmp(name, "WARNING") == 0)
+        return SBFS_LOG_LEVEL_WARN;
+    return SBFS_LOG_LEVEL_INFO;
+}
+
+void sbfs_log_set_level(int level)
+{
+    if (level < SBFS_LOG_LEVEL_ERROR)
+        level = SBFS_LOG_LEVEL_ERROR;
+    if (level > SBFS_LOG_LEVEL_DEBUG)
+        level = SBFS_LOG_LEVEL_DEBUG;
+    __atomic_store_n(&sbfs_log_runtime_level, level, __ATOMIC_RELAXED);
+}
+
+int sbfs_log_init(const char *level, const char *path, uint64_t max_size, int backup_count)
+{
+    sbfs_log_set_level(sbfs_log_level_from_string(level));
+
+    pthread_mutex_lock(&g_log.io_lock);
+    if (g_log.fd != STDERR_FILENO)
+        close(g_log.fd);
+    free(g_log.path);
+    g_log.path = (path && *path) ? strdup(path) : NULL;
+    g_log.max_size = max_size;
+    g_log.backup_count = backup_count > 0 ? backup_count : 0;
+    int ret = open_output();
+    if (ret != 0)
+    {
+        // 日志文件不可写时退回stderr
+        free(g_log.path);
+        g_log.path = NULL;
+        open_output();
+    }
+    pthread_mutex_unlock(&g_log.io_lock);
+    return ret;
+}
+
+int sbfs_log_start(void)
+{
+    if (__atomic_load_n(&g_log.async, __ATOMIC_ACQUIRE))
+        return 0;
+
+    g_log.stop = 0;
+    int ret = pthread_create(&g_log.thread, NULL, drain_thread_fn, NULL);
+    if (ret != 0)
+        return -ret;
+    __atomic_store_n(&g_log.async, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void sbfs_log_shutdown(void)
+{
+    if (__atomic_exchange_n(&g_log.async, 0, __ATOMIC_ACQ_REL))
+    {
+        pthread_mutex_lock(&g_log.wake_lock);
+        g_log.stop = 1;
+        pthread_cond_signal(&g_log.wake);
+        pthread_mutex_unlock(&g_log.wake_lock);
+        pthread_join(g_log.thread, NULL);
+    }
+
+    // 切换为同步模式后仍可能有线程刚写入环形缓冲，最后再排空一次
+    drain_rings();
+
+    uint64_t dropped = __atomic_load_n(&g_log.dropped, __ATOMIC_RELAXED);
+    if (dropped)
+        sbfs_log_write(SBFS_LOG_LEVEL_WARN, __FILE__, __LINE__,
+                       "日志缓冲已满，丢弃 %lu 条日志", (unsigned long)dropped);
+
+    pthread_mutex_lock(&g_log.io_lock);
+    if (g_log.fd != STDERR_FILENO)
+        close(g_log.fd);
+    g_log.fd = STDERR_FILENO;
+    free(g_log.path);
+    g_log.path = NULL;
+    pthread_mutex_unlock(&g_log.io_lock);
+}
+
+uint64_t sbfs_log_dropped(void)
+{
+    return __atomic_load_n(&g_log.dropped, __ATOMIC_RELAXED);
+}
+
+void sbfs_log_write(int level, const char *file, int line, const char *fmt, ...)
+{
+    (void)file;
+    (void)line;
+
+    if (level < SBFS_LOG_LEVEL_ERROR || level > SBFS_LOG_LEVEL_DEBUG)
+        level = SBFS_LOG_LEVEL_INFO;
+
+    log_ring_t *ring = __atomic_load_n(&g_log.async, __ATOMIC_ACQUIRE) ? ring_get() : NULL;
+    if (ring)
+    {
+        uint64_t head = ring->head;
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - tail >= LOG_RING_SLOTS)
+        {
+            // 缓冲已满时丢弃，不阻塞调用线程
+            __atomic_fetch_add(&g_log.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        log_record_t *rec = &ring->slots[head & (LOG_RING_SLOTS - 1)];
+        clock_gettime(CLOCK_REALTIME, &rec->ts);
+        rec->level = level;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(rec->text, sizeof(rec->text), fmt, ap);
+        va_end(ap);
+        rec->len = n < 0 ? 0 : ((size_t)n < sizeof(rec->text) ? (uint32_t)n : sizeof(rec->text) - 1);
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+        // 错误日志或缓冲过半时提前唤醒后台线程，其余情况等待定时排空
+        if (level == SBFS_LOG_LEVEL_ERROR || head + 1 - tail == LOG_RING_SLOTS / 2)
+            pthread_cond_signal(&g_log.wake);
+        return;
+    }
+
+    // 同步模式（后台线程启动前/停止后）：直接写出
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    char text[LOG_TEXT_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    size_t len = n < 0 ? 0 : ((size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1);
+
+    char out[LOG_TEXT_MAX + 64];
+    size_t out_len = format_line(out, sizeof(out), &ts, level, (long)syscall(SYS_gettid), text, len);
+    pthread_mutex_lock(&g_log.io_lock);
+    emit_locked(out, out_len);
+    pthread_mutex_unlock(&g_log.io_lock);
+}
@@ -0,0 +1,325 @@
+/**
+ * 智能备份文件系统 - 模块A：自适应替换缓存（ARC）
+ */
+
+#include "lru_cache.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+
+typedef enum {
+    ARC_T1,
+    ARC_T2,
+    ARC_B1,
+    ARC_B2,
+} arc_list_id_t;
+
+struct lru_entry {
+    uint64_t key;
+    void *value;                 // 幽灵记录为NULL
+    size_t charge;
+    arc_list_id_t list;
+    lru_entry_t *prev;
+    lru_entry_t *next;
+};
+
+static lru_list_t *arc_list(lru_cache_t *cache, arc_list_id_t id)
+{
+    switch (id)
+    {
+    case ARC_T1:
+        return &cache->t1;
+    case ARC_T2:
+        return &cache->t2;
+    case ARC_B1:
+        return &cache->b1;
+    default:
+        return &cache->b2;
+    }
+}
+
+static void list_unlink(lru_cache_t *cache, lru_entry_t *e)
+{
+    lru_list_t *list = arc_list(cache, e->list);
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        list->head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        list->tail = e->prev;
+    list->bytes -= e->charge;
+    e->prev = e->next = NULL;
+}
+
+static void list_push_head(lru_cache_t *cache, lru_entry_t *e, arc_list_id_t id)
+{
+    lru_list_t *list = arc_list(cache, id);
+    e->list = id;
+    e->prev = NULL;
+    e->next = list->head;
+    if (list->head)
+        list->head->prev = e;
+    else
+        list->tail = e;
+    list->head = e;
+    list->bytes += e->charge;
+}
+
+static void entry_drop(lru_cache_t *cache, lru_entry_t *e)
+{
+    list_unlink(cache, e);
+    hash_table_remove(cache->table, e->key);
+    free(e);
+}
+
+// 从 T1 或 T2 的最久未用端淘汰一个条目，转为对应的幽灵记录
+static void arc_replace(lru_cache_t *cache, bool hit_in_b2)
+{
+    bool from_t1 = cache->t1.tail &&
+                   (cache->t1.bytes > cache->target_t1 ||
+                    (hit_in_b2 && cache->t1.bytes == cache->target_t1) || !cache->t2.tail);
+    lru_entry_t *victim = from_t1 ? cache->t1.tail : cache->t2.tail;
+    if (!victim)
+        return;
+
+    list_unlink(cache, victim);
+    victim->value = NULL;
+    list_push_head(cache, victim, from_t1 ? ARC_B1 : ARC_B2);
+    cache->current_size--;
+    cache->evictions++;
+}
+
+// 为份额 charge 的新条目腾出空间并约束幽灵记录的总量（T1+B1 ≤ c，全部 ≤ 2c）
+static void arc_make_room(lru_cache_t *cache, size_t charge, bool hit_in_b2)
+{
+    size_t c = cache->max_size;
+
+    while (cache->t1.bytes + cache->t2.bytes + charge > c && (cache->t1.tail || cache->t2.tail))
+        arc_replace(cache, hit_in_b2);
+
+    while (cache->t1.bytes + cache->b1.bytes + charge > c && cache->b1.tail)
+        entry_drop(cache, cache->b1.tail);
+    while (cache->t1.bytes + cache->t2.bytes + cache->b1.bytes + cache->b2.bytes + charge > 2 * c &&
+           cache->b2.tail)
+        entry_drop(cache, cache->b2.tail);
+}
+
+// 创建缓存
+lru_cache_t *lru_cache_create(size_t max_size)
+{
+    if (max_size == 0)
+        return NULL;
+
+    lru_cache_t *cache = calloc(1, sizeof(lru_cache_t));
+    if (!cache)
+        return NULL;
+
+    cache->table = hash_table_create(64);
+    if (!cache->table)
+    {
+        free(cache);
+        return NULL;
+    }
+
+    cache->max_size = max_size;
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    return cache;
+}
+
+static void arc_free_list(lru_list_t *list)
+{
+    lru_entry_t *e = list->head;
+    while (e)
+    {
+        lru_entry_t *next = e->next;
+        free(e);
+        e = next;
+    }
+    list->head = list->tail = NULL;
+    list->bytes = 0;
+}
+
+// 销毁缓存
+void lru_cache_destroy(lru_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    arc_free_list(&cache->t1);
+    arc_free_list(&cache->t2);
+    arc_free_list(&cache->b1);
+    arc_free_list(&cache->b2);
+    hash_table_destroy(cache->table);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+int lru_cache_put(lru_cache_t *cache, uint64_t key, void *value)
+{
+    return lru_cache_put_sized(cache, key, value, 1);
+}
+
+// 放入缓存：已缓存的条目更新值并视为一次访问；命中幽灵记录时按 ARC 规则调整 p
+int lru_cache_put_sized(lru_cache_t *cache, uint64_t key, void *value, size_t charge)
+{
+    if (!cache || !value || charge == 0)
+        return -EINVAL;
+    if (charge > cache->max_size)
+    {
+        lru_cache_remove(cache, key);
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    lru_entry_t *e = hash_table_get(cache->table, key);
+    if (e && (e->list == ARC_T1 || e->list == ARC_T2))
+    {
+        list_unlink(cache, e);
+        cache->current_size--;
+        arc_make_room(cache, charge, false);
+        e->value = value;
+        e->charge = charge;
+        list_push_head(cache, e, ARC_T2);
+        cache->current_size++;
+        pthread_mutex_unlock(&cache->mutex);
+        return 0;
+    }
+
+    if (e)
+    {
+        // 幽灵命中：B1 命中说明 T1 偏小，B2 命中说明 T2 偏小
+        bool in_b2 = e->list == ARC_B2;
+        size_t b1 = cache->b1.bytes, b2 = cache->b2.bytes;
+        if (!in_b2)
+        {
+            size_t delta = b1 >= b2 ? charge : charge * (b2 / b1);
+            cache->target_t1 = cache->target_t1 + delta > cache->max_size ? cache->max_size
+                                                                          : cache->target_t1 + delta;
+        }
+        else
+        {
+            size_t delta = b2 >= b1 ? charge : charge * (b1 / b2);
+            cache->target_t1 = cache->target_t1 > delta ? cache->target_t1 - delta : 0;
+        }
+
+        list_unlink(cache, e);
+        arc_make_room(cache, charge, in_b2);
+        e->value = value;
+        e->charge = charge;
+        list_push_head(cache, e, ARC_T2);
+        cache->current_size++;
+        pthread_mutex_unlock(&cache->mutex);
+        return 0;
+    }
+
+    e = calloc(1, sizeof(lru_entry_t));
+    if (!e)
+    {
+        pthread_mutex_unlock(&cache->mutex);
+        return -ENOMEM;
+    }
+    e->key = key;
+    e->value = value;
+    e->charge = charge;
+
+    arc_make_room(cache, charge, false);
+    int ret = hash_table_set(cache->table, key, e);
+    if (ret != 0)
+    {
+        pthread_mutex_unlock(&cache->mutex);
+        free(e);
+        return ret;
+    }
+    list_push_head(cache, e, ARC_T1);
+    cache->current_size++;
+
+    pthread_mutex_unlock(&cache->mutex);
+    return 0;
+}
+
+// 获取缓存值
+void *lru_cache_get(lru_cache_t *cache, uint64_t key)
+{
+    if (!cache)
+        return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    lru_entry_t *e = hash_table_get(cache->table, key);
+    void *value = NULL;
+    if (e && e->value)
+    {
+        list_unlink(cache, e);
+        list_push_head(cache, e, ARC_T2);
+        value = e->value;
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return value;
+}
+
+// 移除缓存条目（连同幽灵记录）
+int lru_cache_remove(lru_cache_t *cache, uint64_t key)
+{
+    if (!cache)
+        return -EINVAL;
+
+    pthread_mutex_lock(&cache->mutex);
+    lru_entry_t *e = hash_table_get(cache->table, key);
+    int result = -ENOENT;
+    if (e)
+    {
+        if (e->value)
+            cache->current_size--;
+        entry_drop(cache, e);
+        result = 0;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return result;
+}
+
+// 清空缓存（统计计数保留）
+void lru_cache_clear(lru_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    arc_free_list(&cache->t1);
+    arc_free_list(&cache->t2);
+    arc_free_list(&cache->b1);
+    arc_free_list(&cache->b2);
+    hash_table_clear(cache->table);
+    cache->target_t1 = 0;
+    cache->current_size = 0;
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void lru_cache_get_stats(lru_cache_t *cache, lru_cache_stats_t *out)
+{
+    if (!out)
+        return;
+    if (!cache)
+    {
+        *out = (lru_cache_stats_t){0};
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    out->hits = cache->hits;
+    out->misses = cache->misses;
+    out->evictions = cache->evictions;
+    out->entries = cache->current_size;
+    out->used = cache->t1.bytes + cache->t2.bytes;
+    out->capacity = cache->max_size;
+    pthread_mutex_unlock(&cache->mutex);
+}
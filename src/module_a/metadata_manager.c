@@ -4,317 +4,37 @@
 
 #include "smartbackupfs.h"
 #include "version_manager.h"
+#include "smartbackupfs_ctl.h"
+#include "logger.h"
+#include "worker_pool.h"
+#include "epoch.h"
+#include "inode_table.h"
+#include "slab.h"
+#include "block_container.h"
 #include "dedup.h"
+#include "module_c/dedup_core.h"
 #include "module_c/block_splitter.h"
 #include "module_c/cache.h"
 #include "module_c/block_splitter.h"
+#include "module_c/segment_store.h"
+#include "config_loader.h"
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
-
-// 哈希表辅助函数
-static uint64_t hash_function(uint64_t key, size_t size)
-{
-    // 使用FNV-1a哈希算法的变体
-    uint64_t hash = 14695981039346656037ULL;
-    key ^= 14695981039346656037ULL;
-    for (int i = 0; i < 8; i++)
-    {
-        hash *= 1099511628211ULL;
-        hash ^= (key >> (i * 8)) & 0xFF;
-    }
-    return hash % size;
-}
-
-// 创建哈希表
-hash_table_t *hash_table_create(size_t size)
-{
-    hash_table_t *table = malloc(sizeof(hash_table_t));
-    if (!table)
-        return NULL;
-
-    table->buckets = calloc(size, sizeof(hash_node_t *));
-    if (!table->buckets)
-    {
-        free(table);
-        return NULL;
-    }
-
-    table->size = size;
-    table->count = 0;
-    pthread_rwlock_init(&table->lock, NULL);
-
-    return table;
-}
-
-// 销毁哈希表
-void hash_table_destroy(hash_table_t *table)
-{
-    if (!table)
-        return;
-
-    pthread_rwlock_wrlock(&table->lock);
-
-    for (size_t i = 0; i < table->size; i++)
-    {
-        hash_node_t *node = table->buckets[i];
-        while (node)
-        {
-            hash_node_t *next = node->next;
-            free(node);
-            node = next;
-        }
-    }
-
-    free(table->buckets);
-    pthread_rwlock_unlock(&table->lock);
-    pthread_rwlock_destroy(&table->lock);
-    free(table);
-}
-
-// 设置哈希表值
-int hash_table_set(hash_table_t *table, uint64_t key, void *value)
-{
-    if (!table || !value)
-        return -EINVAL;
-
-    pthread_rwlock_wrlock(&table->lock);
-
-    uint64_t index = hash_function(key, table->size);
-    hash_node_t *node = table->buckets[index];
-
-    // 检查是否已存在
-    while (node)
-    {
-        if (node->key == key)
-        {
-            node->value = value;
-            node->access_time = time(NULL);
-            pthread_rwlock_unlock(&table->lock);
-            return 0;
-        }
-        node = node->next;
-    }
-
-    // 创建新节点
-    hash_node_t *new_node = malloc(sizeof(hash_node_t));
-    if (!new_node)
-    {
-        pthread_rwlock_unlock(&table->lock);
-        return -ENOMEM;
-    }
-
-    new_node->key = key;
-    new_node->value = value;
-    new_node->next = table->buckets[index];
-    new_node->access_time = time(NULL);
-
-    table->buckets[index] = new_node;
-    table->count++;
-
-    pthread_rwlock_unlock(&table->lock);
-    return 0;
-}
-
-// 获取哈希表值
-void *hash_table_get(hash_table_t *table, uint64_t key)
-{
-    if (!table)
-        return NULL;
-
-    pthread_rwlock_rdlock(&table->lock);
-
-    uint64_t index = hash_function(key, table->size);
-    hash_node_t *node = table->buckets[index];
-
-    while (node)
-    {
-        if (node->key == key)
-        {
-            node->access_time = time(NULL);
-            void *value = node->value;
-            pthread_rwlock_unlock(&table->lock);
-            return value;
-        }
-        node = node->next;
-    }
-
-    pthread_rwlock_unlock(&table->lock);
-    return NULL;
-}
-
-// 移除哈希表键值对
-int hash_table_remove(hash_table_t *table, uint64_t key)
-{
-    if (!table)
-        return -EINVAL;
-
-    pthread_rwlock_wrlock(&table->lock);
-
-    uint64_t index = hash_function(key, table->size);
-    hash_node_t **prev = &table->buckets[index];
-    hash_node_t *node = *prev;
-
-    while (node)
-    {
-        if (node->key == key)
-        {
-            *prev = node->next;
-            free(node);
-            table->count--;
-            pthread_rwlock_unlock(&table->lock);
-            return 0;
-        }
-        prev = &node->next;
-        node = node->next;
-    }
-
-    pthread_rwlock_unlock(&table->lock);
-    return -ENOENT;
-}
-
-// 清空哈希表
-void hash_table_clear(hash_table_t *table)
-{
-    if (!table)
-        return;
-
-    pthread_rwlock_wrlock(&table->lock);
-
-    for (size_t i = 0; i < table->size; i++)
-    {
-        hash_node_t *node = table->buckets[i];
-        while (node)
-        {
-            hash_node_t *next = node->next;
-            free(node);
-            node = next;
-        }
-        table->buckets[i] = NULL;
-    }
-
-    table->count = 0;
-    pthread_rwlock_unlock(&table->lock);
-}
-
-// 获取哈希表大小
-size_t hash_table_size(hash_table_t *table)
-{
-    if (!table)
-        return 0;
-    return table->count;
-}
-
-// 创建LRU缓存
-lru_cache_t *lru_cache_create(size_t max_size)
-{
-    lru_cache_t *cache = malloc(sizeof(lru_cache_t));
-    if (!cache)
-        return NULL;
-
-    cache->table = hash_table_create(max_size * 2); // 使用2倍大小减少冲突
-    if (!cache->table)
-    {
-        free(cache);
-        return NULL;
-    }
-
-    cache->max_size = max_size;
-    cache->current_size = 0;
-    pthread_mutex_init(&cache->mutex, NULL);
-
-    return cache;
-}
-
-// 销毁LRU缓存
-void lru_cache_destroy(lru_cache_t *cache)
-{
-    if (!cache)
-        return;
-
-    hash_table_destroy(cache->table);
-    pthread_mutex_destroy(&cache->mutex);
-    free(cache);
-}
-
-// LRU缓存放入
-int lru_cache_put(lru_cache_t *cache, uint64_t key, void *value)
-{
-    if (!cache || !value)
-        return -EINVAL;
-
-    pthread_mutex_lock(&cache->mutex);
-
-    // 检查是否需要淘汰
-    if (hash_table_size(cache->table) >= cache->max_size)
-    {
-        // 简化实现：随机淘汰一个项
-        for (size_t i = 0; i < cache->table->size; i++)
-        {
-            hash_node_t *node = cache->table->buckets[i];
-            if (node)
-            {
-                hash_table_remove(cache->table, node->key);
-                break;
-            }
-        }
-    }
-
-    int result = hash_table_set(cache->table, key, value);
-    pthread_mutex_unlock(&cache->mutex);
-
-    return result;
-}
-
-// LRU缓存获取
-void *lru_cache_get(lru_cache_t *cache, uint64_t key)
-{
-    if (!cache)
-        return NULL;
-
-    pthread_mutex_lock(&cache->mutex);
-    void *value = hash_table_get(cache->table, key);
-    pthread_mutex_unlock(&cache->mutex);
-
-    return value;
-}
-
-// LRU缓存移除
-int lru_cache_remove(lru_cache_t *cache, uint64_t key)
-{
-    if (!cache)
-        return -EINVAL;
-
-    pthread_mutex_lock(&cache->mutex);
-    int result = hash_table_remove(cache->table, key);
-    pthread_mutex_unlock(&cache->mutex);
-
-    return result;
-}
-
-// LRU缓存清空
-void lru_cache_clear(lru_cache_t *cache)
-{
-    if (!cache)
-        return;
-
-    pthread_mutex_lock(&cache->mutex);
-    hash_table_clear(cache->table);
-    pthread_mutex_unlock(&cache->mutex);
-}
+#include <fcntl.h>
 
 // 全局文件系统状态
 fs_state_t fs_state;
 
-// 块映射管理
-hash_table_t *block_maps = NULL;
-pthread_mutex_t block_maps_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 块映射管理：ino -> block_map_t，分片加锁，不同文件之间互不阻塞
+shard_map_t *block_maps = NULL;
+
+void destroy_block_map(block_map_t *map);
 
-// 静态缓存变量
-static lru_cache_t *inode_cache = NULL;
+// 静态缓存变量（inode 由 inode_table 索引，不经缓存）
 static lru_cache_t *block_cache = NULL;
 static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
 dedup_config_t dedup_config;
@@ -322,21 +42,35 @@ dedup_config_t dedup_config;
 // 缓存初始化函数
 static void init_caches(void)
 {
-    inode_cache = lru_cache_create(10000); // 10K个inode缓存
     block_cache = lru_cache_create(5000);  // 5K个数据块缓存
 }
 
-// 初始化文件系统
-void fs_init(void)
+static int fs_restore(void);
+static void fs_checkpoint_start(unsigned interval);
+static void fs_checkpoint_stop(void);
+static void writeback_start(void);
+static void writeback_stop(void);
+
+// 默认定期检查点间隔（秒）
+#define FS_CHECKPOINT_INTERVAL 30
+
+// 每个线程一次从全局计数器领取的inode编号数
+#define INO_BATCH 64
+
+// 本线程尚未用完的inode编号批次 [tls_ino_next, tls_ino_end)
+static _Thread_local uint64_t tls_ino_next;
+static _Thread_local uint64_t tls_ino_end;
+
+// 初始化文件系统；配置了段存储却无法打开或恢复时返回负errno，此时已释放全部资源，不应挂载
+int fs_init(void)
 {
     memset(&fs_state, 0, sizeof(fs_state_t));
 
     // 初始化锁
-    pthread_mutex_init(&fs_state.ino_mutex, NULL);
-    pthread_rwlock_init(&fs_state.cache_lock, NULL);
+    pthread_mutex_init(&fs_state.comment_lock, NULL);
 
     // 初始化块映射管理
-    block_maps = hash_table_create(10000);
+    block_maps = shard_map_create(16384);
 
     // 设置配置（允许基于分块策略调整块大小）
     block_splitter_config_t bcfg = block_splitter_default_config();
@@ -345,6 +79,12 @@ void fs_init(void)
     fs_state.enable_compression = false;   // 初始关闭
     fs_state.enable_deduplication = false; // 初始关闭
 
+    /* 块容器：配置目录后块数据从映射的容器文件中分配，常驻内存交由内核页缓存管理 */
+    const char *container_dir = config_get("storage.container_dir");
+    if (container_dir && *container_dir && !block_container_enabled())
+        block_container_open(container_dir,
+                             config_get_size("storage.container_size", BLOCK_CONTAINER_DEFAULT_SIZE));
+
     // 创建根目录
     fs_state.root = calloc(1, sizeof(directory_t));
     if (!fs_state.root)
@@ -361,25 +101,28 @@ void fs_init(void)
     fs_state.root->meta.gid = getgid();
     fs_state.root->meta.size = DEFAULT_BLOCK_SIZE;
     fs_state.root->meta.blocks = 1;
-    fs_state.root->meta.version = 1;
-    fs_state.root->meta.version_count = 0;
-    fs_state.root->meta.latest_version_id = 0;
-    fs_state.root->meta.last_version_time = 0;
-    fs_state.root->meta.version_pinned = false;
-    fs_state.root->meta.version_pinned_set = false;
     fs_state.root->meta.current_block_map = NULL;
-    fs_state.root->meta.data_hash = 0;
-    pthread_rwlock_init(&fs_state.root->meta.version_lock, NULL);
+    fs_state.root->meta.ext = NULL;
 
     clock_gettime(CLOCK_REALTIME, &fs_state.root->meta.atime);
     fs_state.root->meta.mtime = fs_state.root->meta.atime;
     fs_state.root->meta.ctime = fs_state.root->meta.atime;
 
     pthread_rwlock_init(&fs_state.root->lock, NULL);
+    if (inode_table_insert(&fs_state.root->meta) != 0)
+    {
+        perror("Failed to register root inode");
+        exit(EXIT_FAILURE);
+    }
     fs_state.root->entries = NULL;
+    fs_state.root->entries_tail = NULL;
+    fs_state.root->buckets = NULL;
+    fs_state.root->bucket_count = 0;
     fs_state.root->entry_count = 0;
 
     fs_state.next_ino = 2;
+    fs_state.next_block_id = 1;
+    tls_ino_next = tls_ino_end = 0; // 重新初始化时作废本线程领取的旧批次
     fs_state.total_dirs = 1;
     fs_state.total_files = 0;
     fs_state.total_blocks = 0;
@@ -398,36 +141,97 @@ void fs_init(void)
 
     /* 初始化模块B：版本管理 */
     version_manager_init();
-    /* 启动版本清理后台线程 */
-    version_manager_start_cleaner();
 
     /* 保持配置别名同步 */
     fs_state.max_versions = fs_state.version_max_versions;
     fs_state.expire_days = fs_state.version_expire_days;
+
+    /* 段存储：配置了存储目录时，封存的块追加落盘，并按上次卸载时的检查点重建目录树 */
+    const char *segment_dir = config_get("storage.segment_dir");
+    if (segment_dir && *segment_dir)
+    {
+        int ret = segment_store_open(segment_dir,
+                                     config_get_size("storage.segment_size", SEGMENT_DEFAULT_SIZE),
+                                     (unsigned)config_get_int("storage.segment_clean_percent",
+                                                              SEGMENT_DEFAULT_CLEAN_PERCENT));
+        if (ret == 0 && (ret = fs_restore()) != 0)
+        {
+            // 未能完整重建目录树时先关闭存储：fs_destroy 的检查点不能以残缺的树覆盖上一个完好的检查点
+            segment_store_close();
+        }
+        if (ret != 0)
+        {
+            // 不以内存文件系统继续挂载：用户写入的数据会在卸载时静默丢失
+            SBFS_LOG_ERROR("段存储 %s 打开或恢复失败，拒绝挂载: %s", segment_dir, strerror(-ret));
+            fs_destroy();
+            return ret;
+        }
+    }
+
+    /* 批量控制通道：/.smartbackup/ctl */
+    if (ctl_init() != 0)
+        SBFS_LOG_WARN("控制通道初始化失败，/%s/%s 不可用", SBFS_CTL_DIR_NAME, SBFS_CTL_FILE_NAME);
+
+    /* 启动版本清理后台线程（目录树就绪之后） */
+    version_manager_start_cleaner();
+    writeback_start();
+    if (segment_store_enabled())
+    {
+        long interval = config_get_int("storage.checkpoint_interval", FS_CHECKPOINT_INTERVAL);
+        fs_checkpoint_start(interval > 0 ? (unsigned)interval : 0);
+    }
+    return 0;
+}
+
+// 卸载时释放目录树：子目录递归释放；非目录inode可能有多个硬链接，只摘目录项，
+// 留待遍历inode表时各释放一次
+static void fs_free_tree(directory_t *dir)
+{
+    dir_entry_t *entry = dir->entries;
+    while (entry)
+    {
+        dir_entry_t *next = entry->next;
+        if (S_ISDIR(entry->meta->mode))
+        {
+            directory_t *sub = (directory_t *)entry->meta;
+            fs_free_tree(sub);
+            pthread_rwlock_destroy(&sub->lock);
+            free_inode(entry->meta);
+        }
+        dir_entry_free(entry);
+        entry = next;
+    }
+    directory_destroy_index(dir);
 }
 
-// 销毁文件系统
+// 销毁文件系统（两个前端的 destroy 回调共用）
 void fs_destroy(void)
 {
-    // 清理根目录
+    writeback_stop();
+    fs_checkpoint_stop();
+    fs_checkpoint();
+
+    // 清理目录树
     if (fs_state.root)
     {
         pthread_rwlock_wrlock(&fs_state.root->lock);
+        fs_free_tree(fs_state.root);
+        pthread_rwlock_unlock(&fs_state.root->lock);
+        pthread_rwlock_destroy(&fs_state.root->lock);
+        inode_table_remove(&fs_state.root->meta);
 
-        dir_entry_t *entry = fs_state.root->entries;
-        while (entry)
+        // 剩余的是文件、符号链接与已删除但仍打开的inode
+        uint64_t ino = 0;
+        file_metadata_t *meta;
+        while ((meta = inode_table_next(&ino)) != NULL)
         {
-            dir_entry_t *next = entry->next;
-            free(entry->name);
-            free_inode(entry->meta);
-            free(entry);
-            entry = next;
+            free_inode(meta);
+            ino++;
         }
 
-        pthread_rwlock_unlock(&fs_state.root->lock);
-        pthread_rwlock_destroy(&fs_state.root->lock);
-        pthread_rwlock_destroy(&fs_state.root->meta.version_lock);
+        file_meta_ext_free(&fs_state.root->meta);
         free(fs_state.root);
+        fs_state.root = NULL;
     }
 
     // 清理缓存
@@ -439,119 +243,691 @@ void fs_destroy(void)
     /* 销毁版本管理模块 */
     version_manager_destroy();
 
+    segment_store_close();
+    inode_table_destroy();
+
+    // 此时已无读者，释放所有延迟回收的对象
+    epoch_shutdown();
+
     // 销毁锁
-    pthread_mutex_destroy(&fs_state.ino_mutex);
-    pthread_rwlock_destroy(&fs_state.cache_lock);
+    pthread_mutex_destroy(&fs_state.comment_lock);
 }
 
-// 创建新的inode
-file_metadata_t *create_inode(file_type_t type, mode_t mode)
+// 分配inode编号：先从本线程的批次中取，用完时以一次原子加领取下一批，不取任何锁。
+// 不同线程的编号交错，不保证全局递增；线程退出时批次中剩余的编号直接作废
+uint64_t inode_alloc_ino(void)
 {
-    pthread_mutex_lock(&fs_state.ino_mutex);
-
-    file_metadata_t *meta = calloc(1, sizeof(file_metadata_t));
-    if (!meta)
-    {
-        pthread_mutex_unlock(&fs_state.ino_mutex);
-        return NULL;
-    }
-
-    meta->ino = fs_state.next_ino++;
-    meta->type = type;
-
-    switch (type)
+    if (tls_ino_next == tls_ino_end)
     {
-    case FT_DIRECTORY:
-        meta->mode = S_IFDIR | (mode & 07777);
-        meta->nlink = 2; // '.' 和父目录
-        fs_state.total_dirs++;
-        break;
-    case FT_REGULAR:
-        meta->mode = S_IFREG | (mode & 07777);
-        meta->nlink = 1;
-        fs_state.total_files++;
-        break;
-    case FT_SYMLINK:
-        meta->mode = S_IFLNK | (mode & 07777);
-        meta->nlink = 1;
-        break;
-    default:
-        meta->mode = mode;
-        meta->nlink = 1;
-        break;
+        tls_ino_next = __atomic_fetch_add(&fs_state.next_ino, INO_BATCH, __ATOMIC_RELAXED);
+        tls_ino_end = tls_ino_next + INO_BATCH;
     }
+    return tls_ino_next++;
+}
 
-    meta->uid = fuse_get_context()->uid;
-    meta->gid = fuse_get_context()->gid;
-    meta->size = 0;
-    meta->blocks = 0;
-    meta->version = 1;
-    meta->version_count = 0;
-    meta->latest_version_id = 0;
-    meta->last_version_time = 0;
-    meta->version_pinned = false;
-    meta->version_pinned_set = false;
-    meta->current_block_map = NULL;
-    meta->data_hash = 0;
-    pthread_rwlock_init(&meta->version_lock, NULL);
-
-    clock_gettime(CLOCK_REALTIME, &meta->atime);
-    meta->mtime = meta->atime;
-    meta->ctime = meta->atime;
+/* ---- 段存储：挂载时按检查点重建目录树，卸载时写检查点 ---- */
 
-    meta->xattr = NULL;
-    meta->xattr_size = 0;
+static void block_map_extend(block_map_t *map, uint64_t count);
 
-    pthread_mutex_unlock(&fs_state.ino_mutex);
+// 保存的目录时间：子项全部挂入后再恢复（挂入子项会刷新目录的修改时间）
+typedef struct restore_dir_times {
+    directory_t *dir;
+    struct timespec atime;
+    struct timespec mtime;
+    struct timespec ctime;
+    struct restore_dir_times *next;
+} restore_dir_times_t;
 
-    // 添加到缓存
-    cache_set(meta->ino, meta);
+typedef struct restore_ctx {
+    file_metadata_t *file;        // 正在接收块列表的文件；硬链接的重复项与跳过的项为NULL
+    hash_table_t *blocks;         // 块ID -> data_block_t*，多处共享同一块时只装载一次
+    restore_dir_times_t *dirs;
+    uint64_t max_ino;
+    size_t nodes;
+} restore_ctx_t;
 
-    return meta;
+static void restore_attrs(file_metadata_t *meta, const segment_node_t *node)
+{
+    meta->mode = node->mode;
+    meta->nlink = node->nlink;
+    meta->uid = node->uid;
+    meta->gid = node->gid;
+    meta->atime = node->atime;
+    meta->mtime = node->mtime;
+    meta->ctime = node->ctime;
 }
 
-// 释放inode
-void free_inode(file_metadata_t *meta)
+static int restore_save_dir_times(restore_ctx_t *ctx, directory_t *dir, const segment_node_t *node)
 {
-    if (!meta)
-        return;
+    restore_dir_times_t *t = malloc(sizeof(*t));
+    if (!t)
+        return -ENOMEM;
+    t->dir = dir;
+    t->atime = node->atime;
+    t->mtime = node->mtime;
+    t->ctime = node->ctime;
+    t->next = ctx->dirs;
+    ctx->dirs = t;
+    return 0;
+}
 
-    // 从缓存移除
-    cache_remove(meta->ino);
+// 建立一个目录项对应的inode并挂入父目录；硬链接的后续目录项只增加名称
+static int restore_node(restore_ctx_t *ctx, const segment_node_t *node)
+{
+    ctx->file = NULL;
+    if (node->ino > ctx->max_ino)
+        ctx->max_ino = node->ino;
 
-    // 清理扩展属性
-    if (meta->xattr)
+    if (node->ino == fs_state.root->meta.ino)
     {
-        free(meta->xattr);
+        restore_attrs(&fs_state.root->meta, node);
+        return restore_save_dir_times(ctx, fs_state.root, node);
     }
 
-    pthread_rwlock_destroy(&meta->version_lock);
-
-    free(meta);
-}
+    directory_t *parent = (directory_t *)inode_table_get(node->parent_ino);
+    if (!parent || parent->meta.type != FT_DIRECTORY || !node->name[0])
+    {
+        SBFS_LOG_WARN("段存储：检查点中 inode %llu 的父目录 %llu 不存在，已跳过",
+                      (unsigned long long)node->ino, (unsigned long long)node->parent_ino);
+        return 0;
+    }
 
-// 根据路径查找inode
-file_metadata_t *lookup_path(const char *path)
-{
-    if (!path || path[0] != '/')
+    file_metadata_t *meta = inode_table_get(node->ino);
+    if (meta)
     {
-        return NULL;
+        int ret = add_directory_entry(parent, node->name, meta);
+        return ret == -ENOMEM ? ret : 0;
     }
 
-    if (strcmp(path, "/") == 0)
+    directory_t *dir = NULL;
+    if (node->type == FT_DIRECTORY)
     {
-        return &fs_state.root->meta;
+        dir = calloc(1, sizeof(directory_t));
+        if (!dir)
+            return -ENOMEM;
+        pthread_rwlock_init(&dir->lock, NULL);
+        meta = &dir->meta;
+        meta->size = DEFAULT_BLOCK_SIZE;
+        meta->blocks = 1;
+    }
+    else
+    {
+        meta = calloc(1, sizeof(file_metadata_t));
+        if (!meta)
+            return -ENOMEM;
+        meta->size = node->size;
+        meta->blocks = node->blocks;
     }
+    meta->ino = node->ino;
+    meta->type = (file_type_t)node->type;
+    meta->parent_ino = parent->meta.ino;
+    restore_attrs(meta, node);
 
-    // 使用可重入的分词以避免并发问题
-    char *path_copy = strdup(path);
-    if (!path_copy)
+    int ret = 0;
+    if (node->link_target)
     {
-        return NULL;
+        file_meta_ext_t *ext = file_meta_ext_get(meta);
+        if (!ext || !(ext->link_target = strdup(node->link_target)))
+            ret = -ENOMEM;
+    }
+    if (ret == 0)
+        ret = inode_table_insert(meta);
+    if (ret == 0)
+    {
+        ret = add_directory_entry(parent, node->name, meta);
+        if (ret != 0)
+            inode_table_remove(meta);
+    }
+    if (ret == 0 && dir)
+        ret = restore_save_dir_times(ctx, dir, node);
+    if (ret != 0)
+    {
+        // 名称冲突等只跳过该项，内存不足时中止回放
+        file_meta_ext_free(meta);
+        if (dir)
+            pthread_rwlock_destroy(&dir->lock);
+        free(meta);
+        return ret == -ENOMEM ? ret : 0;
     }
 
-    char *saveptr = NULL;
-    char *token = strtok_r(path_copy + 1, "/", &saveptr);
+    if (dir)
+    {
+        FS_STAT_ADD(total_dirs, 1);
+        FS_STAT_ADD(total_blocks, 1);
+    }
+    else if (meta->type == FT_REGULAR)
+    {
+        FS_STAT_ADD(total_files, 1);
+        ctx->file = meta;
+    }
+    ctx->nodes++;
+    return 0;
+}
+
+// 从段存储装载一个块
+static data_block_t *restore_load_block(uint64_t block_id)
+{
+    segment_block_info_t info;
+    int ret = segment_store_read(block_id, NULL, 0, &info);
+    if (ret != -ERANGE)
+        return NULL;
+    data_block_t *block = allocate_block(info.stored > info.size ? info.stored : info.size);
+    if (!block)
+        return NULL;
+    ret = segment_store_read(block_id, block->data, info.stored, NULL);
+    if (ret != (int)info.stored)
+    {
+        free_block(block);
+        return NULL;
+    }
+    block->block_id = block_id;
+    block->size = info.size;
+    block->compression = info.compression;
+    block->compressed_size = info.compression != COMPRESSION_NONE ? info.stored : 0;
+    block->checksum = info.checksum;
+    memcpy(block->hash, info.hash, sizeof(block->hash));
+    return block;
+}
+
+static int restore_blocks(restore_ctx_t *ctx, const segment_block_ref_t *refs, size_t count)
+{
+    file_metadata_t *meta = ctx->file;
+    block_map_t *map = meta ? file_block_map(meta) : NULL;
+    if (!map)
+    {
+        for (size_t i = 0; i < count; i++)
+            segment_store_release(refs[i].block_id);
+        return meta ? -ENOMEM : 0;
+    }
+
+    int ret = 0;
+    block_map_write_lock(map);
+    for (size_t i = 0; i < count && ret == 0; i++)
+    {
+        data_block_t *block = hash_table_get(ctx->blocks, refs[i].block_id);
+        if (block)
+        {
+            dedup_core_inc_ref(block);
+        }
+        else if ((block = restore_load_block(refs[i].block_id)) != NULL)
+        {
+            block->file_ino = meta->ino;
+            block->offset = refs[i].index * fs_state.block_size;
+            if (hash_table_set(ctx->blocks, block->block_id, block) != 0)
+                ret = -ENOMEM;
+        }
+        else
+        {
+            // 内容缺失的块按空洞处理
+            SBFS_LOG_WARN("段存储：inode %llu 的块 %llu 无法读取", (unsigned long long)meta->ino,
+                          (unsigned long long)refs[i].block_id);
+            segment_store_release(refs[i].block_id);
+            continue;
+        }
+
+        data_block_t **slot = ret == 0 ? block_map_slot(map, refs[i].index, true) : NULL;
+        if (!slot)
+        {
+            dedup_release_block(block);
+            ret = -ENOMEM;
+            break;
+        }
+        __atomic_store_n(slot, block, __ATOMIC_RELEASE);
+        block_map_extend(map, refs[i].index + 1);
+        if (map->block_index)
+            hash_table_set(map->block_index, block->block_id, block);
+    }
+    block_map_write_unlock(map);
+    return ret;
+}
+
+static int restore_cb(void *arg, const segment_node_t *node, const segment_block_ref_t *refs,
+                      size_t count)
+{
+    restore_ctx_t *ctx = arg;
+    return node ? restore_node(ctx, node) : restore_blocks(ctx, refs, count);
+}
+
+// 挂载时按最新检查点重建目录树，编号分配从已用过的最大编号之后继续
+static int fs_restore(void)
+{
+    restore_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.blocks = hash_table_create(1024);
+    if (!ctx.blocks)
+        return -ENOMEM;
+
+    int ret = segment_store_restore(restore_cb, &ctx);
+    while (ctx.dirs)
+    {
+        restore_dir_times_t *t = ctx.dirs;
+        ctx.dirs = t->next;
+        t->dir->meta.atime = t->atime;
+        t->dir->meta.mtime = t->mtime;
+        t->dir->meta.ctime = t->ctime;
+        free(t);
+    }
+    hash_table_destroy(ctx.blocks);
+
+    uint64_t next_block = segment_store_max_block_id() + 1;
+    if (fs_state.next_block_id < next_block)
+        fs_state.next_block_id = next_block;
+    if (fs_state.next_ino <= ctx.max_ino)
+        fs_state.next_ino = ctx.max_ino + 1;
+    if (ret == 0 && ctx.nodes)
+        SBFS_LOG_INFO("段存储：从检查点恢复了 %zu 个目录项，%zu 个inode", ctx.nodes, inode_table_count());
+    return ret;
+}
+
+typedef struct checkpoint_ctx {
+    hash_table_t *seen;           // 已写出的inode（硬链接只随第一次出现写块列表）
+    segment_block_ref_t *refs;
+    int ret;
+} checkpoint_ctx_t;
+
+static void checkpoint_fill_node(segment_node_t *node, const file_metadata_t *meta, uint64_t parent_ino,
+                                 const char *name)
+{
+    memset(node, 0, sizeof(*node));
+    node->ino = meta->ino;
+    node->parent_ino = parent_ino;
+    node->nlink = meta->nlink;
+    node->size = meta->size;
+    node->blocks = meta->blocks;
+    node->type = meta->type;
+    node->mode = meta->mode;
+    node->uid = meta->uid;
+    node->gid = meta->gid;
+    node->atime = meta->atime;
+    node->mtime = meta->mtime;
+    node->ctime = meta->ctime;
+    node->name = name;
+    node->link_target = meta->type == FT_SYMLINK ? file_meta_ext(meta)->link_target : NULL;
+}
+
+// 文件的目录项与块列表在同一次块映射读锁内写出：与写者并发时大小与块列表仍一致
+static int checkpoint_file(checkpoint_ctx_t *ctx, file_metadata_t *meta, uint64_t parent_ino,
+                           const char *name)
+{
+    file_writeback(meta);
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
+
+    size_t n = 0;
+    uint64_t idx = 0;
+    data_block_t *block;
+    segment_node_t node;
+    pthread_rwlock_rdlock(&map->lock);
+    checkpoint_fill_node(&node, meta, parent_ino, name);
+    int ret = segment_store_checkpoint_node(&node);
+    while (ret == 0 && (block = block_map_next(map, &idx)) != NULL)
+    {
+        ctx->refs[n].index = idx++;
+        ctx->refs[n].block_id = block->block_id;
+        if (++n == SEGMENT_CKPT_BATCH)
+        {
+            ret = segment_store_checkpoint_blocks(ctx->refs, n);
+            n = 0;
+        }
+    }
+    pthread_rwlock_unlock(&map->lock);
+    if (ret == 0 && n)
+        ret = segment_store_checkpoint_blocks(ctx->refs, n);
+    return ret;
+}
+
+// 先序遍历：父目录总在子项之前写出
+static int checkpoint_dir(checkpoint_ctx_t *ctx, directory_t *dir)
+{
+    int ret = 0;
+    pthread_rwlock_rdlock(&dir->lock);
+    for (dir_entry_t *entry = dir->entries; entry && ret == 0; entry = entry->next)
+    {
+        file_metadata_t *meta = entry->meta;
+        if (ctl_is_reserved(meta))
+            continue;
+        bool first = hash_table_get(ctx->seen, meta->ino) == NULL;
+        if (first && hash_table_set(ctx->seen, meta->ino, meta) != 0)
+        {
+            ret = -ENOMEM;
+            break;
+        }
+
+        if (first && meta->type == FT_REGULAR)
+        {
+            ret = checkpoint_file(ctx, meta, dir->meta.ino, entry->name);
+            continue;
+        }
+        segment_node_t node;
+        checkpoint_fill_node(&node, meta, dir->meta.ino, entry->name);
+        ret = segment_store_checkpoint_node(&node);
+        if (ret == 0 && meta->type == FT_DIRECTORY)
+            ret = checkpoint_dir(ctx, (directory_t *)meta);
+    }
+    pthread_rwlock_unlock(&dir->lock);
+    return ret;
+}
+
+// 检查点串行执行（段存储同一时间只能写一个）；fsync 按序号判断自己的数据是否已被别人的检查点带上
+static struct {
+    pthread_mutex_t lock;
+    uint64_t started;             // 已开始的检查点数
+    uint64_t done;                // 最近一次成功完成的检查点序号
+    pthread_t thread;             // 定期检查点线程
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+    bool running;
+    unsigned interval;            // 秒
+} fs_ckpt = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static int fs_checkpoint_locked(void)
+{
+    checkpoint_ctx_t ctx = {
+        .seen = hash_table_create(1024),
+        .refs = malloc(SEGMENT_CKPT_BATCH * sizeof(segment_block_ref_t)),
+    };
+    int ret = (ctx.seen && ctx.refs) ? segment_store_checkpoint_begin() : -ENOMEM;
+    if (ret == 0)
+    {
+        segment_node_t root;
+        checkpoint_fill_node(&root, &fs_state.root->meta, 0, "");
+        ret = segment_store_checkpoint_node(&root);
+    }
+    if (ret == 0)
+        ret = checkpoint_dir(&ctx, fs_state.root);
+    if (ret == 0)
+        ret = segment_store_checkpoint_end();
+    if (ret != 0)
+        SBFS_LOG_ERROR("段存储：写检查点失败: %s", strerror(-ret));
+    if (ctx.seen)
+        hash_table_destroy(ctx.seen);
+    free(ctx.refs);
+    return ret;
+}
+
+int fs_checkpoint(void)
+{
+    if (!segment_store_enabled() || !fs_state.root)
+        return 0;
+
+    pthread_mutex_lock(&fs_ckpt.lock);
+    uint64_t seq = __atomic_add_fetch(&fs_ckpt.started, 1, __ATOMIC_RELEASE);
+    int ret = fs_checkpoint_locked();
+    if (ret == 0)
+        fs_ckpt.done = seq;
+    pthread_mutex_unlock(&fs_ckpt.lock);
+    return ret;
+}
+
+// fsync 用：调用之后开始的检查点一定看到了调用前的写入，已有这样的检查点完成时不必再写。
+// 并发的 fsync 排队期间只有第一个真正写检查点，其余直接返回
+static int fs_checkpoint_sync(void)
+{
+    if (!segment_store_enabled() || !fs_state.root)
+        return 0;
+
+    uint64_t want = __atomic_load_n(&fs_ckpt.started, __ATOMIC_ACQUIRE) + 1;
+    pthread_mutex_lock(&fs_ckpt.lock);
+    int ret = 0;
+    if (fs_ckpt.done < want)
+    {
+        uint64_t seq = __atomic_add_fetch(&fs_ckpt.started, 1, __ATOMIC_RELEASE);
+        ret = fs_checkpoint_locked();
+        if (ret == 0)
+            fs_ckpt.done = seq;
+    }
+    pthread_mutex_unlock(&fs_ckpt.lock);
+    return ret;
+}
+
+static void *fs_checkpoint_thread_fn(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&fs_ckpt.wake_lock);
+    while (fs_ckpt.running)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += fs_ckpt.interval;
+        pthread_cond_timedwait(&fs_ckpt.wake, &fs_ckpt.wake_lock, &ts);
+        if (!fs_ckpt.running)
+            break;
+        pthread_mutex_unlock(&fs_ckpt.wake_lock);
+        fs_checkpoint();
+        pthread_mutex_lock(&fs_ckpt.wake_lock);
+    }
+    pthread_mutex_unlock(&fs_ckpt.wake_lock);
+    return NULL;
+}
+
+// 定期写检查点，限定崩溃时目录树回退的范围；间隔为0时只在 fsync 与卸载时写
+static void fs_checkpoint_start(unsigned interval)
+{
+    if (!interval || fs_ckpt.running)
+        return;
+    fs_ckpt.interval = interval;
+    fs_ckpt.running = true;
+    if (pthread_create(&fs_ckpt.thread, NULL, fs_checkpoint_thread_fn, NULL) != 0)
+    {
+        fs_ckpt.running = false;
+        SBFS_LOG_WARN("段存储：定期检查点线程启动失败，只在 fsync 与卸载时写检查点");
+    }
+}
+
+static void fs_checkpoint_stop(void)
+{
+    pthread_mutex_lock(&fs_ckpt.wake_lock);
+    bool running = fs_ckpt.running;
+    fs_ckpt.running = false;
+    pthread_cond_signal(&fs_ckpt.wake);
+    pthread_mutex_unlock(&fs_ckpt.wake_lock);
+    if (running)
+        pthread_join(fs_ckpt.thread, NULL);
+}
+
+// 创建新的inode
+file_metadata_t *create_inode(file_type_t type, mode_t mode)
+{
+    file_metadata_t *meta = calloc(1, sizeof(file_metadata_t));
+    if (!meta)
+    {
+        return NULL;
+    }
+
+    meta->ino = inode_alloc_ino();
+    meta->type = type;
+
+    switch (type)
+    {
+    case FT_DIRECTORY:
+        meta->mode = S_IFDIR | (mode & 07777);
+        meta->nlink = 2; // '.' 和父目录
+        FS_STAT_ADD(total_dirs, 1);
+        break;
+    case FT_REGULAR:
+        meta->mode = S_IFREG | (mode & 07777);
+        meta->nlink = 1;
+        FS_STAT_ADD(total_files, 1);
+        break;
+    case FT_SYMLINK:
+        meta->mode = S_IFLNK | (mode & 07777);
+        meta->nlink = 1;
+        break;
+    default:
+        meta->mode = mode;
+        meta->nlink = 1;
+        break;
+    }
+
+    meta->uid = fuse_get_context()->uid;
+    meta->gid = fuse_get_context()->gid;
+    meta->size = 0;
+    meta->blocks = 0;
+    meta->current_block_map = NULL;
+    meta->ext = NULL;
+
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+    meta->mtime = meta->atime;
+    meta->ctime = meta->atime;
+
+    if (inode_table_insert(meta) != 0)
+    {
+        free(meta);
+        return NULL;
+    }
+
+    return meta;
+}
+
+static const file_meta_ext_t meta_ext_empty;
+
+const file_meta_ext_t *file_meta_ext(const file_metadata_t *meta)
+{
+    const file_meta_ext_t *ext = __atomic_load_n(&meta->ext, __ATOMIC_ACQUIRE);
+    return ext ? ext : &meta_ext_empty;
+}
+
+file_meta_ext_t *file_meta_ext_get(file_metadata_t *meta)
+{
+    file_meta_ext_t *ext = __atomic_load_n(&meta->ext, __ATOMIC_ACQUIRE);
+    if (ext)
+        return ext;
+    file_meta_ext_t *fresh = calloc(1, sizeof(file_meta_ext_t));
+    if (!fresh)
+        return NULL;
+    if (!__atomic_compare_exchange_n(&meta->ext, &ext, fresh, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE))
+    {
+        // 另一线程先装上了冷区
+        free(fresh);
+        return ext;
+    }
+    FS_STAT_ADD(meta_ext_count, 1);
+    return fresh;
+}
+
+void file_meta_ext_free(file_metadata_t *meta)
+{
+    file_meta_ext_t *ext = meta->ext;
+    if (!ext)
+        return;
+    meta->ext = NULL;
+    free(ext->link_target);
+    free(ext->comment);
+    free(ext);
+    FS_STAT_SUB(meta_ext_count, 1);
+}
+
+static void inode_reclaim(void *ptr)
+{
+    file_meta_ext_free(ptr);
+    free(ptr);
+}
+
+// 释放inode
+void free_inode(file_metadata_t *meta)
+{
+    if (!meta)
+        return;
+
+    inode_table_remove(meta);
+
+    // 无锁路径解析可能仍持有该inode（目录则连同目录结构与冷区），延迟到读者离开后释放
+    epoch_retire(meta, inode_reclaim);
+}
+
+// 由 @versions 目录项名称（"v<ID> | ..."）取出版本标记 "v<ID>"
+static bool version_entry_token(const char *name, char *out, size_t size)
+{
+    if (name[0] != 'v')
+        return false;
+    size_t n = 1;
+    while (name[n] >= '0' && name[n] <= '9')
+        n++;
+    if (n == 1 || (name[n] != '\0' && name[n] != ' ') || n >= size)
+        return false;
+    memcpy(out, name, n);
+    out[n] = '\0';
+    return true;
+}
+
+static dir_entry_t *directory_lookup_lockless(directory_t *dir, const char *name, size_t len);
+
+// 无锁路径解析：在纪元读侧临界区内逐级查名称索引，不取目录锁。
+// 只处理不含版本语法的常规路径；任一级未命中或中途遇到非目录时返回false，由加锁路径给出最终结果
+static bool resolve_path_lockless(const char *path, file_metadata_t **result)
+{
+    directory_t *dir = fs_state.root;
+    const char *p = path;
+    for (;;)
+    {
+        while (*p == '/')
+            p++;
+        const char *name = p;
+        while (*p && *p != '/')
+        {
+            if (*p == '@')
+                return false;
+            p++;
+        }
+
+        dir_entry_t *entry = directory_lookup_lockless(dir, name, (size_t)(p - name));
+        if (!entry)
+            return false;
+        file_metadata_t *meta = entry->meta;
+
+        while (*p == '/')
+            p++;
+        if (!*p)
+        {
+            *result = meta;
+            return true;
+        }
+        if (meta->type != FT_DIRECTORY)
+            return false;
+        dir = (directory_t *)meta;
+    }
+}
+
+// 路径解析；with_versions 为真时 filename@vN 与 filename@versions/<项> 解析为版本视图（持有引用）
+static file_metadata_t *resolve_path(const char *path, bool with_versions)
+{
+    if (!path || path[0] != '/')
+    {
+        return NULL;
+    }
+
+    if (strcmp(path, "/") == 0)
+    {
+        return &fs_state.root->meta;
+    }
+
+    // 常规路径先走无锁解析，命中即返回；返回值与加锁解析一样不额外持有引用
+    file_metadata_t *found = NULL;
+    if (epoch_enter())
+    {
+        bool hit = resolve_path_lockless(path, &found);
+        epoch_exit();
+        if (hit)
+            return found;
+    }
+
+    // 使用可重入的分词以避免并发问题；路径复制到线程私有缓冲，超长时才分配
+    size_t len = strlen(path);
+    worker_scratch_t *ws = len < MAX_PATH_LEN ? worker_scratch() : NULL;
+    char *path_copy = ws ? memcpy(ws->path, path, len + 1) : strdup(path);
+    if (!path_copy)
+    {
+        return NULL;
+    }
+
+    char *saveptr = NULL;
+    char *token = strtok_r(path_copy + 1, "/", &saveptr);
 
     directory_t *current_dir = fs_state.root;
     file_metadata_t *result = NULL;
@@ -563,57 +939,58 @@ file_metadata_t *lookup_path(const char *path)
     {
         /* 拆分 token 处理 @version/@versions 语法 */
         char *atpos = strchr(token, '@');
-        char *base_token = NULL;
-        char *ver_token = NULL;
+        const char *ver_token = NULL;
         if (atpos)
         {
-            base_token = strndup(token, atpos - token);
-            ver_token = strdup(atpos + 1);
-        }
-        else
-        {
-            base_token = strdup(token);
+            *atpos = '\0';
+            ver_token = atpos + 1;
         }
 
-        dir_entry_t *entry = find_directory_entry(current_dir, base_token);
-        free(base_token);
+        dir_entry_t *entry = find_directory_entry(current_dir, token);
         if (!entry)
         {
-            free(ver_token);
             pthread_rwlock_unlock(&current_dir->lock);
             result = NULL;
             break;
         }
 
         char *next_token = strtok_r(NULL, "/", &saveptr);
-        if (!next_token)
+        if (ver_token)
         {
-            if (ver_token)
+            if (strcmp(ver_token, "versions") == 0 && !next_token)
             {
-                if (strcmp(ver_token, "versions") == 0)
-                {
-                    /* 交由 readdir 处理，返回列表 */
-                    free(ver_token);
-                    result = entry->meta;
-                    pthread_rwlock_unlock(&current_dir->lock);
-                    break;
-                }
-
-                file_metadata_t *vmeta = version_manager_get_version_meta(entry->meta, ver_token);
-                free(ver_token);
-                result = vmeta;
-                pthread_rwlock_unlock(&current_dir->lock);
-                break;
+                /* 交由 readdir 处理，返回列表 */
+                result = entry->meta;
+            }
+            else if (!with_versions)
+            {
+                result = NULL;
+            }
+            else if (strcmp(ver_token, "versions") == 0)
+            {
+                /* filename@versions/<目录项>：目录项名称以 v<ID> 开头，且必须是最后一级 */
+                char vbuf[32];
+                char *rest = strtok_r(NULL, "/", &saveptr);
+                result = (!rest && version_entry_token(next_token, vbuf, sizeof(vbuf)))
+                             ? version_manager_get_version_meta(entry->meta, vbuf)
+                             : NULL;
+            }
+            else
+            {
+                result = next_token ? NULL : version_manager_get_version_meta(entry->meta, ver_token);
             }
+            pthread_rwlock_unlock(&current_dir->lock);
+            break;
+        }
 
+        if (!next_token)
+        {
             /* 常规路径，直接返回 */
             result = entry->meta;
             pthread_rwlock_unlock(&current_dir->lock);
             break;
         }
 
-        free(ver_token);
-
         // 需要继续向下，但目标不是目录，失败
         if (entry->meta->type != FT_DIRECTORY)
         {
@@ -631,621 +1008,2422 @@ file_metadata_t *lookup_path(const char *path)
         token = next_token;
     }
 
-    free(path_copy);
-    return result;
+    if (!ws)
+        free(path_copy);
+    return result;
+}
+
+// 根据路径查找inode（版本视图不在此解析，见 lookup_path_ref）
+file_metadata_t *lookup_path(const char *path)
+{
+    return resolve_path(path, false);
+}
+
+// 根据路径查找，同时解析版本视图；结果须用 lookup_path_put 归还
+file_metadata_t *lookup_path_ref(const char *path)
+{
+    return resolve_path(path, true);
+}
+
+void lookup_path_put(file_metadata_t *meta)
+{
+    if (meta && meta->type == FT_VERSIONED)
+        version_manager_put_version_meta(meta);
+}
+
+// 根据inode编号查找
+file_metadata_t *lookup_inode(uint64_t ino)
+{
+    return inode_table_get(ino);
+}
+
+// 由元数据填充 struct stat（路径前端与inode前端共用）
+void fill_stat_from_meta(const file_metadata_t *meta, struct stat *stbuf)
+{
+    memset(stbuf, 0, sizeof(struct stat));
+    stbuf->st_ino = meta->ino;
+    stbuf->st_mode = meta->mode;
+    stbuf->st_nlink = meta->nlink;
+    stbuf->st_uid = meta->uid;
+    stbuf->st_gid = meta->gid;
+    stbuf->st_size = meta->size;
+    stbuf->st_blocks = meta->blocks;
+    stbuf->st_atim = meta->atime;
+    stbuf->st_mtim = meta->mtime;
+    stbuf->st_ctim = meta->ctime;
+}
+
+// 销毁已脱离目录树的inode（链接数归零的文件或已删除的空目录）
+void destroy_detached_inode(file_metadata_t *meta)
+{
+    if (!meta)
+        return;
+
+    if (S_ISDIR(meta->mode))
+    {
+        directory_t *dir = (directory_t *)meta;
+        pthread_rwlock_destroy(&dir->lock);
+        directory_destroy_index(dir);
+        free_inode(meta);
+        FS_STAT_SUB(total_dirs, 1);
+        FS_STAT_SUB(total_blocks, 1);
+        return;
+    }
+
+    blkcnt_t blk = meta->blocks;
+
+    // 清理文件数据块映射（不存在时不创建）
+    hash_table_t *shard = shard_map_lock(block_maps, meta->ino);
+    block_map_t *map = hash_table_get_locked(shard, meta->ino);
+    if (map)
+        hash_table_remove_locked(shard, meta->ino);
+    shard_map_unlock(shard);
+
+    if (map)
+    {
+        // 销毁块映射会释放所有数据块
+        destroy_block_map(map);
+    }
+
+    free_inode(meta);
+    FS_STAT_SUB(total_files, 1);
+    FS_STAT_SUB(total_blocks, (uint64_t)blk);
+}
+
+// 目录名称索引初始桶数
+#define DIR_INDEX_INITIAL_BUCKETS 16
+
+// 目录项名称哈希（FNV-1a）
+uint64_t dir_name_hash(const char *name, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static inline size_t dir_bucket_of(uint64_t hash, size_t bucket_count)
+{
+    return (size_t)(hash ^ (hash >> 32)) & (bucket_count - 1);
+}
+
+// 重建名称索引：沿遍历链表重新分桶，不改变遍历顺序
+static int dir_index_resize_locked(directory_t *dir, size_t new_count)
+{
+    dir_entry_t **buckets = calloc(new_count, sizeof(dir_entry_t *));
+    if (!buckets)
+        return -ENOMEM;
+
+    for (dir_entry_t *entry = dir->entries; entry; entry = entry->next)
+    {
+        size_t idx = dir_bucket_of(entry->name_hash, new_count);
+        __atomic_store_n(&entry->hash_next, buckets[idx], __ATOMIC_RELEASE);
+        buckets[idx] = entry;
+    }
+
+    // 先发布新桶数组再发布桶数：无锁读者读到新桶数时必然看到新数组，
+    // 读到旧桶数配新数组时下标仍在范围内（至多查错桶，回退加锁路径）
+    dir_entry_t **old = dir->buckets;
+    __atomic_store_n(&dir->buckets, buckets, __ATOMIC_RELEASE);
+    __atomic_store_n(&dir->bucket_count, new_count, __ATOMIC_RELEASE);
+    epoch_retire(old, free);
+    return 0;
+}
+
+static void dir_index_remove_locked(directory_t *dir, dir_entry_t *entry)
+{
+    dir_entry_t **pp = &dir->buckets[dir_bucket_of(entry->name_hash, dir->bucket_count)];
+    while (*pp)
+    {
+        if (*pp == entry)
+        {
+            __atomic_store_n(pp, entry->hash_next, __ATOMIC_RELEASE);
+            break;
+        }
+        pp = &(*pp)->hash_next;
+    }
+    __atomic_store_n(&entry->hash_next, NULL, __ATOMIC_RELEASE);
+}
+
+// 目录项各字段就绪后才挂入桶链，无锁读者沿链看到的目录项总是完整的
+static void dir_index_add_locked(directory_t *dir, dir_entry_t *entry)
+{
+    size_t idx = dir_bucket_of(entry->name_hash, dir->bucket_count);
+    __atomic_store_n(&entry->hash_next, dir->buckets[idx], __ATOMIC_RELEASE);
+    __atomic_store_n(&dir->buckets[idx], entry, __ATOMIC_RELEASE);
+}
+
+// 创建目录项（名称哈希与长度在此计算并缓存）
+dir_entry_t *dir_entry_create(const char *name, file_metadata_t *meta)
+{
+    dir_entry_t *entry = calloc(1, sizeof(dir_entry_t));
+    if (!entry)
+        return NULL;
+
+    entry->name_len = strlen(name);
+    entry->name = malloc(entry->name_len + 1);
+    if (!entry->name)
+    {
+        free(entry);
+        return NULL;
+    }
+    memcpy(entry->name, name, entry->name_len + 1);
+    entry->name_hash = dir_name_hash(name, entry->name_len);
+    entry->meta = meta;
+    return entry;
+}
+
+static void dir_entry_reclaim(void *ptr)
+{
+    dir_entry_t *entry = ptr;
+    free(entry->name);
+    free(entry);
+}
+
+// 释放目录项：无锁读者可能仍停留在该目录项上，延迟到读者离开后释放
+void dir_entry_free(dir_entry_t *entry)
+{
+    if (!entry)
+        return;
+    epoch_retire(entry, dir_entry_reclaim);
+}
+
+// 插入目录项：追加到遍历链表尾并加入名称索引，调用方持有目录写锁且已确认名称不存在
+int directory_insert_entry_locked(directory_t *dir, dir_entry_t *entry)
+{
+    if (!dir || !entry)
+        return -EINVAL;
+
+    if (dir->bucket_count == 0)
+    {
+        if (dir_index_resize_locked(dir, DIR_INDEX_INITIAL_BUCKETS) != 0)
+            return -ENOMEM;
+    }
+    else if (dir->entry_count + 1 > dir->bucket_count)
+    {
+        // 负载因子超过1时翻倍；扩容失败时沿用旧索引，仅影响桶内链长度
+        dir_index_resize_locked(dir, dir->bucket_count * 2);
+    }
+
+    dir_index_add_locked(dir, entry);
+
+    // 追加到链表尾，cookie随之单调递增，链表顺序即cookie顺序
+    if (dir->next_cookie < DIR_COOKIE_FIRST)
+        dir->next_cookie = DIR_COOKIE_FIRST;
+    entry->cookie = dir->next_cookie++;
+
+    entry->next = NULL;
+    entry->prev = dir->entries_tail;
+    if (dir->entries_tail)
+        dir->entries_tail->next = entry;
+    else
+        dir->entries = entry;
+    dir->entries_tail = entry;
+    dir->entry_count++;
+    return 0;
+}
+
+// 摘除目录项（不释放），调用方持有目录写锁
+void directory_unlink_entry_locked(directory_t *dir, dir_entry_t *entry)
+{
+    if (!dir || !entry)
+        return;
+
+    if (dir->bucket_count)
+        dir_index_remove_locked(dir, entry);
+
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        dir->entries = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        dir->entries_tail = entry->prev;
+
+    entry->next = NULL;
+    entry->prev = NULL;
+    if (dir->entry_count > 0)
+        dir->entry_count--;
+    dir->remove_gen++;
+}
+
+// 重命名目录项：更新名称索引，保持遍历位置不变，调用方持有目录写锁
+// dir 为 NULL 时表示目录项已摘除，仅更新名称
+int directory_rename_entry_locked(directory_t *dir, dir_entry_t *entry, const char *new_name)
+{
+    if (!entry || !new_name)
+        return -EINVAL;
+
+    size_t len = strlen(new_name);
+    char *name = malloc(len + 1);
+    if (!name)
+        return -ENOMEM;
+    memcpy(name, new_name, len + 1);
+
+    if (dir && dir->bucket_count)
+        dir_index_remove_locked(dir, entry);
+    epoch_retire(entry->name, free);
+    __atomic_store_n(&entry->name, name, __ATOMIC_RELEASE);
+    entry->name_len = len;
+    __atomic_store_n(&entry->name_hash, dir_name_hash(name, len), __ATOMIC_RELAXED);
+    if (dir && dir->bucket_count)
+        dir_index_add_locked(dir, entry);
+    return 0;
+}
+
+// 释放目录名称索引（目录项本身由调用方释放）
+void directory_destroy_index(directory_t *dir)
+{
+    if (!dir)
+        return;
+    dir_entry_t **old = dir->buckets;
+    __atomic_store_n(&dir->bucket_count, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&dir->buckets, NULL, __ATOMIC_RELEASE);
+    epoch_retire(old, free);
+}
+
+// 定位readdir续读位置：返回第一个cookie大于offset的目录项，调用方持有目录读锁
+dir_entry_t *directory_seek_locked(directory_t *dir, const dir_cursor_t *cursor, uint64_t offset)
+{
+    if (!dir)
+        return NULL;
+    if (offset < DIR_COOKIE_FIRST)
+        return dir->entries;
+
+    // 游标与偏移吻合且期间没有删除，上次记录的目录项仍然有效
+    if (cursor && cursor->valid && cursor->dir == dir &&
+        cursor->remove_gen == dir->remove_gen && cursor->last_cookie == offset)
+        return cursor->last ? cursor->last->next : dir->entries;
+
+    // 游标失效（并发删除或seekdir）：沿链表按cookie跳过
+    dir_entry_t *entry = dir->entries;
+    while (entry && entry->cookie <= offset)
+        entry = entry->next;
+    return entry;
+}
+
+// 记录本次readdir返回的最后位置，调用方持有目录读锁
+void directory_cursor_save_locked(dir_cursor_t *cursor, directory_t *dir,
+                                  dir_entry_t *last, uint64_t last_cookie)
+{
+    if (!cursor)
+        return;
+    cursor->dir = dir;
+    cursor->last = last;
+    cursor->last_cookie = last_cookie;
+    cursor->remove_gen = dir->remove_gen;
+    cursor->valid = true;
+}
+
+// 添加目录项
+int add_directory_entry(directory_t *dir, const char *name, file_metadata_t *meta)
+{
+    if (!dir || !name || !meta)
+    {
+        return -EINVAL;
+    }
+
+    pthread_rwlock_wrlock(&dir->lock);
+
+    // 检查是否已存在
+    if (find_directory_entry(dir, name))
+    {
+        pthread_rwlock_unlock(&dir->lock);
+        return -EEXIST;
+    }
+
+    dir_entry_t *entry = dir_entry_create(name, meta);
+    if (!entry || directory_insert_entry_locked(dir, entry) != 0)
+    {
+        dir_entry_free(entry);
+        pthread_rwlock_unlock(&dir->lock);
+        return -ENOMEM;
+    }
+
+    // 更新目录大小
+    dir->meta.size += entry->name_len + sizeof(dir_entry_t);
+    dir->meta.blocks = (dir->meta.size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+
+    // 更新修改时间
+    clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
+    dir->meta.ctime = dir->meta.mtime;
+
+    pthread_rwlock_unlock(&dir->lock);
+    return 0;
+}
+
+// 移除目录项
+int remove_directory_entry(directory_t *dir, const char *name)
+{
+    if (!dir || !name)
+    {
+        return -EINVAL;
+    }
+
+    pthread_rwlock_wrlock(&dir->lock);
+
+    dir_entry_t *entry = find_directory_entry(dir, name);
+    if (!entry)
+    {
+        pthread_rwlock_unlock(&dir->lock);
+        return -ENOENT;
+    }
+
+    directory_unlink_entry_locked(dir, entry);
+
+    // 更新目录大小
+    dir->meta.size -= entry->name_len + sizeof(dir_entry_t);
+    dir->meta.blocks = (dir->meta.size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+
+    // 更新修改时间
+    clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
+    dir->meta.ctime = dir->meta.mtime;
+
+    dir_entry_free(entry);
+
+    pthread_rwlock_unlock(&dir->lock);
+    return 0;
+}
+
+// 查找目录项（按名称哈希索引，调用方持有目录锁）
+dir_entry_t *find_directory_entry(directory_t *dir, const char *name)
+{
+    if (!dir || !name || dir->bucket_count == 0)
+    {
+        return NULL;
+    }
+
+    size_t len = strlen(name);
+    uint64_t hash = dir_name_hash(name, len);
+    dir_entry_t *entry = dir->buckets[dir_bucket_of(hash, dir->bucket_count)];
+    while (entry)
+    {
+        if (entry->name_hash == hash && entry->name_len == len &&
+            memcmp(entry->name, name, len) == 0)
+        {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+
+    return NULL;
+}
+
+// 无锁查找目录项（名称为 name 起的 len 字节）：调用方处于纪元读侧临界区，
+// 返回的目录项在离开临界区前有效；并发修改期间可能漏查，但不会返回名称不符的目录项
+static dir_entry_t *directory_lookup_lockless(directory_t *dir, const char *name, size_t len)
+{
+    size_t count = __atomic_load_n(&dir->bucket_count, __ATOMIC_ACQUIRE);
+    dir_entry_t **buckets = __atomic_load_n(&dir->buckets, __ATOMIC_ACQUIRE);
+    if (count == 0 || !buckets)
+        return NULL;
+
+    uint64_t hash = dir_name_hash(name, len);
+    dir_entry_t *entry = __atomic_load_n(&buckets[dir_bucket_of(hash, count)], __ATOMIC_ACQUIRE);
+    while (entry)
+    {
+        const char *entry_name = __atomic_load_n(&entry->name, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&entry->name_hash, __ATOMIC_RELAXED) == hash &&
+            strncmp(entry_name, name, len) == 0 && entry_name[len] == '\0')
+        {
+            return entry;
+        }
+        entry = __atomic_load_n(&entry->hash_next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+// 块头与块数据从slab分配：块头使用专属类别，数据按尺寸类别
+static slab_class_t *block_header_class;
+static pthread_once_t block_header_once = PTHREAD_ONCE_INIT;
+
+static void block_header_class_init(void)
+{
+    block_header_class = slab_class_create("block_hdr", sizeof(data_block_t));
+}
+
+// 分配数据块
+data_block_t *allocate_block(size_t size)
+{
+    pthread_once(&block_header_once, block_header_class_init);
+    data_block_t *block = slab_class_alloc(block_header_class);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    // 清零：部分写入的新块其余部分按空洞读出零
+    block->data = slab_zalloc(size);
+    if (!block->data)
+    {
+        slab_free(block);
+        return NULL;
+    }
+
+    block->block_id = __atomic_fetch_add(&fs_state.next_block_id, 1, __ATOMIC_RELAXED);
+    block->file_ino = 0;
+    block->offset = 0;
+    block->size = size;
+    block->compressed_size = 0;
+    block->compression = COMPRESSION_NONE;
+    memset(block->hash, 0, sizeof(block->hash));
+    block->ref_count = 1;
+    pthread_mutex_init(&block->ref_lock, NULL);
+    block->checksum = 0;
+    block->next = NULL;
+
+    FS_STAT_ADD(total_blocks, 1);
+    FS_STAT_ADD(used_blocks, 1);
+
+    return block;
+}
+
+static void block_reclaim(void *ptr)
+{
+    data_block_t *block = ptr;
+    slab_free(block->data);
+    pthread_mutex_destroy(&block->ref_lock);
+    slab_free(block);
+}
+
+// 释放数据块：先从缓存与去重索引摘除，内存延迟到无锁读者离开后释放
+void free_block(data_block_t *block)
+{
+    if (!block)
+        return;
+
+    cache_invalidate_block(block->block_id);
+    dedup_remove_block(block);
+    segment_store_release(block->block_id);
+
+    FS_STAT_SUB(used_blocks, 1);
+    epoch_retire(block, block_reclaim);
+}
+
+// 切换块的数据缓冲（压缩、换回原始数据）：与块映射写序号相同，期间序号为奇数。
+// 调用方持块映射写锁，且块为本映射私有
+void block_data_update_begin(data_block_t *block)
+{
+    __atomic_store_n(&block->data_seq, block->data_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void block_data_update_end(data_block_t *block)
+{
+    __atomic_store_n(&block->data_seq, block->data_seq + 1, __ATOMIC_RELEASE);
+}
+
+// 取 data 与压缩字段的一致快照：无锁读者可能与写者的压缩/解压并发，
+// 分别读取字段会把压缩数据当作 size 字节的原始数据读出界
+static void block_data_snapshot(const data_block_t *block, data_block_t *snap)
+{
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&block->data_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        snap->data = __atomic_load_n(&block->data, __ATOMIC_RELAXED);
+        snap->size = __atomic_load_n(&block->size, __ATOMIC_RELAXED);
+        snap->compressed_size = __atomic_load_n(&block->compressed_size, __ATOMIC_RELAXED);
+        snap->compression = __atomic_load_n(&block->compression, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&block->data_seq, __ATOMIC_RELAXED) == seq)
+            return;
+    }
+}
+
+// 读取数据块
+int read_block(data_block_t *block, char *buf, size_t size, off_t offset)
+{
+    if (!block || !buf)
+    {
+        return -EINVAL;
+    }
+
+    data_block_t snap;
+    block_data_snapshot(block, &snap);
+
+    if (offset < 0 || (size_t)offset >= snap.size)
+    {
+        return 0; // EOF
+    }
+
+    size_t to_read = size;
+    if (offset + to_read > snap.size)
+    {
+        to_read = snap.size - offset;
+    }
+
+    // 压缩块：读整块时直接解压到调用方缓冲，否则经线程私有缓冲，不分配内存
+    if (snap.compressed_size > 0 && snap.compression != COMPRESSION_NONE)
+    {
+        int n = block_decompress_range(&snap, buf, offset, to_read);
+        return n == (int)to_read ? n : -EIO;
+    }
+
+    memcpy(buf, snap.data + offset, to_read);
+    return to_read;
+}
+
+// 压缩块就地换回原始数据（持块映射写锁）
+static int block_make_plain(data_block_t *block)
+{
+    if (block->compressed_size == 0 || block->compression == COMPRESSION_NONE)
+        return 0;
+
+    char *plain = slab_alloc(block->size);
+    size_t plain_size = 0;
+    if (!plain || block_decompress_into(block, plain, block->size, &plain_size) != 0)
+    {
+        slab_free(plain);
+        return -EIO;
+    }
+    // 无锁读者可能正在读取压缩数据，旧缓冲摘下后延迟释放
+    char *old = block->data;
+    block_data_update_begin(block);
+    __atomic_store_n(&block->data, plain, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->size, plain_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->compressed_size, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->compression, COMPRESSION_NONE, __ATOMIC_RELAXED);
+    block_data_update_end(block);
+    epoch_retire(old, slab_free);
+    return 0;
+}
+
+// 写入数据块
+// 按调用方提供的填充函数写入数据块（数据直接落入块存储，不经中间缓冲）
+static int write_block_fill(data_block_t *block, size_t size, off_t offset,
+                            block_fill_fn fill, void *ctx)
+{
+    if (!block || !fill)
+    {
+        return -EINVAL;
+    }
+
+    if (offset < 0 || (size_t)offset >= block->size)
+    {
+        return -ENOSPC;
+    }
+
+    size_t to_write = size;
+    if (offset + to_write > block->size)
+    {
+        to_write = block->size - offset;
+    }
+
+    int ret = block_make_plain(block);
+    if (ret < 0)
+        return ret;
+
+    ret = fill(ctx, block->data + offset, to_write);
+    if (ret < 0)
+        return ret;
+
+    return to_write;
+}
+
+// 更新校验和与简易哈希（供模块C占位）；文件写路径推迟到块封存时才计算
+static void block_update_checksum(data_block_t *block)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < block->size; i++)
+    {
+        sum += (uint8_t)block->data[i];
+    }
+    block->checksum = sum;
+    for (size_t i = 0; i < sizeof(block->hash); i++)
+    {
+        block->hash[i] = (uint8_t)((sum >> ((i % 4) * 8)) ^ (i * 31));
+    }
+}
+
+// 内存缓冲区填充：依次拷贝，游标随之前移
+static int memory_fill(void *ctx, char *dst, size_t len)
+{
+    const char **src = ctx;
+    memcpy(dst, *src, len);
+    *src += len;
+    return 0;
+}
+
+int write_block(data_block_t *block, const char *buf, size_t size, off_t offset)
+{
+    if (!buf)
+    {
+        return -EINVAL;
+    }
+
+    int ret = write_block_fill(block, size, offset, memory_fill, &buf);
+    if (ret >= 0)
+        block_update_checksum(block);
+    return ret;
+}
+
+// 块映射基数树：索引上限 2^60 个块，最高层节点的 shift 不超过 54，移位不会溢出
+#define BLOCK_MAP_MAX_INDEX ((uint64_t)1 << 60)
+#define BLOCK_MAP_SLOT_MASK (BLOCK_MAP_NODE_SLOTS - 1)
+
+static slab_class_t *block_map_node_class;
+static pthread_once_t block_map_node_once = PTHREAD_ONCE_INIT;
+
+static void block_map_node_class_init(void)
+{
+    block_map_node_class = slab_class_create("bmap_node", sizeof(block_map_node_t));
+}
+
+static block_map_node_t *bmap_node_alloc(uint32_t shift)
+{
+    pthread_once(&block_map_node_once, block_map_node_class_init);
+    block_map_node_t *node = slab_class_alloc(block_map_node_class);
+    if (!node)
+        return NULL;
+    memset(node, 0, sizeof(*node));
+    node->shift = shift;
+    return node;
+}
+
+// 节点 node 能否容纳索引 index（根节点覆盖 [0, 2^(shift+6))）
+static bool bmap_covers(const block_map_node_t *node, uint64_t index)
+{
+    return (index >> (node->shift + BLOCK_MAP_NODE_SHIFT)) == 0;
+}
+
+static bool bmap_node_empty(const block_map_node_t *node)
+{
+    for (unsigned int i = 0; i < BLOCK_MAP_NODE_SLOTS; i++)
+        if (node->slots[i].child)
+            return false;
+    return true;
+}
+
+static data_block_t *bmap_lookup(block_map_node_t *node, uint64_t index)
+{
+    if (!node || !bmap_covers(node, index))
+        return NULL;
+    while (node->shift > 0)
+    {
+        node = __atomic_load_n(&node->slots[(index >> node->shift) & BLOCK_MAP_SLOT_MASK].child,
+                               __ATOMIC_ACQUIRE);
+        if (!node)
+            return NULL;
+    }
+    return __atomic_load_n(&node->slots[index & BLOCK_MAP_SLOT_MASK].block, __ATOMIC_ACQUIRE);
+}
+
+// 在以 base 为起点的子树中找索引不小于 *index 的第一个块
+static data_block_t *bmap_next(block_map_node_t *node, uint64_t base, uint64_t *index)
+{
+    unsigned int first = (unsigned int)((*index - base) >> node->shift);
+    for (unsigned int i = first; i < BLOCK_MAP_NODE_SLOTS; i++)
+    {
+        uint64_t start = base + ((uint64_t)i << node->shift);
+        if (i > first)
+            *index = start;
+        if (node->shift == 0)
+        {
+            data_block_t *block = __atomic_load_n(&node->slots[i].block, __ATOMIC_ACQUIRE);
+            if (block)
+                return block;
+            continue;
+        }
+        block_map_node_t *child = __atomic_load_n(&node->slots[i].child, __ATOMIC_ACQUIRE);
+        if (child)
+        {
+            data_block_t *block = bmap_next(child, start, index);
+            if (block)
+                return block;
+        }
+    }
+    return NULL;
+}
+
+// 清空 index 所在的槽，并摘除因此变空的子树节点；返回 node 自身是否已空
+static bool bmap_erase(block_map_node_t *node, uint64_t index)
+{
+    unsigned int i = (index >> node->shift) & BLOCK_MAP_SLOT_MASK;
+    if (node->shift == 0)
+    {
+        __atomic_store_n(&node->slots[i].block, NULL, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        block_map_node_t *child = node->slots[i].child;
+        if (child && bmap_erase(child, index))
+        {
+            __atomic_store_n(&node->slots[i].child, NULL, __ATOMIC_RELEASE);
+            epoch_retire(child, slab_free);
+        }
+    }
+    return bmap_node_empty(node);
+}
+
+static void bmap_free_tree(block_map_node_t *node)
+{
+    if (node->shift > 0)
+    {
+        for (unsigned int i = 0; i < BLOCK_MAP_NODE_SLOTS; i++)
+            if (node->slots[i].child)
+                bmap_free_tree(node->slots[i].child);
+    }
+    slab_free(node);
+}
+
+data_block_t *block_map_get(block_map_t *map, uint64_t index)
+{
+    if (index >= __atomic_load_n(&map->block_count, __ATOMIC_ACQUIRE))
+        return NULL;
+    return bmap_lookup(__atomic_load_n(&map->root, __ATOMIC_ACQUIRE), index);
+}
+
+data_block_t *block_map_next(block_map_t *map, uint64_t *index)
+{
+    uint64_t count = __atomic_load_n(&map->block_count, __ATOMIC_ACQUIRE);
+    block_map_node_t *root = __atomic_load_n(&map->root, __ATOMIC_ACQUIRE);
+    if (!root || *index >= count || !bmap_covers(root, *index))
+        return NULL;
+
+    uint64_t idx = *index;
+    data_block_t *block = bmap_next(root, 0, &idx);
+    if (!block || idx >= count)
+        return NULL;
+    *index = idx;
+    return block;
+}
+
+// 树高不够时在上方加根（原根成为新根的0号子树），再自顶向下补齐缺失的节点；
+// 新节点先初始化再发布，无锁读者要么看不到它，要么看到完整的节点
+data_block_t **block_map_slot(block_map_t *map, uint64_t index, bool create)
+{
+    if (index >= BLOCK_MAP_MAX_INDEX)
+        return NULL;
+
+    block_map_node_t *node = map->root;
+    if (!node)
+    {
+        if (!create)
+            return NULL;
+        node = bmap_node_alloc(0);
+        if (!node)
+            return NULL;
+        __atomic_store_n(&map->root, node, __ATOMIC_RELEASE);
+    }
+    while (!bmap_covers(node, index))
+    {
+        if (!create)
+            return NULL;
+        block_map_node_t *top = bmap_node_alloc(node->shift + BLOCK_MAP_NODE_SHIFT);
+        if (!top)
+            return NULL;
+        top->slots[0].child = node;
+        __atomic_store_n(&map->root, top, __ATOMIC_RELEASE);
+        node = top;
+    }
+
+    while (node->shift > 0)
+    {
+        unsigned int i = (index >> node->shift) & BLOCK_MAP_SLOT_MASK;
+        block_map_node_t *child = node->slots[i].child;
+        if (!child)
+        {
+            if (!create)
+                return NULL;
+            child = bmap_node_alloc(node->shift - BLOCK_MAP_NODE_SHIFT);
+            if (!child)
+                return NULL;
+            __atomic_store_n(&node->slots[i].child, child, __ATOMIC_RELEASE);
+        }
+        node = child;
+    }
+    return &node->slots[index & BLOCK_MAP_SLOT_MASK].block;
+}
+
+// 清空一个块位置（持写锁），树变空时连根摘除
+static void block_map_clear_slot(block_map_t *map, uint64_t index)
+{
+    block_map_node_t *root = map->root;
+    if (!root || !bmap_covers(root, index))
+        return;
+    if (bmap_erase(root, index))
+    {
+        __atomic_store_n(&map->root, NULL, __ATOMIC_RELEASE);
+        epoch_retire(root, slab_free);
+    }
+}
+
+// 截断后降低树高：根只剩0号子树时由该子树接替
+static void block_map_shrink(block_map_t *map)
+{
+    block_map_node_t *root = map->root;
+    while (root && root->shift > 0)
+    {
+        for (unsigned int i = 1; i < BLOCK_MAP_NODE_SLOTS; i++)
+            if (root->slots[i].child)
+                return;
+        block_map_node_t *child = root->slots[0].child;
+        __atomic_store_n(&map->root, child, __ATOMIC_RELEASE);
+        epoch_retire(root, slab_free);
+        root = child;
+    }
+}
+
+// 创建文件块映射
+block_map_t *create_block_map(uint64_t file_ino)
+{
+    block_map_t *map = malloc(sizeof(block_map_t));
+    if (!map)
+        return NULL;
+
+    map->file_ino = file_ino;
+    map->block_count = 0;
+    map->root = NULL;
+    map->dirty = NULL;
+    map->dirty_count = 0;
+    map->dirty_capacity = 0;
+    map->dirty_since = 0;
+    map->writeback_queued = false;
+    map->seq = 0;
+    map->direct_blocks = 12; // 默认12个直接块
+    map->indirect_blocks = 0;
+    map->version_block_ids = NULL;
+    map->version_block_capacity = 0;
+    map->version_id = 0;
+    map->block_index = hash_table_create(16); // 按需扩容，小文件不预留大表
+    pthread_rwlock_init(&map->lock, NULL);
+
+    if (!map->block_index)
+    {
+        pthread_rwlock_destroy(&map->lock);
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+static void block_map_reclaim(void *ptr)
+{
+    block_map_t *map = ptr;
+    if (map->root)
+        bmap_free_tree(map->root);
+    free(map->dirty);
+    pthread_rwlock_destroy(&map->lock);
+    free(map);
+}
+
+// 销毁文件块映射：数据块立即释放引用，映射结构与基数树延迟到无锁读者离开后释放
+void destroy_block_map(block_map_t *map)
+{
+    if (!map)
+        return;
+
+    block_map_write_lock(map);
+
+    // 释放所有数据块（只访问有数据的位置）
+    uint64_t i = 0;
+    data_block_t *b;
+    while ((b = block_map_next(map, &i)) != NULL)
+    {
+        __atomic_store_n(block_map_slot(map, i, false), NULL, __ATOMIC_RELEASE);
+        if (b->dirty)
+        {
+            b->dirty = 0;
+            FS_STAT_SUB(dirty_blocks, 1);
+        }
+        dedup_release_block(b);
+        i++;
+    }
+    __atomic_store_n(&map->block_count, 0, __ATOMIC_RELEASE);
+    map->dirty_count = 0;
+
+    if (map->block_index)
+        hash_table_destroy(map->block_index);
+    map->block_index = NULL;
+    block_map_write_unlock(map);
+    epoch_retire(map, block_map_reclaim);
+}
+
+// 获取文件块映射
+block_map_t *get_block_map(uint64_t file_ino)
+{
+    block_map_t *map = shard_map_get(block_maps, file_ino);
+    if (map)
+        return map;
+
+    hash_table_t *shard = shard_map_lock(block_maps, file_ino);
+    map = hash_table_get_locked(shard, file_ino);
+    if (!map)
+    {
+        map = create_block_map(file_ino);
+        if (map && hash_table_set_locked(shard, file_ino, map) != 0)
+        {
+            destroy_block_map(map);
+            map = NULL;
+        }
+    }
+    shard_map_unlock(shard);
+    return map;
+}
+
+/* 计算两个块映射的差异块，结果写入 diff_blocks（key=块索引，value=新块指针） */
+int block_map_diff(block_map_t *old_map, block_map_t *new_map, hash_table_t *diff_blocks)
+{
+    if (!new_map || !diff_blocks)
+        return -EINVAL;
+
+    // 两个映射各自按有数据的块推进，双方都是空洞的区间直接跳过
+    uint64_t i = 0;
+    for (;; i++)
+    {
+        uint64_t oi = i, ni = i;
+        data_block_t *oldb = old_map ? block_map_next(old_map, &oi) : NULL;
+        data_block_t *newb = block_map_next(new_map, &ni);
+        if (!oldb && !newb)
+            break;
+        if (!newb || (oldb && oi < ni))
+        {
+            i = oi;
+            newb = NULL;
+        }
+        else if (!oldb || ni < oi)
+        {
+            i = ni;
+            oldb = NULL;
+        }
+        else
+        {
+            i = oi;
+        }
+
+        uint32_t oldchk = oldb ? oldb->checksum : 0;
+        uint32_t newchk = newb ? newb->checksum : 0;
+
+        if (oldb == NULL && newb == NULL)
+            continue;
+
+        if (oldchk != newchk || (oldb && newb && oldb->size != newb->size))
+        {
+            /* 使用非NULL占位，NULL表示删除，用标记指针1表示删除事件 */
+            void *val = newb ? (void *)newb : (void *)1;
+            hash_table_set(diff_blocks, i, val);
+        }
+    }
+
+    /* 对差异块执行去重/压缩处理（模块C集成） */
+    dedup_process_diff_blocks(diff_blocks, &dedup_config);
+
+    return 0;
+}
+
+// 取得inode的块映射：首次访问经全局表解析后缓存到inode，之后直接读取
+block_map_t *file_block_map(file_metadata_t *meta)
+{
+    block_map_t *map = __atomic_load_n(&meta->current_block_map, __ATOMIC_ACQUIRE);
+    if (map)
+        return map;
+
+    map = get_block_map(meta->ino);
+    if (map)
+        __atomic_store_n(&meta->current_block_map, map, __ATOMIC_RELEASE);
+    return map;
+}
+
+// 本线程封存后待写入段存储的块（各持一个引用，期间改写会先复制出私有副本，内容不变）。
+// 段存储追加可能写出批缓冲，推迟到释放最外层块映射写锁之后进行
+static _Thread_local struct {
+    data_block_t **blocks;
+    size_t count;
+    size_t cap;
+    unsigned depth;               // 本线程持有的块映射写锁数
+} tls_store_queue;
+
+static void block_store_enqueue(data_block_t *block)
+{
+    if (!segment_store_enabled())
+        return;
+    if (tls_store_queue.count == tls_store_queue.cap)
+    {
+        size_t cap = tls_store_queue.cap ? tls_store_queue.cap * 2 : 64;
+        data_block_t **blocks = realloc(tls_store_queue.blocks, cap * sizeof(data_block_t *));
+        if (!blocks)
+        {
+            // 内存不足时退回锁内直接写入
+            segment_store_put(block);
+            return;
+        }
+        tls_store_queue.blocks = blocks;
+        tls_store_queue.cap = cap;
+    }
+    dedup_core_inc_ref(block);
+    tls_store_queue.blocks[tls_store_queue.count++] = block;
+}
+
+static void block_store_drain(void)
+{
+    for (size_t i = 0; i < tls_store_queue.count; i++)
+    {
+        segment_store_put(tls_store_queue.blocks[i]);
+        dedup_release_block(tls_store_queue.blocks[i]);
+    }
+    tls_store_queue.count = 0;
+}
+
+// 写序号在持写锁期间为奇数；无锁读者读前读后各取一次序号，两次相同且为偶数时读到的内容完整
+void block_map_write_lock(block_map_t *map)
+{
+    pthread_rwlock_wrlock(&map->lock);
+    __atomic_store_n(&map->seq, map->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    tls_store_queue.depth++;
+}
+
+void block_map_write_unlock(block_map_t *map)
+{
+    __atomic_store_n(&map->seq, map->seq + 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&map->lock);
+    if (--tls_store_queue.depth == 0 && tls_store_queue.count)
+        block_store_drain();
+}
+
+// 无锁读取的尝试次数，期间一直有写者时改走加锁路径
+#define READ_LOCKLESS_ATTEMPTS 2
+
+// 无锁读取文件区间：调用方处于纪元读侧临界区，树节点与数据块在临界区内不会被释放。
+// 读完后校验写序号，期间有写者（或解压失败）则重试；不经过块缓存。
+// 成功返回读取字节数，放弃时返回 -EAGAIN
+static int read_file_range_lockless(block_map_t *map, char *buf, size_t size, off_t offset)
+{
+    size_t bs = fs_state.block_size;
+    for (int attempt = 0; attempt < READ_LOCKLESS_ATTEMPTS; attempt++)
+    {
+        uint64_t seq = __atomic_load_n(&map->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+
+        bool ok = true;
+        size_t done = 0;
+        while (done < size)
+        {
+            uint64_t block_index = ((uint64_t)offset + done) / bs;
+            size_t block_offset = ((uint64_t)offset + done) % bs;
+            size_t len = bs - block_offset;
+            if (len > size - done)
+                len = size - done;
+
+            data_block_t *block = block_map_get(map, block_index);
+            if (!block)
+            {
+                memset(buf + done, 0, len);
+            }
+            else if (read_block(block, buf + done, len, block_offset) != (int)len)
+            {
+                ok = false;
+                break;
+            }
+            done += len;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (ok && __atomic_load_n(&map->seq, __ATOMIC_RELAXED) == seq)
+            return (int)done;
+    }
+    return -EAGAIN;
+}
+
+// 按块读取文件区间；readahead 为真时预取区间后的下一个块
+// 先尝试无锁读取，仅在与写者冲突时取块映射读锁，经块缓存读取
+static int read_file_range(file_metadata_t *meta, block_map_t *map, char *buf,
+                           size_t size, off_t offset, bool readahead)
+{
+    if (offset < 0)
+        return -EINVAL;
+    if (offset >= meta->size)
+        return 0;
+
+    size_t remaining = meta->size - offset;
+    if (size > remaining)
+        size = remaining;
+
+    if (epoch_enter())
+    {
+        int fast = read_file_range_lockless(map, buf, size, offset);
+        epoch_exit();
+        if (fast >= 0)
+        {
+            clock_gettime(CLOCK_REALTIME, &meta->atime);
+            return fast;
+        }
+    }
+
+    pthread_rwlock_rdlock(&map->lock);
+    // 缓存返回的副本只在纪元临界区内有效；无法登记时不经缓存读取
+    bool in_epoch = epoch_enter();
+
+    size_t bytes_read = 0;
+    size_t current_offset = offset;
+    size_t remaining_bytes = size;
+
+    while (remaining_bytes > 0)
+    {
+        uint64_t block_index = current_offset / fs_state.block_size;
+        size_t block_offset = current_offset % fs_state.block_size;
+        size_t bytes_to_read = fs_state.block_size - block_offset;
+
+        if (bytes_to_read > remaining_bytes)
+        {
+            bytes_to_read = remaining_bytes;
+        }
+
+        if (block_index >= map->block_count)
+        {
+            // 读取空数据（稀疏文件支持）
+            memset(buf + bytes_read, 0, bytes_to_read);
+            bytes_read += bytes_to_read;
+        }
+        else
+        {
+            data_block_t *block = block_map_get(map, block_index);
+            data_block_t *cached = NULL;
+            if (block && in_epoch)
+                cached = cache_get_block(block->block_id);
+            if (cached)
+                block = cached;
+            if (block)
+            {
+                int result = read_block(block, buf + bytes_read, bytes_to_read, block_offset);
+                if (result < 0)
+                {
+                    if (in_epoch)
+                        epoch_exit();
+                    pthread_rwlock_unlock(&map->lock);
+                    return result;
+                }
+                bytes_read += result;
+                // 命中时 cache_get_block 已完成提升；写回缓冲中的脏块不进缓存
+                if (!cached && !block->dirty)
+                    cache_put_block(block);
+
+                /* 预取区间后的下一个块以提升顺序读性能（区间内的块本次即会读取） */
+                data_block_t *next = in_epoch && readahead && remaining_bytes == bytes_to_read
+                                         ? block_map_get(map, block_index + 1)
+                                         : NULL;
+                if (next)
+                {
+                    uint64_t next_id = next->block_id;
+                    cache_prefetch(&next_id, 1);
+                }
+            }
+            else
+            {
+                // 空块，填充零
+                memset(buf + bytes_read, 0, bytes_to_read);
+                bytes_read += bytes_to_read;
+            }
+        }
+
+        current_offset += bytes_to_read;
+        remaining_bytes -= bytes_to_read;
+
+    }
+
+    if (in_epoch)
+        epoch_exit();
+    pthread_rwlock_unlock(&map->lock);
+
+    // 更新访问时间
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+
+    return bytes_read;
+}
+
+// 高性能文件读取（支持大文件）
+int smart_read_file(file_metadata_t *meta, char *buf, size_t size, off_t offset)
+{
+    if (!meta || !buf || !S_ISREG(meta->mode))
+    {
+        return -EINVAL;
+    }
+
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
+
+    return read_file_range(meta, map, buf, size, offset, true);
+}
+
+// 以下块映射辅助函数均要求调用方已用 block_map_write_lock 取得写锁
+
+// 块数至少扩大到 count：树上没有节点的位置即为空洞，不需要预先分配
+static void block_map_extend(block_map_t *map, uint64_t count)
+{
+    if (count > map->block_count)
+        __atomic_store_n(&map->block_count, count, __ATOMIC_RELEASE);
+}
+
+// 写回缓冲上限：单个文件的脏块数、全局脏块数（4KB块时约64MB），脏数据最长停留秒数
+#define WRITEBACK_MAP_LIMIT 256
+#define WRITEBACK_GLOBAL_LIMIT 16384
+#define WRITEBACK_MAX_AGE 5
+// 后台写回线程检查有脏块文件的间隔（秒）
+#define WRITEBACK_INTERVAL 1
+
+static void writeback_enqueue(block_map_t *map);
+
+// 登记脏块：块内容已改但暂不做校验和/去重/压缩，等封存时一次完成。
+// 登记失败（内存不足）时块保持非脏，由调用方写完后立即封存
+static void block_map_mark_dirty(block_map_t *map, uint64_t block_index, data_block_t *block)
+{
+    if (map->dirty_count == map->dirty_capacity)
+    {
+        size_t cap = map->dirty_capacity ? map->dirty_capacity * 2 : 16;
+        uint64_t *dirty = realloc(map->dirty, cap * sizeof(uint64_t));
+        if (!dirty)
+            return;
+        map->dirty = dirty;
+        map->dirty_capacity = cap;
+    }
+    if (map->dirty_count == 0)
+        map->dirty_since = time(NULL);
+    map->dirty[map->dirty_count++] = block_index;
+    block->dirty = 1;
+    FS_STAT_ADD(dirty_blocks, 1);
+    if (!map->writeback_queued)
+        writeback_enqueue(map);
+}
+
+static bool block_is_shared(data_block_t *block)
+{
+    pthread_mutex_lock(&block->ref_lock);
+    bool shared = block->ref_count > 1;
+    pthread_mutex_unlock(&block->ref_lock);
+    return shared;
+}
+
+// 取得可写入的块：按需建立树上的路径、为空洞分配新块；块被共享（去重命中或克隆）时先换成私有副本。
+// full 为真表示本次写入覆盖整个块：旧块被共享或已压缩时不读旧内容，直接换成新块并放掉旧块的引用。
+// 返回的块已登记为脏块；已在写回缓冲中的块是私有的且不在缓存中，直接返回
+static data_block_t *block_map_writable(file_metadata_t *meta, block_map_t *map, uint64_t block_index,
+                                        bool full, int *err)
+{
+    data_block_t **slot = block_map_slot(map, block_index, true);
+    if (!slot)
+    {
+        *err = block_index >= BLOCK_MAP_MAX_INDEX ? -EFBIG : -ENOMEM;
+        return NULL;
+    }
+
+    // 分配数据块（如果需要）
+    data_block_t *block = *slot;
+    if (block && block->dirty)
+        return block;
+    if (!block)
+    {
+        block = allocate_block(fs_state.block_size);
+        if (!block)
+        {
+            *err = -ENOMEM;
+            return NULL;
+        }
+        block->file_ino = meta->ino;
+        block->offset = block_index * fs_state.block_size;
+        __atomic_store_n(slot, block, __ATOMIC_RELEASE);
+        block_map_extend(map, block_index + 1);
+        if (map->block_index)
+            hash_table_set(map->block_index, block->block_id, block);
+        block_map_mark_dirty(map, block_index, block);
+        return block;
+    }
+
+    uint64_t old_id = block->block_id;
+    cache_invalidate_block(old_id);
+    if (full && (block->compressed_size > 0 || block_is_shared(block)))
+    {
+        data_block_t *fresh = allocate_block(fs_state.block_size);
+        if (!fresh)
+        {
+            *err = -ENOMEM;
+            return NULL;
+        }
+        __atomic_store_n(slot, fresh, __ATOMIC_RELEASE);
+        dedup_release_block(block);
+    }
+    else
+    {
+        int cow = dedup_cow_block(slot);
+        if (cow < 0)
+        {
+            *err = cow;
+            return NULL;
+        }
+        // 原块就地改写：内容即将改变，先从去重索引摘除，避免其他文件按旧哈希共享到它
+        if (*slot == block)
+            dedup_remove_block(block);
+    }
+    if (*slot != block)
+    {
+        block = *slot;
+        block->file_ino = meta->ino;
+        block->offset = block_index * fs_state.block_size;
+        if (map->block_index)
+        {
+            hash_table_remove(map->block_index, old_id);
+            hash_table_set(map->block_index, block->block_id, block);
+        }
+    }
+    block_map_mark_dirty(map, block_index, block);
+    return block;
+}
+
+// 块数据写完后的去重/压缩处理（可能替换块指针），放回缓存，解锁后写入段存储
+static void block_map_written(block_map_t *map, uint64_t block_index)
+{
+    data_block_t **slot = block_map_slot(map, block_index, false);
+    if (!slot)
+        return;
+    dedup_process_block_on_write(slot, &dedup_config);
+    data_block_t *block = *slot;
+    if (!block)
+        return;
+    if (map->block_index)
+        hash_table_set(map->block_index, block->block_id, block);
+    block_store_enqueue(block);
+    cache_put_block(block);
+}
+
+// 封存一个块：补算校验和，去重/压缩后放回缓存
+static void block_map_seal(block_map_t *map, uint64_t block_index)
+{
+    data_block_t *block = block_map_get(map, block_index);
+    if (!block)
+        return;
+    if (block->dirty)
+    {
+        block->dirty = 0;
+        FS_STAT_SUB(dirty_blocks, 1);
+    }
+    // 封存前块可能已被其他模块压缩（adaptive_compress 等），先换回原始数据；解压失败时保持原样
+    if (block_make_plain(block) != 0)
+        return;
+    block_update_checksum(block);
+    block_map_written(map, block_index);
+}
+
+// 写完一段数据后：写到块末尾（或未能登记为脏块）的块立即封存，其余留在写回缓冲
+static void block_map_filled(block_map_t *map, uint64_t block_index, data_block_t *block, bool full)
+{
+    if (full || !block->dirty)
+        block_map_seal(map, block_index);
+}
+
+// 封存全部脏块；列表中已封存或已释放的旧项直接跳过
+static void block_map_writeback(block_map_t *map)
+{
+    for (size_t i = 0; i < map->dirty_count; i++)
+    {
+        data_block_t *block = block_map_get(map, map->dirty[i]);
+        if (block && block->dirty)
+            block_map_seal(map, map->dirty[i]);
+    }
+    map->dirty_count = 0;
+}
+
+// 写入结束时检查写回缓冲：本文件脏块过多或脏数据停留过久时，由写者自己同步封存本文件的脏块
+// （超限的写者因此被放慢）；全局超限由 writeback_throttle 在解锁后处理
+static void block_map_writeback_check(block_map_t *map)
+{
+    if (map->dirty_count == 0)
+        return;
+    if (map->dirty_count >= WRITEBACK_MAP_LIMIT || time(NULL) - map->dirty_since >= WRITEBACK_MAX_AGE)
+        block_map_writeback(map);
+}
+
+// 后台写回：有脏块的文件登记在待查队列中，线程定期封存停留过久的脏块；
+// 全局脏块超限时写者唤醒线程封存所有文件的脏块，并等这一轮结束
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;          // 唤醒后台线程
+    pthread_cond_t done;          // 一轮检查结束
+    pthread_t thread;
+    bool running;
+    bool force;                   // 下一轮不看停留时间，全部封存
+    bool forcing;                 // 正在进行全部封存的一轮
+    uint64_t forced;              // 已完成的全部封存轮数
+    uint64_t *inos;               // 待查队列：有脏块的文件
+    size_t count;
+    size_t cap;
+} writeback = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static bool writeback_enqueue_ino(uint64_t ino)
+{
+    pthread_mutex_lock(&writeback.lock);
+    if (writeback.count == writeback.cap)
+    {
+        size_t cap = writeback.cap ? writeback.cap * 2 : 64;
+        uint64_t *inos = realloc(writeback.inos, cap * sizeof(uint64_t));
+        if (!inos)
+        {
+            pthread_mutex_unlock(&writeback.lock);
+            return false;
+        }
+        writeback.inos = inos;
+        writeback.cap = cap;
+    }
+    writeback.inos[writeback.count++] = ino;
+    pthread_mutex_unlock(&writeback.lock);
+    return true;
 }
 
-// 根据inode编号查找
-file_metadata_t *lookup_inode(uint64_t ino)
+// 持块映射写锁调用；登记失败（内存不足）时下次登记脏块再试
+static void writeback_enqueue(block_map_t *map)
 {
-    return (file_metadata_t *)cache_get(ino);
+    map->writeback_queued = writeback_enqueue_ino(map->file_ino);
 }
 
-// 添加目录项
-int add_directory_entry(directory_t *dir, const char *name, file_metadata_t *meta)
+// 检查一轮待查队列：停留过久（force 时不论时间）的文件封存全部脏块，其余重新登记
+static void writeback_pass(bool force)
 {
-    if (!dir || !name || !meta)
+    pthread_mutex_lock(&writeback.lock);
+    uint64_t *inos = writeback.inos;
+    size_t count = writeback.count;
+    writeback.inos = NULL;
+    writeback.count = writeback.cap = 0;
+    pthread_mutex_unlock(&writeback.lock);
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++)
     {
-        return -EINVAL;
+        // 映射可能正被删除：纪元临界区内其内存不会回收，已销毁的映射没有脏块
+        bool in_epoch = epoch_enter();
+        block_map_t *map = in_epoch ? shard_map_get(block_maps, inos[i]) : NULL;
+        if (map)
+        {
+            block_map_write_lock(map);
+            map->writeback_queued = false;
+            if (map->dirty_count && (force || now - map->dirty_since >= WRITEBACK_MAX_AGE))
+                block_map_writeback(map);
+            if (map->dirty_count)
+                writeback_enqueue(map);
+            block_map_write_unlock(map);
+        }
+        if (in_epoch)
+            epoch_exit();
+        else
+            writeback_enqueue_ino(inos[i]);   // 无法登记本线程时留到下一轮
     }
+    free(inos);
+}
 
-    // 检查是否已存在
-    if (find_directory_entry(dir, name))
+static void *writeback_thread_fn(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&writeback.lock);
+    while (writeback.running)
     {
-        return -EEXIST;
+        if (!writeback.force)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += WRITEBACK_INTERVAL;
+            pthread_cond_timedwait(&writeback.wake, &writeback.lock, &ts);
+            if (!writeback.running)
+                break;
+        }
+        bool force = writeback.force;
+        writeback.force = false;
+        writeback.forcing = force;
+        pthread_mutex_unlock(&writeback.lock);
+        writeback_pass(force);
+        pthread_mutex_lock(&writeback.lock);
+        if (force)
+        {
+            writeback.forcing = false;
+            writeback.forced++;
+            pthread_cond_broadcast(&writeback.done);
+        }
     }
+    // 唤醒仍在等待的写者
+    pthread_cond_broadcast(&writeback.done);
+    pthread_mutex_unlock(&writeback.lock);
+    return NULL;
+}
 
-    pthread_rwlock_wrlock(&dir->lock);
+static void writeback_start(void)
+{
+    pthread_mutex_lock(&writeback.lock);
+    writeback.running = pthread_create(&writeback.thread, NULL, writeback_thread_fn, NULL) == 0;
+    pthread_mutex_unlock(&writeback.lock);
+    if (!writeback.running)
+        SBFS_LOG_WARN("后台写回线程启动失败，脏块只在写入时按上限封存");
+}
 
-    dir_entry_t *entry = malloc(sizeof(dir_entry_t));
-    if (!entry)
+static void writeback_stop(void)
+{
+    pthread_mutex_lock(&writeback.lock);
+    bool running = writeback.running;
+    writeback.running = false;
+    pthread_cond_signal(&writeback.wake);
+    pthread_mutex_unlock(&writeback.lock);
+    if (running)
+        pthread_join(writeback.thread, NULL);
+    free(writeback.inos);
+    writeback.inos = NULL;
+    writeback.count = writeback.cap = 0;
+    writeback.force = writeback.forcing = false;
+}
+
+// 写者释放块映射锁后调用：全局脏块超限时请后台线程封存所有文件的脏块，等一轮结束后返回；
+// 线程未运行时由写者自己完成这一轮
+static void writeback_throttle(void)
+{
+    if (__atomic_load_n(&fs_state.dirty_blocks, __ATOMIC_RELAXED) < WRITEBACK_GLOBAL_LIMIT)
+        return;
+    pthread_mutex_lock(&writeback.lock);
+    if (!writeback.running)
     {
-        pthread_rwlock_unlock(&dir->lock);
-        return -ENOMEM;
+        pthread_mutex_unlock(&writeback.lock);
+        writeback_pass(true);
+        return;
     }
+    // 已在进行的一轮可能错过本写者刚登记的脏块，要等下一轮
+    uint64_t target = writeback.forced + (writeback.forcing ? 2 : 1);
+    writeback.force = true;
+    pthread_cond_signal(&writeback.wake);
+    while (writeback.running && writeback.forced < target)
+        pthread_cond_wait(&writeback.done, &writeback.lock);
+    pthread_mutex_unlock(&writeback.lock);
+}
 
-    entry->name = strdup(name);
-    entry->meta = meta;
-    entry->next = dir->entries;
-    dir->entries = entry;
-    dir->entry_count++;
-
-    // 更新目录大小
-    dir->meta.size += strlen(name) + sizeof(dir_entry_t);
-    dir->meta.blocks = (dir->meta.size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+// 释放一个块位置上的数据块，该位置变为空洞
+static void block_map_drop(block_map_t *map, uint64_t block_index)
+{
+    data_block_t *block = block_map_get(map, block_index);
+    if (!block)
+        return;
+    if (block->dirty)
+    {
+        block->dirty = 0;
+        FS_STAT_SUB(dirty_blocks, 1);
+    }
 
-    // 更新修改时间
-    clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
-    dir->meta.ctime = dir->meta.mtime;
+    block_map_clear_slot(map, block_index);
+    cache_invalidate_block(block->block_id);
+    if (map->block_index)
+        hash_table_remove(map->block_index, block->block_id);
+    dedup_release_block(block);
+}
 
-    pthread_rwlock_unlock(&dir->lock);
+static int zero_fill(void *ctx, char *dst, size_t len)
+{
+    (void)ctx;
+    memset(dst, 0, len);
     return 0;
 }
 
-// 移除目录项
-int remove_directory_entry(directory_t *dir, const char *name)
+// 把 [offset, end) 清零：整块覆盖的块直接释放为空洞，首尾不足一块的部分写零
+static int block_map_zero_range(file_metadata_t *meta, block_map_t *map, off_t offset, off_t end)
 {
-    if (!dir || !name)
+    size_t bs = fs_state.block_size;
+    while (offset < end)
     {
-        return -EINVAL;
+        uint64_t block_index = (uint64_t)offset / bs;
+        size_t block_offset = (uint64_t)offset % bs;
+        size_t len = bs - block_offset;
+        if ((off_t)len > end - offset)
+            len = (size_t)(end - offset);
+
+        if (block_index >= map->block_count)
+            break;
+        if (len == bs)
+        {
+            block_map_drop(map, block_index);
+        }
+        else if (block_map_get(map, block_index))
+        {
+            int err = 0;
+            data_block_t *block = block_map_writable(meta, map, block_index, false, &err);
+            if (!block)
+                return err;
+            int r = write_block_fill(block, len, block_offset, zero_fill, NULL);
+            if (r < 0)
+                return r;
+            block_map_filled(map, block_index, block, block_offset + len == bs);
+        }
+        offset += len;
     }
+    return 0;
+}
 
-    pthread_rwlock_wrlock(&dir->lock);
+// 按块写入文件区间，数据由 fill 依次提供
+static int write_file_range(file_metadata_t *meta, block_map_t *map, size_t size, off_t offset,
+                            block_fill_fn fill, void *ctx)
+{
+    if (offset < 0)
+        return -EINVAL;
 
-    dir_entry_t **prev = &dir->entries;
-    dir_entry_t *entry = dir->entries;
+    int err = 0;
+    block_map_write_lock(map);
 
-    while (entry)
+    // 检查是否需要扩展文件
+    off_t new_size = offset + size;
+    if (new_size > meta->size)
     {
-        if (strcmp(entry->name, name) == 0)
-        {
-            *prev = entry->next;
-            dir->entry_count--;
+        meta->size = new_size;
+    }
+
+    size_t bytes_written = 0;
+    size_t current_offset = offset;
+    size_t remaining_bytes = size;
 
-            // 更新目录大小
-            dir->meta.size -= strlen(name) + sizeof(dir_entry_t);
-            dir->meta.blocks = (dir->meta.size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+    while (remaining_bytes > 0)
+    {
+        uint64_t block_index = current_offset / fs_state.block_size;
+        size_t block_offset = current_offset % fs_state.block_size;
+        size_t bytes_to_write = fs_state.block_size - block_offset;
 
-            // 更新修改时间
-            clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
-            dir->meta.ctime = dir->meta.mtime;
+        if (bytes_to_write > remaining_bytes)
+        {
+            bytes_to_write = remaining_bytes;
+        }
 
-            free(entry->name);
-            free(entry);
+        data_block_t *block = block_map_writable(meta, map, block_index,
+                                                 bytes_to_write == fs_state.block_size, &err);
+        if (!block)
+        {
+            block_map_write_unlock(map);
+            return err;
+        }
 
-            pthread_rwlock_unlock(&dir->lock);
-            return 0;
+        // 写入数据块
+        int result = write_block_fill(block, bytes_to_write, block_offset, fill, ctx);
+        if (result < 0)
+        {
+            block_map_write_unlock(map);
+            return result;
         }
+        block_map_filled(map, block_index, block, block_offset + result == fs_state.block_size);
 
-        prev = &entry->next;
-        entry = entry->next;
+        bytes_written += result;
+        current_offset += result;
+        remaining_bytes -= result;
     }
 
-    pthread_rwlock_unlock(&dir->lock);
-    return -ENOENT;
+    // 更新文件块数
+    meta->blocks = (meta->size + fs_state.block_size - 1) / fs_state.block_size;
+
+    block_map_writeback_check(map);
+    block_map_write_unlock(map);
+    writeback_throttle();
+
+    // 更新修改时间
+    clock_gettime(CLOCK_REALTIME, &meta->mtime);
+
+    return bytes_written;
 }
 
-// 查找目录项
-dir_entry_t *find_directory_entry(directory_t *dir, const char *name)
+// 高性能文件写入（支持大文件）
+int smart_write_file(file_metadata_t *meta, const char *buf, size_t size, off_t offset)
 {
-    if (!dir || !name)
+    if (!meta || !buf || !S_ISREG(meta->mode))
     {
-        return NULL;
+        return -EINVAL;
     }
 
-    dir_entry_t *entry = dir->entries;
-    while (entry)
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
+
+    return write_file_range(meta, map, size, offset, memory_fill, &buf);
+}
+
+// 克隆时按字节拷贝的分段大小
+#define CLONE_COPY_CHUNK (1024 * 1024)
+
+// 按字节拷贝区间（首尾不足一块或两端块内偏移不同的部分）
+static ssize_t clone_copy_bytes(file_metadata_t *src, block_map_t *smap, off_t src_off,
+                                file_metadata_t *dst, block_map_t *dmap, off_t dst_off, size_t len)
+{
+    if (len == 0)
+        return 0;
+
+    size_t chunk = len < CLONE_COPY_CHUNK ? len : CLONE_COPY_CHUNK;
+    char *buf = malloc(chunk);
+    if (!buf)
+        return -ENOMEM;
+
+    size_t done = 0;
+    while (done < len)
     {
-        if (strcmp(entry->name, name) == 0)
+        size_t n = len - done < chunk ? len - done : chunk;
+        int r = read_file_range(src, smap, buf, n, src_off + done, false);
+        if (r <= 0)
         {
-            return entry;
+            free(buf);
+            return r < 0 ? r : (ssize_t)done;
         }
-        entry = entry->next;
+        const char *p = buf;
+        int w = write_file_range(dst, dmap, (size_t)r, dst_off + done, memory_fill, &p);
+        if (w < 0)
+        {
+            free(buf);
+            return w;
+        }
+        done += (size_t)w;
     }
-
-    return NULL;
+    free(buf);
+    return (ssize_t)done;
 }
 
-// 分配数据块
-data_block_t *allocate_block(size_t size)
+// 共享整块：源块引用计数加一后直接挂入目标块映射，目标原有块释放引用。
+// 两端偏移均按块对齐；末尾不足一块时，仅当区间到达源文件末尾且目标在其后没有数据才整块共享。
+// 返回共享的字节数（其余部分由调用方按字节拷贝）
+static ssize_t clone_share_blocks(file_metadata_t *src, block_map_t *smap, off_t src_off,
+                                  file_metadata_t *dst, block_map_t *dmap, off_t dst_off, size_t len)
 {
-    data_block_t *block = malloc(sizeof(data_block_t));
-    if (!block)
+    size_t bs = fs_state.block_size;
+
+    // 两个映射按地址顺序加锁，避免相向克隆死锁
+    if (smap == dmap)
     {
-        return NULL;
+        block_map_write_lock(dmap);
+    }
+    else if (smap < dmap)
+    {
+        block_map_write_lock(smap);
+        block_map_write_lock(dmap);
+    }
+    else
+    {
+        block_map_write_lock(dmap);
+        block_map_write_lock(smap);
     }
 
-    block->data = malloc(size);
-    if (!block->data)
+    size_t nblocks = len / bs;
+    size_t shared = nblocks * bs;
+    if (len % bs && src_off + (off_t)len >= src->size && dst_off + (off_t)len >= dst->size)
     {
-        free(block);
-        return NULL;
+        nblocks++;
+        shared = len;
     }
 
-    block->block_id = fs_state.total_blocks++;
-    block->file_ino = 0;
-    block->offset = 0;
-    block->size = size;
-    block->compressed_size = 0;
-    block->compression = COMPRESSION_NONE;
-    memset(block->hash, 0, sizeof(block->hash));
-    block->ref_count = 1;
-    pthread_mutex_init(&block->ref_lock, NULL);
-    block->checksum = 0;
-    block->next = NULL;
+    uint64_t sidx = (uint64_t)src_off / bs;
+    uint64_t didx = (uint64_t)dst_off / bs;
+    ssize_t ret = (ssize_t)shared;
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        // 写回缓冲中的块先封存再共享（脏块须为私有）
+        data_block_t *sb = block_map_get(smap, sidx + i);
+        if (sb && sb->dirty)
+        {
+            block_map_seal(smap, sidx + i);
+            sb = block_map_get(smap, sidx + i);
+        }
+        if (sb == block_map_get(dmap, didx + i))
+            continue;
 
-    fs_state.used_blocks++;
+        // 源端空洞在目标端同样表现为空洞
+        block_map_drop(dmap, didx + i);
+        if (sb)
+        {
+            data_block_t **slot = block_map_slot(dmap, didx + i, true);
+            if (!slot)
+            {
+                ret = -ENOMEM;
+                break;
+            }
+            dedup_core_inc_ref(sb);
+            __atomic_store_n(slot, sb, __ATOMIC_RELEASE);
+            if (dmap->block_index)
+                hash_table_set(dmap->block_index, sb->block_id, sb);
+        }
+    }
+    if (ret > 0)
+        block_map_extend(dmap, didx + nblocks);
 
-    return block;
+    if (ret > 0 && dst_off + ret > dst->size)
+        dst->size = dst_off + ret;
+    dst->blocks = (dst->size + bs - 1) / bs;
+
+    if (smap != dmap)
+        block_map_write_unlock(smap);
+    block_map_write_unlock(dmap);
+    return ret;
 }
 
-// 释放数据块
-void free_block(data_block_t *block)
+// 克隆文件区间：块对齐的部分共享源文件的数据块（仅修改块映射与引用计数），
+// 之后任一方写入该块时由写路径先做写时复制；其余部分按字节拷贝。
+// 返回拷贝的字节数，区间起点越过源文件末尾时返回0；非普通文件返回 -EOPNOTSUPP（内核回退为普通拷贝）
+ssize_t file_clone_range(file_metadata_t *src, off_t src_off, file_metadata_t *dst, off_t dst_off,
+                         size_t len)
 {
-    if (!block)
-        return;
+    if (!src || !dst || src_off < 0 || dst_off < 0)
+        return -EINVAL;
+    if (src->type != FT_REGULAR || dst->type != FT_REGULAR)
+        return S_ISDIR(src->mode) || S_ISDIR(dst->mode) ? -EISDIR : -EOPNOTSUPP;
+    if (src_off >= src->size)
+        return 0;
+    if (len > (size_t)(src->size - src_off))
+        len = (size_t)(src->size - src_off);
+    if (src == dst && src_off < dst_off + (off_t)len && dst_off < src_off + (off_t)len)
+        return -EINVAL;
 
-    cache_invalidate_block(block->block_id);
-    dedup_remove_block(block);
+    block_map_t *smap = file_block_map(src);
+    block_map_t *dmap = file_block_map(dst);
+    if (!smap || !dmap)
+        return -ENOMEM;
 
-    if (block->data)
+    // 两端块内偏移不同则无法共享，整段按字节拷贝
+    size_t bs = fs_state.block_size;
+    size_t head = len;
+    if ((uint64_t)src_off % bs == (uint64_t)dst_off % bs)
     {
-        free(block->data);
+        head = (bs - (uint64_t)src_off % bs) % bs;
+        if (head > len)
+            head = len;
     }
 
-    pthread_mutex_destroy(&block->ref_lock);
-
-    fs_state.used_blocks--;
-    free(block);
-}
+    ssize_t done = clone_copy_bytes(src, smap, src_off, dst, dmap, dst_off, head);
+    if (done < 0 || (size_t)done < head)
+        return done;
 
-// 读取数据块
-int read_block(data_block_t *block, char *buf, size_t size, off_t offset)
-{
-    if (!block || !buf)
+    if ((size_t)done < len)
     {
-        return -EINVAL;
+        ssize_t shared = clone_share_blocks(src, smap, src_off + done, dst, dmap, dst_off + done,
+                                            len - (size_t)done);
+        if (shared < 0)
+            return done > 0 ? done : shared;
+        done += shared;
     }
 
-    if (offset < 0 || (size_t)offset >= block->size)
+    if ((size_t)done < len)
     {
-        return 0; // EOF
+        ssize_t tail = clone_copy_bytes(src, smap, src_off + done, dst, dmap, dst_off + done,
+                                        len - (size_t)done);
+        if (tail < 0)
+            return done > 0 ? done : tail;
+        done += tail;
     }
 
-    size_t to_read = size;
-    if (offset + to_read > block->size)
-    {
-        to_read = block->size - offset;
-    }
+    clock_gettime(CLOCK_REALTIME, &dst->mtime);
+    dst->ctime = dst->mtime;
+    return done;
+}
 
-    char *plain = NULL;
-    size_t plain_size = 0;
-    const char *src = block->data;
-    if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
-    {
-        if (block_decompress(block, &plain, &plain_size) != 0)
-            return -EIO;
-        src = plain;
-    }
+// 封存文件写回缓冲中的全部脏块
+int file_writeback(file_metadata_t *meta)
+{
+    if (!meta)
+        return -EINVAL;
+    if (meta->type != FT_REGULAR)
+        return 0;
 
-    memcpy(buf, src + offset, to_read);
-    if (plain)
-        free(plain);
-    return to_read;
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
+
+    block_map_write_lock(map);
+    block_map_writeback(map);
+    block_map_write_unlock(map);
+    return 0;
 }
 
-// 写入数据块
-int write_block(data_block_t *block, const char *buf, size_t size, off_t offset)
+// 封存脏块后写检查点：块数据、块映射与目录树一起落盘，崩溃后 fsync 过的文件按 fsync 时的内容与大小恢复
+int file_sync(file_metadata_t *meta)
 {
-    if (!block || !buf)
-    {
+    int ret = file_writeback(meta);
+    return ret == 0 ? fs_checkpoint_sync() : ret;
+}
+
+// 截断文件：新旧大小中较小者之后的数据全部清除，缩小时释放末尾的数据块，
+// 扩大时新增部分为空洞，读出零
+int file_truncate(file_metadata_t *meta, off_t size)
+{
+    if (!meta || size < 0)
+        return -EINVAL;
+    if (S_ISDIR(meta->mode))
+        return -EISDIR;
+    if (meta->type != FT_REGULAR)
         return -EINVAL;
-    }
 
-    if (offset < 0 || (size_t)offset >= block->size)
-    {
-        return -ENOSPC;
-    }
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
 
-    size_t to_write = size;
-    if (offset + to_write > block->size)
-    {
-        to_write = block->size - offset;
-    }
+    size_t bs = fs_state.block_size;
+    block_map_write_lock(map);
 
-    if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
+    off_t keep = size < meta->size ? size : meta->size;
+    uint64_t keep_blocks = ((uint64_t)keep + bs - 1) / bs;
+    int ret = block_map_zero_range(meta, map, keep, (off_t)(keep_blocks * bs));
+    if (ret == 0)
     {
-        char *plain = NULL;
-        size_t plain_size = 0;
-        if (block_decompress(block, &plain, &plain_size) != 0)
-            return -EIO;
-        free(block->data);
-        block->data = plain;
-        block->size = plain_size;
-        block->compressed_size = 0;
-        block->compression = COMPRESSION_NONE;
+        uint64_t i = keep_blocks;
+        while (block_map_next(map, &i))
+            block_map_drop(map, i++);
+        if (map->block_count > keep_blocks)
+            __atomic_store_n(&map->block_count, keep_blocks, __ATOMIC_RELEASE);
+        block_map_shrink(map);
+
+        meta->size = size;
+        meta->blocks = (size + bs - 1) / bs;
     }
 
-    memcpy(block->data + offset, buf, to_write);
+    block_map_write_unlock(map);
 
-    // 更新校验和与简易哈希（供模块C占位）
-    uint32_t sum = 0;
-    for (size_t i = 0; i < block->size; i++)
-    {
-        sum += (uint8_t)block->data[i];
-    }
-    block->checksum = sum;
-    for (size_t i = 0; i < sizeof(block->hash); i++)
+    if (ret == 0)
     {
-        block->hash[i] = (uint8_t)((sum >> ((i % 4) * 8)) ^ (i * 31));
+        clock_gettime(CLOCK_REALTIME, &meta->mtime);
+        meta->ctime = meta->mtime;
     }
-
-    return to_write;
+    return ret;
 }
 
-// 创建文件块映射
-block_map_t *create_block_map(uint64_t file_ino)
+// 预分配/打洞：PUNCH_HOLE（须同时带 KEEP_SIZE）释放区间内的整块，首尾写零；
+// 模式为0时仅按需扩大文件（块存储本身稀疏，不做实际预分配）
+int file_fallocate(file_metadata_t *meta, int mode, off_t offset, off_t length)
 {
-    block_map_t *map = malloc(sizeof(block_map_t));
-    if (!map)
-        return NULL;
+    if (!meta || offset < 0 || length <= 0)
+        return -EINVAL;
+    if (S_ISDIR(meta->mode))
+        return -EISDIR;
+    if (meta->type != FT_REGULAR)
+        return -ENODEV;
 
-    map->file_ino = file_ino;
-    map->block_count = 0;
-    map->blocks = NULL;
-    map->direct_blocks = 12; // 默认12个直接块
-    map->indirect_blocks = 0;
-    map->version_block_ids = NULL;
-    map->version_block_capacity = 0;
-    map->version_id = 0;
-    map->block_index = hash_table_create(1024);
-    pthread_rwlock_init(&map->lock, NULL);
+    if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
+        return -EOPNOTSUPP;
 
-    if (!map->block_index)
+    if (!(mode & FALLOC_FL_PUNCH_HOLE))
     {
-        pthread_rwlock_destroy(&map->lock);
-        free(map);
-        return NULL;
+        if (!(mode & FALLOC_FL_KEEP_SIZE) && offset + length > meta->size)
+            return file_truncate(meta, offset + length);
+        return 0;
     }
+    if (!(mode & FALLOC_FL_KEEP_SIZE))
+        return -EOPNOTSUPP;
 
-    return map;
+    block_map_t *map = file_block_map(meta);
+    if (!map)
+        return -ENOMEM;
+
+    block_map_write_lock(map);
+    off_t end = offset + length > meta->size ? meta->size : offset + length;
+    int ret = block_map_zero_range(meta, map, offset, end);
+    block_map_write_unlock(map);
+
+    if (ret == 0)
+    {
+        clock_gettime(CLOCK_REALTIME, &meta->mtime);
+        meta->ctime = meta->mtime;
+    }
+    return ret;
 }
 
-// 销毁文件块映射
-void destroy_block_map(block_map_t *map)
+// SEEK_DATA/SEEK_HOLE：按块映射判断，块内有数据的整块视为数据，文件末尾视为空洞
+off_t file_seek_data(file_metadata_t *meta, off_t offset, int whence)
 {
+    if (!meta || offset < 0)
+        return -EINVAL;
+    if (whence != SEEK_DATA && whence != SEEK_HOLE)
+        return -EINVAL;
+    if (S_ISDIR(meta->mode))
+        return -EISDIR;
+    if (offset >= meta->size)
+        return -ENXIO;
+    if (meta->type != FT_REGULAR)
+        return whence == SEEK_DATA ? offset : meta->size;
+
+    block_map_t *map = file_block_map(meta);
     if (!map)
-        return;
+        return -ENOMEM;
 
-    pthread_rwlock_wrlock(&map->lock);
+    size_t bs = fs_state.block_size;
+    bool want_data = whence == SEEK_DATA;
+    pthread_rwlock_rdlock(&map->lock);
 
-    // 释放所有数据块
-    for (uint64_t i = 0; i < map->block_count; i++)
+    uint64_t idx = (uint64_t)offset / bs;
+    if (want_data)
     {
-        if (map->blocks[i])
-        {
-            data_block_t *b = map->blocks[i];
-            dedup_release_block(b);
-        }
+        if (!block_map_next(map, &idx))
+            idx = map->block_count;
+    }
+    else
+    {
+        while (idx < map->block_count && block_map_get(map, idx))
+            idx++;
     }
 
-    free(map->blocks);
-    if (map->block_index)
-        hash_table_destroy(map->block_index);
+    off_t pos;
+    if (idx < map->block_count || !want_data)
+    {
+        pos = (off_t)(idx * bs);
+        if (pos < offset)
+            pos = offset;
+        if (pos > meta->size)
+            pos = meta->size;
+    }
+    else
+    {
+        pos = meta->size;
+    }
     pthread_rwlock_unlock(&map->lock);
-    pthread_rwlock_destroy(&map->lock);
-    free(map);
+
+    if (want_data && pos >= meta->size)
+        return -ENXIO;
+    return pos;
 }
 
-// 获取文件块映射
-block_map_t *get_block_map(uint64_t file_ino)
+// 打开文件句柄：普通文件在此一次性解析块映射
+// 版本视图（FT_VERSIONED）没有块映射，句柄接管调用方持有的视图引用，释放句柄时归还
+file_handle_t *file_handle_open(file_metadata_t *meta, int flags)
 {
-    pthread_mutex_lock(&block_maps_mutex);
-    block_map_t *map = hash_table_get(block_maps, file_ino);
+    if (!meta)
+        return NULL;
 
-    if (!map)
+    file_handle_t *fh = calloc(1, sizeof(file_handle_t));
+    if (!fh)
+        return NULL;
+
+    fh->meta = meta;
+    fh->flags = flags;
+    if (meta->type == FT_CONTROL)
     {
-        map = create_block_map(file_ino);
-        if (map)
+        fh->ctl = ctl_session_create();
+        if (!fh->ctl)
         {
-            hash_table_set(block_maps, file_ino, map);
+            free(fh);
+            return NULL;
         }
     }
-
-    pthread_mutex_unlock(&block_maps_mutex);
-    return map;
+    else if (S_ISREG(meta->mode) && meta->type != FT_VERSIONED)
+    {
+        fh->map = file_block_map(meta);
+        if (!fh->map)
+        {
+            free(fh);
+            return NULL;
+        }
+    }
+    return fh;
 }
 
-/* 计算两个块映射的差异块，结果写入 diff_blocks（key=块索引，value=新块指针） */
-int block_map_diff(block_map_t *old_map, block_map_t *new_map, hash_table_t *diff_blocks)
+void file_handle_release(file_handle_t *fh)
 {
-    if (!new_map || !diff_blocks)
-        return -EINVAL;
+    if (!fh)
+        return;
+    if (fh->map)
+        file_writeback(fh->meta);
+    ctl_session_destroy(fh->ctl);
+    lookup_path_put(fh->meta);
+    free(fh);
+}
 
-    uint64_t max_blocks = new_map->block_count;
-    if (old_map && old_map->block_count > max_blocks)
-        max_blocks = old_map->block_count;
+// 块容器中的块按需从容器文件调入：连续顺序读时对读取位置之后的一个窗口发起预读，
+// 每前进半个窗口提示一次
+#define READ_ADVISE_BLOCKS 64
 
-    for (uint64_t i = 0; i < max_blocks; i++)
+static void file_handle_advise_ahead(file_handle_t *fh, off_t end)
+{
+    if (fh->seq_reads == 0)
+        fh->advised_until = 0;
+    if (!block_container_enabled() || fh->seq_reads < 2)
+        return;
+    uint64_t first = (uint64_t)end / fs_state.block_size;
+    if (first + READ_ADVISE_BLOCKS / 2 <= fh->advised_until)
+        return;
+    // 只是优化：无法进入纪元临界区时不提示
+    if (!epoch_enter())
+        return;
+    uint64_t until = first + READ_ADVISE_BLOCKS;
+    uint64_t count = __atomic_load_n(&fh->map->block_count, __ATOMIC_ACQUIRE);
+    // 同一 slab 中相邻分配的块在地址上连续，合并成一次提示
+    const char *run = NULL;
+    size_t run_len = 0;
+    for (uint64_t i = first > fh->advised_until ? first : fh->advised_until; i < until && i < count; i++)
     {
-        data_block_t *oldb = (old_map && i < old_map->block_count) ? old_map->blocks[i] : NULL;
-        data_block_t *newb = (i < new_map->block_count) ? new_map->blocks[i] : NULL;
-
-        uint32_t oldchk = oldb ? oldb->checksum : 0;
-        uint32_t newchk = newb ? newb->checksum : 0;
-
-        if (oldb == NULL && newb == NULL)
+        data_block_t *block = block_map_get(fh->map, i);
+        const char *data = block ? __atomic_load_n(&block->data, __ATOMIC_ACQUIRE) : NULL;
+        if (!data)
             continue;
-
-        if (oldchk != newchk || (oldb && newb && oldb->size != newb->size))
+        size_t len = block->compressed_size ? block->compressed_size : block->size;
+        if (run && data == run + run_len)
         {
-            /* 使用非NULL占位，NULL表示删除，用标记指针1表示删除事件 */
-            void *val = newb ? (void *)newb : (void *)1;
-            hash_table_set(diff_blocks, i, val);
+            run_len += len;
+            continue;
         }
+        block_container_advise(run, run_len, BLOCK_CONTAINER_WILLNEED);
+        run = data;
+        run_len = len;
     }
-
-    /* 对差异块执行去重/压缩处理（模块C集成） */
-    dedup_process_diff_blocks(diff_blocks, &dedup_config);
-
-    return 0;
+    block_container_advise(run, run_len, BLOCK_CONTAINER_WILLNEED);
+    epoch_exit();
+    fh->advised_until = until;
 }
 
-// 高性能文件读取（支持大文件）
-int smart_read_file(file_metadata_t *meta, char *buf, size_t size, off_t offset)
+// 经句柄读取：偏移与上次读结束位置相同视为顺序读，顺序读时预取
+int file_handle_read(file_handle_t *fh, char *buf, size_t size, off_t offset)
 {
-    if (!meta || !buf || !S_ISREG(meta->mode))
-    {
+    if (!fh || !buf || !fh->map)
         return -EINVAL;
+
+    bool sequential = (offset == fh->next_read_offset);
+    fh->seq_reads = sequential ? fh->seq_reads + 1 : 0;
+
+    int ret = read_file_range(fh->meta, fh->map, buf, size, offset, fh->seq_reads > 0);
+    if (ret >= 0)
+    {
+        fh->next_read_offset = offset + ret;
+        file_handle_advise_ahead(fh, fh->next_read_offset);
     }
+    return ret;
+}
 
-    if (offset < 0)
+int file_handle_write(file_handle_t *fh, const char *buf, size_t size, off_t offset)
+{
+    if (!fh || !buf || !fh->map)
         return -EINVAL;
-    if (offset >= meta->size)
-        return 0;
-
-    size_t remaining = meta->size - offset;
-    if (size > remaining)
-        size = remaining;
 
-    block_map_t *map = get_block_map(meta->ino);
-    if (!map)
-        return -ENOMEM;
+    return write_file_range(fh->meta, fh->map, size, offset, memory_fill, &buf);
+}
 
-    meta->current_block_map = map;
+// 经句柄写入，数据由 fill 直接拷入块存储（供 write_buf 从 fuse_bufvec/管道取数）
+int file_handle_write_fill(file_handle_t *fh, size_t size, off_t offset,
+                           block_fill_fn fill, void *ctx)
+{
+    if (!fh || !fill || !fh->map)
+        return -EINVAL;
 
-    pthread_rwlock_rdlock(&map->lock);
+    return write_file_range(fh->meta, fh->map, size, offset, fill, ctx);
+}
 
-    size_t bytes_read = 0;
-    size_t current_offset = offset;
-    size_t remaining_bytes = size;
+// 读取向量中空洞使用的全零区
+#define READ_VEC_ZERO_CHUNK 65536
+static const char read_vec_zero[READ_VEC_ZERO_CHUNK];
 
-    while (remaining_bytes > 0)
+// 追加一段
+static int read_vec_push(file_read_vec_t *vec, const char *base, size_t len)
+{
+    // 与上一段在内存中相邻（连续的全零区、解压区中相邻的块等）时合并
+    if (vec->count > 0)
     {
-        uint64_t block_index = current_offset / fs_state.block_size;
-        size_t block_offset = current_offset % fs_state.block_size;
-        size_t bytes_to_read = fs_state.block_size - block_offset;
-
-        if (bytes_to_read > remaining_bytes)
+        struct iovec *last = &vec->iov[vec->count - 1];
+        if ((const char *)last->iov_base + last->iov_len == base)
         {
-            bytes_to_read = remaining_bytes;
+            last->iov_len += len;
+            vec->total += len;
+            return 0;
         }
+    }
+    if (vec->count == FILE_READ_VEC_MAX)
+        return -E2BIG;
+    vec->iov[vec->count].iov_base = (void *)base;
+    vec->iov[vec->count].iov_len = len;
+    vec->count++;
+    vec->total += len;
+    return 0;
+}
 
-        if (block_index >= map->block_count)
-        {
-            // 读取空数据（稀疏文件支持）
-            memset(buf + bytes_read, 0, bytes_to_read);
-        }
-        else
+// 追加一段空洞：上一段也是空洞时先把它延长到整个全零区，相邻空洞块不各占一段
+static int read_vec_push_zero(file_read_vec_t *vec, size_t len)
+{
+    if (vec->count > 0 && len > 0)
+    {
+        struct iovec *last = &vec->iov[vec->count - 1];
+        if ((const char *)last->iov_base == read_vec_zero && last->iov_len < READ_VEC_ZERO_CHUNK)
         {
-            data_block_t *block = map->blocks[block_index];
-            data_block_t *cached = NULL;
-            if (block)
-                cached = cache_get_block(block->block_id);
-            if (cached)
-                block = cached;
-            if (block)
-            {
-                int result = read_block(block, buf + bytes_read, bytes_to_read, block_offset);
-                if (result < 0)
-                {
-                    pthread_rwlock_unlock(&map->lock);
-                    return result;
-                }
-                bytes_read += result;
-                cache_put_block(block);
-
-                /* 预取下一个块以提升顺序读性能 */
-                if (block_index + 1 < map->block_count && map->blocks[block_index + 1])
-                {
-                    uint64_t next_id = map->blocks[block_index + 1]->block_id;
-                    cache_prefetch(&next_id, 1);
-                }
-            }
-            else
-            {
-                // 空块，填充零
-                memset(buf + bytes_read, 0, bytes_to_read);
-                bytes_read += bytes_to_read;
-            }
+            size_t n = READ_VEC_ZERO_CHUNK - last->iov_len;
+            if (n > len)
+                n = len;
+            last->iov_len += n;
+            vec->total += n;
+            len -= n;
         }
-
-        current_offset += bytes_to_read;
-        remaining_bytes -= bytes_to_read;
-
     }
-
-    pthread_rwlock_unlock(&map->lock);
-
-    // 更新访问时间
-    clock_gettime(CLOCK_REALTIME, &meta->atime);
-
-    return bytes_read;
+    while (len > 0)
+    {
+        size_t n = len < READ_VEC_ZERO_CHUNK ? len : READ_VEC_ZERO_CHUNK;
+        int ret = read_vec_push(vec, read_vec_zero, n);
+        if (ret < 0)
+            return ret;
+        len -= n;
+    }
+    return 0;
 }
 
-// 高性能文件写入（支持大文件）
-int smart_write_file(file_metadata_t *meta, const char *buf, size_t size, off_t offset)
+// 构造零拷贝读取向量：未压缩块直接引用块数据，空洞引用全零区，压缩块解压到线程私有缓冲。
+// 成功时持有块映射读锁，调用方须在同一线程内、再次解压之前把 iov 交给内核，然后调用 file_read_vec_release；
+// 段数超过 FILE_READ_VEC_MAX 时返回 -E2BIG，调用方应回退到拷贝读取
+int file_handle_read_vec(file_handle_t *fh, size_t size, off_t offset, file_read_vec_t *vec)
 {
-    if (!meta || !buf || !S_ISREG(meta->mode))
-    {
+    if (!fh || !vec || !fh->map)
         return -EINVAL;
-    }
-
     if (offset < 0)
         return -EINVAL;
 
-    block_map_t *map = get_block_map(meta->ino);
-    if (!map)
-        return -ENOMEM;
+    memset(vec, 0, sizeof(*vec));
 
-    meta->current_block_map = map;
+    file_metadata_t *meta = fh->meta;
+    block_map_t *map = fh->map;
+    pthread_rwlock_rdlock(&map->lock);
+    vec->map = map;
 
-    pthread_rwlock_wrlock(&map->lock);
+    if (offset >= meta->size)
+        return 0;
+    size_t remaining = meta->size - offset;
+    if (size > remaining)
+        size = remaining;
 
-    // 检查是否需要扩展文件
-    off_t new_size = offset + size;
-    if (new_size > meta->size)
-    {
-        meta->size = new_size;
-    }
+    size_t bs = fs_state.block_size;
+    uint64_t first_index = (uint64_t)offset / bs;
+    char *arena = NULL;           // 压缩块的解压区：区间内第 k 个块解压到 arena + k * bs
 
-    size_t bytes_written = 0;
     size_t current_offset = offset;
     size_t remaining_bytes = size;
-
-    while (remaining_bytes > 0)
+    int ret = 0;
+    while (remaining_bytes > 0 && ret == 0)
     {
-        uint64_t block_index = current_offset / fs_state.block_size;
-        size_t block_offset = current_offset % fs_state.block_size;
-        size_t bytes_to_write = fs_state.block_size - block_offset;
-
-        if (bytes_to_write > remaining_bytes)
+        uint64_t block_index = current_offset / bs;
+        size_t block_offset = current_offset % bs;
+        size_t chunk = bs - block_offset;
+        if (chunk > remaining_bytes)
+            chunk = remaining_bytes;
+
+        data_block_t *block = block_map_get(map, block_index);
+        size_t avail = 0;
+        if (!block)
         {
-            bytes_to_write = remaining_bytes;
+            ret = read_vec_push_zero(vec, chunk);
         }
-
-        // 扩展块映射数组
-        if (block_index >= map->block_count)
+        else if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
         {
-            size_t new_count = block_index + 1;
-            data_block_t **new_blocks = realloc(map->blocks,
-                                                new_count * sizeof(data_block_t *));
-            if (!new_blocks)
-            {
-                pthread_rwlock_unlock(&map->lock);
-                return -ENOMEM;
-            }
-
-            // 初始化新增的块指针
-            for (size_t i = map->block_count; i < new_count; i++)
+            // 解压区取自线程私有缓冲，按整个区间一次取足（之后不再扩大，已入向量的段保持有效）
+            if (!arena)
             {
-                new_blocks[i] = NULL;
+                uint64_t last_index = ((uint64_t)offset + size - 1) / bs;
+                arena = worker_scratch_block((size_t)(last_index - first_index + 1) * bs);
+                if (!arena)
+                {
+                    ret = -ENOMEM;
+                    break;
+                }
             }
-
-            map->blocks = new_blocks;
-            map->block_count = new_count;
-        }
-
-        // 分配数据块（如果需要）
-        if (!map->blocks[block_index])
-        {
-            map->blocks[block_index] = allocate_block(fs_state.block_size);
-            if (!map->blocks[block_index])
+            char *plain = arena + (size_t)(block_index - first_index) * bs;
+            size_t plain_size = 0;
+            if (block->size > bs || block_decompress_into(block, plain, bs, &plain_size) != 0)
             {
-                pthread_rwlock_unlock(&map->lock);
-                return -ENOMEM;
+                ret = -EIO;
+                break;
             }
-            map->blocks[block_index]->file_ino = meta->ino;
-            map->blocks[block_index]->offset = block_index * fs_state.block_size;
-            if (map->block_index)
-                hash_table_set(map->block_index, map->blocks[block_index]->block_id, map->blocks[block_index]);
+            avail = block_offset < plain_size ? plain_size - block_offset : 0;
+            if (avail > chunk)
+                avail = chunk;
+            if (avail > 0 && (ret = read_vec_push(vec, plain + block_offset, avail)) < 0)
+                break;
+            if (avail < chunk)
+                ret = read_vec_push_zero(vec, chunk - avail);
         }
         else
         {
-            cache_invalidate_block(map->blocks[block_index]->block_id);
-        }
-
-        // 写入数据块
-        int result = write_block(map->blocks[block_index],
-                                 buf + bytes_written, bytes_to_write, block_offset);
-        if (result < 0)
-        {
-            pthread_rwlock_unlock(&map->lock);
-            return result;
+            avail = block_offset < block->size ? block->size - block_offset : 0;
+            if (avail > chunk)
+                avail = chunk;
+            if (avail > 0)
+                ret = read_vec_push(vec, block->data + block_offset, avail);
+            if (ret == 0 && avail < chunk)
+                ret = read_vec_push_zero(vec, chunk - avail);
         }
 
-        /* 去重/压缩处理：可能替换块指针 */
-        dedup_process_block_on_write(&map->blocks[block_index], &dedup_config);
-        if (map->block_index && map->blocks[block_index])
-            hash_table_set(map->block_index, map->blocks[block_index]->block_id, map->blocks[block_index]);
-
-        if (map->blocks[block_index])
-            cache_put_block(map->blocks[block_index]);
-
-        bytes_written += result;
-        current_offset += result;
-        remaining_bytes -= result;
+        current_offset += chunk;
+        remaining_bytes -= chunk;
     }
 
-    // 更新文件块数
-    meta->blocks = (meta->size + fs_state.block_size - 1) / fs_state.block_size;
-
-    pthread_rwlock_unlock(&map->lock);
+    if (ret < 0)
+    {
+        file_read_vec_release(vec);
+        return ret;
+    }
 
-    // 更新修改时间
-    clock_gettime(CLOCK_REALTIME, &meta->mtime);
+    // 更新访问时间与顺序读游标
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+    fh->seq_reads = (offset == fh->next_read_offset) ? fh->seq_reads + 1 : 0;
+    fh->next_read_offset = offset + vec->total;
+    file_handle_advise_ahead(fh, fh->next_read_offset);
+    return 0;
+}
 
-    return bytes_written;
+// 释放读取向量：释放块映射读锁
+void file_read_vec_release(file_read_vec_t *vec)
+{
+    if (!vec)
+        return;
+    if (vec->map)
+        pthread_rwlock_unlock(&vec->map->lock);
+    memset(vec, 0, sizeof(*vec));
 }
 
-// 缓存操作
+// 缓存操作（数据块缓存）
 void cache_set(uint64_t key, void *value)
 {
     pthread_once(&cache_once, init_caches);
-
-    // 根据key范围判断缓存类型
-    if (key < 0x100000000ULL)
-    { // inode缓存
-        lru_cache_put(inode_cache, key, value);
-    }
-    else
-    { // 数据块缓存
-        lru_cache_put(block_cache, key, value);
-    }
+    lru_cache_put(block_cache, key, value);
 }
 
 void *cache_get(uint64_t key)
 {
     pthread_once(&cache_once, init_caches);
-
-    if (key < 0x100000000ULL)
-    {
-        return lru_cache_get(inode_cache, key);
-    }
-    else
-    {
-        return lru_cache_get(block_cache, key);
-    }
+    return lru_cache_get(block_cache, key);
 }
 
 void cache_remove(uint64_t key)
 {
     pthread_once(&cache_once, init_caches);
-
-    if (key < 0x100000000ULL)
-    {
-        lru_cache_remove(inode_cache, key);
-    }
-    else
-    {
-        lru_cache_remove(block_cache, key);
-    }
+    lru_cache_remove(block_cache, key);
 }
 
 void cache_clear(void)
 {
     pthread_once(&cache_once, init_caches);
-
-    lru_cache_clear(inode_cache);
     lru_cache_clear(block_cache);
-}
\ No newline at end of file
+}
+// 缓存命中统计，格式与 dedup_format_stats 一致
+int cache_format_stats(char *buf, size_t buf_size)
+{
+    if (!buf || buf_size == 0)
+        return -1;
+    pthread_once(&cache_once, init_caches);
+
+    lru_cache_stats_t bs;
+    lru_cache_get_stats(block_cache, &bs);
+    int n = snprintf(buf, buf_size,
+                     "inode_entries=%zu;"
+                     "block_hits=%llu;block_misses=%llu;block_evictions=%llu;block_entries=%zu;"
+                     "dirty_blocks=%llu",
+                     inode_table_count(), (unsigned long long)bs.hits,
+                     (unsigned long long)bs.misses, (unsigned long long)bs.evictions, bs.entries,
+                     (unsigned long long)__atomic_load_n(&fs_state.dirty_blocks, __ATOMIC_RELAXED));
+    return (n >= 0 && (size_t)n < buf_size) ? n : -1;
+}
+
+int inode_format_stats(char *buf, size_t buf_size)
+{
+    if (!buf || buf_size == 0)
+        return -1;
+    unsigned long long files = __atomic_load_n(&fs_state.total_files, __ATOMIC_RELAXED);
+    unsigned long long dirs = __atomic_load_n(&fs_state.total_dirs, __ATOMIC_RELAXED);
+    unsigned long long exts = __atomic_load_n(&fs_state.meta_ext_count, __ATOMIC_RELAXED);
+    unsigned long long bytes = files * sizeof(file_metadata_t) + dirs * sizeof(directory_t) +
+                               exts * sizeof(file_meta_ext_t);
+    unsigned long long inodes = files + dirs;
+    int n = snprintf(buf, buf_size,
+                     "inodes=%llu;meta_bytes=%zu;dir_bytes=%zu;ext_bytes=%zu;ext_allocated=%llu;"
+                     "bytes_per_inode=%llu",
+                     inodes, sizeof(file_metadata_t), sizeof(directory_t), sizeof(file_meta_ext_t),
+                     exts, inodes ? bytes / inodes : 0);
+    return (n >= 0 && (size_t)n < buf_size) ? n : -1;
+}
@@ -0,0 +1,573 @@
+/**
+ * 智能备份文件系统 - 模块A：数据块内存的slab分配器
+ */
+
+#include "slab.h"
+#include "block_container.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(SBFS_SLAB_DISABLE) || defined(__SANITIZE_ADDRESS__)
+#define SLAB_PASSTHROUGH 1
+#endif
+
+#define SLAB_SPAN_SHIFT 20
+#define SLAB_SPAN ((size_t)1 << SLAB_SPAN_SHIFT)
+#define SLAB_HEADER_SIZE 64          // slab 头部占用的空间，对象从其后开始切分
+#define SLAB_MIN_SHIFT 6
+#define SLAB_MAX_SHIFT 16
+// 尺寸类别：64B，之后每个2的幂区间等分为4档（80、96、112、128、160……64KB）
+#define SLAB_SIZE_CLASSES (1 + (SLAB_MAX_SHIFT - SLAB_MIN_SHIFT) * 4)
+#define SLAB_MAX_CLASSES (SLAB_SIZE_CLASSES + 4)
+#define SLAB_MAGAZINE 32             // 每线程每类别缓存的空闲对象上限，与仓库按半数交换
+
+// slab 头部，位于 SLAB_SPAN 对齐区域的起始处
+typedef struct slab {
+    slab_class_t *cls;           // NULL 表示单独映射的超大对象
+    struct slab *prev;           // 所属类别的部分空闲链表
+    struct slab *next;
+    void *free_list;             // 已归还的对象，对象首字存放下一项（按页类别不用）
+    char *carve;                 // 尚未切分区域的起点
+    size_t free_count;           // 已归还与未切分的对象总数
+    size_t map_len;              // 映射长度
+    size_t free_top;             // 按页类别：头部页内空闲下标栈的深度
+} slab_t;
+
+_Static_assert(sizeof(slab_t) <= SLAB_HEADER_SIZE, "slab header too large");
+_Static_assert(BLOCK_CONTAINER_SPAN == SLAB_SPAN, "container spans must match slab alignment");
+
+struct slab_class {
+    char name[16];
+    size_t obj_size;
+    size_t per_slab;
+    size_t first_off;            // 首个对象相对 slab 起点的偏移
+    bool paged;                  // 对象不小于一页：空闲下标存于头部页，空闲对象所占整页可归还内核
+    unsigned int index;
+    pthread_mutex_t lock;        // 保护以下字段及本类别各 slab 的空闲链表
+    slab_t *partial;             // 仍有空闲对象的 slab
+    size_t slabs;
+    size_t empty_slabs;          // 完全空闲但暂不归还的 slab（至多约1/8，避免反复映射）
+    size_t free_objs;            // 各 slab 内的空闲对象总数
+};
+
+typedef struct slab_magazine {
+    size_t count;                // 只由所属线程修改；统计时无锁读取
+    void *objs[SLAB_MAGAZINE];
+} slab_magazine_t;
+
+typedef struct slab_tcache {
+    struct slab_tcache *prev;
+    struct slab_tcache *next;
+    slab_magazine_t mags[SLAB_MAX_CLASSES];
+} slab_tcache_t;
+
+static slab_class_t g_classes[SLAB_MAX_CLASSES];  // 前 SLAB_SIZE_CLASSES 个为通用尺寸类别
+static unsigned int g_class_count;
+static pthread_mutex_t g_class_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static size_t g_large_count;
+static size_t g_page_size;
+
+static slab_tcache_t *g_tcaches;
+static pthread_mutex_t g_tcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifndef SLAB_PASSTHROUGH
+static _Thread_local slab_tcache_t *tls_tcache;
+static pthread_key_t tcache_key;
+static void tcache_release(void *arg);
+#endif
+
+static void class_init(slab_class_t *cls, const char *name, size_t obj_size, unsigned int index)
+{
+    snprintf(cls->name, sizeof(cls->name), "%s", name);
+    cls->obj_size = obj_size;
+    cls->paged = obj_size >= g_page_size;
+    cls->first_off = cls->paged ? g_page_size : SLAB_HEADER_SIZE;
+    cls->per_slab = (SLAB_SPAN - cls->first_off) / obj_size;
+    cls->index = index;
+    pthread_mutex_init(&cls->lock, NULL);
+}
+
+// 通用类别 i 的对象尺寸
+static size_t class_size(unsigned int i)
+{
+    if (i == 0)
+        return (size_t)1 << SLAB_MIN_SHIFT;
+    unsigned int shift = SLAB_MIN_SHIFT + (i - 1) / 4;
+    return ((size_t)1 << shift) + (size_t)((i - 1) % 4 + 1) * ((size_t)1 << (shift - 2));
+}
+
+static void slab_global_init(void)
+{
+    g_page_size = (size_t)sysconf(_SC_PAGESIZE);
+    for (unsigned int i = 0; i < SLAB_SIZE_CLASSES; i++)
+    {
+        char name[16];
+        size_t size = class_size(i);
+        snprintf(name, sizeof(name), "%zu", size);
+        class_init(&g_classes[i], name, size, i);
+    }
+    __atomic_store_n(&g_class_count, SLAB_SIZE_CLASSES, __ATOMIC_RELEASE);
+#ifndef SLAB_PASSTHROUGH
+    pthread_key_create(&tcache_key, tcache_release);
+#endif
+}
+
+// 容纳 size 字节的最小通用类别下标（调用方保证 size 不超过最大类别）
+static unsigned int size_class(size_t size)
+{
+    if (size <= ((size_t)1 << SLAB_MIN_SHIFT))
+        return 0;
+    unsigned int shift = 63 - (unsigned int)__builtin_clzll((unsigned long long)(size - 1));
+    size_t step = (size_t)((size - 1 - ((size_t)1 << shift)) >> (shift - 2));
+    return 1 + (shift - SLAB_MIN_SHIFT) * 4 + (unsigned int)step;
+}
+
+slab_class_t *slab_class_create(const char *name, size_t obj_size)
+{
+    if (obj_size == 0 || obj_size > ((size_t)1 << SLAB_MAX_SHIFT))
+        return NULL;
+    pthread_once(&g_init_once, slab_global_init);
+
+    // 对象首字用于空闲链表，尺寸按16字节对齐
+    obj_size = (obj_size + 15) & ~(size_t)15;
+
+    pthread_mutex_lock(&g_class_lock);
+    unsigned int index = g_class_count;
+    slab_class_t *cls;
+    if (index < SLAB_MAX_CLASSES)
+    {
+        cls = &g_classes[index];
+        class_init(cls, name ? name : "obj", obj_size, index);
+        __atomic_store_n(&g_class_count, index + 1, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        cls = &g_classes[size_class(obj_size)];  // 专属类别已用尽，共用通用类别
+    }
+    pthread_mutex_unlock(&g_class_lock);
+    return cls;
+}
+
+#ifdef SLAB_PASSTHROUGH
+
+void *slab_class_alloc(slab_class_t *cls)
+{
+    return cls ? malloc(cls->obj_size) : NULL;
+}
+
+void *slab_alloc(size_t size)
+{
+    return malloc(size ? size : 1);
+}
+
+void *slab_zalloc(size_t size)
+{
+    return calloc(1, size ? size : 1);
+}
+
+void slab_free(void *ptr)
+{
+    free(ptr);
+}
+
+#else
+
+static slab_t *slab_of(const void *ptr)
+{
+    return (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SPAN - 1));
+}
+
+// 映射 len 字节、起点按 SLAB_SPAN 对齐的匿名内存：多映射一个对齐单位后裁掉首尾
+static void *span_map(size_t len)
+{
+    char *raw = mmap(NULL, len + SLAB_SPAN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+    char *aligned = (char *)(((uintptr_t)raw + SLAB_SPAN - 1) & ~(uintptr_t)(SLAB_SPAN - 1));
+    if (aligned > raw)
+        munmap(raw, (size_t)(aligned - raw));
+    size_t tail = (size_t)(raw + len + SLAB_SPAN - (aligned + len));
+    if (tail > 0)
+        munmap(aligned + len, tail);
+    return aligned;
+}
+
+// 数据尺寸类别的 slab 优先取自块容器（映射文件），定长元数据类别与超大对象仍用匿名内存
+static void *slab_span_map(const slab_class_t *cls)
+{
+    if (cls->index < SLAB_SIZE_CLASSES && block_container_enabled())
+    {
+        void *span = block_container_map(SLAB_SPAN);
+        if (span)
+            return span;
+    }
+    return span_map(SLAB_SPAN);
+}
+
+static void span_unmap(void *ptr, size_t len)
+{
+    if (block_container_owns(ptr))
+        block_container_unmap(ptr, len);
+    else
+        munmap(ptr, len);
+}
+
+static void partial_link(slab_class_t *cls, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = cls->partial;
+    if (cls->partial)
+        cls->partial->prev = s;
+    cls->partial = s;
+}
+
+static void partial_unlink(slab_class_t *cls, slab_t *s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        cls->partial = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+    s->prev = s->next = NULL;
+}
+
+// 以下在 cls->lock 内调用
+static slab_t *slab_grow(slab_class_t *cls)
+{
+    slab_t *s = slab_span_map(cls);
+    if (!s)
+        return NULL;
+    s->cls = cls;
+    s->free_list = NULL;
+    s->free_top = 0;
+    s->carve = (char *)s + cls->first_off;
+    s->free_count = cls->per_slab;
+    s->map_len = SLAB_SPAN;
+    partial_link(cls, s);
+    cls->slabs++;
+    cls->empty_slabs++;
+    cls->free_objs += cls->per_slab;
+    return s;
+}
+
+// 按页类别的空闲下标栈，紧跟在头部之后
+static uint16_t *slab_free_stack(slab_t *s)
+{
+    return (uint16_t *)((char *)s + sizeof(slab_t));
+}
+
+static void *slab_pop(slab_class_t *cls, slab_t *s)
+{
+    void *obj;
+    if (cls->paged && s->free_top > 0)
+    {
+        uint16_t idx = slab_free_stack(s)[--s->free_top];
+        obj = (char *)s + cls->first_off + (size_t)idx * cls->obj_size;
+    }
+    else if (s->free_list)
+    {
+        obj = s->free_list;
+        s->free_list = *(void **)obj;
+    }
+    else
+    {
+        obj = s->carve;
+        s->carve += cls->obj_size;
+    }
+    if (s->free_count == cls->per_slab)
+        cls->empty_slabs--;
+    s->free_count--;
+    cls->free_objs--;
+    if (s->free_count == 0)
+        partial_unlink(cls, s);
+    return obj;
+}
+
+// 类别内空闲对象超过 1/8 时，把空闲对象完整覆盖的页交还内核（再次使用时按零页重新分配）；
+// 容器中的页在文件中打洞，同时归还磁盘空间
+static void slab_purge(slab_class_t *cls, char *obj)
+{
+    if (cls->free_objs * 8 <= cls->slabs * cls->per_slab)
+        return;
+    uintptr_t start = ((uintptr_t)obj + g_page_size - 1) & ~(uintptr_t)(g_page_size - 1);
+    uintptr_t end = ((uintptr_t)obj + cls->obj_size) & ~(uintptr_t)(g_page_size - 1);
+    if (end <= start)
+        return;
+    if (block_container_owns(obj))
+        block_container_discard((void *)start, end - start);
+    else
+        madvise((void *)start, end - start, MADV_DONTNEED);
+}
+
+static void slab_push(slab_class_t *cls, void *obj)
+{
+    slab_t *s = slab_of(obj);
+    if (cls->paged)
+    {
+        slab_purge(cls, obj);
+        size_t idx = (size_t)((char *)obj - ((char *)s + cls->first_off)) / cls->obj_size;
+        slab_free_stack(s)[s->free_top++] = (uint16_t)idx;
+    }
+    else
+    {
+        *(void **)obj = s->free_list;
+        s->free_list = obj;
+    }
+    if (s->free_count++ == 0)
+        partial_link(cls, s);
+    cls->free_objs++;
+
+    if (s->free_count == cls->per_slab)
+    {
+        if (cls->empty_slabs >= 1 + cls->slabs / 8)
+        {
+            partial_unlink(cls, s);
+            cls->slabs--;
+            cls->free_objs -= cls->per_slab;
+            span_unmap(s, s->map_len);
+        }
+        else
+        {
+            cls->empty_slabs++;
+        }
+    }
+}
+
+static void depot_put(slab_class_t *cls, void **objs, size_t n)
+{
+    pthread_mutex_lock(&cls->lock);
+    for (size_t i = 0; i < n; i++)
+        slab_push(cls, objs[i]);
+    pthread_mutex_unlock(&cls->lock);
+}
+
+// 线程退出时把弹匣中的对象还给仓库
+static void tcache_release(void *arg)
+{
+    slab_tcache_t *tc = arg;
+    if (tls_tcache == tc)
+        tls_tcache = NULL;
+
+    pthread_mutex_lock(&g_tcache_lock);
+    if (tc->prev)
+        tc->prev->next = tc->next;
+    else
+        g_tcaches = tc->next;
+    if (tc->next)
+        tc->next->prev = tc->prev;
+    pthread_mutex_unlock(&g_tcache_lock);
+
+    unsigned int nclass = __atomic_load_n(&g_class_count, __ATOMIC_ACQUIRE);
+    for (unsigned int i = 0; i < nclass; i++)
+    {
+        if (tc->mags[i].count)
+            depot_put(&g_classes[i], tc->mags[i].objs, tc->mags[i].count);
+    }
+    free(tc);
+}
+
+// 从类别仓库批量取对象，返回实际取得的数量
+static size_t depot_take(slab_class_t *cls, void **objs, size_t want)
+{
+    size_t n = 0;
+    pthread_mutex_lock(&cls->lock);
+    while (n < want)
+    {
+        if (!cls->partial && !slab_grow(cls))
+            break;
+        objs[n++] = slab_pop(cls, cls->partial);
+    }
+    pthread_mutex_unlock(&cls->lock);
+    return n;
+}
+
+static slab_tcache_t *tcache_get(void)
+{
+    if (tls_tcache)
+        return tls_tcache;
+
+    slab_tcache_t *tc = calloc(1, sizeof(slab_tcache_t));
+    if (!tc)
+        return NULL;
+    pthread_setspecific(tcache_key, tc);
+
+    pthread_mutex_lock(&g_tcache_lock);
+    tc->next = g_tcaches;
+    if (g_tcaches)
+        g_tcaches->prev = tc;
+    g_tcaches = tc;
+    pthread_mutex_unlock(&g_tcache_lock);
+
+    tls_tcache = tc;
+    return tc;
+}
+
+static void *class_alloc(slab_class_t *cls)
+{
+    slab_tcache_t *tc = tcache_get();
+    if (!tc)
+    {
+        void *obj;
+        return depot_take(cls, &obj, 1) ? obj : NULL;
+    }
+
+    slab_magazine_t *mag = &tc->mags[cls->index];
+    size_t count = mag->count;
+    if (count == 0)
+    {
+        count = depot_take(cls, mag->objs, SLAB_MAGAZINE / 2);
+        if (count == 0)
+            return NULL;
+    }
+    count--;
+    __atomic_store_n(&mag->count, count, __ATOMIC_RELAXED);
+    return mag->objs[count];
+}
+
+static void class_free(slab_class_t *cls, void *obj)
+{
+    slab_tcache_t *tc = tcache_get();
+    if (!tc)
+    {
+        depot_put(cls, &obj, 1);
+        return;
+    }
+
+    slab_magazine_t *mag = &tc->mags[cls->index];
+    size_t count = mag->count;
+    if (count == SLAB_MAGAZINE)
+    {
+        // 归还较早放入的一半，保留最近释放的（更可能仍在CPU缓存中）
+        depot_put(cls, mag->objs, SLAB_MAGAZINE / 2);
+        memmove(mag->objs, mag->objs + SLAB_MAGAZINE / 2, (SLAB_MAGAZINE / 2) * sizeof(void *));
+        count = SLAB_MAGAZINE / 2;
+    }
+    mag->objs[count++] = obj;
+    __atomic_store_n(&mag->count, count, __ATOMIC_RELAXED);
+}
+
+void *slab_class_alloc(slab_class_t *cls)
+{
+    return cls ? class_alloc(cls) : NULL;
+}
+
+void *slab_alloc(size_t size)
+{
+    pthread_once(&g_init_once, slab_global_init);
+    if (size <= ((size_t)1 << SLAB_MAX_SHIFT))
+        return class_alloc(&g_classes[size_class(size)]);
+
+    // 超大对象单独映射，头部同样位于对齐起点，释放时按地址即可识别
+    size_t page = g_page_size;
+    size_t len = (SLAB_HEADER_SIZE + size + page - 1) & ~(page - 1);
+    slab_t *s = span_map(len);
+    if (!s)
+        return NULL;
+    s->cls = NULL;
+    s->map_len = len;
+    __atomic_add_fetch(&g_large_count, 1, __ATOMIC_RELAXED);
+    return (char *)s + SLAB_HEADER_SIZE;
+}
+
+void *slab_zalloc(size_t size)
+{
+    void *ptr = slab_alloc(size);
+    if (ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void slab_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    slab_t *s = slab_of(ptr);
+    if (s->cls)
+    {
+        class_free(s->cls, ptr);
+        return;
+    }
+    __atomic_sub_fetch(&g_large_count, 1, __ATOMIC_RELAXED);
+    munmap(s, s->map_len);
+}
+
+#endif // SLAB_PASSTHROUGH
+
+size_t slab_get_stats(slab_class_stats_t *out, size_t max)
+{
+    if (!out || max == 0)
+        return 0;
+    pthread_once(&g_init_once, slab_global_init);
+
+    unsigned int nclass = __atomic_load_n(&g_class_count, __ATOMIC_ACQUIRE);
+    size_t cached[SLAB_MAX_CLASSES] = {0};
+    pthread_mutex_lock(&g_tcache_lock);
+    for (slab_tcache_t *tc = g_tcaches; tc; tc = tc->next)
+    {
+        for (unsigned int i = 0; i < nclass; i++)
+            cached[i] += __atomic_load_n(&tc->mags[i].count, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&g_tcache_lock);
+
+    size_t n = 0;
+    for (unsigned int i = 0; i < nclass && n < max; i++, n++)
+    {
+        slab_class_t *cls = &g_classes[i];
+        pthread_mutex_lock(&cls->lock);
+        size_t slabs = cls->slabs;
+        size_t free_objs = cls->free_objs;
+        pthread_mutex_unlock(&cls->lock);
+
+        size_t objects = slabs * cls->per_slab;
+        size_t idle = free_objs + cached[i];
+        out[n] = (slab_class_stats_t){
+            .name = cls->name,
+            .obj_size = cls->obj_size,
+            .slabs = slabs,
+            .objects = objects,
+            .live = objects > idle ? objects - idle : 0,
+            .cached = cached[i],
+        };
+    }
+    if (n < max)
+    {
+        size_t large = __atomic_load_n(&g_large_count, __ATOMIC_RELAXED);
+        out[n++] = (slab_class_stats_t){
+            .name = "large",
+            .slabs = large,
+            .objects = large,
+            .live = large,
+        };
+    }
+    return n;
+}
+
+int slab_format_stats(char *buf, size_t size)
+{
+    if (!buf || size == 0)
+        return -1;
+
+    slab_class_stats_t stats[SLAB_MAX_CLASSES + 1];
+    size_t n = slab_get_stats(stats, SLAB_MAX_CLASSES + 1);
+    size_t len = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < n; i++)
+    {
+        if (stats[i].slabs == 0)
+            continue;
+        int w = snprintf(buf + len, size - len, "%s%s=%zu/%zu", len ? ";" : "", stats[i].name,
+                         stats[i].live, stats[i].objects);
+        if (w < 0 || (size_t)w >= size - len)
+            return -1;
+        len += (size_t)w;
+    }
+    return (int)len;
+}
@@ -1,15 +1,25 @@
 /**
  * 智能备份文件系统 - 模块A：FUSE基础实现
- * 基于FUSE 3.0+ API
+ * 基于FUSE 3.12+ API
  */
 
-#define FUSE_USE_VERSION 31
+#define FUSE_USE_VERSION 312
 
 #include "smartbackupfs.h"
 #include "version_manager.h"
 #include "dedup.h"
 #include "module_d.h"
+#include "smartbackupfs_ll.h"
+#include "logger.h"
+#include "config_loader.h"
+#include "smartbackupfs_ctl.h"
+#include "worker_pool.h"
+#include "slab.h"
+#include "block_container.h"
+#include "inode_table.h"
+#include "module_c/segment_store.h"
 #include <fuse3/fuse.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,7 +38,7 @@
 extern fs_state_t fs_state;
 
 // 外部函数声明
-extern void fs_init(void);
+extern int fs_init(void);
 extern void fs_destroy(void);
 extern file_metadata_t *create_inode(file_type_t type, mode_t mode);
 extern int add_directory_entry(directory_t *dir, const char *name, file_metadata_t *meta);
@@ -107,15 +117,15 @@ static directory_t *get_parent_directory(const char *path, char **child_name)
         return NULL;
     }
 
-    // 复制路径以便修改
-    char *path_copy = strdup(path);
-    char *last_slash = strrchr(path_copy, '/');
-
-    if (!last_slash)
+    // 复制路径以便修改（使用线程私有缓冲）
+    size_t len = strlen(path);
+    worker_scratch_t *ws = worker_scratch();
+    if (!ws || len >= MAX_PATH_LEN)
     {
-        free(path_copy);
         return NULL;
     }
+    char *path_copy = memcpy(ws->parent, path, len + 1);
+    char *last_slash = strrchr(path_copy, '/');
 
     // 提取子文件名
     if (child_name)
@@ -126,7 +136,6 @@ static directory_t *get_parent_directory(const char *path, char **child_name)
     // 如果是根目录下的文件
     if (last_slash == path_copy)
     {
-        free(path_copy);
         return fs_state.root;
     }
 
@@ -135,7 +144,6 @@ static directory_t *get_parent_directory(const char *path, char **child_name)
 
     // 查找父目录
     file_metadata_t *parent_meta = lookup_path(path_copy);
-    free(path_copy);
 
     if (!parent_meta || parent_meta->type != FT_DIRECTORY)
     {
@@ -154,14 +162,55 @@ static directory_t *get_parent_directory(const char *path, char **child_name)
     return parent_dir;
 }
 
-// 块映射管理外部声明
-extern block_map_t *get_block_map(uint64_t file_ino);
-extern void destroy_block_map(block_map_t *map);
-extern int hash_table_remove(hash_table_t *table, uint64_t key);
+// 把节点以新名称挂入父目录（create/mkdir/symlink/link共用）：父目录只解析一次，
+// 存在性检查与插入在同一次父目录写锁内完成。
+// 成功返回0，节点已发布；失败返回负errno，节点未挂入，由调用方处理
+static int attach_new_node(const char *path, file_metadata_t *meta)
+{
+    char *child_name = NULL;
+    directory_t *parent_dir = get_parent_directory(path, &child_name);
+    if (!parent_dir || !child_name || !child_name[0])
+    {
+        free(child_name);
+        return -ENOENT;
+    }
+
+    dir_entry_t *entry = dir_entry_create(child_name, meta);
+    bool has_version_syntax = strchr(child_name, '@') != NULL;
+    free(child_name);
+    if (!entry)
+        return -ENOMEM;
+
+    // 含'@'的名称与版本语法重叠（如 file@versions），仍按完整路径判断是否已存在
+    if (has_version_syntax && lookup_path(path))
+    {
+        dir_entry_free(entry);
+        return -EEXIST;
+    }
+
+    pthread_rwlock_wrlock(&parent_dir->lock);
+    int ret = find_directory_entry(parent_dir, entry->name)
+                  ? -EEXIST
+                  : directory_insert_entry_locked(parent_dir, entry);
+    if (ret == 0)
+    {
+        // 更新父目录修改时间
+        clock_gettime(CLOCK_REALTIME, &parent_dir->meta.mtime);
+        parent_dir->meta.ctime = parent_dir->meta.mtime;
+    }
+    pthread_rwlock_unlock(&parent_dir->lock);
+    if (ret != 0)
+        dir_entry_free(entry);
+    return ret;
+}
 
-// 全局变量外部声明
-extern hash_table_t *block_maps;
-extern pthread_mutex_t block_maps_mutex;
+// 路径是否为 filename@versions 虚拟目录本身（其下的目录项不算）
+static bool is_versions_dir_path(const char *path)
+{
+    size_t len = strlen(path);
+    size_t suffix = strlen("@versions");
+    return len > suffix && strcmp(path + len - suffix, "@versions") == 0;
+}
 
 // 获取文件属性
 static int smartbackupfs_getattr(const char *path, struct stat *stbuf,
@@ -171,82 +220,56 @@ static int smartbackupfs_getattr(const char *path, struct stat *stbuf,
 
     memset(stbuf, 0, sizeof(struct stat));
 
-    // 检查是否是 @versions 路径
-    if (strstr(path, "@versions") != NULL)
+    // filename@versions 目录本身
+    if (is_versions_dir_path(path))
     {
         // 解析基础路径（去掉@versions部分）
         char *path_copy = strdup(path);
-        char *at = strrchr(path_copy, '@');
-        if (at)
-            *at = '\0';
+        if (!path_copy)
+            return -ENOMEM;
+        path_copy[strlen(path_copy) - strlen("@versions")] = '\0';
 
         file_metadata_t *base = lookup_path(path_copy);
         free(path_copy);
         
         if (!base)
             return -ENOENT;
+        if (!VERSION_INO_VALID(base->ino, 0))
+            return -EOVERFLOW;
 
-        // @versions 作为虚拟目录返回
-        stbuf->st_ino = base->ino + 1000000; // 使用特殊的inode编号
-        stbuf->st_mode = S_IFDIR | 0755;
+        // @versions 作为虚拟目录返回，inode编号由文件inode派生（版本ID 0）
+        stbuf->st_ino = VERSION_INO(base->ino, 0);
+        stbuf->st_mode = S_IFDIR | 0555;
         stbuf->st_nlink = 2;
         stbuf->st_uid = base->uid;
         stbuf->st_gid = base->gid;
         stbuf->st_size = 4096;
         stbuf->st_blocks = 8;
-        clock_gettime(CLOCK_REALTIME, &stbuf->st_atim);
-        stbuf->st_mtim = stbuf->st_atim;
-        stbuf->st_ctim = stbuf->st_atim;
+        stbuf->st_atim = base->atime;
+        stbuf->st_mtim = base->mtime;
+        stbuf->st_ctim = base->ctime;
         return 0;
     }
 
-    file_metadata_t *meta = lookup_path(path);
+    file_metadata_t *meta = lookup_path_ref(path);
     if (!meta)
     {
         return -ENOENT;
     }
 
-    stbuf->st_ino = meta->ino;
-    stbuf->st_mode = meta->mode;
-    stbuf->st_nlink = meta->nlink;
-    stbuf->st_uid = meta->uid;
-    stbuf->st_gid = meta->gid;
-    stbuf->st_size = meta->size;
-    stbuf->st_blocks = meta->blocks;
-    stbuf->st_atim = meta->atime;
-    stbuf->st_mtim = meta->mtime;
-    stbuf->st_ctim = meta->ctime;
-
+    fill_stat_from_meta(meta, stbuf);
+    lookup_path_put(meta);
     return 0;
 }
 
 // 创建目录
 static int smartbackupfs_mkdir(const char *path, mode_t mode)
 {
-    // 检查目录是否已存在
-    if (lookup_path(path))
-    {
-        return -EEXIST;
-    }
-
-    // 获取父目录和目录名
-    char *child_name = NULL;
-    directory_t *parent_dir = get_parent_directory(path, &child_name);
-    if (!parent_dir || !child_name)
-    {
-        if (child_name)
-            free(child_name);
-        return -ENOENT;
-    }
-
-    // 分配新的inode
-    pthread_mutex_lock(&fs_state.ino_mutex);
-    ino_t new_ino = fs_state.next_ino++;
-    pthread_mutex_unlock(&fs_state.ino_mutex);
-
     // 创建目录元数据
     directory_t *new_dir = calloc(1, sizeof(directory_t));
-    new_dir->meta.ino = new_ino;
+    if (!new_dir)
+        return -ENOMEM;
+    new_dir->meta.ino = inode_alloc_ino();
     new_dir->meta.mode = S_IFDIR | (mode & 07777);
     new_dir->meta.nlink = 2; // '.'和父目录
     new_dir->meta.uid = fuse_get_context()->uid;
@@ -259,34 +282,20 @@ static int smartbackupfs_mkdir(const char *path, mode_t mode)
     new_dir->meta.ctime = new_dir->meta.atime;
     pthread_rwlock_init(&new_dir->lock, NULL);
 
-    // 创建目录项
-    dir_entry_t *new_entry = malloc(sizeof(dir_entry_t));
-    new_entry->name = strdup(child_name);
-    new_entry->meta = &new_dir->meta;
-    new_entry->next = NULL;
-
-    free(child_name);
-
-    // 添加到正确的父目录
-    pthread_rwlock_wrlock(&parent_dir->lock);
-    if (parent_dir->entries)
-    {
-        dir_entry_t *last = parent_dir->entries;
-        while (last->next)
-            last = last->next;
-        last->next = new_entry;
-    }
-    else
+    // 先登记到inode表，挂入目录树后即可按编号找到
+    int ret = inode_table_insert(&new_dir->meta);
+    if (ret == 0)
+        ret = attach_new_node(path, &new_dir->meta);
+    if (ret != 0)
     {
-        parent_dir->entries = new_entry;
+        inode_table_remove(&new_dir->meta);
+        pthread_rwlock_destroy(&new_dir->lock);
+        free(new_dir);
+        return ret;
     }
-    pthread_rwlock_unlock(&parent_dir->lock);
 
-    // 添加到缓存
-    cache_set(new_dir->meta.ino, new_dir);
-
-    fs_state.total_dirs++;
-    fs_state.total_blocks++;
+    FS_STAT_ADD(total_dirs, 1);
+    FS_STAT_ADD(total_blocks, 1);
 
     return 0;
 }
@@ -306,89 +315,63 @@ static int smartbackupfs_unlink(const char *path)
 
     pthread_rwlock_wrlock(&parent_dir->lock);
 
-    dir_entry_t **entry_ptr = &parent_dir->entries;
-
-    while (*entry_ptr)
+    dir_entry_t *to_delete = find_directory_entry(parent_dir, child_name);
+    if (to_delete)
     {
-        if (strcmp((*entry_ptr)->name, child_name) == 0)
+        // 检查是否是目录
+        if (S_ISDIR(to_delete->meta->mode))
         {
-            dir_entry_t *to_delete = *entry_ptr;
-
-            // 检查是否是目录
-            if (S_ISDIR(to_delete->meta->mode))
-            {
-                pthread_rwlock_unlock(&parent_dir->lock);
-                free(child_name);
-                return -EISDIR;
-            }
-
-            // 在删除前创建版本快照（事件触发策略）
-            version_manager_create_version(to_delete->meta, "unlink");
-
-            // 记录文件删除事务
-            if (module_d_state.wal_enabled) {
-                uint64_t tx_id = md_transaction_begin(TX_DELETE_FILE);
-                transaction_header_t header;
-                header.tx_id = tx_id;
-                header.type = TX_DELETE_FILE;
-                header.state = TX_COMMITTED;
-                header.timestamp = time(NULL);
-                header.ino = to_delete->meta->ino;
-                header.block_id = 0;
-                header.data_size = strlen(path) + 1;
-                header.checksum = 0;
-                md_transaction_log(tx_id, &header, sizeof(header));
-                md_transaction_log(tx_id, path, strlen(path) + 1);
-                md_transaction_commit(tx_id);
-                printf("模块D：记录文件删除事务 %lu，文件: %s\n", tx_id, path);
-            }
-
-            // 从链表中删除
-            *entry_ptr = to_delete->next;
-
-            // 减少链接计数
-            to_delete->meta->nlink--;
-            clock_gettime(CLOCK_REALTIME, &to_delete->meta->ctime);
-
-            // 如果链接计数为0，才真正删除文件数据和元数据
-            if (to_delete->meta->nlink == 0)
-            {
-                blkcnt_t blk = to_delete->meta->blocks;
-                // 清理文件数据块映射
-                block_map_t *map = get_block_map(to_delete->meta->ino);
-                if (map)
-                {
-                    // 销毁块映射会释放所有数据块
-                    destroy_block_map(map);
-
-                    // 从块映射表中移除
-                    pthread_mutex_lock(&block_maps_mutex);
-                    hash_table_remove(block_maps, to_delete->meta->ino);
-                    pthread_mutex_unlock(&block_maps_mutex);
-                }
-
-                // 从缓存中移除
-                cache_remove(to_delete->meta->ino);
-
-                // 清理扩展属性
-                if (to_delete->meta->xattr)
-                {
-                    free(to_delete->meta->xattr);
-                }
-
-                free(to_delete->meta);
-                fs_state.total_files--;
-                fs_state.total_blocks -= blk;
-            }
-
-            free(to_delete->name);
-            free(to_delete);
+            pthread_rwlock_unlock(&parent_dir->lock);
+            free(child_name);
+            return -EISDIR;
+        }
 
+        if (ctl_is_reserved(to_delete->meta))
+        {
             pthread_rwlock_unlock(&parent_dir->lock);
             free(child_name);
-            return 0;
+            return -EPERM;
+        }
+
+        // 在删除前创建版本快照（事件触发策略）
+        version_manager_create_version(to_delete->meta, "unlink");
+
+        // 记录文件删除事务
+        if (module_d_state.wal_enabled) {
+            uint64_t tx_id = md_transaction_begin(TX_DELETE_FILE);
+            transaction_header_t header;
+            header.tx_id = tx_id;
+            header.type = TX_DELETE_FILE;
+            header.state = TX_COMMITTED;
+            header.timestamp = time(NULL);
+            header.ino = to_delete->meta->ino;
+            header.block_id = 0;
+            header.data_size = strlen(path) + 1;
+            header.checksum = 0;
+            md_transaction_log(tx_id, &header, sizeof(header));
+            md_transaction_log(tx_id, path, strlen(path) + 1);
+            md_transaction_commit(tx_id);
+            SBFS_LOG_DEBUG("模块D：记录文件删除事务 %lu，文件: %s", tx_id, path);
+        }
+
+        // 从目录中摘除
+        directory_unlink_entry_locked(parent_dir, to_delete);
+
+        // 减少链接计数
+        to_delete->meta->nlink--;
+        clock_gettime(CLOCK_REALTIME, &to_delete->meta->ctime);
+
+        // 如果链接计数为0，才真正删除文件数据和元数据
+        if (to_delete->meta->nlink == 0)
+        {
+            destroy_detached_inode(to_delete->meta);
         }
-        entry_ptr = &(*entry_ptr)->next;
+
+        dir_entry_free(to_delete);
+
+        pthread_rwlock_unlock(&parent_dir->lock);
+        free(child_name);
+        return 0;
     }
 
     pthread_rwlock_unlock(&parent_dir->lock);
@@ -416,52 +399,43 @@ static int smartbackupfs_rmdir(const char *path)
 
     pthread_rwlock_wrlock(&parent_dir->lock);
 
-    dir_entry_t **entry_ptr = &parent_dir->entries;
-
-    while (*entry_ptr)
+    dir_entry_t *to_delete = find_directory_entry(parent_dir, child_name);
+    if (to_delete)
     {
-        if (strcmp((*entry_ptr)->name, child_name) == 0)
+        // 检查是否是目录
+        if (!S_ISDIR(to_delete->meta->mode))
         {
-            dir_entry_t *to_delete = *entry_ptr;
-
-            // 检查是否是目录
-            if (!S_ISDIR(to_delete->meta->mode))
-            {
-                pthread_rwlock_unlock(&parent_dir->lock);
-                free(child_name);
-                return -ENOTDIR;
-            }
-
-            // 检查目录是否为空
-            directory_t *dir = (directory_t *)to_delete->meta;
-            if (dir->entries)
-            {
-                pthread_rwlock_unlock(&parent_dir->lock);
-                free(child_name);
-                return -ENOTEMPTY;
-            }
-
-            // 从链表中删除
-            *entry_ptr = to_delete->next;
-
-            // 释放资源
-            free(to_delete->name);
-            pthread_rwlock_destroy(&dir->lock);
-
-            // 从缓存中移除
-            cache_remove(to_delete->meta->ino);
-
-            free(to_delete->meta);
-            free(to_delete);
+            pthread_rwlock_unlock(&parent_dir->lock);
+            free(child_name);
+            return -ENOTDIR;
+        }
 
-            fs_state.total_dirs--;
-            fs_state.total_blocks--;
+        if (ctl_is_reserved(to_delete->meta))
+        {
+            pthread_rwlock_unlock(&parent_dir->lock);
+            free(child_name);
+            return -EPERM;
+        }
 
+        // 检查目录是否为空
+        directory_t *dir = (directory_t *)to_delete->meta;
+        if (dir->entries)
+        {
             pthread_rwlock_unlock(&parent_dir->lock);
             free(child_name);
-            return 0;
+            return -ENOTEMPTY;
         }
-        entry_ptr = &(*entry_ptr)->next;
+
+        // 从目录中摘除
+        directory_unlink_entry_locked(parent_dir, to_delete);
+
+        // 释放资源
+        destroy_detached_inode(to_delete->meta);
+        dir_entry_free(to_delete);
+
+        pthread_rwlock_unlock(&parent_dir->lock);
+        free(child_name);
+        return 0;
     }
 
     pthread_rwlock_unlock(&parent_dir->lock);
@@ -481,6 +455,12 @@ static int smartbackupfs_rename(const char *from, const char *to,
         return -ENOENT;
     }
 
+    // 控制目录与控制文件不可移动
+    if (ctl_is_reserved(src_meta))
+    {
+        return -EPERM;
+    }
+
     // 在重命名前创建版本快照（事件触发策略）
     version_manager_create_version(src_meta, "rename");
 
@@ -520,19 +500,11 @@ static int smartbackupfs_rename(const char *from, const char *to,
         // 需要先从源目录删除，再添加到目标目录
         pthread_rwlock_wrlock(&src_parent_dir->lock);
 
-        // 查找并从源目录删除
-        dir_entry_t **src_entry_ptr = &src_parent_dir->entries;
-        dir_entry_t *move_entry = NULL;
-
-        while (*src_entry_ptr)
+        // 查找并从源目录摘除
+        dir_entry_t *move_entry = find_directory_entry(src_parent_dir, src_child_name);
+        if (move_entry)
         {
-            if (strcmp((*src_entry_ptr)->name, src_child_name) == 0)
-            {
-                move_entry = *src_entry_ptr;
-                *src_entry_ptr = (*src_entry_ptr)->next;
-                break;
-            }
-            src_entry_ptr = &(*src_entry_ptr)->next;
+            directory_unlink_entry_locked(src_parent_dir, move_entry);
         }
 
         pthread_rwlock_unlock(&src_parent_dir->lock);
@@ -547,10 +519,21 @@ static int smartbackupfs_rename(const char *from, const char *to,
         // 更新文件名并添加到目标目录
         pthread_rwlock_wrlock(&dst_parent_dir->lock);
 
-        free(move_entry->name);
-        move_entry->name = strdup(dst_child_name);
-        move_entry->next = dst_parent_dir->entries;
-        dst_parent_dir->entries = move_entry;
+        int ret = directory_rename_entry_locked(NULL, move_entry, dst_child_name);
+        if (ret == 0)
+            ret = directory_insert_entry_locked(dst_parent_dir, move_entry);
+        if (ret != 0)
+        {
+            // 目标不可用：放回源目录
+            pthread_rwlock_unlock(&dst_parent_dir->lock);
+            pthread_rwlock_wrlock(&src_parent_dir->lock);
+            directory_rename_entry_locked(NULL, move_entry, src_child_name);
+            directory_insert_entry_locked(src_parent_dir, move_entry);
+            pthread_rwlock_unlock(&src_parent_dir->lock);
+            free(src_child_name);
+            free(dst_child_name);
+            return ret;
+        }
 
         // 更新目标目录的修改时间
         clock_gettime(CLOCK_REALTIME, &dst_parent_dir->meta.mtime);
@@ -563,16 +546,10 @@ static int smartbackupfs_rename(const char *from, const char *to,
         // 同目录重命名
         pthread_rwlock_wrlock(&src_parent_dir->lock);
 
-        dir_entry_t *entry = src_parent_dir->entries;
-        while (entry)
+        dir_entry_t *entry = find_directory_entry(src_parent_dir, src_child_name);
+        if (entry)
         {
-            if (strcmp(entry->name, src_child_name) == 0)
-            {
-                free(entry->name);
-                entry->name = strdup(dst_child_name);
-                break;
-            }
-            entry = entry->next;
+            directory_rename_entry_locked(src_parent_dir, entry, dst_child_name);
         }
 
         // 更新目录修改时间
@@ -613,44 +590,52 @@ static int smartbackupfs_truncate(const char *path, off_t size,
         return -EINVAL;
     }
 
-    if (size == meta->size)
+    // 控制文件没有内容，O_TRUNC 打开时忽略
+    if (meta->type == FT_CONTROL)
     {
         return 0;
     }
 
-    // 调整数据缓冲区大小
-    // 简化实现：只更新文件大小，不管理实际数据
-    // 实际项目应该使用数据块管理
-
-    meta->size = size;
-    meta->blocks = (size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
-
-    // 更新修改时间
-    clock_gettime(CLOCK_REALTIME, &meta->mtime);
+    if (size == meta->size)
+    {
+        return 0;
+    }
 
-    return 0;
+    // 缩小时释放末尾的数据块，扩大部分为空洞
+    return file_truncate(meta, size);
 }
 
 // 打开文件
 static int smartbackupfs_open(const char *path, struct fuse_file_info *fi)
 {
-    file_metadata_t *meta = lookup_path(path);
+    // 版本视图（filename@vN）也可打开，句柄持有视图引用直到release
+    file_metadata_t *meta = lookup_path_ref(path);
     if (!meta)
     {
         return -ENOENT;
     }
 
+    int ret = 0;
     if (S_ISDIR(meta->mode))
     {
-        return -EISDIR;
+        ret = -EISDIR;
+    }
+    else if (meta->type == FT_VERSIONED && (fi->flags & O_ACCMODE) != O_RDONLY)
+    {
+        ret = -EROFS;
+    }
+    // 控制文件仅限挂载用户与root
+    else if (meta->type == FT_CONTROL && fuse_get_context()->uid != 0 &&
+             fuse_get_context()->uid != meta->uid)
+    {
+        ret = -EACCES;
     }
-
     // 检查访问权限
-    if ((fi->flags & O_ACCMODE) == O_RDONLY)
+    else if ((fi->flags & O_ACCMODE) == O_RDONLY)
     {
         if (!(meta->mode & S_IRUSR))
         {
-            return -EACCES;
+            ret = -EACCES;
         }
     }
     else if ((fi->flags & O_ACCMODE) == O_WRONLY ||
@@ -658,9 +643,30 @@ static int smartbackupfs_open(const char *path, struct fuse_file_info *fi)
     {
         if (!(meta->mode & S_IWUSR))
         {
-            return -EACCES;
+            ret = -EACCES;
         }
     }
+    if (ret != 0)
+    {
+        lookup_path_put(meta);
+        return ret;
+    }
+
+    // 分配文件句柄，后续读写直接使用缓存的元数据与块映射
+    file_handle_t *fh = file_handle_open(meta, fi->flags);
+    if (!fh)
+    {
+        lookup_path_put(meta);
+        return -ENOMEM;
+    }
+    fi->fh = (uint64_t)(uintptr_t)fh;
+
+    // 控制文件的响应按会话顺序读取：绕过页缓存，禁止定位
+    if (fh->ctl)
+    {
+        fi->direct_io = 1;
+        fi->nonseekable = 1;
+    }
 
     // 更新访问时间
     clock_gettime(CLOCK_REALTIME, &meta->atime);
@@ -672,35 +678,83 @@ static int smartbackupfs_open(const char *path, struct fuse_file_info *fi)
 static int smartbackupfs_read(const char *path, char *buf, size_t size,
                               off_t offset, struct fuse_file_info *fi)
 {
-    (void)fi;
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    if (fh && fh->map)
+    {
+        return file_handle_read(fh, buf, size, offset);
+    }
+    if (fh && fh->meta->type == FT_VERSIONED)
+    {
+        return version_manager_read_version_data(fh->meta, buf, size, offset);
+    }
+    if (fh && fh->ctl)
+    {
+        return ctl_session_read(fh->ctl, buf, size);
+    }
 
-    file_metadata_t *meta = lookup_path(path);
+    // 无句柄时按路径解析
+    file_metadata_t *meta = lookup_path_ref(path);
     if (!meta)
     {
         return -ENOENT;
     }
 
+    int ret;
     if (S_ISDIR(meta->mode))
     {
-        return -EISDIR;
+        ret = -EISDIR;
     }
-
-    if (meta->type == FT_VERSIONED)
+    else if (meta->type == FT_VERSIONED)
+    {
+        ret = version_manager_read_version_data(meta, buf, size, offset);
+    }
+    else
     {
-        return version_manager_read_version_data(meta, buf, size, offset);
+        // 使用高性能读取函数
+        ret = smart_read_file(meta, buf, size, offset);
     }
+    lookup_path_put(meta);
+    return ret;
+}
 
-    // 使用高性能读取函数
-    return smart_read_file(meta, buf, size, offset);
+// 写入完成后的版本策略与WAL记录（head 为写入数据的开头部分）
+static void smartbackupfs_write_done(const char *path, file_metadata_t *meta,
+                                     const char *head, size_t head_len,
+                                     size_t size, off_t offset)
+{
+    /* 变化策略：块级差异 >10% 触发版本 */
+    version_manager_maybe_change_snapshot(meta);
+
+    // 记录文件写入事务
+    if (module_d_state.wal_enabled) {
+        uint64_t tx_id = md_transaction_begin(TX_WRITE_DATA);
+        transaction_header_t header;
+        header.tx_id = tx_id;
+        header.type = TX_WRITE_DATA;
+        header.state = TX_COMMITTED;
+        header.timestamp = time(NULL);
+        header.ino = meta->ino;
+        header.block_id = (uint64_t)(offset / 4096); // 计算块ID
+        header.data_size = size;
+        header.checksum = 0;
+        md_transaction_log(tx_id, &header, sizeof(header));
+        md_transaction_log(tx_id, head, head_len > 1024 ? 1024 : head_len); // 记录前1KB数据
+        md_transaction_commit(tx_id);
+        SBFS_LOG_DEBUG("模块D：记录文件写入事务 %lu，文件: %s，大小: %zu", tx_id, path, size);
+    }
 }
 
 // 写入文件
 static int smartbackupfs_write(const char *path, const char *buf, size_t size,
                                off_t offset, struct fuse_file_info *fi)
 {
-    (void)fi;
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    if (fh && fh->ctl)
+    {
+        return ctl_session_write(fh->ctl, buf, size);
+    }
 
-    file_metadata_t *meta = lookup_path(path);
+    file_metadata_t *meta = (fh && fh->map) ? fh->meta : lookup_path(path);
     if (!meta)
     {
         return -ENOENT;
@@ -711,192 +765,351 @@ static int smartbackupfs_write(const char *path, const char *buf, size_t size,
         return -EISDIR;
     }
 
-    // 使用高性能写入函数
-    int ret = smart_write_file(meta, buf, size, offset);
+    // 使用高性能写入函数（有句柄时跳过块映射解析）
+    int ret = (fh && fh->map) ? file_handle_write(fh, buf, size, offset)
+                              : smart_write_file(meta, buf, size, offset);
     if (ret >= 0)
     {
-        /* 变化策略：块级差异 >10% 触发版本 */
-        version_manager_maybe_change_snapshot(meta);
-        
-        // 记录文件写入事务
-        if (module_d_state.wal_enabled) {
-            uint64_t tx_id = md_transaction_begin(TX_WRITE_DATA);
-            transaction_header_t header;
-            header.tx_id = tx_id;
-            header.type = TX_WRITE_DATA;
-            header.state = TX_COMMITTED;
-            header.timestamp = time(NULL);
-            header.ino = meta->ino;
-            header.block_id = (uint64_t)(offset / 4096); // 计算块ID
-            header.data_size = size;
-            header.checksum = 0;
-            md_transaction_log(tx_id, &header, sizeof(header));
-            md_transaction_log(tx_id, buf, size > 1024 ? 1024 : size); // 记录前1KB数据
-            md_transaction_commit(tx_id);
-            printf("模块D：记录文件写入事务 %lu，文件: %s，大小: %zu\n", tx_id, path, size);
-        }
+        smartbackupfs_write_done(path, meta, buf, size, size, offset);
     }
     return ret;
 }
 
-// 同步文件
-static int smartbackupfs_fsync(const char *path, int isdatasync,
-                               struct fuse_file_info *fi)
+// fuse_bufvec 填充：数据从内核缓冲或splice管道直接拷入块存储，并保留开头部分
+int smartbackupfs_bufvec_fill(void *ctx, char *dst, size_t len)
 {
-    (void)path;
-    (void)isdatasync;
-    (void)fi;
+    bufvec_fill_ctx_t *fill = ctx;
+    struct fuse_bufvec dst_buf = FUSE_BUFVEC_INIT(len);
+    dst_buf.buf[0].mem = dst;
+
+    ssize_t copied = fuse_buf_copy(&dst_buf, fill->src, 0);
+    if (copied < 0)
+        return (int)copied;
+    if ((size_t)copied != len)
+        return -EIO;
 
-    // 在这个内存文件系统中，fsync操作直接返回成功
-    // 在实际项目中，这里应该将数据写入持久化存储
+    if (fill->head_len < BUFVEC_FILL_HEAD)
+    {
+        size_t n = BUFVEC_FILL_HEAD - fill->head_len;
+        if (n > len)
+            n = len;
+        memcpy(fill->head + fill->head_len, dst, n);
+        fill->head_len += n;
+    }
     return 0;
 }
 
-// 读取目录
-static int smartbackupfs_readdir(const char *path, void *buf,
-                                 fuse_fill_dir_t filler, off_t offset,
-                                 struct fuse_file_info *fi,
-                                 enum fuse_readdir_flags flags)
+// 写入文件（fuse_bufvec）：启用splice读时数据可直接由管道落入块存储
+static int smartbackupfs_write_buf(const char *path, struct fuse_bufvec *buf,
+                                   off_t offset, struct fuse_file_info *fi)
 {
-    (void)offset;
-    (void)fi;
-    (void)flags;
-
-    fprintf(stderr, "READDIR: path='%s'\n", path);
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    size_t size = fuse_buf_size(buf);
 
-    // 支持 filename@versions 路径，列出版本
-    if (strstr(path, "@versions") != NULL)
+    if (!fh || !fh->map)
     {
-        // 解析基础路径（去掉@versions部分）
-        char *path_copy = strdup(path);
-        char *at = strrchr(path_copy, '@');
-        if (at)
-            *at = '\0';
+        // 无普通文件句柄：汇集到临时缓冲后走普通写入
+        char *tmp = malloc(size ? size : 1);
+        if (!tmp)
+            return -ENOMEM;
+        struct fuse_bufvec dst_buf = FUSE_BUFVEC_INIT(size);
+        dst_buf.buf[0].mem = tmp;
+        ssize_t copied = fuse_buf_copy(&dst_buf, buf, 0);
+        int ret = copied < 0 ? (int)copied
+                             : smartbackupfs_write(path, tmp, (size_t)copied, offset, fi);
+        free(tmp);
+        return ret;
+    }
+
+    bufvec_fill_ctx_t ctx;
+    ctx.src = buf;
+    ctx.head_len = 0;
+    int ret = file_handle_write_fill(fh, size, offset, smartbackupfs_bufvec_fill, &ctx);
+    if (ret >= 0)
+    {
+        smartbackupfs_write_done(path, fh->meta, ctx.head, ctx.head_len, (size_t)ret, offset);
+    }
+    return ret;
+}
 
-        file_metadata_t *base = lookup_path(path_copy);
-        free(path_copy);
-        if (!base)
-            return -ENOENT;
+// 区间拷贝：块对齐部分共享数据块，不经过用户态缓冲
+static ssize_t smartbackupfs_copy_file_range(const char *path_in, struct fuse_file_info *fi_in,
+                                             off_t offset_in, const char *path_out,
+                                             struct fuse_file_info *fi_out, off_t offset_out,
+                                             size_t size, int flags)
+{
+    if (flags != 0)
+        return -EINVAL;
 
-        char **list = NULL;
-        size_t count = 0;
-        if (version_manager_list_versions(base, &list, &count) == 0)
-        {
-            // 列表中每个版本作为目录项返回
-            for (size_t i = 0; i < count; i++)
-            {
-                filler(buf, list[i], NULL, 0, 0);
-                free(list[i]);
-            }
-            free(list);
-            return 0;
-        }
-        return 0;
-    }
+    file_handle_t *fh_in = fi_in ? (file_handle_t *)(uintptr_t)fi_in->fh : NULL;
+    file_handle_t *fh_out = fi_out ? (file_handle_t *)(uintptr_t)fi_out->fh : NULL;
+    file_metadata_t *src = fh_in ? fh_in->meta : lookup_path(path_in);
+    file_metadata_t *dst = fh_out ? fh_out->meta : lookup_path(path_out);
+    if (!src || !dst)
+        return -ENOENT;
 
-    // 添加标准目录项
-    filler(buf, ".", NULL, 0, 0);
-    filler(buf, "..", NULL, 0, 0);
+    ssize_t ret = file_clone_range(src, offset_in, dst, offset_out, size);
+    if (ret > 0)
+    {
+        version_manager_maybe_change_snapshot(dst);
+    }
+    return ret;
+}
 
-    // 查找目录
-    file_metadata_t *meta = lookup_path(path);
+// 预分配/打洞
+static int smartbackupfs_fallocate(const char *path, int mode, off_t offset, off_t length,
+                                   struct fuse_file_info *fi)
+{
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    file_metadata_t *meta = fh ? fh->meta : lookup_path(path);
     if (!meta)
     {
-        fprintf(stderr, "READDIR: directory not found for path '%s'\n", path);
         return -ENOENT;
     }
 
-    if (meta->type != FT_DIRECTORY)
+    int ret = file_fallocate(meta, mode, offset, length);
+    if (ret == 0)
     {
-        fprintf(stderr, "READDIR: path '%s' is not a directory\n", path);
-        return -ENOTDIR;
+        version_manager_maybe_change_snapshot(meta);
     }
+    return ret;
+}
 
-    // 直接将元数据转换为目录结构
-    directory_t *dir = (directory_t *)meta;
-    fprintf(stderr, "READDIR: found directory '%s', entries count\n", path);
-
-    // 添加目录中的文件
-    pthread_rwlock_rdlock(&dir->lock);
-    dir_entry_t *entry = dir->entries;
-    int count = 0;
-    while (entry)
+// SEEK_DATA/SEEK_HOLE：由块映射直接回答，稀疏感知的工具可跳过空洞
+static off_t smartbackupfs_lseek(const char *path, off_t off, int whence,
+                                 struct fuse_file_info *fi)
+{
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    file_metadata_t *meta = fh ? fh->meta : lookup_path(path);
+    if (!meta)
     {
-        fprintf(stderr, "READDIR: adding entry '%s'\n", entry->name);
-        filler(buf, entry->name, NULL, 0, 0);
-        entry = entry->next;
-        count++;
+        return -ENOENT;
     }
-    pthread_rwlock_unlock(&dir->lock);
-
-    fprintf(stderr, "READDIR: path '%s' had %d entries\n", path, count);
-    return 0;
+    return file_seek_data(meta, off, whence);
 }
 
-// 访问权限检查
-static int smartbackupfs_access(const char *path, int mask)
+// 同步文件
+static int smartbackupfs_fsync(const char *path, int isdatasync,
+                               struct fuse_file_info *fi)
 {
-    file_metadata_t *meta = lookup_path(path);
+    (void)isdatasync;
+
+    // 封存写回缓冲中的脏块；启用段存储时再把已追加的块记录落盘
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    file_metadata_t *meta = fh ? fh->meta : lookup_path(path);
     if (!meta)
     {
-        // 如果文件不存在，但是要创建，检查父目录
-        char *path_copy = strdup(path);
-        char *last_slash = strrchr(path_copy, '/');
-        if (last_slash && last_slash != path_copy)
-        {
-            *last_slash = '\0';
-            file_metadata_t *parent = lookup_path(path_copy);
-            free(path_copy);
-            if (parent && parent->type == FT_DIRECTORY)
-            {
-                return 0; // 父目录存在且可访问
-            }
-        }
-        if (path_copy)
-            free(path_copy);
         return -ENOENT;
     }
+    return file_sync(meta);
+}
+
+// 打开目录：分配readdir游标，供分批读取时O(1)续读
+static int smartbackupfs_opendir(const char *path, struct fuse_file_info *fi)
+{
+    (void)path;
 
-    // 简化的权限检查
-    // 实际实现需要根据mask检查具体的读/写/执行权限
+    dir_cursor_t *cursor = calloc(1, sizeof(dir_cursor_t));
+    if (!cursor)
+        return -ENOMEM;
+    fi->fh = (uint64_t)(uintptr_t)cursor;
     return 0;
 }
 
-// 创建文件
-static int smartbackupfs_create(const char *path, mode_t mode,
-                                struct fuse_file_info *fi)
+static int smartbackupfs_releasedir(const char *path, struct fuse_file_info *fi)
 {
-    // 添加调试信息
-    fprintf(stderr, "CREATE: path='%s', mode=0%o\n", path, mode);
+    (void)path;
 
-    // 检查文件是否已存在
-    if (lookup_path(path))
-    {
-        fprintf(stderr, "CREATE: file already exists\n");
-        return -EEXIST;
-    }
+    free((dir_cursor_t *)(uintptr_t)fi->fh);
+    fi->fh = 0;
+    return 0;
+}
 
-    // 获取父目录和文件名
-    char *child_name = NULL;
-    directory_t *parent_dir = get_parent_directory(path, &child_name);
-    if (!parent_dir || !child_name)
+// filename@versions 的列举状态
+typedef struct {
+    void *buf;
+    fuse_fill_dir_t filler;
+    enum fuse_fill_dir_flags fill_flags;
+    const file_metadata_t *base;
+} versions_fill_ctx_t;
+
+// 版本目录项偏移：版本按ID降序列出，偏移随ID减小而增大，续读时跳过ID不小于上次返回的版本
+#define VERSIONS_COOKIE(vid) ((off_t)(DIR_COOKIE_FIRST + VERSION_INO_VID_MAX - (vid)))
+#define VERSIONS_COOKIE_VID(off) ((uint64_t)(DIR_COOKIE_FIRST + VERSION_INO_VID_MAX - (off)))
+
+static int versions_fill_entry(void *ctx, const char *name, uint64_t vino, uint64_t version_id,
+                               off_t size, time_t create_time)
+{
+    versions_fill_ctx_t *fill = ctx;
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_ino = vino;
+    st.st_mode = S_IFREG | (fill->base->mode & 0555);
+    if (fill->fill_flags & FUSE_FILL_DIR_PLUS)
+    {
+        st.st_nlink = 1;
+        st.st_uid = fill->base->uid;
+        st.st_gid = fill->base->gid;
+        st.st_size = size;
+        st.st_mtim.tv_sec = create_time;
+        st.st_ctim = st.st_mtim;
+        st.st_atim = fill->base->atime;
+    }
+    return fill->filler(fill->buf, name, &st, VERSIONS_COOKIE(version_id), fill->fill_flags);
+}
+
+// 列出 filename@versions：直接在版本链读锁下逐项填充，不构造中间列表
+static int smartbackupfs_readdir_versions(const char *path, void *buf, fuse_fill_dir_t filler,
+                                          off_t offset, enum fuse_readdir_flags flags)
+{
+    // 解析基础路径（去掉@versions部分）
+    char *path_copy = strdup(path);
+    if (!path_copy)
+        return -ENOMEM;
+    path_copy[strlen(path_copy) - strlen("@versions")] = '\0';
+    file_metadata_t *base = lookup_path(path_copy);
+    free(path_copy);
+    if (!base)
+        return -ENOENT;
+
+    versions_fill_ctx_t fill = {
+        .buf = buf,
+        .filler = filler,
+        .fill_flags = (flags & FUSE_READDIR_PLUS) ? FUSE_FILL_DIR_PLUS : 0,
+        .base = base,
+    };
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_mode = S_IFDIR;
+    if (offset < DIR_COOKIE_DOT && filler(buf, ".", &st, DIR_COOKIE_DOT, 0))
+        return 0;
+    if (offset < DIR_COOKIE_DOTDOT && filler(buf, "..", &st, DIR_COOKIE_DOTDOT, 0))
+        return 0;
+
+    if (offset > VERSIONS_COOKIE(1))
+        return 0; // 版本1之后没有更多目录项
+    uint64_t below = offset >= DIR_COOKIE_FIRST ? VERSIONS_COOKIE_VID(offset) : 0;
+    version_manager_for_each_version(base, below, versions_fill_entry, &fill);
+    return 0;
+}
+
+// 读取目录
+// 偏移量为目录项cookie：'.'为1，'..'为2，其余目录项插入时分配且不随重命名改变，
+// 缓冲区填满时停止，内核以最后返回的cookie续读
+static int smartbackupfs_readdir(const char *path, void *buf,
+                                 fuse_fill_dir_t filler, off_t offset,
+                                 struct fuse_file_info *fi,
+                                 enum fuse_readdir_flags flags)
+{
+    // 支持 filename@versions 路径，列出版本
+    if (is_versions_dir_path(path))
     {
-        fprintf(stderr, "CREATE: failed to get parent directory for '%s'\n", path);
-        if (child_name)
-            free(child_name);
+        return smartbackupfs_readdir_versions(path, buf, filler, offset, flags);
+    }
+
+    // 查找目录
+    file_metadata_t *meta = lookup_path(path);
+    if (!meta)
+    {
+        return -ENOENT;
+    }
+
+    if (meta->type != FT_DIRECTORY)
+    {
+        return -ENOTDIR;
+    }
+
+    directory_t *dir = (directory_t *)meta;
+    dir_cursor_t *cursor = fi ? (dir_cursor_t *)(uintptr_t)fi->fh : NULL;
+
+    // READDIRPLUS：直接由目录项元数据填充属性，省去逐项getattr
+    bool plus = (flags & FUSE_READDIR_PLUS) != 0;
+    enum fuse_fill_dir_flags fill_flags = plus ? FUSE_FILL_DIR_PLUS : 0;
+    struct stat st;
+    dir_entry_t *last = NULL;
+
+    pthread_rwlock_rdlock(&dir->lock);
+
+    // 添加标准目录项
+    if (offset < DIR_COOKIE_DOT)
+    {
+        memset(&st, 0, sizeof(st));
+        fill_stat_from_meta(&dir->meta, &st);
+        if (filler(buf, ".", &st, DIR_COOKIE_DOT, fill_flags))
+            goto full;
+    }
+    if (offset < DIR_COOKIE_DOTDOT)
+    {
+        memset(&st, 0, sizeof(st));
+        st.st_mode = S_IFDIR;
+        if (filler(buf, "..", &st, DIR_COOKIE_DOTDOT, 0))
+            goto full;
+    }
+
+    for (dir_entry_t *entry = directory_seek_locked(dir, cursor, (uint64_t)offset);
+         entry; entry = entry->next)
+    {
+        memset(&st, 0, sizeof(st));
+        if (plus)
+            fill_stat_from_meta(entry->meta, &st);
+        else
+            st.st_mode = entry->meta->mode;
+        if (filler(buf, entry->name, &st, (off_t)entry->cookie, fill_flags))
+            break;
+        last = entry;
+    }
+    if (last)
+        directory_cursor_save_locked(cursor, dir, last, last->cookie);
+
+full:
+    pthread_rwlock_unlock(&dir->lock);
+    return 0;
+}
+
+// 访问权限检查
+static int smartbackupfs_access(const char *path, int mask)
+{
+    file_metadata_t *meta = lookup_path_ref(path);
+    if (!meta)
+    {
+        // 如果文件不存在，但是要创建，检查父目录
+        char *path_copy = strdup(path);
+        if (!path_copy)
+            return -ENOMEM;
+        char *last_slash = strrchr(path_copy, '/');
+        file_metadata_t *parent = NULL;
+        if (last_slash && last_slash != path_copy)
+        {
+            *last_slash = '\0';
+            parent = lookup_path(path_copy);
+        }
+        free(path_copy);
+        if (parent && parent->type == FT_DIRECTORY)
+        {
+            return 0; // 父目录存在且可访问
+        }
         return -ENOENT;
     }
 
-    // 分配新的inode
-    pthread_mutex_lock(&fs_state.ino_mutex);
-    ino_t new_ino = fs_state.next_ino++;
-    pthread_mutex_unlock(&fs_state.ino_mutex);
+    // 简化的权限检查：版本视图只读，其余按mask放行
+    int ret = (meta->type == FT_VERSIONED && (mask & W_OK)) ? -EROFS : 0;
+    lookup_path_put(meta);
+    return ret;
+}
+
+// 创建文件
+static int smartbackupfs_create(const char *path, mode_t mode,
+                                struct fuse_file_info *fi)
+{
+    // 添加调试信息
+    SBFS_LOG_DEBUG("CREATE: path='%s', mode=0%o", path, mode);
 
     // 创建文件元数据
-    file_metadata_t *new_file = malloc(sizeof(file_metadata_t));
-    memset(new_file, 0, sizeof(file_metadata_t));
+    file_metadata_t *new_file = calloc(1, sizeof(file_metadata_t));
+    if (!new_file)
+        return -ENOMEM;
 
-    new_file->ino = new_ino;
+    new_file->ino = inode_alloc_ino();
     new_file->mode = S_IFREG | (mode & 07777);
     new_file->nlink = 1;
     new_file->uid = fuse_get_context()->uid;
@@ -908,33 +1121,19 @@ static int smartbackupfs_create(const char *path, mode_t mode,
     new_file->mtime = new_file->atime;
     new_file->ctime = new_file->atime;
 
-    // 创建目录项
-    dir_entry_t *new_entry = malloc(sizeof(dir_entry_t));
-    new_entry->name = strdup(child_name);
-    new_entry->meta = new_file;
-    new_entry->next = NULL;
-
-    free(child_name);
-
-    // 添加到正确的父目录
-    pthread_rwlock_wrlock(&parent_dir->lock);
-    if (parent_dir->entries)
-    {
-        dir_entry_t *last = parent_dir->entries;
-        while (last->next)
-            last = last->next;
-        last->next = new_entry;
-    }
-    else
+    // 登记到inode表并添加到正确的父目录（已存在或父目录不存在时失败）
+    int ret = inode_table_insert(new_file);
+    if (ret == 0)
+        ret = attach_new_node(path, new_file);
+    if (ret != 0)
     {
-        parent_dir->entries = new_entry;
+        SBFS_LOG_DEBUG("CREATE: '%s' 创建失败: %s", path, strerror(-ret));
+        inode_table_remove(new_file);
+        free(new_file);
+        return ret;
     }
-    pthread_rwlock_unlock(&parent_dir->lock);
-
-    // 添加到缓存
-    cache_set(new_file->ino, new_file);
 
-    fs_state.total_files++;
+    FS_STAT_ADD(total_files, 1);
 
         // 记录文件创建事务
         if (module_d_state.wal_enabled) {
@@ -951,16 +1150,19 @@ static int smartbackupfs_create(const char *path, mode_t mode,
             md_transaction_log(tx_id, &header, sizeof(header));
             md_transaction_log(tx_id, path, strlen(path) + 1);
             md_transaction_commit(tx_id);
-            printf("模块D：记录文件创建事务 %lu，文件: %s\n", tx_id, path);
+            SBFS_LOG_DEBUG("模块D：记录文件创建事务 %lu，文件: %s", tx_id, path);
         }
 
-    // 设置文件描述符
+    // 设置文件句柄
     if (fi)
     {
-        fi->fh = (uint64_t)new_file;
+        file_handle_t *fh = file_handle_open(new_file, fi->flags);
+        if (!fh)
+            return -ENOMEM;
+        fi->fh = (uint64_t)(uintptr_t)fh;
     }
 
-    fprintf(stderr, "CREATE: successfully created file '%s'\n", path);
+    SBFS_LOG_DEBUG("CREATE: successfully created file '%s'", path);
     return 0;
 }
 
@@ -1018,10 +1220,11 @@ static int smartbackupfs_utimens(const char *path, const struct timespec ts[2],
 static int smartbackupfs_flush(const char *path, struct fuse_file_info *fi)
 {
     (void)path;
-    (void)fi;
 
-    // 内存文件系统中，flush直接返回成功
-    // 在实际项目中，这里应该确保所有缓存数据写入存储
+    // 封存写回缓冲中的脏块（release 时句柄释放也会封存）
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    if (fh && fh->map)
+        return file_writeback(fh->meta);
     return 0;
 }
 
@@ -1029,41 +1232,22 @@ static int smartbackupfs_flush(const char *path, struct fuse_file_info *fi)
 static int smartbackupfs_release(const char *path, struct fuse_file_info *fi)
 {
     (void)path;
-    (void)fi;
 
     // 清理文件句柄相关资源
+    file_handle_release((file_handle_t *)(uintptr_t)fi->fh);
+    fi->fh = 0;
     return 0;
 }
 
 // 创建符号链接
 static int smartbackupfs_symlink(const char *target, const char *linkpath)
 {
-    // 检查链接是否已存在
-    if (lookup_path(linkpath))
-    {
-        return -EEXIST;
-    }
-
-    // 获取父目录和链接名
-    char *child_name = NULL;
-    directory_t *parent_dir = get_parent_directory(linkpath, &child_name);
-    if (!parent_dir || !child_name)
-    {
-        if (child_name)
-            free(child_name);
-        return -ENOENT;
-    }
-
-    // 分配新的inode
-    pthread_mutex_lock(&fs_state.ino_mutex);
-    ino_t new_ino = fs_state.next_ino++;
-    pthread_mutex_unlock(&fs_state.ino_mutex);
-
     // 创建符号链接元数据
-    file_metadata_t *new_link = malloc(sizeof(file_metadata_t));
-    memset(new_link, 0, sizeof(file_metadata_t));
+    file_metadata_t *new_link = calloc(1, sizeof(file_metadata_t));
+    if (!new_link)
+        return -ENOMEM;
 
-    new_link->ino = new_ino;
+    new_link->ino = inode_alloc_ino();
     new_link->type = FT_SYMLINK;
     new_link->mode = S_IFLNK | 0777;
     new_link->nlink = 1;
@@ -1075,37 +1259,28 @@ static int smartbackupfs_symlink(const char *target, const char *linkpath)
     new_link->mtime = new_link->atime;
     new_link->ctime = new_link->atime;
 
-    // 存储目标路径作为扩展属性
-    new_link->xattr = strdup(target);
-    new_link->xattr_size = strlen(target) + 1;
-
-    // 创建目录项
-    dir_entry_t *new_entry = malloc(sizeof(dir_entry_t));
-    new_entry->name = strdup(child_name);
-    new_entry->meta = new_link;
-    new_entry->next = NULL;
-
-    free(child_name);
-
-    // 添加到正确的父目录
-    pthread_rwlock_wrlock(&parent_dir->lock);
-    if (parent_dir->entries)
+    // 目标路径存放在冷区
+    file_meta_ext_t *ext = file_meta_ext_get(new_link);
+    if (!ext || !(ext->link_target = strdup(target)))
     {
-        dir_entry_t *last = parent_dir->entries;
-        while (last->next)
-            last = last->next;
-        last->next = new_entry;
+        file_meta_ext_free(new_link);
+        free(new_link);
+        return -ENOMEM;
     }
-    else
+
+    // 登记到inode表并添加到正确的父目录
+    int ret = inode_table_insert(new_link);
+    if (ret == 0)
+        ret = attach_new_node(linkpath, new_link);
+    if (ret != 0)
     {
-        parent_dir->entries = new_entry;
+        inode_table_remove(new_link);
+        file_meta_ext_free(new_link);
+        free(new_link);
+        return ret;
     }
-    pthread_rwlock_unlock(&parent_dir->lock);
 
-    // 添加到缓存
-    cache_set(new_link->ino, new_link);
-
-    fs_state.total_files++;
+    FS_STAT_ADD(total_files, 1);
 
     return 0;
 }
@@ -1124,18 +1299,19 @@ static int smartbackupfs_readlink(const char *path, char *buf, size_t size)
         return -EINVAL;
     }
 
-    if (!meta->xattr)
+    const char *target = file_meta_ext(meta)->link_target;
+    if (!target)
     {
         return -ENODATA;
     }
 
-    size_t target_len = strlen(meta->xattr);
+    size_t target_len = strlen(target);
     if (size > 0)
     {
         size_t copy_len = (target_len < size) ? target_len : size - 1;
         if (copy_len > 0)
         {
-            memcpy(buf, meta->xattr, copy_len);
+            memcpy(buf, target, copy_len);
         }
         // 如果缓冲区足够大，添加null终止符（FUSE要求）
         if (copy_len < size)
@@ -1160,721 +1336,688 @@ static int smartbackupfs_link(const char *oldpath, const char *newpath)
         return -EPERM; // 不能对目录创建硬链接
     }
 
-    // 检查目标是否已存在
-    if (lookup_path(newpath))
-    {
-        return -EEXIST;
-    }
-
-    // 获取目标父目录和链接名
-    char *child_name = NULL;
-    directory_t *parent_dir = get_parent_directory(newpath, &child_name);
-    if (!parent_dir || !child_name)
-    {
-        if (child_name)
-            free(child_name);
-        return -ENOENT;
-    }
-
-    // 创建新的目录项
-    dir_entry_t *new_entry = malloc(sizeof(dir_entry_t));
-    new_entry->name = strdup(child_name);
-    new_entry->meta = src_meta; // 指向相同的元数据
-    new_entry->next = NULL;
-
-    free(child_name);
-
-    // 添加到正确的父目录
-    pthread_rwlock_wrlock(&parent_dir->lock);
-    if (parent_dir->entries)
-    {
-        dir_entry_t *last = parent_dir->entries;
-        while (last->next)
-            last = last->next;
-        last->next = new_entry;
-    }
-    else
+    // 创建新的目录项（指向相同的元数据）并挂入目标父目录
+    int ret = attach_new_node(newpath, src_meta);
+    if (ret != 0)
     {
-        parent_dir->entries = new_entry;
+        return ret;
     }
 
     // 增加链接数
     src_meta->nlink++;
     clock_gettime(CLOCK_REALTIME, &src_meta->ctime);
 
-    // 更新父目录修改时间
-    clock_gettime(CLOCK_REALTIME, &parent_dir->meta.mtime);
-    parent_dir->meta.ctime = parent_dir->meta.mtime;
+    return 0;
+}
 
-    pthread_rwlock_unlock(&parent_dir->lock);
+// ---------------------------------------------------------------------------
+// 扩展属性：按名称查表分发（路径前端、inode前端与控制通道共用）
+
+// 取值：返回值长度（不含NUL）并令 *out 指向值，或返回负errno
+typedef int (*xattr_get_fn)(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                            const char **out);
+// 设置/删除：成功返回0（由分发函数更新ctime），失败返回负errno
+typedef int (*xattr_set_fn)(file_metadata_t *meta, const char *name, const char *value,
+                            size_t size);
+typedef int (*xattr_remove_fn)(file_metadata_t *meta);
+
+#define XATTR_F_LIST 0x1   // 出现在 listxattr 结果中
+#define XATTR_F_RDONLY 0x2 // 只读：set/remove 返回 EPERM
+
+typedef struct {
+    const char *name;
+    unsigned flags;
+    const char *fixed;       // 固定取值（get 为NULL时使用）
+    xattr_get_fn get;
+    xattr_set_fn set;
+    xattr_remove_fn remove;
+    bool (*present)(const file_metadata_t *meta); // 非NULL时仅在返回真时列出
+} xattr_handler_t;
+
+#define XATTR_SCRATCH_SIZE 2048
+
+// 将属性值复制为以NUL结尾的字符串（超长截断）
+static const char *xattr_value_str(const char *value, size_t size, char *tmp, size_t tmp_size)
+{
+    size_t copy = size < tmp_size ? size : tmp_size - 1;
+    if (!value)
+        copy = 0;
+    memcpy(tmp, value ? value : "", copy);
+    tmp[copy] = '\0';
+    return tmp;
+}
 
-    return 0;
+// 开关类属性：缺省或非'0'开头视为开启
+static bool xattr_value_flag(const char *value, size_t size)
+{
+    return !(value && size > 0 && value[0] == '0');
 }
 
-// 获取扩展属性
-static int smartbackupfs_getxattr(const char *path, const char *name, char *value,
-                                  size_t size)
+static void xattr_dedup_commit(void)
 {
-    file_metadata_t *meta = lookup_path(path);
-    if (!meta)
-    {
-        return -ENOENT;
-    }
+    dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
+                        dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
+}
 
-    if (strcmp(name, "user.comment") == 0)
-    {
-        if (!meta->xattr)
-        {
-            return -ENODATA;
-        }
+// 解析 "v<ID>" / "<ID>" 形式的版本号
+static uint64_t xattr_value_version(const char *value, size_t size)
+{
+    if (!value || size == 0)
+        return 0;
+    char buf[32];
+    const char *vstr = xattr_value_str(value, size, buf, sizeof(buf));
+    if (vstr[0] == 'v')
+        vstr++;
+    return strtoull(vstr, NULL, 10);
+}
 
-        size_t attr_len = strlen(meta->xattr) + 1;
-        if (size == 0)
-        {
-            return attr_len;
-        }
+/* user.comment */
+static bool xattr_comment_present(const file_metadata_t *meta)
+{
+    return file_meta_ext(meta)->comment != NULL;
+}
 
-        if (size < attr_len)
-        {
-            return -ERANGE;
-        }
+static int xattr_comment_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                             const char **out)
+{
+    (void)scratch;
+    (void)scratch_size;
+    const char *comment = file_meta_ext(meta)->comment;
+    if (!comment)
+        return -ENODATA;
+    *out = comment;
+    return (int)strlen(comment);
+}
 
-        memcpy(value, meta->xattr, attr_len);
-        return attr_len;
-    }
+static int xattr_comment_set(file_metadata_t *meta, const char *name, const char *value,
+                             size_t size)
+{
+    (void)name;
+    file_meta_ext_t *ext = file_meta_ext_get(meta);
+    char *comment = malloc(size + 1);
+    if (!ext || !comment)
+    {
+        free(comment);
+        return -ENOMEM;
+    }
+    memcpy(comment, value, size);
+    comment[size] = '\0';
+    pthread_mutex_lock(&fs_state.comment_lock);
+    free(ext->comment);
+    ext->comment = comment;
+    pthread_mutex_unlock(&fs_state.comment_lock);
+    return 0;
+}
 
-    if (strcmp(name, "user.version.pinned") == 0)
-    {
-        if (!meta->version_pinned_set)
-        {
-            return -ENODATA;
-        }
+static int xattr_comment_remove(file_metadata_t *meta)
+{
+    if (!file_meta_ext(meta)->comment)
+        return -ENODATA;
+    pthread_mutex_lock(&fs_state.comment_lock);
+    free(meta->ext->comment);
+    meta->ext->comment = NULL;
+    pthread_mutex_unlock(&fs_state.comment_lock);
+    return 0;
+}
 
-        const char *val = meta->version_pinned ? "1" : "0";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.version.max_size_mb") == 0)
-    {
-        char buf[32];
-        int n = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)fs_state.version_retention_size_mb);
-        size_t attr_len = (size_t)(n + 1);
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, buf, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.dedup.enable") == 0)
-    {
-        const char *val = dedup_config.enable_deduplication ? "1" : "0";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.compression.algo") == 0)
-    {
-        const char *val = compression_algo_to_str(dedup_config.algo);
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.compression.level") == 0)
-    {
-        char buf[16];
-        int n = snprintf(buf, sizeof(buf), "%d", dedup_config.compression_level);
-        size_t attr_len = (size_t)(n + 1);
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, buf, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.compression.min_size") == 0)
-    {
-        char buf[32];
-        int n = snprintf(buf, sizeof(buf), "%zu", dedup_config.min_compress_size);
-        size_t attr_len = (size_t)(n + 1);
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, buf, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.dedup.stats") == 0)
-    {
-        char stats[128];
-        int n = dedup_format_stats(stats, sizeof(stats));
-        if (n < 0)
-            return -EIO;
-        size_t attr_len = (size_t)n + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, stats, attr_len);
-        return attr_len;
-    }
-
-    // 模块D：数据完整性保护扩展属性
-    if (strcmp(name, "user.integrity.enable") == 0)
-    {
-        const char *val = "1"; // 默认启用
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.integrity.checksum") == 0)
-    {
-        const char *val = "checksum_ok"; // 模拟校验和
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    // 模块D：事务日志系统扩展属性
-    if (strcmp(name, "user.transaction.enable") == 0)
-    {
-        const char *val = "1"; // 默认启用
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.transaction.created") == 0 || 
-        strcmp(name, "user.transaction.modified") == 0)
-    {
-        const char *val = "transaction_logged";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    // 模块D：备份系统扩展属性
-    if (strcmp(name, "user.backup.storage_path") == 0)
-    {
-        const char *val = "/tmp/backup_default";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.backup.create") == 0 || 
-        strcmp(name, "user.backup.verified") == 0)
-    {
-        const char *val = "backup_operation_completed";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    // 模块D：系统健康监控扩展属性
-    if (strcmp(name, "user.health.monitor") == 0)
-    {
-        const char *val = "1"; // 默认启用
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.health.status") == 0)
-    {
-        const char *val = "health_ok";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    if (strcmp(name, "user.health.report") == 0 ||
-        strcmp(name, "user.integrity.scan") == 0 ||
-        strcmp(name, "user.integrity.repair") == 0 ||
-        strcmp(name, "user.orphan.cleanup") == 0 ||
-        strcmp(name, "user.crash.recovery") == 0 ||
-        strcmp(name, "user.alert.trigger") == 0 ||
-        strcmp(name, "user.alert.list") == 0 ||
-        strcmp(name, "user.performance.monitor") == 0 ||
-        strcmp(name, "user.storage.monitor") == 0 ||
-        strcmp(name, "user.cache.monitor") == 0)
-    {
-        const char *val = "operation_completed";
-        size_t attr_len = strlen(val) + 1;
-        if (size == 0)
-            return attr_len;
-        if (size < attr_len)
-            return -ERANGE;
-        memcpy(value, val, attr_len);
-        return attr_len;
-    }
-
-    return -ENODATA;
+/* user.version.* */
+static bool xattr_pinned_present(const file_metadata_t *meta)
+{
+    return file_meta_ext(meta)->version_pinned_set;
 }
 
-// 设置扩展属性
-static int smartbackupfs_setxattr(const char *path, const char *name,
-                                  const char *value, size_t size, int flags)
+static int xattr_pinned_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                            const char **out)
 {
-    file_metadata_t *meta = lookup_path(path);
-    if (!meta)
-    {
-        return -ENOENT;
-    }
+    (void)scratch;
+    (void)scratch_size;
+    const file_meta_ext_t *ext = file_meta_ext(meta);
+    if (!ext->version_pinned_set)
+        return -ENODATA;
+    *out = ext->version_pinned ? "1" : "0";
+    return 1;
+}
 
-    if (!has_write_permission(meta))
-    {
-        return -EACCES;
-    }
+static int xattr_pinned_set(file_metadata_t *meta, const char *name, const char *value,
+                            size_t size)
+{
+    (void)name;
+    file_meta_ext_t *ext = file_meta_ext_get(meta);
+    if (!ext)
+        return -ENOMEM;
+    ext->version_pinned = xattr_value_flag(value, size);
+    ext->version_pinned_set = true;
+    return 0;
+}
 
-    if (strcmp(name, "user.comment") == 0)
-    {
-        pthread_mutex_lock(&fs_state.ino_mutex);
-        if (meta->xattr)
-            free(meta->xattr);
-        meta->xattr = malloc(size + 1);
-        if (!meta->xattr)
-        {
-            pthread_mutex_unlock(&fs_state.ino_mutex);
-            return -ENOMEM;
-        }
-        memcpy(meta->xattr, value, size);
-        meta->xattr[size] = '\0';
-        meta->xattr_size = size + 1;
-        pthread_mutex_unlock(&fs_state.ino_mutex);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_pinned_remove(file_metadata_t *meta)
+{
+    if (!file_meta_ext(meta)->version_pinned_set)
+        return -ENODATA;
+    meta->ext->version_pinned = false;
+    meta->ext->version_pinned_set = false;
+    return 0;
+}
 
-    if (strcmp(name, "user.version.pinned") == 0)
-    {
-        bool pinned = true;
-        if (value && size > 0)
-        {
-            pinned = !(value[0] == '0');
-        }
-        meta->version_pinned = pinned;
-        meta->version_pinned_set = true;
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_max_size_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                              const char **out)
+{
+    (void)meta;
+    *out = scratch;
+    return snprintf(scratch, scratch_size, "%llu", (unsigned long long)fs_state.version_retention_size_mb);
+}
 
-    if (strcmp(name, "user.version.max_size_mb") == 0)
-    {
-        char tmp[32] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        uint64_t mb = strtoull(tmp, NULL, 10);
-        fs_state.version_retention_size_mb = mb;
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_max_size_set(file_metadata_t *meta, const char *name, const char *value,
+                              size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[32];
+    fs_state.version_retention_size_mb = strtoull(xattr_value_str(value, size, tmp, sizeof(tmp)), NULL, 10);
+    return 0;
+}
 
-    if (strcmp(name, "user.dedup.enable") == 0)
-    {
-        bool enable = true;
-        if (value && size > 0)
-            enable = !(value[0] == '0');
-        dedup_config.enable_deduplication = enable;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_version_create_set(file_metadata_t *meta, const char *name, const char *value,
+                                    size_t size)
+{
+    (void)name;
+    (void)value;
+    (void)size;
+    /* 手动快照触发 */
+    version_manager_create_manual(meta, "manual-xattr");
+    return 0;
+}
 
-    if (strcmp(name, "user.compression.algo") == 0)
-    {
-        char tmp[16] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        compression_algorithm_t algo = compression_algo_from_str(tmp);
-        dedup_set_compression(&dedup_config, algo, dedup_config.compression_level);
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_version_delete_set(file_metadata_t *meta, const char *name, const char *value,
+                                    size_t size)
+{
+    (void)name;
+    uint64_t vid = xattr_value_version(value, size);
+    if (vid == 0)
+        return -EINVAL;
+    return version_manager_delete_version(meta->ino, vid);
+}
 
-    if (strcmp(name, "user.compression.level") == 0)
-    {
-        char tmp[16] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        int lvl = (int)strtol(tmp, NULL, 10);
-        if (lvl < 1)
-            lvl = 1;
-        if (lvl > 9)
-            lvl = 9;
-        dedup_config.compression_level = lvl;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_version_important_set(file_metadata_t *meta, const char *name, const char *value,
+                                       size_t size)
+{
+    (void)name;
+    uint64_t vid = xattr_value_version(value, size);
+    if (vid == 0)
+        return -EINVAL;
+    return version_manager_mark_important(meta->ino, vid, true);
+}
 
-    if (strcmp(name, "user.compression.min_size") == 0)
-    {
-        char tmp[32] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        size_t min_sz = (size_t)strtoull(tmp, NULL, 10);
-        if (min_sz < 512)
-            min_sz = 512;
-        dedup_config.min_compress_size = min_sz;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_version_important_remove(file_metadata_t *meta)
+{
+    /* 默认针对最新版本取消重要标记 */
+    uint64_t latest = file_meta_ext(meta)->latest_version_id;
+    if (latest)
+        version_manager_mark_important(meta->ino, latest, false);
+    return 0;
+}
 
-    if (strcmp(name, "user.dedup.stats") == 0)
-    {
-        return -EPERM; /* 只读 */
-    }
+/* user.dedup.* / user.compression.* */
+static int xattr_dedup_enable_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                  const char **out)
+{
+    (void)meta;
+    (void)scratch;
+    (void)scratch_size;
+    *out = dedup_config.enable_deduplication ? "1" : "0";
+    return 1;
+}
 
-    if (strcmp(name, "user.version.create") == 0)
-    {
-        /* 手动快照触发 */
-        version_manager_create_manual(meta, "manual-xattr");
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_dedup_enable_set(file_metadata_t *meta, const char *name, const char *value,
+                                  size_t size)
+{
+    (void)meta;
+    (void)name;
+    dedup_config.enable_deduplication = xattr_value_flag(value, size);
+    xattr_dedup_commit();
+    return 0;
+}
 
-    if (strcmp(name, "user.version.delete") == 0)
-    {
-        if (!value || size == 0)
-            return -EINVAL;
-        char buf[32] = {0};
-        size_t copy = size < sizeof(buf) ? size : sizeof(buf) - 1;
-        memcpy(buf, value, copy);
-        char *vstr = buf;
-        if (vstr[0] == 'v')
-            vstr++;
-        uint64_t vid = strtoull(vstr, NULL, 10);
-        if (vid == 0)
-            return -EINVAL;
-        int r = version_manager_delete_version(meta->ino, vid);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return r;
-    }
-
-    if (strcmp(name, "user.version.important") == 0)
-    {
-        if (!value || size == 0)
-            return -EINVAL;
-        char buf[32] = {0};
-        size_t copy = size < sizeof(buf) ? size : sizeof(buf) - 1;
-        memcpy(buf, value, copy);
-        char *vstr = buf;
-        if (vstr[0] == 'v')
-            vstr++;
-        uint64_t vid = strtoull(vstr, NULL, 10);
-        if (vid == 0)
-            return -EINVAL;
-        int r = version_manager_mark_important(meta->ino, vid, true);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return r;
-    }
+static int xattr_dedup_enable_remove(file_metadata_t *meta)
+{
+    (void)meta;
+    dedup_config.enable_deduplication = false;
+    xattr_dedup_commit();
+    return 0;
+}
 
-    // 模块D：数据完整性保护扩展属性
-    if (strcmp(name, "user.integrity.enable") == 0 ||
-        strcmp(name, "user.integrity.scan") == 0 ||
-        strcmp(name, "user.integrity.repair") == 0)
-    {
-        bool enable = true;
-        if (value && size > 0)
-            enable = !(value[0] == '0');
-        printf("模块D：数据完整性保护 %s\n", enable ? "已启用" : "已禁用");
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_dedup_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                 const char **out)
+{
+    (void)meta;
+    int n = dedup_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    // 模块D：事务日志系统扩展属性
-    if (strcmp(name, "user.transaction.enable") == 0)
-    {
-        bool enable = true;
-        if (value && size > 0)
-            enable = !(value[0] == '0');
-        
-        // 实际启用/禁用事务日志系统
-        module_d_state.wal_enabled = enable;
-        printf("模块D：事务日志系统 %s\n", enable ? "已启用" : "已禁用");
-        
-        if (enable) {
-            // 如果启用，记录一个事务开始
-            uint64_t tx_id = md_transaction_begin(TX_METADATA_UPDATE);
-            printf("事务日志已启用，开始事务 %lu\n", tx_id);
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_cache_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                 const char **out)
+{
+    (void)meta;
+    int n = cache_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    // 模块D：备份系统扩展属性
-    if (strcmp(name, "user.backup.storage_path") == 0)
-    {
-        char tmp[256] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        printf("模块D：备份存储路径设置为 %s\n", tmp);
-        
-        // 实际设置备份存储路径
-        if (md_set_backup_storage_path(tmp) == 0) {
-            printf("备份存储路径设置成功\n");
-        } else {
-            printf("备份存储路径设置失败\n");
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_slab_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                const char **out)
+{
+    (void)meta;
+    int n = slab_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    if (strcmp(name, "user.backup.create") == 0)
-    {
-        char tmp[64] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        printf("模块D：创建备份 - %s\n", tmp);
-        
-        // 实际创建备份
-        if (md_create_backup(tmp) == 0) {
-            printf("备份创建成功: %s\n", tmp);
-        } else {
-            printf("备份创建失败\n");
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_inode_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                 const char **out)
+{
+    (void)meta;
+    int n = inode_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    // 模块D：系统健康监控扩展属性
-    if (strcmp(name, "user.health.monitor") == 0)
-    {
-        bool enable = true;
-        if (value && size > 0)
-            enable = !(value[0] == '0');
-        printf("模块D：系统健康监控 %s\n", enable ? "已启用" : "已禁用");
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_segment_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                   const char **out)
+{
+    (void)meta;
+    int n = segment_store_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    if (strcmp(name, "user.health.report") == 0)
-    {
-        char tmp[256] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        printf("模块D：生成健康报告 - %s\n", tmp);
-        
-        // 实际生成健康报告文件
-        if (md_generate_health_report(tmp) == 0) {
-            printf("健康报告已生成: %s\n", tmp);
-        } else {
-            printf("生成健康报告失败\n");
-        }
-        
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+static int xattr_container_stats_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                     const char **out)
+{
+    (void)meta;
+    int n = block_container_format_stats(scratch, scratch_size);
+    if (n < 0)
+        return -EIO;
+    *out = scratch;
+    return n;
+}
 
-    // 模块D：其他操作扩展属性
-    if (strcmp(name, "user.orphan.cleanup") == 0)
-    {
-        printf("模块D：清理孤儿数据\n");
-        md_cleanup_orphaned_data();
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
-    
-    if (strcmp(name, "user.crash.recovery") == 0)
-    {
-        printf("模块D：执行崩溃恢复\n");
-        md_crash_recovery();
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+static int xattr_compression_algo_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                      const char **out)
+{
+    (void)meta;
+    (void)scratch;
+    (void)scratch_size;
+    *out = compression_algo_to_str(dedup_config.algo);
+    return (int)strlen(*out);
+}
+
+static int xattr_compression_algo_set(file_metadata_t *meta, const char *name, const char *value,
+                                      size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[16];
+    compression_algorithm_t algo = compression_algo_from_str(xattr_value_str(value, size, tmp, sizeof(tmp)));
+    dedup_set_compression(&dedup_config, algo, dedup_config.compression_level);
+    xattr_dedup_commit();
+    return 0;
+}
+
+static int xattr_compression_algo_remove(file_metadata_t *meta)
+{
+    (void)meta;
+    dedup_set_compression(&dedup_config, COMPRESSION_NONE, dedup_config.compression_level);
+    xattr_dedup_commit();
+    return 0;
+}
+
+static int xattr_compression_level_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                       const char **out)
+{
+    (void)meta;
+    *out = scratch;
+    return snprintf(scratch, scratch_size, "%d", dedup_config.compression_level);
+}
+
+static int xattr_compression_level_set(file_metadata_t *meta, const char *name, const char *value,
+                                       size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[16];
+    int lvl = (int)strtol(xattr_value_str(value, size, tmp, sizeof(tmp)), NULL, 10);
+    if (lvl < 1)
+        lvl = 1;
+    if (lvl > 9)
+        lvl = 9;
+    dedup_config.compression_level = lvl;
+    xattr_dedup_commit();
+    return 0;
+}
+
+static int xattr_compression_level_remove(file_metadata_t *meta)
+{
+    (void)meta;
+    dedup_config.compression_level = 1;
+    xattr_dedup_commit();
+    return 0;
+}
+
+static int xattr_compression_min_size_get(file_metadata_t *meta, char *scratch, size_t scratch_size,
+                                          const char **out)
+{
+    (void)meta;
+    *out = scratch;
+    return snprintf(scratch, scratch_size, "%zu", dedup_config.min_compress_size);
+}
+
+static int xattr_compression_min_size_set(file_metadata_t *meta, const char *name, const char *value,
+                                          size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[32];
+    size_t min_sz = (size_t)strtoull(xattr_value_str(value, size, tmp, sizeof(tmp)), NULL, 10);
+    if (min_sz < 512)
+        min_sz = 512;
+    dedup_config.min_compress_size = min_sz;
+    xattr_dedup_commit();
+    return 0;
+}
+
+static int xattr_compression_min_size_remove(file_metadata_t *meta)
+{
+    (void)meta;
+    dedup_config.min_compress_size = 1024;
+    xattr_dedup_commit();
+    return 0;
+}
+
+/* 模块D */
+static int xattr_integrity_set(file_metadata_t *meta, const char *name, const char *value,
+                               size_t size)
+{
+    (void)meta;
+    (void)name;
+    SBFS_LOG_INFO("模块D：数据完整性保护 %s", xattr_value_flag(value, size) ? "已启用" : "已禁用");
+    return 0;
+}
+
+static int xattr_transaction_enable_set(file_metadata_t *meta, const char *name, const char *value,
+                                        size_t size)
+{
+    (void)meta;
+    (void)name;
+    bool enable = xattr_value_flag(value, size);
+
+    // 实际启用/禁用事务日志系统
+    module_d_state.wal_enabled = enable;
+    SBFS_LOG_INFO("模块D：事务日志系统 %s", enable ? "已启用" : "已禁用");
+
+    if (enable) {
+        // 如果启用，记录一个事务开始
+        uint64_t tx_id = md_transaction_begin(TX_METADATA_UPDATE);
+        SBFS_LOG_INFO("事务日志已启用，开始事务 %lu", tx_id);
     }
-    
-    if (strcmp(name, "user.alert.trigger") == 0)
-    {
-        char tmp[256] = {0};
-        size_t copy = size < sizeof(tmp) ? size : sizeof(tmp) - 1;
-        memcpy(tmp, value, copy);
-        printf("模块D：触发预警条件 - %s\n", tmp);
-        md_add_alert(ALERT_WARNING, "用户触发", tmp);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+    return 0;
+}
+
+static int xattr_backup_storage_path_set(file_metadata_t *meta, const char *name, const char *value,
+                                         size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[256];
+    xattr_value_str(value, size, tmp, sizeof(tmp));
+    SBFS_LOG_INFO("模块D：备份存储路径设置为 %s", tmp);
+
+    // 实际设置备份存储路径
+    if (md_set_backup_storage_path(tmp) == 0) {
+        SBFS_LOG_INFO("备份存储路径设置成功");
+    } else {
+        SBFS_LOG_WARN("备份存储路径设置失败");
     }
-    
-    if (strcmp(name, "user.performance.monitor") == 0 ||
-        strcmp(name, "user.storage.monitor") == 0 ||
-        strcmp(name, "user.cache.monitor") == 0)
-    {
-        bool enable = true;
-        if (value && size > 0)
-            enable = !(value[0] == '0');
-        printf("模块D：%s监控已%s\n", name, enable ? "启用" : "禁用");
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+    return 0;
+}
+
+static int xattr_backup_create_set(file_metadata_t *meta, const char *name, const char *value,
+                                   size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[64];
+    xattr_value_str(value, size, tmp, sizeof(tmp));
+    SBFS_LOG_INFO("模块D：创建备份 - %s", tmp);
+
+    // 实际创建备份
+    if (md_create_backup(tmp) == 0) {
+        SBFS_LOG_INFO("备份创建成功: %s", tmp);
+    } else {
+        SBFS_LOG_WARN("备份创建失败");
     }
+    return 0;
+}
 
-    return -ENOTSUP;
+static int xattr_health_monitor_set(file_metadata_t *meta, const char *name, const char *value,
+                                    size_t size)
+{
+    (void)meta;
+    (void)name;
+    SBFS_LOG_INFO("模块D：系统健康监控 %s", xattr_value_flag(value, size) ? "已启用" : "已禁用");
+    return 0;
 }
 
-// 列出扩展属性
-static int smartbackupfs_listxattr(const char *path, char *list, size_t size)
+static int xattr_health_report_set(file_metadata_t *meta, const char *name, const char *value,
+                                   size_t size)
 {
-    file_metadata_t *meta = lookup_path(path);
-    if (!meta)
-    {
-        return -ENOENT;
+    (void)meta;
+    (void)name;
+    char tmp[256];
+    xattr_value_str(value, size, tmp, sizeof(tmp));
+    SBFS_LOG_INFO("模块D：生成健康报告 - %s", tmp);
+
+    // 实际生成健康报告文件
+    if (md_generate_health_report(tmp) == 0) {
+        SBFS_LOG_INFO("健康报告已生成: %s", tmp);
+    } else {
+        SBFS_LOG_WARN("生成健康报告失败");
     }
+    return 0;
+}
 
-    const char *attrs[] = {
-        "user.comment",
-        "user.version.pinned",
-        "user.version.max_size_mb",
-        "user.dedup.enable",
-        "user.compression.algo",
-        "user.compression.level",
-        "user.compression.min_size",
-        "user.dedup.stats",
-        // 模块D：数据完整性保护扩展属性
-        "user.integrity.enable",
-        "user.integrity.checksum",
-        "user.integrity.scan",
-        "user.integrity.repair",
-        // 模块D：事务日志系统扩展属性
-        "user.transaction.enable",
-        "user.transaction.created",
-        "user.transaction.modified",
-        // 模块D：备份系统扩展属性
-        "user.backup.storage_path",
-        "user.backup.create",
-        "user.backup.verified",
-        // 模块D：系统健康监控扩展属性
-        "user.health.monitor",
-        "user.health.status",
-        "user.health.report",
-        "user.orphan.cleanup",
-        "user.crash.recovery",
-        "user.alert.trigger",
-        "user.alert.list",
-        "user.performance.monitor",
-        "user.storage.monitor",
-        "user.cache.monitor"};
-    size_t lens[28];
-    for (size_t i = 0; i < 28; i++)
-        lens[i] = strlen(attrs[i]) + 1;
+static int xattr_orphan_cleanup_set(file_metadata_t *meta, const char *name, const char *value,
+                                    size_t size)
+{
+    (void)meta;
+    (void)name;
+    (void)value;
+    (void)size;
+    SBFS_LOG_INFO("模块D：清理孤儿数据");
+    md_cleanup_orphaned_data();
+    return 0;
+}
 
-    size_t total_size = 0;
-    
-    // 基础属性（前8个）
-    if (meta->xattr)
-        total_size += lens[0];
-    if (meta->version_pinned_set)
-        total_size += lens[1];
-    
-    // version.max_size_mb 始终列出
-    total_size += lens[2];
-    
-    // 其他基础属性（3-7）
-    for (size_t i = 3; i < 8; i++)
-        total_size += lens[i];
-    
-    // 模块D属性（8-27）
-    for (size_t i = 8; i < 28; i++)
-        total_size += lens[i];
+static int xattr_segment_clean_set(file_metadata_t *meta, const char *name, const char *value,
+                                   size_t size)
+{
+    (void)meta;
+    (void)name;
+    (void)value;
+    (void)size;
+    if (!segment_store_enabled())
+        return -ENOTSUP;
+    SBFS_LOG_INFO("段存储：手动清理，回收 %d 个段", segment_store_clean());
+    return 0;
+}
+
+static int xattr_crash_recovery_set(file_metadata_t *meta, const char *name, const char *value,
+                                    size_t size)
+{
+    (void)meta;
+    (void)name;
+    (void)value;
+    (void)size;
+    SBFS_LOG_INFO("模块D：执行崩溃恢复");
+    md_crash_recovery();
+    return 0;
+}
+
+static int xattr_alert_trigger_set(file_metadata_t *meta, const char *name, const char *value,
+                                   size_t size)
+{
+    (void)meta;
+    (void)name;
+    char tmp[256];
+    xattr_value_str(value, size, tmp, sizeof(tmp));
+    SBFS_LOG_INFO("模块D：触发预警条件 - %s", tmp);
+    md_add_alert(ALERT_WARNING, "用户触发", tmp);
+    return 0;
+}
+
+static int xattr_monitor_set(file_metadata_t *meta, const char *name, const char *value,
+                             size_t size)
+{
+    (void)meta;
+    SBFS_LOG_INFO("模块D：%s监控已%s", name, xattr_value_flag(value, size) ? "启用" : "禁用");
+    return 0;
+}
 
+// 属性表：按名称字典序排列，供二分查找
+static const xattr_handler_t xattr_handlers[] = {
+    {"user.alert.list", XATTR_F_LIST, "operation_completed", NULL, NULL, NULL, NULL},
+    {"user.alert.trigger", XATTR_F_LIST, "operation_completed", NULL, xattr_alert_trigger_set, NULL, NULL},
+    {"user.backup.create", XATTR_F_LIST, "backup_operation_completed", NULL, xattr_backup_create_set, NULL, NULL},
+    {"user.backup.storage_path", XATTR_F_LIST, "/tmp/backup_default", NULL, xattr_backup_storage_path_set, NULL, NULL},
+    {"user.backup.verified", XATTR_F_LIST, "backup_operation_completed", NULL, NULL, NULL, NULL},
+    {"user.cache.monitor", XATTR_F_LIST, "operation_completed", NULL, xattr_monitor_set, NULL, NULL},
+    {"user.cache.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_cache_stats_get, NULL, NULL, NULL},
+    {"user.comment", XATTR_F_LIST, NULL, xattr_comment_get, xattr_comment_set, xattr_comment_remove,
+     xattr_comment_present},
+    {"user.compression.algo", XATTR_F_LIST, NULL, xattr_compression_algo_get, xattr_compression_algo_set,
+     xattr_compression_algo_remove, NULL},
+    {"user.compression.level", XATTR_F_LIST, NULL, xattr_compression_level_get, xattr_compression_level_set,
+     xattr_compression_level_remove, NULL},
+    {"user.compression.min_size", XATTR_F_LIST, NULL, xattr_compression_min_size_get,
+     xattr_compression_min_size_set, xattr_compression_min_size_remove, NULL},
+    {"user.container.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_container_stats_get, NULL, NULL, NULL},
+    {"user.crash.recovery", XATTR_F_LIST, "operation_completed", NULL, xattr_crash_recovery_set, NULL, NULL},
+    {"user.dedup.enable", XATTR_F_LIST, NULL, xattr_dedup_enable_get, xattr_dedup_enable_set,
+     xattr_dedup_enable_remove, NULL},
+    {"user.dedup.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_dedup_stats_get, NULL, NULL, NULL},
+    {"user.health.monitor", XATTR_F_LIST, "1", NULL, xattr_health_monitor_set, NULL, NULL},
+    {"user.health.report", XATTR_F_LIST, "operation_completed", NULL, xattr_health_report_set, NULL, NULL},
+    {"user.health.status", XATTR_F_LIST, "health_ok", NULL, NULL, NULL, NULL},
+    {"user.inode.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_inode_stats_get, NULL, NULL, NULL},
+    {"user.integrity.checksum", XATTR_F_LIST, "checksum_ok", NULL, NULL, NULL, NULL},
+    {"user.integrity.enable", XATTR_F_LIST, "1", NULL, xattr_integrity_set, NULL, NULL},
+    {"user.integrity.repair", XATTR_F_LIST, "operation_completed", NULL, xattr_integrity_set, NULL, NULL},
+    {"user.integrity.scan", XATTR_F_LIST, "operation_completed", NULL, xattr_integrity_set, NULL, NULL},
+    {"user.orphan.cleanup", XATTR_F_LIST, "operation_completed", NULL, xattr_orphan_cleanup_set, NULL, NULL},
+    {"user.performance.monitor", XATTR_F_LIST, "operation_completed", NULL, xattr_monitor_set, NULL, NULL},
+    {"user.segment.clean", XATTR_F_LIST, "operation_completed", NULL, xattr_segment_clean_set, NULL, NULL},
+    {"user.segment.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_segment_stats_get, NULL, NULL, NULL},
+    {"user.slab.stats", XATTR_F_LIST | XATTR_F_RDONLY, NULL, xattr_slab_stats_get, NULL, NULL, NULL},
+    {"user.storage.monitor", XATTR_F_LIST, "operation_completed", NULL, xattr_monitor_set, NULL, NULL},
+    {"user.transaction.created", XATTR_F_LIST, "transaction_logged", NULL, NULL, NULL, NULL},
+    {"user.transaction.enable", XATTR_F_LIST, "1", NULL, xattr_transaction_enable_set, NULL, NULL},
+    {"user.transaction.modified", XATTR_F_LIST, "transaction_logged", NULL, NULL, NULL, NULL},
+    {"user.version.create", 0, NULL, NULL, xattr_version_create_set, NULL, NULL},
+    {"user.version.delete", 0, NULL, NULL, xattr_version_delete_set, NULL, NULL},
+    {"user.version.important", 0, NULL, NULL, xattr_version_important_set, xattr_version_important_remove,
+     NULL},
+    {"user.version.max_size_mb", XATTR_F_LIST, NULL, xattr_max_size_get, xattr_max_size_set, NULL, NULL},
+    {"user.version.pinned", XATTR_F_LIST, NULL, xattr_pinned_get, xattr_pinned_set, xattr_pinned_remove,
+     xattr_pinned_present},
+};
+
+#define XATTR_HANDLER_COUNT (sizeof(xattr_handlers) / sizeof(xattr_handlers[0]))
+
+static int xattr_handler_cmp(const void *key, const void *elem)
+{
+    return strcmp((const char *)key, ((const xattr_handler_t *)elem)->name);
+}
+
+static const xattr_handler_t *xattr_find_handler(const char *name)
+{
+    return bsearch(name, xattr_handlers, XATTR_HANDLER_COUNT, sizeof(xattr_handler_t),
+                   xattr_handler_cmp);
+}
+
+static bool xattr_listed(const xattr_handler_t *h, const file_metadata_t *meta)
+{
+    return (h->flags & XATTR_F_LIST) && (!h->present || h->present(meta));
+}
+
+// 获取扩展属性（按元数据，供路径前端、inode前端与控制通道共用）
+int smartbackupfs_xattr_get(file_metadata_t *meta, const char *name, char *value,
+                            size_t size)
+{
+    const xattr_handler_t *h = xattr_find_handler(name);
+    if (!h || (!h->get && !h->fixed))
+        return -ENODATA;
+
+    char scratch[XATTR_SCRATCH_SIZE];
+    const char *val = h->fixed;
+    int len = h->get ? h->get(meta, scratch, sizeof(scratch), &val) : (int)strlen(val);
+    if (len < 0)
+        return len;
+
+    size_t attr_len = (size_t)len + 1;
     if (size == 0)
-        return total_size;
-    if (size < total_size)
+        return (int)attr_len;
+    if (size < attr_len)
         return -ERANGE;
+    memcpy(value, val, attr_len);
+    return (int)attr_len;
+}
 
-    char *p = list;
-    if (meta->xattr)
-    {
-        memcpy(p, attrs[0], lens[0]);
-        p += lens[0];
-    }
-    if (meta->version_pinned_set)
+// 获取扩展属性
+static int smartbackupfs_getxattr(const char *path, const char *name, char *value,
+                                  size_t size)
+{
+    file_metadata_t *meta = lookup_path_ref(path);
+    if (!meta)
     {
-        memcpy(p, attrs[1], lens[1]);
-        p += lens[1];
+        return -ENOENT;
     }
 
-    /* version.max_size_mb 始终列出 */
-    memcpy(p, attrs[2], lens[2]);
-    p += lens[2];
+    int ret = smartbackupfs_xattr_get(meta, name, value, size);
+    lookup_path_put(meta);
+    return ret;
+}
 
-    for (size_t i = 3; i < 8; i++)
-    {
-        memcpy(p, attrs[i], lens[i]);
-        p += lens[i];
-    }
-    
-    // 模块D属性（8-27）
-    for (size_t i = 8; i < 28; i++)
-    {
-        memcpy(p, attrs[i], lens[i]);
-        p += lens[i];
-    }
+// 设置扩展属性（按元数据，调用方负责权限检查）
+int smartbackupfs_xattr_set(file_metadata_t *meta, const char *name,
+                            const char *value, size_t size, int flags)
+{
+    (void)flags;
 
-    return total_size;
+    const xattr_handler_t *h = xattr_find_handler(name);
+    if (h && (h->flags & XATTR_F_RDONLY))
+        return -EPERM;
+    if (!h || !h->set)
+        return -ENOTSUP;
+
+    int ret = h->set(meta, name, value, size);
+    if (ret == 0)
+        clock_gettime(CLOCK_REALTIME, &meta->ctime);
+    return ret;
 }
 
-// 删除扩展属性
-static int smartbackupfs_removexattr(const char *path, const char *name)
+// 设置扩展属性
+static int smartbackupfs_setxattr(const char *path, const char *name,
+                                  const char *value, size_t size, int flags)
 {
     file_metadata_t *meta = lookup_path(path);
     if (!meta)
@@ -1887,117 +2030,112 @@ static int smartbackupfs_removexattr(const char *path, const char *name)
         return -EACCES;
     }
 
-    if (strcmp(name, "user.comment") == 0)
-    {
-        if (!meta->xattr)
-            return -ENODATA;
-        pthread_mutex_lock(&fs_state.ino_mutex);
-        free(meta->xattr);
-        meta->xattr = NULL;
-        meta->xattr_size = 0;
-        pthread_mutex_unlock(&fs_state.ino_mutex);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+    return smartbackupfs_xattr_set(meta, name, value, size, flags);
+}
 
-    if (strcmp(name, "user.version.pinned") == 0)
+// 列出扩展属性（按元数据）
+int smartbackupfs_xattr_list(file_metadata_t *meta, char *list, size_t size)
+{
+    size_t total_size = 0;
+    for (size_t i = 0; i < XATTR_HANDLER_COUNT; i++)
     {
-        if (!meta->version_pinned_set)
-            return -ENODATA;
-        meta->version_pinned = false;
-        meta->version_pinned_set = false;
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+        if (xattr_listed(&xattr_handlers[i], meta))
+            total_size += strlen(xattr_handlers[i].name) + 1;
     }
 
-    if (strcmp(name, "user.dedup.enable") == 0)
-    {
-        dedup_config.enable_deduplication = false;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+    if (size == 0)
+        return total_size;
+    if (size < total_size)
+        return -ERANGE;
 
-    if (strcmp(name, "user.compression.algo") == 0)
+    char *p = list;
+    for (size_t i = 0; i < XATTR_HANDLER_COUNT; i++)
     {
-        dedup_set_compression(&dedup_config, COMPRESSION_NONE, dedup_config.compression_level);
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+        if (!xattr_listed(&xattr_handlers[i], meta))
+            continue;
+        size_t len = strlen(xattr_handlers[i].name) + 1;
+        memcpy(p, xattr_handlers[i].name, len);
+        p += len;
     }
 
-    if (strcmp(name, "user.compression.level") == 0)
+    return total_size;
+}
+
+// 列出扩展属性
+static int smartbackupfs_listxattr(const char *path, char *list, size_t size)
+{
+    file_metadata_t *meta = lookup_path_ref(path);
+    if (!meta)
     {
-        dedup_config.compression_level = 1;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+        return -ENOENT;
     }
 
-    if (strcmp(name, "user.compression.min_size") == 0)
-    {
-        dedup_config.min_compress_size = 1024;
-        dedup_update_config(dedup_config.enable_deduplication, dedup_config.enable_compression,
-                            dedup_config.algo, dedup_config.compression_level, dedup_config.min_compress_size);
+    int ret = smartbackupfs_xattr_list(meta, list, size);
+    lookup_path_put(meta);
+    return ret;
+}
+
+// 删除扩展属性（按元数据，调用方负责权限检查）
+int smartbackupfs_xattr_remove(file_metadata_t *meta, const char *name)
+{
+    const xattr_handler_t *h = xattr_find_handler(name);
+    if (h && (h->flags & XATTR_F_RDONLY))
+        return -EPERM;
+    if (!h || !h->remove)
+        return -ENODATA;
+
+    int ret = h->remove(meta);
+    if (ret == 0)
         clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
-    }
+    return ret;
+}
 
-    if (strcmp(name, "user.dedup.stats") == 0)
+// 删除扩展属性
+static int smartbackupfs_removexattr(const char *path, const char *name)
+{
+    file_metadata_t *meta = lookup_path(path);
+    if (!meta)
     {
-        return -EPERM;
+        return -ENOENT;
     }
 
-    if (strcmp(name, "user.version.important") == 0)
+    if (!has_write_permission(meta))
     {
-        /* 默认针对最新版本取消重要标记 */
-        if (meta->latest_version_id)
-            version_manager_mark_important(meta->ino, meta->latest_version_id, false);
-        clock_gettime(CLOCK_REALTIME, &meta->ctime);
-        return 0;
+        return -EACCES;
     }
 
-    return -ENODATA;
+    return smartbackupfs_xattr_remove(meta, name);
 }
 
 // 释放文件系统资源
 static void smartbackupfs_destroy(void *private_data)
 {
     (void)private_data;
+    fs_destroy();
+}
 
-    // 清理根目录
-    if (fs_state.root)
-    {
-        dir_entry_t *entry = fs_state.root->entries;
-        while (entry)
-        {
-            dir_entry_t *next = entry->next;
-
-            if (S_ISDIR(entry->meta->mode))
-            {
-                directory_t *dir = (directory_t *)entry->meta;
-                pthread_rwlock_destroy(&dir->lock);
-            }
-
-            free(entry->name);
-            free_inode(entry->meta);
-            free(entry);
-
-            entry = next;
-        }
+// 连接参数协商（两个前端共用）：启用splice收发数据，放大单次写请求。
+// max_read 只能通过挂载选项设置，默认不受限，这里不做修改
+void smartbackupfs_negotiate_conn(struct fuse_conn_info *conn)
+{
+    unsigned splice_caps = FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE;
+    conn->want |= conn->capable & splice_caps;
+    conn->max_write = SMARTBACKUPFS_MAX_WRITE;
+}
 
-        pthread_rwlock_destroy(&fs_state.root->lock);
-        free(fs_state.root);
-    }
+static void *smartbackupfs_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+    (void)cfg;
 
-    pthread_mutex_destroy(&fs_state.ino_mutex);
+    // 此时已完成守护进程化，日志后台线程可以安全启动
+    sbfs_log_start();
+    smartbackupfs_negotiate_conn(conn);
+    return NULL;
 }
 
 // FUSE操作结构
 static struct fuse_operations smartbackupfs_ops = {
+    .init = smartbackupfs_init,
     .getattr = smartbackupfs_getattr,
     .mkdir = smartbackupfs_mkdir,
     .unlink = smartbackupfs_unlink,
@@ -2007,8 +2145,14 @@ static struct fuse_operations smartbackupfs_ops = {
     .open = smartbackupfs_open,
     .read = smartbackupfs_read,
     .write = smartbackupfs_write,
+    .write_buf = smartbackupfs_write_buf,
+    .copy_file_range = smartbackupfs_copy_file_range,
+    .fallocate = smartbackupfs_fallocate,
+    .lseek = smartbackupfs_lseek,
     .fsync = smartbackupfs_fsync,
+    .opendir = smartbackupfs_opendir,
     .readdir = smartbackupfs_readdir,
+    .releasedir = smartbackupfs_releasedir,
     .create = smartbackupfs_create,
     .chmod = smartbackupfs_chmod,
     .utimens = smartbackupfs_utimens,
@@ -2025,16 +2169,129 @@ static struct fuse_operations smartbackupfs_ops = {
     .destroy = smartbackupfs_destroy,
 };
 
+// 程序私有命令行选项（解析后从FUSE参数中剔除）
+struct smartbackupfs_cli {
+    int lowlevel; /* --lowlevel：使用基于inode的低层前端 */
+    char *config_path; /* --config=PATH：配置文件（config.yaml） */
+};
+
+#define SMARTBACKUPFS_OPT(t, p, v) { t, offsetof(struct smartbackupfs_cli, p), v }
+
+static const struct fuse_opt smartbackupfs_cli_opts[] = {
+    SMARTBACKUPFS_OPT("--lowlevel", lowlevel, 1),
+    SMARTBACKUPFS_OPT("--config=%s", config_path, 0),
+    FUSE_OPT_END
+};
+
+// 运行高层路径接口会话（展开 fuse_main，以便按配置设置多线程循环）
+static int smartbackupfs_hl_main(struct fuse_args *args)
+{
+    struct fuse_cmdline_opts opts;
+    struct fuse *fuse = NULL;
+    int ret = 1;
+
+    if (fuse_parse_cmdline(args, &opts) != 0)
+        return 1;
+
+    if (opts.show_help)
+    {
+        printf("用法: %s [选项] <挂载点>\n\n", args->argv[0]);
+        fuse_cmdline_help();
+        fuse_lib_help(args);
+        ret = 0;
+        goto out;
+    }
+    if (opts.show_version)
+    {
+        fuse_lowlevel_version();
+        ret = 0;
+        goto out;
+    }
+    if (!opts.mountpoint)
+    {
+        fprintf(stderr, "用法: %s [选项] <挂载点>\n", args->argv[0]);
+        goto out;
+    }
+
+    fuse = fuse_new(args, &smartbackupfs_ops, sizeof(smartbackupfs_ops), NULL);
+    if (!fuse)
+        goto out;
+    if (fuse_mount(fuse, opts.mountpoint) != 0)
+        goto out_destroy;
+
+    fuse_daemonize(opts.foreground);
+
+    struct fuse_session *se = fuse_get_session(fuse);
+    if (fuse_set_signal_handlers(se) != 0)
+        goto out_unmount;
+
+    if (opts.singlethread)
+    {
+        ret = fuse_loop(fuse);
+    }
+    else
+    {
+        struct fuse_loop_config *loop_cfg = worker_pool_loop_config(&opts);
+        ret = loop_cfg ? fuse_loop_mt(fuse, loop_cfg) : 1;
+        fuse_loop_cfg_destroy(loop_cfg);
+    }
+
+    fuse_remove_signal_handlers(se);
+out_unmount:
+    fuse_unmount(fuse);
+out_destroy:
+    fuse_destroy(fuse);
+out:
+    free(opts.mountpoint);
+    return ret ? 1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
-    // 初始化文件系统
-    fs_init();
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct smartbackupfs_cli cli = {0};
+    if (fuse_opt_parse(&args, &cli, smartbackupfs_cli_opts, NULL) == -1)
+    {
+        return 1;
+    }
+
+    if (cli.config_path)
+    {
+        int cret = config_load(cli.config_path);
+        if (cret != 0)
+        {
+            fprintf(stderr, "无法加载配置文件 %s: %s\n", cli.config_path, strerror(-cret));
+            free(cli.config_path);
+            fuse_opt_free_args(&args);
+            return 1;
+        }
+    }
+
+    // 日志：未指定配置文件时以INFO级别输出到stderr
+    const char *log_file = config_get("logging.file");
+    if (sbfs_log_init(config_get_string("logging.level", "INFO"), log_file,
+                      config_get_size("logging.max_size", 0),
+                      (int)config_get_int("logging.backup_count", 0)) != 0)
+    {
+        fprintf(stderr, "警告：无法打开日志文件 %s，日志输出到stderr\n", log_file);
+    }
+
+    // 初始化文件系统（配置的段存储不可用时拒绝挂载）
+    if (fs_init() != 0)
+    {
+        fprintf(stderr, "文件系统初始化失败，未挂载\n");
+        sbfs_log_shutdown();
+        config_free();
+        free(cli.config_path);
+        fuse_opt_free_args(&args);
+        return 1;
+    }
 
     // 初始化模块D：数据完整性与恢复机制
     if (module_d_init() != 0) {
-        printf("警告：模块D初始化失败，数据完整性与恢复功能将不可用\n");
+        SBFS_LOG_WARN("模块D初始化失败，数据完整性与恢复功能将不可用");
     } else {
-        printf("模块D：数据完整性与恢复机制已初始化\n");
+        SBFS_LOG_INFO("模块D：数据完整性与恢复机制已初始化");
     }
 
     printf("智能备份文件系统 v6.0\n");
@@ -2051,8 +2308,23 @@ int main(int argc, char *argv[])
     printf("  - 自适应压缩：按策略选择 gzip/lz4/none，记录压缩比\n");
     printf("  - 多级缓存：L1 内存 + L2 文件缓存 + L3 目录缓存，写入级联失效\n");
     printf("  - 缓存/存储监控：命中率、压缩/去重输入字节与移除计数\n");
-    printf("  - 并发一致性：version_lock + block_index + 引用计数协同\n");
+    printf("  - 并发一致性：块映射读写锁 + block_index + 引用计数协同\n");
     printf("  - 模块D：数据完整性保护、事务日志系统、备份恢复工具、系统健康监控\n");
+    printf("  - 前端：%s\n", cli.lowlevel ? "低层inode接口（--lowlevel）" : "高层路径接口");
 
-    return fuse_main(argc, argv, &smartbackupfs_ops, NULL);
+    int ret;
+    if (cli.lowlevel)
+    {
+        ret = smartbackupfs_ll_main(&args);
+    }
+    else
+    {
+        ret = smartbackupfs_hl_main(&args);
+    }
+
+    sbfs_log_shutdown();
+    config_free();
+    free(cli.config_path);
+    fuse_opt_free_args(&args);
+    return ret;
 }
\ No newline at end of file
@@ -0,0 +1,1532 @@
+/**
+ * 智能备份文件系统 - 模块A：FUSE低层（inode）前端
+ * 所有操作以 fuse_ino_t 为键，直接作用于 file_metadata_t/directory_t，
+ * 不再逐级解析路径。内核持有的引用由 lookup/forget 计数维护。
+ */
+
+#define FUSE_USE_VERSION 312
+
+#include "smartbackupfs_ll.h"
+#include "version_manager.h"
+#include "smartbackupfs_ctl.h"
+#include "module_d.h"
+#include "logger.h"
+#include "worker_pool.h"
+#include "inode_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+// 全局文件系统状态
+extern fs_state_t fs_state;
+
+// 外部函数声明
+extern int smart_read_file(file_metadata_t *meta, char *buf, size_t size, off_t offset);
+extern int smart_write_file(file_metadata_t *meta, const char *buf, size_t size, off_t offset);
+
+// 扩展属性（与路径前端共用，见 smartbackupfs_basic.c）
+extern int smartbackupfs_xattr_get(file_metadata_t *meta, const char *name, char *value, size_t size);
+extern int smartbackupfs_xattr_set(file_metadata_t *meta, const char *name, const char *value, size_t size, int flags);
+extern int smartbackupfs_xattr_list(file_metadata_t *meta, char *list, size_t size);
+extern int smartbackupfs_xattr_remove(file_metadata_t *meta, const char *name);
+
+// 连接协商与 fuse_bufvec 填充（与路径前端共用，见 smartbackupfs_basic.c）
+extern void smartbackupfs_negotiate_conn(struct fuse_conn_info *conn);
+extern int smartbackupfs_bufvec_fill(void *ctx, char *dst, size_t len);
+
+/* inode表项：记录内核通过 lookup 持有的引用数 */
+typedef struct ll_inode {
+    file_metadata_t *meta;
+    uint64_t nlookup;   /* 内核引用计数，forget 时递减 */
+    bool detached;      /* 已脱离目录树，引用归零后释放 */
+} ll_inode_t;
+
+/* inode表：ino -> ll_inode_t；根目录不入表，始终有效。
+ * 按ino分片加锁，引用计数在表项所在分片的写锁内修改 */
+static shard_map_t *ll_inodes = NULL;
+
+#define LL_INODE_TABLE_SIZE 65536
+
+// 按inode编号取元数据
+// 内核在请求处理期间保持对该inode的引用，forget 不会与之并发，因此无需加表锁
+static file_metadata_t *ll_get_meta(fuse_ino_t ino)
+{
+    if (ino == FUSE_ROOT_ID)
+        return &fs_state.root->meta;
+
+    ll_inode_t *node = shard_map_get(ll_inodes, ino);
+    return node ? node->meta : NULL;
+}
+
+// 按inode编号取目录
+static directory_t *ll_get_dir(fuse_ino_t ino, int *err)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        *err = ENOENT;
+        return NULL;
+    }
+    if (meta->type != FT_DIRECTORY)
+    {
+        *err = ENOTDIR;
+        return NULL;
+    }
+    return (directory_t *)meta;
+}
+
+// 记录一次内核引用（每个成功的 entry/create 回复对应一次）
+// 调用方须持有包含该目录项的父目录锁，保证元数据不会被并发释放
+static int ll_ref_meta(file_metadata_t *meta)
+{
+    if (meta->ino == FUSE_ROOT_ID)
+        return 0;
+
+    hash_table_t *shard = shard_map_lock(ll_inodes, meta->ino);
+    ll_inode_t *node = hash_table_get_locked(shard, meta->ino);
+    if (!node)
+    {
+        node = calloc(1, sizeof(ll_inode_t));
+        if (!node)
+        {
+            shard_map_unlock(shard);
+            return -ENOMEM;
+        }
+        node->meta = meta;
+        if (hash_table_set_locked(shard, meta->ino, node) != 0)
+        {
+            shard_map_unlock(shard);
+            free(node);
+            return -ENOMEM;
+        }
+    }
+    node->nlookup++;
+    shard_map_unlock(shard);
+    return 0;
+}
+
+// inode已脱离目录树：内核仍持有引用时推迟到 forget 释放
+static void ll_detach_meta(file_metadata_t *meta)
+{
+    hash_table_t *shard = shard_map_lock(ll_inodes, meta->ino);
+    ll_inode_t *node = hash_table_get_locked(shard, meta->ino);
+    if (node && node->nlookup > 0)
+    {
+        node->detached = true;
+        shard_map_unlock(shard);
+        return;
+    }
+    shard_map_unlock(shard);
+
+    destroy_detached_inode(meta);
+}
+
+// 递减内核引用，归零时移出inode表
+static void ll_forget_one(fuse_ino_t ino, uint64_t nlookup)
+{
+    if (ino == FUSE_ROOT_ID)
+        return;
+
+    file_metadata_t *to_destroy = NULL;
+
+    hash_table_t *shard = shard_map_lock(ll_inodes, ino);
+    ll_inode_t *node = hash_table_get_locked(shard, ino);
+    if (node)
+    {
+        node->nlookup = nlookup >= node->nlookup ? 0 : node->nlookup - nlookup;
+        if (node->nlookup == 0)
+        {
+            hash_table_remove_locked(shard, ino);
+            if (node->detached)
+                to_destroy = node->meta;
+            free(node);
+        }
+    }
+    shard_map_unlock(shard);
+
+    if (to_destroy)
+        destroy_detached_inode(to_destroy);
+}
+
+// 填充目录项回复参数
+static void ll_fill_entry(file_metadata_t *meta, struct fuse_entry_param *e)
+{
+    memset(e, 0, sizeof(*e));
+    e->ino = meta->ino;
+    e->attr_timeout = LL_ATTR_TIMEOUT;
+    e->entry_timeout = LL_ENTRY_TIMEOUT;
+    fill_stat_from_meta(meta, &e->attr);
+}
+
+// 写权限检查（与路径前端 has_write_permission 语义一致）
+static bool ll_has_write_permission(fuse_req_t req, file_metadata_t *meta)
+{
+    const struct fuse_ctx *ctx = fuse_req_ctx(req);
+    if (!ctx || !meta)
+        return false;
+    if (ctx->uid == 0)
+        return true;
+    if (ctx->uid == meta->uid)
+        return (meta->mode & S_IWUSR) != 0;
+    if (ctx->gid == meta->gid)
+        return (meta->mode & S_IWGRP) != 0;
+    return (meta->mode & S_IWOTH) != 0;
+}
+
+// 分配新inode；目录类型分配完整的 directory_t
+static file_metadata_t *ll_alloc_inode(fuse_req_t req, file_type_t type, mode_t mode)
+{
+    file_metadata_t *meta;
+    if (type == FT_DIRECTORY)
+    {
+        directory_t *dir = calloc(1, sizeof(directory_t));
+        if (!dir)
+            return NULL;
+        pthread_rwlock_init(&dir->lock, NULL);
+        meta = &dir->meta;
+        meta->mode = S_IFDIR | (mode & 07777);
+        meta->nlink = 2; // '.'和父目录
+        meta->size = DEFAULT_BLOCK_SIZE;
+        meta->blocks = 1;
+    }
+    else
+    {
+        meta = calloc(1, sizeof(file_metadata_t));
+        if (!meta)
+            return NULL;
+        meta->mode = (type == FT_SYMLINK ? S_IFLNK : S_IFREG) | (mode & 07777);
+        meta->nlink = 1;
+    }
+
+    meta->ino = inode_alloc_ino();
+
+    const struct fuse_ctx *ctx = fuse_req_ctx(req);
+    meta->type = type;
+    meta->uid = ctx->uid;
+    meta->gid = ctx->gid;
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+    meta->mtime = meta->atime;
+    meta->ctime = meta->atime;
+    return meta;
+}
+
+// 释放尚未挂入目录树的新inode（不计入统计）
+static void ll_free_unpublished(file_metadata_t *meta)
+{
+    if (S_ISDIR(meta->mode))
+    {
+        pthread_rwlock_destroy(&((directory_t *)meta)->lock);
+        directory_destroy_index((directory_t *)meta);
+    }
+    free_inode(meta);
+}
+
+// 追加目录项，调用方持有父目录写锁且已确认名称不存在
+static int ll_append_entry_locked(directory_t *dir, const char *name, file_metadata_t *meta)
+{
+    dir_entry_t *new_entry = dir_entry_create(name, meta);
+    if (!new_entry)
+        return -ENOMEM;
+    int ret = directory_insert_entry_locked(dir, new_entry);
+    if (ret != 0)
+    {
+        dir_entry_free(new_entry);
+        return ret;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
+    dir->meta.ctime = dir->meta.mtime;
+    return 0;
+}
+
+// 从目录摘除名称对应的目录项，调用方持有父目录写锁
+static dir_entry_t *ll_unlink_entry_locked(directory_t *dir, const char *name)
+{
+    dir_entry_t *found = find_directory_entry(dir, name);
+    if (!found)
+        return NULL;
+    directory_unlink_entry_locked(dir, found);
+    clock_gettime(CLOCK_REALTIME, &dir->meta.mtime);
+    dir->meta.ctime = dir->meta.mtime;
+    return found;
+}
+
+// 记录模块D事务（名称相对父目录）
+static void ll_log_transaction(transaction_type_t type, uint64_t ino, uint64_t block_id,
+                               const void *data, size_t size)
+{
+    if (!module_d_state.wal_enabled)
+        return;
+
+    uint64_t tx_id = md_transaction_begin(type);
+    transaction_header_t header;
+    header.tx_id = tx_id;
+    header.type = type;
+    header.state = TX_COMMITTED;
+    header.timestamp = time(NULL);
+    header.ino = ino;
+    header.block_id = block_id;
+    header.data_size = size;
+    header.checksum = 0;
+    md_transaction_log(tx_id, &header, sizeof(header));
+    md_transaction_log(tx_id, data, size);
+    md_transaction_commit(tx_id);
+}
+
+// 创建新节点并挂入父目录（mkdir/create/symlink共用）
+static int ll_make_node(fuse_req_t req, fuse_ino_t parent, const char *name,
+                        file_type_t type, mode_t mode, const char *link_target,
+                        struct fuse_entry_param *e)
+{
+    int err = 0;
+    directory_t *parent_dir = ll_get_dir(parent, &err);
+    if (!parent_dir)
+        return -err;
+
+    file_metadata_t *meta = ll_alloc_inode(req, type, mode);
+    if (!meta)
+        return -ENOMEM;
+
+    if (link_target)
+    {
+        // 目标路径存放在冷区
+        meta->mode = S_IFLNK | 0777;
+        meta->size = strlen(link_target);
+        meta->blocks = (meta->size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+        file_meta_ext_t *ext = file_meta_ext_get(meta);
+        if (!ext || !(ext->link_target = strdup(link_target)))
+        {
+            ll_free_unpublished(meta);
+            return -ENOMEM;
+        }
+    }
+
+    // 先登记到inode表，失败路径经 free_inode 注销
+    int ret = inode_table_insert(meta);
+    if (ret != 0)
+    {
+        ll_free_unpublished(meta);
+        return ret;
+    }
+
+    pthread_rwlock_wrlock(&parent_dir->lock);
+    if (find_directory_entry(parent_dir, name))
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        ll_free_unpublished(meta);
+        return -EEXIST;
+    }
+
+    ret = ll_append_entry_locked(parent_dir, name, meta);
+    if (ret == 0)
+        ret = ll_ref_meta(meta);
+    if (ret != 0)
+    {
+        dir_entry_t *entry = ll_unlink_entry_locked(parent_dir, name);
+        pthread_rwlock_unlock(&parent_dir->lock);
+        if (entry)
+        {
+            dir_entry_free(entry);
+        }
+        ll_free_unpublished(meta);
+        return ret;
+    }
+
+    meta->parent_ino = parent_dir->meta.ino;
+    ll_fill_entry(meta, e);
+    pthread_rwlock_unlock(&parent_dir->lock);
+
+    if (type == FT_DIRECTORY)
+    {
+        FS_STAT_ADD(total_dirs, 1);
+        FS_STAT_ADD(total_blocks, 1);
+    }
+    else
+    {
+        FS_STAT_ADD(total_files, 1);
+    }
+    return 0;
+}
+
+static void smartbackupfs_ll_init(void *userdata, struct fuse_conn_info *conn)
+{
+    (void)userdata;
+
+    sbfs_log_start();
+    smartbackupfs_negotiate_conn(conn);
+}
+
+static void ll_free_inode_node(uint64_t ino, void *node, void *arg)
+{
+    (void)ino;
+    (void)arg;
+    free(node);
+}
+
+static void smartbackupfs_ll_destroy(void *userdata)
+{
+    (void)userdata;
+
+    if (ll_inodes)
+    {
+        shard_map_foreach(ll_inodes, ll_free_inode_node, NULL);
+        shard_map_destroy(ll_inodes);
+        ll_inodes = NULL;
+    }
+    fs_destroy();
+}
+
+static void smartbackupfs_ll_lookup(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    int err = 0;
+    directory_t *dir = ll_get_dir(parent, &err);
+    if (!dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    struct fuse_entry_param e;
+    pthread_rwlock_rdlock(&dir->lock);
+    dir_entry_t *entry = find_directory_entry(dir, name);
+    if (!entry)
+    {
+        pthread_rwlock_unlock(&dir->lock);
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    int ret = ll_ref_meta(entry->meta);
+    if (ret == 0)
+        ll_fill_entry(entry->meta, &e);
+    pthread_rwlock_unlock(&dir->lock);
+
+    if (ret != 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void smartbackupfs_ll_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
+{
+    ll_forget_one(ino, nlookup);
+    fuse_reply_none(req);
+}
+
+static void smartbackupfs_ll_forget_multi(fuse_req_t req, size_t count,
+                                          struct fuse_forget_data *forgets)
+{
+    for (size_t i = 0; i < count; i++)
+        ll_forget_one(forgets[i].ino, forgets[i].nlookup);
+    fuse_reply_none(req);
+}
+
+static void smartbackupfs_ll_getattr(fuse_req_t req, fuse_ino_t ino,
+                                     struct fuse_file_info *fi)
+{
+    (void)fi;
+
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    struct stat st;
+    fill_stat_from_meta(meta, &st);
+    fuse_reply_attr(req, &st, LL_ATTR_TIMEOUT);
+}
+
+static void smartbackupfs_ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr,
+                                     int to_set, struct fuse_file_info *fi)
+{
+    (void)fi;
+
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    const struct fuse_ctx *ctx = fuse_req_ctx(req);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (to_set & FUSE_SET_ATTR_MODE)
+    {
+        if (!(ctx->uid == 0 || ctx->uid == meta->uid))
+        {
+            fuse_reply_err(req, EACCES);
+            return;
+        }
+        meta->mode = (meta->mode & S_IFMT) | (attr->st_mode & 07777);
+        meta->ctime = now;
+    }
+
+    if (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID))
+    {
+        if (ctx->uid != 0)
+        {
+            fuse_reply_err(req, EPERM);
+            return;
+        }
+        if (to_set & FUSE_SET_ATTR_UID)
+            meta->uid = attr->st_uid;
+        if (to_set & FUSE_SET_ATTR_GID)
+            meta->gid = attr->st_gid;
+        meta->ctime = now;
+    }
+
+    if (to_set & FUSE_SET_ATTR_SIZE)
+    {
+        if (S_ISDIR(meta->mode))
+        {
+            fuse_reply_err(req, EISDIR);
+            return;
+        }
+        if (attr->st_size < 0)
+        {
+            fuse_reply_err(req, EINVAL);
+            return;
+        }
+        if (attr->st_size != meta->size && meta->type != FT_CONTROL)
+        {
+            // 缩小时释放末尾的数据块，扩大部分为空洞
+            int ret = file_truncate(meta, attr->st_size);
+            if (ret < 0)
+            {
+                fuse_reply_err(req, -ret);
+                return;
+            }
+        }
+    }
+
+    if (to_set & FUSE_SET_ATTR_ATIME_NOW)
+        meta->atime = now;
+    else if (to_set & FUSE_SET_ATTR_ATIME)
+        meta->atime = attr->st_atim;
+
+    if (to_set & FUSE_SET_ATTR_MTIME_NOW)
+        meta->mtime = now;
+    else if (to_set & FUSE_SET_ATTR_MTIME)
+        meta->mtime = attr->st_mtim;
+
+    if (to_set & FUSE_SET_ATTR_CTIME)
+        meta->ctime = attr->st_ctim;
+
+    struct stat st;
+    fill_stat_from_meta(meta, &st);
+    fuse_reply_attr(req, &st, LL_ATTR_TIMEOUT);
+}
+
+static void smartbackupfs_ll_readlink(fuse_req_t req, fuse_ino_t ino)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (!S_ISLNK(meta->mode))
+    {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+    const char *target = file_meta_ext(meta)->link_target;
+    if (!target)
+    {
+        fuse_reply_err(req, ENODATA);
+        return;
+    }
+    fuse_reply_readlink(req, target);
+}
+
+static void smartbackupfs_ll_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name,
+                                   mode_t mode)
+{
+    struct fuse_entry_param e;
+    int ret = ll_make_node(req, parent, name, FT_DIRECTORY, mode, NULL, &e);
+    if (ret != 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void smartbackupfs_ll_symlink(fuse_req_t req, const char *link, fuse_ino_t parent,
+                                     const char *name)
+{
+    struct fuse_entry_param e;
+    int ret = ll_make_node(req, parent, name, FT_SYMLINK, 0777, link, &e);
+    if (ret != 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void smartbackupfs_ll_create(fuse_req_t req, fuse_ino_t parent, const char *name,
+                                    mode_t mode, struct fuse_file_info *fi)
+{
+    struct fuse_entry_param e;
+    int ret = ll_make_node(req, parent, name, FT_REGULAR, mode, NULL, &e);
+    if (ret != 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+
+    // 记录文件创建事务
+    ll_log_transaction(TX_CREATE_FILE, e.ino, 0, name, strlen(name) + 1);
+
+    // 句柄分配失败时 fh 为0，读写回退到按inode解析
+    file_handle_t *fh = file_handle_open(ll_get_meta(e.ino), fi->flags);
+    fi->fh = (uint64_t)(uintptr_t)fh;
+    if (fuse_reply_create(req, &e, fi) == -ENOENT)
+        file_handle_release(fh);
+}
+
+static void smartbackupfs_ll_unlink(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    int err = 0;
+    directory_t *parent_dir = ll_get_dir(parent, &err);
+    if (!parent_dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&parent_dir->lock);
+    dir_entry_t *entry = find_directory_entry(parent_dir, name);
+    if (!entry)
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (S_ISDIR(entry->meta->mode))
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, EISDIR);
+        return;
+    }
+    if (ctl_is_reserved(entry->meta))
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, EPERM);
+        return;
+    }
+
+    file_metadata_t *meta = entry->meta;
+
+    // 在删除前创建版本快照（事件触发策略）
+    version_manager_create_version(meta, "unlink");
+
+    // 记录文件删除事务
+    ll_log_transaction(TX_DELETE_FILE, meta->ino, 0, name, strlen(name) + 1);
+
+    ll_unlink_entry_locked(parent_dir, name);
+    dir_entry_free(entry);
+
+    meta->nlink--;
+    clock_gettime(CLOCK_REALTIME, &meta->ctime);
+    bool last_link = (meta->nlink == 0);
+    pthread_rwlock_unlock(&parent_dir->lock);
+
+    if (last_link)
+        ll_detach_meta(meta);
+
+    fuse_reply_err(req, 0);
+}
+
+static void smartbackupfs_ll_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    int err = 0;
+    directory_t *parent_dir = ll_get_dir(parent, &err);
+    if (!parent_dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&parent_dir->lock);
+    dir_entry_t *entry = find_directory_entry(parent_dir, name);
+    if (!entry)
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (!S_ISDIR(entry->meta->mode))
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, ENOTDIR);
+        return;
+    }
+    if (ctl_is_reserved(entry->meta))
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, EPERM);
+        return;
+    }
+
+    // 检查目录是否为空
+    directory_t *dir = (directory_t *)entry->meta;
+    pthread_rwlock_rdlock(&dir->lock);
+    bool empty = (dir->entries == NULL);
+    pthread_rwlock_unlock(&dir->lock);
+    if (!empty)
+    {
+        pthread_rwlock_unlock(&parent_dir->lock);
+        fuse_reply_err(req, ENOTEMPTY);
+        return;
+    }
+
+    ll_unlink_entry_locked(parent_dir, name);
+    dir_entry_free(entry);
+    pthread_rwlock_unlock(&parent_dir->lock);
+
+    ll_detach_meta(&dir->meta);
+    fuse_reply_err(req, 0);
+}
+
+static void smartbackupfs_ll_rename(fuse_req_t req, fuse_ino_t parent, const char *name,
+                                    fuse_ino_t newparent, const char *newname,
+                                    unsigned int flags)
+{
+    (void)flags;
+
+    int err = 0;
+    directory_t *src_dir = ll_get_dir(parent, &err);
+    directory_t *dst_dir = src_dir ? ll_get_dir(newparent, &err) : NULL;
+    if (!src_dir || !dst_dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    if (src_dir == dst_dir)
+    {
+        // 同目录重命名
+        pthread_rwlock_wrlock(&src_dir->lock);
+        dir_entry_t *entry = find_directory_entry(src_dir, name);
+        if (!entry)
+        {
+            pthread_rwlock_unlock(&src_dir->lock);
+            fuse_reply_err(req, ENOENT);
+            return;
+        }
+        if (ctl_is_reserved(entry->meta))
+        {
+            pthread_rwlock_unlock(&src_dir->lock);
+            fuse_reply_err(req, EPERM);
+            return;
+        }
+        if (find_directory_entry(src_dir, newname))
+        {
+            pthread_rwlock_unlock(&src_dir->lock);
+            fuse_reply_err(req, EEXIST);
+            return;
+        }
+
+        // 在重命名前创建版本快照（事件触发策略）
+        version_manager_create_version(entry->meta, "rename");
+
+        if (directory_rename_entry_locked(src_dir, entry, newname) != 0)
+        {
+            pthread_rwlock_unlock(&src_dir->lock);
+            fuse_reply_err(req, ENOMEM);
+            return;
+        }
+        clock_gettime(CLOCK_REALTIME, &src_dir->meta.mtime);
+        src_dir->meta.ctime = src_dir->meta.mtime;
+        clock_gettime(CLOCK_REALTIME, &entry->meta->mtime);
+        pthread_rwlock_unlock(&src_dir->lock);
+        fuse_reply_err(req, 0);
+        return;
+    }
+
+    // 跨目录移动：先从源目录摘除，再挂入目标目录
+    pthread_rwlock_wrlock(&src_dir->lock);
+    dir_entry_t *entry = find_directory_entry(src_dir, name);
+    if (!entry)
+    {
+        pthread_rwlock_unlock(&src_dir->lock);
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (ctl_is_reserved(entry->meta))
+    {
+        pthread_rwlock_unlock(&src_dir->lock);
+        fuse_reply_err(req, EPERM);
+        return;
+    }
+    version_manager_create_version(entry->meta, "rename");
+    ll_unlink_entry_locked(src_dir, name);
+    pthread_rwlock_unlock(&src_dir->lock);
+
+    file_metadata_t *meta = entry->meta;
+    dir_entry_free(entry);
+
+    pthread_rwlock_wrlock(&dst_dir->lock);
+    int ret = find_directory_entry(dst_dir, newname) ? -EEXIST
+                                                     : ll_append_entry_locked(dst_dir, newname, meta);
+    if (ret == 0)
+        meta->parent_ino = dst_dir->meta.ino;
+    pthread_rwlock_unlock(&dst_dir->lock);
+
+    if (ret != 0)
+    {
+        // 目标不可用：放回源目录
+        pthread_rwlock_wrlock(&src_dir->lock);
+        ll_append_entry_locked(src_dir, name, meta);
+        pthread_rwlock_unlock(&src_dir->lock);
+        fuse_reply_err(req, -ret);
+        return;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &meta->mtime);
+    fuse_reply_err(req, 0);
+}
+
+static void smartbackupfs_ll_link(fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent,
+                                  const char *newname)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (S_ISDIR(meta->mode))
+    {
+        fuse_reply_err(req, EPERM); // 不能对目录创建硬链接
+        return;
+    }
+
+    int err = 0;
+    directory_t *parent_dir = ll_get_dir(newparent, &err);
+    if (!parent_dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    struct fuse_entry_param e;
+    pthread_rwlock_wrlock(&parent_dir->lock);
+    int ret = find_directory_entry(parent_dir, newname) ? -EEXIST
+                                                        : ll_append_entry_locked(parent_dir, newname, meta);
+    if (ret == 0)
+    {
+        meta->nlink++;
+        clock_gettime(CLOCK_REALTIME, &meta->ctime);
+        ret = ll_ref_meta(meta);
+        ll_fill_entry(meta, &e);
+    }
+    pthread_rwlock_unlock(&parent_dir->lock);
+
+    if (ret != 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+    fuse_reply_entry(req, &e);
+}
+
+static void smartbackupfs_ll_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (S_ISDIR(meta->mode))
+    {
+        fuse_reply_err(req, EISDIR);
+        return;
+    }
+
+    // 检查访问权限
+    int acc = fi->flags & O_ACCMODE;
+    if (acc == O_RDONLY && !(meta->mode & S_IRUSR))
+    {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+    if ((acc == O_WRONLY || acc == O_RDWR) && !(meta->mode & S_IWUSR))
+    {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+    // 控制文件仅限挂载用户与root
+    if (meta->type == FT_CONTROL)
+    {
+        const struct fuse_ctx *ctx = fuse_req_ctx(req);
+        if (ctx->uid != 0 && ctx->uid != meta->uid)
+        {
+            fuse_reply_err(req, EACCES);
+            return;
+        }
+    }
+
+    file_handle_t *fh = file_handle_open(meta, fi->flags);
+    if (!fh)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    fi->fh = (uint64_t)(uintptr_t)fh;
+
+    // 控制文件的响应按会话顺序读取：绕过页缓存，禁止定位
+    if (fh->ctl)
+    {
+        fi->direct_io = 1;
+        fi->nonseekable = 1;
+    }
+
+    // 更新访问时间
+    clock_gettime(CLOCK_REALTIME, &meta->atime);
+    if (fuse_reply_open(req, fi) == -ENOENT)
+        file_handle_release(fh);
+}
+
+// 取得打开句柄（仅普通文件的句柄缓存了块映射）
+static inline file_handle_t *ll_file_handle(struct fuse_file_info *fi)
+{
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    return (fh && fh->map) ? fh : NULL;
+}
+
+// 取得控制文件会话
+static inline ctl_session_t *ll_ctl_session(struct fuse_file_info *fi)
+{
+    file_handle_t *fh = fi ? (file_handle_t *)(uintptr_t)fi->fh : NULL;
+    return fh ? fh->ctl : NULL;
+}
+
+static void smartbackupfs_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                                  struct fuse_file_info *fi)
+{
+    ctl_session_t *ctl = ll_ctl_session(fi);
+    if (ctl)
+    {
+        char *buf = malloc(size ? size : 1);
+        if (!buf)
+        {
+            fuse_reply_err(req, ENOMEM);
+            return;
+        }
+        int ret = ctl_session_read(ctl, buf, size);
+        if (ret < 0)
+            fuse_reply_err(req, -ret);
+        else
+            fuse_reply_buf(req, buf, (size_t)ret);
+        free(buf);
+        return;
+    }
+
+    file_handle_t *fh = ll_file_handle(fi);
+    file_metadata_t *meta = fh ? fh->meta : ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (S_ISDIR(meta->mode))
+    {
+        fuse_reply_err(req, EISDIR);
+        return;
+    }
+
+    // 零拷贝：各段直接指向块存储，由 writev 一次拷入内核（持有块映射读锁直到回复完成）
+    if (fh)
+    {
+        file_read_vec_t vec;
+        int ret = file_handle_read_vec(fh, size, off, &vec);
+        if (ret == 0)
+        {
+            if (vec.count > 0)
+                fuse_reply_iov(req, vec.iov, (int)vec.count);
+            else
+                fuse_reply_buf(req, NULL, 0);
+            file_read_vec_release(&vec);
+            return;
+        }
+        if (ret != -E2BIG)
+        {
+            fuse_reply_err(req, -ret);
+            return;
+        }
+        // 段数过多（高度碎片化的区间）：回退到拷贝读取
+    }
+
+    char *buf = malloc(size ? size : 1);
+    if (!buf)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    int ret = fh ? file_handle_read(fh, buf, size, off) : smart_read_file(meta, buf, size, off);
+    if (ret < 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_buf(req, buf, (size_t)ret);
+    free(buf);
+}
+
+static void smartbackupfs_ll_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
+                                   size_t size, off_t off, struct fuse_file_info *fi)
+{
+    ctl_session_t *ctl = ll_ctl_session(fi);
+    if (ctl)
+    {
+        int ret = ctl_session_write(ctl, buf, size);
+        if (ret < 0)
+            fuse_reply_err(req, -ret);
+        else
+            fuse_reply_write(req, (size_t)ret);
+        return;
+    }
+
+    file_handle_t *fh = ll_file_handle(fi);
+    file_metadata_t *meta = fh ? fh->meta : ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (S_ISDIR(meta->mode))
+    {
+        fuse_reply_err(req, EISDIR);
+        return;
+    }
+
+    int ret = fh ? file_handle_write(fh, buf, size, off) : smart_write_file(meta, buf, size, off);
+    if (ret < 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+
+    /* 变化策略：块级差异 >10% 触发版本 */
+    version_manager_maybe_change_snapshot(meta);
+
+    // 记录文件写入事务（前1KB数据）
+    ll_log_transaction(TX_WRITE_DATA, meta->ino, (uint64_t)(off / DEFAULT_BLOCK_SIZE),
+                       buf, size > 1024 ? 1024 : size);
+
+    fuse_reply_write(req, (size_t)ret);
+}
+
+// 写入（fuse_bufvec）：启用splice读时数据直接由管道落入块存储
+static void smartbackupfs_ll_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv,
+                                       off_t off, struct fuse_file_info *fi)
+{
+    file_handle_t *fh = ll_file_handle(fi);
+    size_t size = fuse_buf_size(bufv);
+
+    if (!fh)
+    {
+        // 无普通文件句柄：汇集到临时缓冲后走普通写入
+        char *tmp = malloc(size ? size : 1);
+        if (!tmp)
+        {
+            fuse_reply_err(req, ENOMEM);
+            return;
+        }
+        struct fuse_bufvec dst_buf = FUSE_BUFVEC_INIT(size);
+        dst_buf.buf[0].mem = tmp;
+        ssize_t copied = fuse_buf_copy(&dst_buf, bufv, 0);
+        if (copied < 0)
+            fuse_reply_err(req, (int)-copied);
+        else
+            smartbackupfs_ll_write(req, ino, tmp, (size_t)copied, off, fi);
+        free(tmp);
+        return;
+    }
+
+    bufvec_fill_ctx_t ctx;
+    ctx.src = bufv;
+    ctx.head_len = 0;
+    int ret = file_handle_write_fill(fh, size, off, smartbackupfs_bufvec_fill, &ctx);
+    if (ret < 0)
+    {
+        fuse_reply_err(req, -ret);
+        return;
+    }
+
+    /* 变化策略：块级差异 >10% 触发版本 */
+    version_manager_maybe_change_snapshot(fh->meta);
+
+    // 记录文件写入事务（前1KB数据）
+    ll_log_transaction(TX_WRITE_DATA, fh->meta->ino, (uint64_t)(off / DEFAULT_BLOCK_SIZE),
+                       ctx.head, ctx.head_len);
+
+    fuse_reply_write(req, (size_t)ret);
+}
+
+// 区间拷贝：块对齐部分共享数据块，不经过用户态缓冲
+static void smartbackupfs_ll_copy_file_range(fuse_req_t req, fuse_ino_t ino_in, off_t off_in,
+                                             struct fuse_file_info *fi_in, fuse_ino_t ino_out,
+                                             off_t off_out, struct fuse_file_info *fi_out,
+                                             size_t len, int flags)
+{
+    if (flags != 0)
+    {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    // 版本视图与控制文件的句柄同样取其元数据，由 file_clone_range 拒绝
+    file_handle_t *fh_in = fi_in ? (file_handle_t *)(uintptr_t)fi_in->fh : NULL;
+    file_handle_t *fh_out = fi_out ? (file_handle_t *)(uintptr_t)fi_out->fh : NULL;
+    file_metadata_t *src = fh_in ? fh_in->meta : ll_get_meta(ino_in);
+    file_metadata_t *dst = fh_out ? fh_out->meta : ll_get_meta(ino_out);
+    if (!src || !dst)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    ssize_t ret = file_clone_range(src, off_in, dst, off_out, len);
+    if (ret < 0)
+    {
+        fuse_reply_err(req, (int)-ret);
+        return;
+    }
+    if (ret > 0)
+        version_manager_maybe_change_snapshot(dst);
+    fuse_reply_write(req, (size_t)ret);
+}
+
+static void smartbackupfs_ll_fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t offset,
+                                       off_t length, struct fuse_file_info *fi)
+{
+    file_handle_t *fh = ll_file_handle(fi);
+    file_metadata_t *meta = fh ? fh->meta : ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    int ret = file_fallocate(meta, mode, offset, length);
+    if (ret == 0)
+        version_manager_maybe_change_snapshot(meta);
+    fuse_reply_err(req, -ret);
+}
+
+// SEEK_DATA/SEEK_HOLE：由块映射直接回答，稀疏感知的工具可跳过空洞
+static void smartbackupfs_ll_lseek(fuse_req_t req, fuse_ino_t ino, off_t off, int whence,
+                                   struct fuse_file_info *fi)
+{
+    file_handle_t *fh = ll_file_handle(fi);
+    file_metadata_t *meta = fh ? fh->meta : ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    off_t pos = file_seek_data(meta, off, whence);
+    if (pos < 0)
+        fuse_reply_err(req, (int)-pos);
+    else
+        fuse_reply_lseek(req, pos);
+}
+
+// 封存写回缓冲中的脏块（release 时句柄释放也会封存）
+static void smartbackupfs_ll_flush(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    file_handle_t *fh = ll_file_handle(fi);
+    int ret = fh && fh->map ? file_writeback(fh->meta) : 0;
+    fuse_reply_err(req, ret < 0 ? -ret : 0);
+}
+
+static void smartbackupfs_ll_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    (void)ino;
+    file_handle_release((file_handle_t *)(uintptr_t)fi->fh);
+    fi->fh = 0;
+    fuse_reply_err(req, 0);
+}
+
+static void smartbackupfs_ll_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+                                   struct fuse_file_info *fi)
+{
+    (void)datasync;
+
+    // 封存写回缓冲中的脏块；启用段存储时再把已追加的块记录落盘
+    file_handle_t *fh = ll_file_handle(fi);
+    file_metadata_t *meta = fh ? fh->meta : ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    int ret = file_sync(meta);
+    fuse_reply_err(req, ret < 0 ? -ret : 0);
+}
+
+// 打开目录：分配readdir游标，记录续读位置
+static void smartbackupfs_ll_opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    int err = 0;
+    if (!ll_get_dir(ino, &err))
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    dir_cursor_t *cursor = calloc(1, sizeof(dir_cursor_t));
+    if (!cursor)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    fi->fh = (uint64_t)(uintptr_t)cursor;
+    if (fuse_reply_open(req, fi) == -ENOENT)
+        free(cursor);
+}
+
+// 填充一个'.'或'..'目录项（readdirplus下不建立内核引用）
+static size_t ll_add_dot_entry(fuse_req_t req, char *buf, size_t bufsize, const char *name,
+                               fuse_ino_t ino, off_t off, bool plus)
+{
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(e));
+    e.attr.st_ino = ino;
+    e.attr.st_mode = S_IFDIR;
+    if (plus)
+        return fuse_add_direntry_plus(req, buf, bufsize, name, &e, off);
+    return fuse_add_direntry(req, buf, bufsize, name, &e.attr, off);
+}
+
+// readdir/readdirplus公共实现
+// 偏移量为目录项cookie：'.'为1，'..'为2，其余目录项插入时分配且不随重命名改变
+static void ll_do_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                          struct fuse_file_info *fi, bool plus)
+{
+    int err = 0;
+    directory_t *dir = ll_get_dir(ino, &err);
+    if (!dir)
+    {
+        fuse_reply_err(req, err);
+        return;
+    }
+
+    char *buf = malloc(size ? size : 1);
+    if (!buf)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+
+    dir_cursor_t *cursor = fi ? (dir_cursor_t *)(uintptr_t)fi->fh : NULL;
+    dir_entry_t *last = NULL;
+    size_t used = 0;
+    size_t len;
+
+    pthread_rwlock_rdlock(&dir->lock);
+    if (off < DIR_COOKIE_DOT)
+    {
+        len = ll_add_dot_entry(req, buf + used, size - used, ".", dir->meta.ino,
+                               DIR_COOKIE_DOT, plus);
+        if (len > size - used)
+            goto full;
+        used += len;
+    }
+    if (off < DIR_COOKIE_DOTDOT)
+    {
+        len = ll_add_dot_entry(req, buf + used, size - used, "..",
+                               dir->meta.parent_ino ? dir->meta.parent_ino : FUSE_ROOT_ID,
+                               DIR_COOKIE_DOTDOT, plus);
+        if (len > size - used)
+            goto full;
+        used += len;
+    }
+    for (dir_entry_t *entry = directory_seek_locked(dir, cursor, (uint64_t)off);
+         entry; entry = entry->next)
+    {
+        if (plus)
+        {
+            struct fuse_entry_param e;
+            ll_fill_entry(entry->meta, &e);
+            len = fuse_add_direntry_plus(req, buf + used, size - used, entry->name, &e,
+                                         (off_t)entry->cookie);
+            // 只有确实放入缓冲区的目录项才增加lookup计数
+            if (len > size - used || ll_ref_meta(entry->meta) != 0)
+                break;
+        }
+        else
+        {
+            struct stat st;
+            memset(&st, 0, sizeof(st));
+            st.st_ino = entry->meta->ino;
+            st.st_mode = entry->meta->mode;
+            len = fuse_add_direntry(req, buf + used, size - used, entry->name, &st,
+                                    (off_t)entry->cookie);
+            if (len > size - used)
+                break;
+        }
+        used += len;
+        last = entry;
+    }
+    if (last)
+        directory_cursor_save_locked(cursor, dir, last, last->cookie);
+full:
+    pthread_rwlock_unlock(&dir->lock);
+
+    fuse_reply_buf(req, buf, used);
+    free(buf);
+}
+
+static void smartbackupfs_ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                                     struct fuse_file_info *fi)
+{
+    ll_do_readdir(req, ino, size, off, fi, false);
+}
+
+// READDIRPLUS：随目录项返回属性并建立lookup引用，省去逐项LOOKUP/GETATTR
+static void smartbackupfs_ll_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+                                         struct fuse_file_info *fi)
+{
+    ll_do_readdir(req, ino, size, off, fi, true);
+}
+
+static void smartbackupfs_ll_releasedir(fuse_req_t req, fuse_ino_t ino,
+                                        struct fuse_file_info *fi)
+{
+    (void)ino;
+    free((dir_cursor_t *)(uintptr_t)fi->fh);
+    fi->fh = 0;
+    fuse_reply_err(req, 0);
+}
+
+static void smartbackupfs_ll_access(fuse_req_t req, fuse_ino_t ino, int mask)
+{
+    (void)mask;
+
+    // 简化的权限检查，与路径前端一致
+    fuse_reply_err(req, ll_get_meta(ino) ? 0 : ENOENT);
+}
+
+static void smartbackupfs_ll_getxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
+                                      size_t size)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    if (size == 0)
+    {
+        int ret = smartbackupfs_xattr_get(meta, name, NULL, 0);
+        if (ret < 0)
+            fuse_reply_err(req, -ret);
+        else
+            fuse_reply_xattr(req, (size_t)ret);
+        return;
+    }
+
+    char *value = malloc(size);
+    if (!value)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    int ret = smartbackupfs_xattr_get(meta, name, value, size);
+    if (ret < 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_buf(req, value, (size_t)ret);
+    free(value);
+}
+
+static void smartbackupfs_ll_setxattr(fuse_req_t req, fuse_ino_t ino, const char *name,
+                                      const char *value, size_t size, int flags)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (!ll_has_write_permission(req, meta))
+    {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+    int ret = smartbackupfs_xattr_set(meta, name, value, size, flags);
+    fuse_reply_err(req, ret < 0 ? -ret : 0);
+}
+
+static void smartbackupfs_ll_listxattr(fuse_req_t req, fuse_ino_t ino, size_t size)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    if (size == 0)
+    {
+        int ret = smartbackupfs_xattr_list(meta, NULL, 0);
+        if (ret < 0)
+            fuse_reply_err(req, -ret);
+        else
+            fuse_reply_xattr(req, (size_t)ret);
+        return;
+    }
+
+    char *list = malloc(size);
+    if (!list)
+    {
+        fuse_reply_err(req, ENOMEM);
+        return;
+    }
+    int ret = smartbackupfs_xattr_list(meta, list, size);
+    if (ret < 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_buf(req, list, (size_t)ret);
+    free(list);
+}
+
+static void smartbackupfs_ll_removexattr(fuse_req_t req, fuse_ino_t ino, const char *name)
+{
+    file_metadata_t *meta = ll_get_meta(ino);
+    if (!meta)
+    {
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+    if (!ll_has_write_permission(req, meta))
+    {
+        fuse_reply_err(req, EACCES);
+        return;
+    }
+    int ret = smartbackupfs_xattr_remove(meta, name);
+    fuse_reply_err(req, ret < 0 ? -ret : 0);
+}
+
+// FUSE低层操作结构
+static const struct fuse_lowlevel_ops smartbackupfs_ll_ops = {
+    .init = smartbackupfs_ll_init,
+    .destroy = smartbackupfs_ll_destroy,
+    .lookup = smartbackupfs_ll_lookup,
+    .forget = smartbackupfs_ll_forget,
+    .forget_multi = smartbackupfs_ll_forget_multi,
+    .getattr = smartbackupfs_ll_getattr,
+    .setattr = smartbackupfs_ll_setattr,
+    .readlink = smartbackupfs_ll_readlink,
+    .mkdir = smartbackupfs_ll_mkdir,
+    .unlink = smartbackupfs_ll_unlink,
+    .rmdir = smartbackupfs_ll_rmdir,
+    .symlink = smartbackupfs_ll_symlink,
+    .rename = smartbackupfs_ll_rename,
+    .link = smartbackupfs_ll_link,
+    .open = smartbackupfs_ll_open,
+    .read = smartbackupfs_ll_read,
+    .write = smartbackupfs_ll_write,
+    .write_buf = smartbackupfs_ll_write_buf,
+    .copy_file_range = smartbackupfs_ll_copy_file_range,
+    .fallocate = smartbackupfs_ll_fallocate,
+    .lseek = smartbackupfs_ll_lseek,
+    .flush = smartbackupfs_ll_flush,
+    .release = smartbackupfs_ll_release,
+    .fsync = smartbackupfs_ll_fsync,
+    .opendir = smartbackupfs_ll_opendir,
+    .readdir = smartbackupfs_ll_readdir,
+    .readdirplus = smartbackupfs_ll_readdirplus,
+    .releasedir = smartbackupfs_ll_releasedir,
+    .access = smartbackupfs_ll_access,
+    .create = smartbackupfs_ll_create,
+    .getxattr = smartbackupfs_ll_getxattr,
+    .setxattr = smartbackupfs_ll_setxattr,
+    .listxattr = smartbackupfs_ll_listxattr,
+    .removexattr = smartbackupfs_ll_removexattr,
+};
+
+int smartbackupfs_ll_main(struct fuse_args *args)
+{
+    struct fuse_cmdline_opts opts;
+    struct fuse_session *se = NULL;
+    int ret = 1;
+
+    if (fuse_parse_cmdline(args, &opts) != 0)
+        return 1;
+
+    if (opts.show_help)
+    {
+        printf("用法: %s --lowlevel [选项] <挂载点>\n\n", args->argv[0]);
+        fuse_cmdline_help();
+        fuse_lowlevel_help();
+        ret = 0;
+        goto out;
+    }
+    if (opts.show_version)
+    {
+        fuse_lowlevel_version();
+        ret = 0;
+        goto out;
+    }
+    if (!opts.mountpoint)
+    {
+        fprintf(stderr, "用法: %s --lowlevel [选项] <挂载点>\n", args->argv[0]);
+        goto out;
+    }
+
+    ll_inodes = shard_map_create(LL_INODE_TABLE_SIZE);
+    if (!ll_inodes)
+        goto out;
+
+    se = fuse_session_new(args, &smartbackupfs_ll_ops, sizeof(smartbackupfs_ll_ops), NULL);
+    if (!se)
+        goto out;
+    if (fuse_set_signal_handlers(se) != 0)
+        goto out_destroy;
+    if (fuse_session_mount(se, opts.mountpoint) != 0)
+        goto out_signals;
+
+    fuse_daemonize(opts.foreground);
+
+    if (opts.singlethread)
+    {
+        ret = fuse_session_loop(se);
+    }
+    else
+    {
+        struct fuse_loop_config *loop_cfg = worker_pool_loop_config(&opts);
+        ret = loop_cfg ? fuse_session_loop_mt(se, loop_cfg) : 1;
+        fuse_loop_cfg_destroy(loop_cfg);
+    }
+
+    fuse_session_unmount(se);
+out_signals:
+    fuse_remove_signal_handlers(se);
+out_destroy:
+    fuse_session_destroy(se);
+out:
+    free(opts.mountpoint);
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * 智能备份文件系统 - 模块A：FUSE工作线程池与线程私有缓冲
+ */
+
+#include "worker_pool.h"
+#include "config_loader.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+
+static _Thread_local worker_scratch_t *tls_scratch;
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+// 线程退出（空闲工作线程被回收）时释放缓冲
+static void scratch_release(void *arg)
+{
+    worker_scratch_t *ws = arg;
+    free(ws->block);
+    free(ws);
+}
+
+static void scratch_key_create(void)
+{
+    pthread_key_create(&scratch_key, scratch_release);
+}
+
+worker_scratch_t *worker_scratch(void)
+{
+    if (tls_scratch)
+        return tls_scratch;
+
+    pthread_once(&scratch_key_once, scratch_key_create);
+    worker_scratch_t *ws = malloc(sizeof(worker_scratch_t));
+    if (!ws)
+        return NULL;
+    ws->block_cap = fs_state.block_size ? fs_state.block_size : DEFAULT_BLOCK_SIZE;
+    ws->block = malloc(ws->block_cap);
+    if (!ws->block)
+    {
+        free(ws);
+        return NULL;
+    }
+
+    pthread_setspecific(scratch_key, ws);
+    tls_scratch = ws;
+    return ws;
+}
+
+char *worker_scratch_block(size_t size)
+{
+    worker_scratch_t *ws = worker_scratch();
+    if (!ws)
+        return NULL;
+    if (size > ws->block_cap)
+    {
+        char *p = realloc(ws->block, size);
+        if (!p)
+            return NULL;
+        ws->block = p;
+        ws->block_cap = size;
+    }
+    return ws->block;
+}
+
+// 解析 "0-7,16,24-31" 形式的CPU列表，成功返回0
+static int parse_cpu_list(const char *list, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    const char *p = list;
+    while (*p)
+    {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE)
+            return -EINVAL;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= CPU_SETSIZE)
+                return -EINVAL;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+
+        while (*p == ' ')
+            p++;
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return -EINVAL;
+        while (*p == ' ')
+            p++;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -EINVAL;
+}
+
+// 当前线程绑定到 performance.cpu_set；libfuse 从本线程派生工作线程，亲和性随之继承
+static void worker_pool_pin_cpus(void)
+{
+    const char *list = config_get("performance.cpu_set");
+    if (!list || !*list)
+        return;
+
+    cpu_set_t set;
+    if (parse_cpu_list(list, &set) != 0)
+    {
+        SBFS_LOG_WARN("performance.cpu_set 格式无效: %s，工作线程不绑定CPU", list);
+        return;
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+        SBFS_LOG_WARN("绑定CPU集合 %s 失败: %s", list, strerror(err));
+    else
+        SBFS_LOG_INFO("FUSE工作线程绑定到CPU %s", list);
+}
+
+// 配置项存在时取配置值，否则取命令行/libfuse默认值
+static unsigned int pool_setting(const char *key, unsigned int fallback)
+{
+    long v = config_get_int(key, -1);
+    if (v < 0)
+        return fallback;
+    return v > UINT_MAX ? UINT_MAX : (unsigned int)v;
+}
+
+struct fuse_loop_config *worker_pool_loop_config(const struct fuse_cmdline_opts *opts)
+{
+    struct fuse_loop_config *cfg = fuse_loop_cfg_create();
+    if (!cfg)
+        return NULL;
+
+    unsigned int max_threads = pool_setting("performance.max_threads", opts->max_threads);
+    unsigned int max_idle = pool_setting("performance.max_idle_threads", opts->max_idle_threads);
+    bool clone_fd = config_get_bool("performance.clone_fd", opts->clone_fd != 0);
+    if (max_threads == 0)
+        max_threads = 1;
+
+    fuse_loop_cfg_set_max_threads(cfg, max_threads);
+    fuse_loop_cfg_set_idle_threads(cfg, max_idle);
+    fuse_loop_cfg_set_clone_fd(cfg, clone_fd ? 1 : 0);
+    worker_pool_pin_cpus();
+
+    SBFS_LOG_INFO("FUSE多线程循环：最多 %u 个工作线程，空闲保留 %d，clone_fd=%s", max_threads,
+                  max_idle == UINT_MAX ? -1 : (int)max_idle, clone_fd ? "on" : "off");
+    return cfg;
+}
@@ -8,6 +8,9 @@
 #include "version_manager.h"
 #include "smartbackupfs.h"
 #include "dedup.h"
+#include "slab.h"
+#include "block_container.h"
+#include "worker_pool.h"
 #include "module_c/cache.h"
 #include "module_c/storage_prediction.h"
 #include <errno.h>
@@ -19,29 +22,237 @@
 #include <pthread.h>
 
 /* 函数原型（由 module_a 提供的实现） */
-hash_table_t *hash_table_create(size_t size);
-void hash_table_destroy(hash_table_t *table);
-void *hash_table_get(hash_table_t *table, uint64_t key);
-int hash_table_set(hash_table_t *table, uint64_t key, void *value);
-
-lru_cache_t *lru_cache_create(size_t max_size);
-void lru_cache_destroy(lru_cache_t *cache);
-int lru_cache_put(lru_cache_t *cache, uint64_t key, void *value);
-void *lru_cache_get(lru_cache_t *cache, uint64_t key);
-int lru_cache_remove(lru_cache_t *cache, uint64_t key);
-
 block_map_t *get_block_map(uint64_t file_ino);
 file_metadata_t *lookup_inode(uint64_t ino);
 
-/* 全局版本链表按文件ino组织 */
-static hash_table_t *versions_by_file = NULL; /* key: file_ino -> value: version_chain_t* */
-static pthread_mutex_t versions_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* 全局版本链表按文件ino组织（分片加锁，不同文件的版本创建互不阻塞） */
+static shard_map_t *versions_by_file = NULL; /* key: file_ino -> value: version_chain_t* */
 static int cleaner_running = 0;
+static pthread_mutex_t cleaner_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cleaner_wake = PTHREAD_COND_INITIALIZER;
 
 
 /* 向前声明：用于父子版本间的数据继承解析 */
 static int snapshot_get_block_data(const version_node_t *vn, uint64_t block_index, const char **data, size_t *size);
 
+/* 版本元数据缓存：按虚拟inode索引的有界LRU，条目带引用计数。
+ * 命中只增加引用；缓存满时回收最久未用且无人引用的条目重新填充，稳定状态下不分配内存。
+ * 加锁顺序：chain->lock 在前，vmeta_cache.lock 在后。
+ */
+#define VERSION_META_CACHE_MAX 2000
+#define VERSION_META_CACHE_BUCKETS 4096
+
+typedef struct version_meta_entry {
+    file_metadata_t meta;              /* 必须为首成员，对外以 file_metadata_t* 传递 */
+    file_meta_ext_t ext;               /* 视图的冷区随条目一起分配，meta.ext 指向这里 */
+    uint32_t refs;                     /* 调用方持有的引用数 */
+    bool cached;                       /* 仍在缓存索引中 */
+    bool stale;                        /* 对应版本已删除（在链写锁下设置） */
+    struct version_meta_entry *hash_next;
+    struct version_meta_entry *lru_prev;   /* 靠近 lru_head 为最近使用 */
+    struct version_meta_entry *lru_next;
+} version_meta_entry_t;
+
+static struct {
+    pthread_mutex_t lock;
+    version_meta_entry_t *buckets[VERSION_META_CACHE_BUCKETS];
+    version_meta_entry_t *lru_head;
+    version_meta_entry_t *lru_tail;
+    size_t count;
+} vmeta_cache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static size_t vmeta_bucket(uint64_t vino)
+{
+    return (size_t)((vino * 0x9E3779B97F4A7C15ULL) >> 32) & (VERSION_META_CACHE_BUCKETS - 1);
+}
+
+static version_meta_entry_t *vmeta_find_locked(uint64_t vino)
+{
+    for (version_meta_entry_t *e = vmeta_cache.buckets[vmeta_bucket(vino)]; e; e = e->hash_next)
+    {
+        if (e->meta.ino == vino)
+            return e;
+    }
+    return NULL;
+}
+
+static void vmeta_lru_unlink_locked(version_meta_entry_t *e)
+{
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        vmeta_cache.lru_head = e->lru_next;
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        vmeta_cache.lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void vmeta_lru_push_locked(version_meta_entry_t *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = vmeta_cache.lru_head;
+    if (vmeta_cache.lru_head)
+        vmeta_cache.lru_head->lru_prev = e;
+    vmeta_cache.lru_head = e;
+    if (!vmeta_cache.lru_tail)
+        vmeta_cache.lru_tail = e;
+}
+
+/* 从缓存索引中摘除（不释放） */
+static void vmeta_detach_locked(version_meta_entry_t *e)
+{
+    version_meta_entry_t **link = &vmeta_cache.buckets[vmeta_bucket(e->meta.ino)];
+    while (*link && *link != e)
+        link = &(*link)->hash_next;
+    if (*link)
+        *link = e->hash_next;
+    e->hash_next = NULL;
+    vmeta_lru_unlink_locked(e);
+    e->cached = false;
+    vmeta_cache.count--;
+}
+
+static void vmeta_free(version_meta_entry_t *e)
+{
+    free(e->ext.comment);
+    free(e);
+}
+
+/* 由文件元数据与版本节点填充版本视图（调用方持有 chain->lock） */
+static void vmeta_fill(version_meta_entry_t *e, const file_metadata_t *meta, const version_node_t *vn)
+{
+    file_metadata_t *v = &e->meta;
+    v->ino = VERSION_INO(meta->ino, vn->version_id);
+    v->type = FT_VERSIONED;
+    /* 版本视图只读 */
+    v->mode = meta->mode & ~(mode_t)(S_IWUSR | S_IWGRP | S_IWOTH);
+    v->nlink = 1;
+    v->uid = meta->uid;
+    v->gid = meta->gid;
+    v->size = (off_t)vn->file_size;
+    v->blocks = vn->blocks;
+    v->atime = meta->atime;
+    v->mtime.tv_sec = vn->create_time;
+    v->mtime.tv_nsec = 0;
+    v->ctime = v->mtime;
+    v->parent_ino = meta->parent_ino;
+    v->current_block_map = NULL;
+    free(e->ext.comment);
+    e->ext = (file_meta_ext_t){
+        .latest_version_id = file_meta_ext(meta)->latest_version_id,
+        .last_version_time = vn->create_time,
+        .version_handle = (void *)vn,
+        .version_pinned = vn->is_important,
+    };
+    v->ext = &e->ext;
+    e->stale = false;
+}
+
+/* 取得版本视图的引用（调用方持有 chain->lock） */
+static file_metadata_t *vmeta_acquire(const file_metadata_t *meta, const version_node_t *vn)
+{
+    if (!VERSION_INO_VALID(meta->ino, vn->version_id))
+        return NULL;
+    uint64_t vino = VERSION_INO(meta->ino, vn->version_id);
+
+    pthread_mutex_lock(&vmeta_cache.lock);
+    version_meta_entry_t *e = vmeta_find_locked(vino);
+    if (e)
+    {
+        e->refs++;
+        vmeta_lru_unlink_locked(e);
+        vmeta_lru_push_locked(e);
+        pthread_mutex_unlock(&vmeta_cache.lock);
+        return &e->meta;
+    }
+
+    /* 缓存已满：从尾部找一个无人引用的条目复用 */
+    if (vmeta_cache.count >= VERSION_META_CACHE_MAX)
+    {
+        for (version_meta_entry_t *victim = vmeta_cache.lru_tail; victim; victim = victim->lru_prev)
+        {
+            if (victim->refs == 0)
+            {
+                vmeta_detach_locked(victim);
+                e = victim;
+                break;
+            }
+        }
+    }
+    if (!e)
+    {
+        e = calloc(1, sizeof(version_meta_entry_t));
+        if (!e)
+        {
+            pthread_mutex_unlock(&vmeta_cache.lock);
+            return NULL;
+        }
+    }
+
+    vmeta_fill(e, meta, vn);
+    e->refs = 1;
+    e->cached = true;
+    size_t b = vmeta_bucket(vino);
+    e->hash_next = vmeta_cache.buckets[b];
+    vmeta_cache.buckets[b] = e;
+    vmeta_lru_push_locked(e);
+    vmeta_cache.count++;
+    pthread_mutex_unlock(&vmeta_cache.lock);
+    return &e->meta;
+}
+
+/* 版本被删除：使缓存中的视图失效，仍被引用的视图在最后一个引用释放时回收（调用方持有 chain 写锁） */
+static void vmeta_invalidate(uint64_t file_ino, uint64_t version_id)
+{
+    if (!VERSION_INO_VALID(file_ino, version_id))
+        return;
+
+    pthread_mutex_lock(&vmeta_cache.lock);
+    version_meta_entry_t *e = vmeta_find_locked(VERSION_INO(file_ino, version_id));
+    if (e)
+    {
+        e->stale = true;
+        e->ext.version_handle = NULL;
+        vmeta_detach_locked(e);
+        if (e->refs == 0)
+            vmeta_free(e);
+    }
+    pthread_mutex_unlock(&vmeta_cache.lock);
+}
+
+void version_manager_put_version_meta(file_metadata_t *vmeta)
+{
+    if (!vmeta || vmeta->type != FT_VERSIONED)
+        return;
+
+    version_meta_entry_t *e = (version_meta_entry_t *)vmeta;
+    pthread_mutex_lock(&vmeta_cache.lock);
+    if (e->refs > 0)
+        e->refs--;
+    bool release = (e->refs == 0 && !e->cached);
+    pthread_mutex_unlock(&vmeta_cache.lock);
+
+    if (release)
+        vmeta_free(e);
+}
+
+static void vmeta_cache_clear(void)
+{
+    pthread_mutex_lock(&vmeta_cache.lock);
+    version_meta_entry_t *e = vmeta_cache.lru_head;
+    while (e)
+    {
+        version_meta_entry_t *next = e->lru_next;
+        vmeta_detach_locked(e);
+        if (e->refs == 0)
+            vmeta_free(e);
+        e = next;
+    }
+    pthread_mutex_unlock(&vmeta_cache.lock);
+}
+
 /* 从链表中移除并释放一个版本节点（调用方持有 chain->lock） */
 static version_node_t *version_remove_node_locked(version_chain_t *chain, version_node_t *del, file_metadata_t *meta, uint64_t *added_bytes)
 {
@@ -75,10 +286,11 @@ static version_node_t *version_remove_node_locked(version_chain_t *chain, versio
                 size_t sz = 0;
                 if (snapshot_get_block_data(del, i, &data, &sz) == 0 && data && sz > 0)
                 {
-                    char *copy = malloc(sz);
+                    char *copy = slab_alloc(sz);
                     if (copy)
                     {
                         memcpy(copy, data, sz);
+                        block_container_advise(copy, sz, BLOCK_CONTAINER_COLD);
                         iter->snapshots[i].data = copy;
                         iter->snapshots[i].size = sz;
                         iter->snapshots[i].has_data = true;
@@ -95,7 +307,7 @@ static version_node_t *version_remove_node_locked(version_chain_t *chain, versio
     for (size_t i = 0; i < del->snapshot_count; i++)
     {
         if (del->snapshots[i].has_data)
-            free(del->snapshots[i].data);
+            slab_free(del->snapshots[i].data);
     }
     free(del->snapshots);
     free(del->diff_blocks);
@@ -103,16 +315,15 @@ static version_node_t *version_remove_node_locked(version_chain_t *chain, versio
     if (del->description)
         free(del->description);
 
-    uint64_t key = (chain->file_ino << 32) | (del->version_id & 0xffffffffULL);
-    if (fs_state.version_cache)
-        lru_cache_remove(fs_state.version_cache, key);
+    vmeta_invalidate(chain->file_ino, del->version_id);
 
-    if (meta)
+    file_meta_ext_t *ext = meta ? meta->ext : NULL;
+    if (ext)
     {
-        if (meta->version_count > 0)
-            meta->version_count--;
-        if (meta->latest_version_id == del->version_id)
-            meta->latest_version_id = chain->head ? chain->head->version_id : 0;
+        if (ext->version_count > 0)
+            ext->version_count--;
+        if (ext->latest_version_id == del->version_id)
+            ext->latest_version_id = chain->head ? chain->head->version_id : 0;
     }
 
     if (added_bytes)
@@ -166,7 +377,7 @@ static void version_apply_retention_locked(version_chain_t *chain, file_metadata
     if (!chain)
         return;
 
-    if (meta && meta->version_pinned)
+    if (meta && file_meta_ext(meta)->version_pinned)
         return;
 
     size_t keep = fs_state.version_max_versions ? fs_state.version_max_versions : fs_state.version_retention_count;
@@ -211,21 +422,28 @@ static void version_apply_retention_locked(version_chain_t *chain, file_metadata
 /* 内部帮助函数：查找或创建version_chain */
 static version_chain_t *get_or_create_chain(uint64_t file_ino)
 {
-    pthread_mutex_lock(&versions_mutex);
-    version_chain_t *chain = hash_table_get(versions_by_file, file_ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, file_ino);
+    if (chain)
+        return chain;
+
+    hash_table_t *shard = shard_map_lock(versions_by_file, file_ino);
+    chain = hash_table_get_locked(shard, file_ino);
     if (!chain)
     {
         chain = calloc(1, sizeof(version_chain_t));
-        if (!chain)
+        if (chain)
         {
-            pthread_mutex_unlock(&versions_mutex);
-            return NULL;
+            chain->file_ino = file_ino;
+            pthread_rwlock_init(&chain->lock, NULL);
+            if (hash_table_set_locked(shard, file_ino, chain) != 0)
+            {
+                pthread_rwlock_destroy(&chain->lock);
+                free(chain);
+                chain = NULL;
+            }
         }
-        chain->file_ino = file_ino;
-        pthread_rwlock_init(&chain->lock, NULL);
-        hash_table_set(versions_by_file, file_ino, chain);
     }
-    pthread_mutex_unlock(&versions_mutex);
+    shard_map_unlock(shard);
     return chain;
 }
 
@@ -274,58 +492,51 @@ time_t version_manager_parse_time_expr(const char *expr)
     return 0;
 }
 
-size_t version_manager_collect_samples(version_history_sample_t *buf, size_t max_samples)
+typedef struct {
+    version_history_sample_t *buf;
+    size_t max_samples;
+    size_t count;
+} sample_collect_ctx_t;
+
+static void collect_chain_samples(uint64_t key, void *value, void *arg)
 {
-    if (!versions_by_file)
-        return 0;
-    size_t count = 0;
+    (void)key;
+    version_chain_t *chain = value;
+    sample_collect_ctx_t *ctx = arg;
+    if (ctx->buf && ctx->count >= ctx->max_samples)
+        return;
 
-    pthread_mutex_lock(&versions_mutex);
-    for (size_t i = 0; i < versions_by_file->size; i++)
+    pthread_rwlock_rdlock(&chain->lock);
+    for (version_node_t *vn = chain->head; vn; vn = vn->next)
     {
-        hash_node_t *node = versions_by_file->buckets[i];
-        while (node)
+        if (ctx->buf && ctx->count < ctx->max_samples)
         {
-            version_chain_t *chain = node->value;
-            if (chain)
-            {
-                pthread_rwlock_rdlock(&chain->lock);
-                for (version_node_t *vn = chain->head; vn; vn = vn->next)
-                {
-                    if (buf && count < max_samples)
-                    {
-                        buf[count].create_time = vn->create_time;
-                        buf[count].file_size = vn->file_size;
-                    }
-                    count++;
-                    if (buf && count >= max_samples)
-                        break;
-                }
-                pthread_rwlock_unlock(&chain->lock);
-            }
-            if (buf && count >= max_samples)
-                break;
-            node = node->next;
+            ctx->buf[ctx->count].create_time = vn->create_time;
+            ctx->buf[ctx->count].file_size = vn->file_size;
         }
-        if (buf && count >= max_samples)
+        ctx->count++;
+        if (ctx->buf && ctx->count >= ctx->max_samples)
             break;
     }
-    pthread_mutex_unlock(&versions_mutex);
-    return count;
+    pthread_rwlock_unlock(&chain->lock);
+}
+
+size_t version_manager_collect_samples(version_history_sample_t *buf, size_t max_samples)
+{
+    if (!versions_by_file)
+        return 0;
+
+    sample_collect_ctx_t ctx = {.buf = buf, .max_samples = max_samples, .count = 0};
+    shard_map_foreach(versions_by_file, collect_chain_samples, &ctx);
+    return ctx.count;
 }
 
 int version_manager_init(void)
 {
-    versions_by_file = hash_table_create(4096);
+    versions_by_file = shard_map_create(4096);
     if (!versions_by_file)
         return -ENOMEM;
 
-    /* 确保fs_state的版本缓存存在（若尚未初始化） */
-    if (!fs_state.version_cache)
-    {
-        fs_state.version_cache = lru_cache_create(2000); /* 2k条版本元数据缓存 */
-    }
-
     /* 默认配置 */
     if (fs_state.version_time_interval == 0)
         fs_state.version_time_interval = 3600; /* 1小时 */
@@ -349,6 +560,37 @@ int version_manager_init(void)
     return 0;
 }
 
+static void free_version_chain(uint64_t key, void *value, void *arg)
+{
+    (void)key;
+    (void)arg;
+    version_chain_t *chain = value;
+    pthread_rwlock_wrlock(&chain->lock);
+    version_node_t *vn = chain->head;
+    while (vn)
+    {
+        version_node_t *next = vn->next;
+        if (vn->snapshots)
+        {
+            for (size_t i = 0; i < vn->snapshot_count; i++)
+            {
+                if (vn->snapshots[i].has_data)
+                    slab_free(vn->snapshots[i].data);
+            }
+            free(vn->snapshots);
+        }
+        if (vn->description)
+            free(vn->description);
+        free(vn->diff_blocks);
+        free(vn->block_checksums);
+        free(vn);
+        vn = next;
+    }
+    pthread_rwlock_unlock(&chain->lock);
+    pthread_rwlock_destroy(&chain->lock);
+    free(chain);
+}
+
 void version_manager_destroy(void)
 {
     /* 停止清理线程 */
@@ -358,53 +600,26 @@ void version_manager_destroy(void)
         return;
 
     /* 释放所有chains */
-    pthread_rwlock_wrlock(&versions_by_file->lock);
-    for (size_t i = 0; i < versions_by_file->size; i++)
-    {
-        hash_node_t *node = versions_by_file->buckets[i];
-        while (node)
-        {
-            version_chain_t *chain = node->value;
-            if (chain)
-            {
-                pthread_rwlock_wrlock(&chain->lock);
-                version_node_t *vn = chain->head;
-                while (vn)
-                {
-                    version_node_t *next = vn->next;
-                    if (vn->snapshots)
-                    {
-                        for (size_t i = 0; i < vn->snapshot_count; i++)
-                        {
-                            if (vn->snapshots[i].has_data)
-                                free(vn->snapshots[i].data);
-                        }
-                        free(vn->snapshots);
-                    }
-                    if (vn->description)
-                        free(vn->description);
-                    free(vn->diff_blocks);
-                    free(vn->block_checksums);
-                    free(vn);
-                    vn = next;
-                }
-                pthread_rwlock_unlock(&chain->lock);
-                pthread_rwlock_destroy(&chain->lock);
-                free(chain);
-            }
-            node = node->next;
-        }
-    }
-    pthread_rwlock_unlock(&versions_by_file->lock);
-
-    hash_table_destroy(versions_by_file);
+    shard_map_foreach(versions_by_file, free_version_chain, NULL);
+    shard_map_destroy(versions_by_file);
     versions_by_file = NULL;
 
-    if (fs_state.version_cache)
+    vmeta_cache_clear();
+}
+
+/* 取块的原始内容：压缩块解压到线程私有缓冲（不分配内存，下一次解压前有效）；
+ * 解压失败时退回按压缩数据本身计算 */
+static const char *version_block_plain(data_block_t *b, size_t *plain_size)
+{
+    *plain_size = b->size;
+    if (b->compressed_size > 0 && b->compression != COMPRESSION_NONE)
     {
-        lru_cache_destroy(fs_state.version_cache);
-        fs_state.version_cache = NULL;
+        char *plain = worker_scratch_block(b->size);
+        if (plain && block_decompress_into(b, plain, b->size, plain_size) == 0)
+            return plain;
+        *plain_size = b->compressed_size;
     }
+    return b->data;
 }
 
 /* 创建版本：基于块校验和计算差异，仅保存差异块的索引和每个块的校验和快照 */
@@ -421,6 +636,11 @@ int version_manager_create_version(file_metadata_t *meta, const char *reason)
     if (!chain)
         return -ENOMEM;
 
+    /* 版本计数记在冷区，首个版本时分配 */
+    file_meta_ext_t *ext = file_meta_ext_get(meta);
+    if (!ext)
+        return -ENOMEM;
+
     version_node_t *vn = calloc(1, sizeof(version_node_t));
     if (!vn)
         return -ENOMEM;
@@ -462,7 +682,7 @@ int version_manager_create_version(file_metadata_t *meta, const char *reason)
 
         for (size_t i = 0; i < vn->block_count; i++)
         {
-            data_block_t *b = map->blocks[i];
+            data_block_t *b = block_map_get(map, i);
             uint32_t prev = (vn->parent && i < vn->parent->block_count) ? vn->parent->block_checksums[i] : 0;
             uint32_t cur = 0;
             size_t plain_size = 0;
@@ -470,26 +690,18 @@ int version_manager_create_version(file_metadata_t *meta, const char *reason)
 
             if (b && b->data)
             {
-                char *owned = NULL;
-                plain_size = b->size;
-                plain = b->data;
-                if (b->compressed_size > 0 && b->compression != COMPRESSION_NONE)
-                {
-                    if (block_decompress(b, &owned, &plain_size) == 0 && owned)
-                        plain = owned;
-                    else
-                        plain_size = b->size;
-                }
-
+                plain = version_block_plain(b, &plain_size);
                 cur = rolling_checksum(plain, plain_size);
 
                 if (cur != prev || !vn->parent)
                 {
                     vn->snapshots[i].size = plain_size;
-                    vn->snapshots[i].data = malloc(plain_size);
+                    // 快照数据与块数据同在 slab 中（配置了块容器时即在容器里），写入后很少再读，提示优先回收
+                    vn->snapshots[i].data = slab_alloc(plain_size);
                     if (vn->snapshots[i].data)
                     {
                         memcpy(vn->snapshots[i].data, plain, plain_size);
+                        block_container_advise(vn->snapshots[i].data, plain_size, BLOCK_CONTAINER_COLD);
                         vn->snapshots[i].has_data = true;
                         vn->stored_bytes += plain_size;
                     }
@@ -501,9 +713,6 @@ int version_manager_create_version(file_metadata_t *meta, const char *reason)
                     vn->snapshots[i].data = NULL;
                     vn->snapshots[i].has_data = false;
                 }
-
-                if (owned)
-                    free(owned);
             }
             else
             {
@@ -532,20 +741,9 @@ int version_manager_create_version(file_metadata_t *meta, const char *reason)
     version_apply_retention_locked(chain, meta, time(NULL));
 
     /* 更新文件元数据中的版本计数 */
-    meta->version_count++;
-    meta->latest_version_id = vn->version_id;
-    meta->last_version_time = vn->create_time;
-    /* 将版本元数据缓存到 fs_state.version_cache 以便快速访问 */
-    file_metadata_t *vmeta = malloc(sizeof(file_metadata_t));
-    if (vmeta)
-    {
-        memcpy(vmeta, meta, sizeof(file_metadata_t));
-        vmeta->type = FT_VERSIONED;
-        /* 组合key：高32位为ino，低32位为version_id */
-        uint64_t key = (meta->ino << 32) | (vn->version_id & 0xffffffffULL);
-        vmeta->version_handle = vn;
-        lru_cache_put(fs_state.version_cache, key, vmeta);
-    }
+    ext->version_count++;
+    ext->latest_version_id = vn->version_id;
+    ext->last_version_time = vn->create_time;
 
     pthread_rwlock_unlock(&chain->lock);
 
@@ -565,7 +763,7 @@ int version_manager_maybe_change_snapshot(file_metadata_t *meta)
     if (!meta)
         return -EINVAL;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, meta->ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, meta->ino);
     if (!chain || !chain->head)
         return 0; /* 没有历史版本，不触发 */
 
@@ -584,23 +782,13 @@ int version_manager_maybe_change_snapshot(file_metadata_t *meta)
     size_t diffcnt = 0;
     for (size_t i = 0; i < block_count; i++)
     {
-        data_block_t *b = map->blocks[i];
+        data_block_t *b = block_map_get(map, i);
         uint32_t cur = 0;
         if (b && b->data)
         {
-            char *owned = NULL;
-            size_t plain_size = b->size;
-            const char *plain = b->data;
-            if (b->compressed_size > 0 && b->compression != COMPRESSION_NONE)
-            {
-                if (block_decompress(b, &owned, &plain_size) == 0 && owned)
-                    plain = owned;
-                else
-                    plain_size = b->size;
-            }
+            size_t plain_size = 0;
+            const char *plain = version_block_plain(b, &plain_size);
             cur = rolling_checksum(plain, plain_size);
-            if (owned)
-                free(owned);
         }
         uint32_t prev = (i < chain->head->block_count) ? chain->head->block_checksums[i] : 0;
         if (cur != prev)
@@ -623,20 +811,21 @@ int version_manager_create_periodic(file_metadata_t *meta, const char *reason)
         return -EINVAL;
     time_t now = time(NULL);
     uint32_t interval = fs_state.version_time_interval ? fs_state.version_time_interval : 3600;
-    if (meta->last_version_time == 0 || (now - meta->last_version_time) >= (time_t)interval)
+    time_t last = file_meta_ext(meta)->last_version_time;
+    if (last == 0 || (now - last) >= (time_t)interval)
     {
         return version_manager_create_version(meta, reason ? reason : "periodic");
     }
     return 0;
 }
 
-/* 根据版本字符串（v<num> / latest）返回版本元数据副本 */
+/* 根据版本字符串（v<num> / latest / 时间表达式）返回版本视图的引用 */
 file_metadata_t *version_manager_get_version_meta(file_metadata_t *meta, const char *verstr)
 {
     if (!meta || !verstr)
         return NULL;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, meta->ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, meta->ino);
     if (!chain)
         return NULL;
 
@@ -678,45 +867,54 @@ file_metadata_t *version_manager_get_version_meta(file_metadata_t *meta, const c
     if (!vn && best_time)
         vn = best_time;
 
-    if (!vn)
-    {
-        pthread_rwlock_unlock(&chain->lock);
-        return NULL;
-    }
+    file_metadata_t *vmeta = vn ? vmeta_acquire(meta, vn) : NULL;
+    pthread_rwlock_unlock(&chain->lock);
+    return vmeta;
+}
 
-    /* 从缓存尝试取 */
-    uint64_t key = (meta->ino << 32) | (vn->version_id & 0xffffffffULL);
-    file_metadata_t *cached = (file_metadata_t *)lru_cache_get(fs_state.version_cache, key);
-    if (cached)
+/* 格式化 @versions 目录项名称："v<ID> | <时间> | <描述>" */
+static void version_format_entry(const version_node_t *vn, char *buf, size_t size)
+{
+    char tbuf[32] = {0};
+    struct tm tmv;
+    localtime_r(&vn->create_time, &tmv);
+    strftime(tbuf, sizeof(tbuf), "%F %T", &tmv);
+    const char *desc = vn->description ? vn->description : "auto";
+    snprintf(buf, size, "v%llu | %s | %s", (unsigned long long)vn->version_id, tbuf, desc);
+    /* 描述来自用户输入，不能含路径分隔符 */
+    for (char *p = buf; *p; p++)
     {
-        /* 返回副本，避免外部修改缓存对象 */
-        file_metadata_t *copy = malloc(sizeof(file_metadata_t));
-        if (copy)
-            memcpy(copy, cached, sizeof(file_metadata_t));
-        pthread_rwlock_unlock(&chain->lock);
-        return copy;
+        if (*p == '/')
+            *p = '_';
     }
+}
 
-    /* 否则，基于原始meta构造一个版本元数据副本 */
-    file_metadata_t *vmeta = malloc(sizeof(file_metadata_t));
-    if (!vmeta)
-    {
-        pthread_rwlock_unlock(&chain->lock);
-        return NULL;
-    }
-    memcpy(vmeta, meta, sizeof(file_metadata_t));
-    vmeta->type = FT_VERSIONED;
-    vmeta->version = (uint32_t)vn->version_id;
-    vmeta->size = vn->file_size;
-    vmeta->blocks = vn->blocks;
-    vmeta->version_handle = vn;
-    /* 不改变 ino，使得读取流程简化（真实实现可分配独立ino） */
+int version_manager_for_each_version(file_metadata_t *meta, uint64_t below_id,
+                                     version_visit_fn fn, void *ctx)
+{
+    if (!meta || !fn)
+        return -EINVAL;
 
-    /* 缓存版本元数据 */
-    lru_cache_put(fs_state.version_cache, key, vmeta);
+    version_chain_t *chain = shard_map_get(versions_by_file, meta->ino);
+    if (!chain)
+        return 0;
 
+    char name[VERSION_ENTRY_NAME_MAX];
+    int ret = 0;
+    pthread_rwlock_rdlock(&chain->lock);
+    /* 链表按版本ID降序排列（最新在head） */
+    for (version_node_t *vn = chain->head; vn; vn = vn->next)
+    {
+        if (below_id && vn->version_id >= below_id)
+            continue;
+        version_format_entry(vn, name, sizeof(name));
+        ret = fn(ctx, name, VERSION_INO(meta->ino, vn->version_id), vn->version_id,
+                 (off_t)vn->file_size, vn->create_time);
+        if (ret != 0)
+            break;
+    }
     pthread_rwlock_unlock(&chain->lock);
-    return vmeta;
+    return ret;
 }
 
 int version_manager_list_versions(file_metadata_t *meta, char ***out_list, size_t *out_count)
@@ -724,7 +922,7 @@ int version_manager_list_versions(file_metadata_t *meta, char ***out_list, size_
     if (!meta || !out_list || !out_count)
         return -EINVAL;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, meta->ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, meta->ino);
     if (!chain)
     {
         *out_list = NULL;
@@ -745,13 +943,8 @@ int version_manager_list_versions(file_metadata_t *meta, char ***out_list, size_
     size_t i = 0;
     while (vn && i < n)
     {
-        char buf[128];
-        char tbuf[32] = {0};
-        struct tm tmv;
-        localtime_r(&vn->create_time, &tmv);
-        strftime(tbuf, sizeof(tbuf), "%F %T", &tmv);
-        const char *desc = vn->description ? vn->description : "auto";
-        snprintf(buf, sizeof(buf), "v%llu | %s | %s", (unsigned long long)vn->version_id, tbuf, desc);
+        char buf[VERSION_ENTRY_NAME_MAX];
+        version_format_entry(vn, buf, sizeof(buf));
         list[i] = strdup(buf);
         i++;
         vn = vn->next;
@@ -769,7 +962,7 @@ uint64_t version_manager_get_version_by_time(uint64_t ino, time_t target_time)
     if (!target_time)
         return 0;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, ino);
     if (!chain)
         return 0;
 
@@ -792,10 +985,28 @@ uint64_t version_manager_get_version_by_time(uint64_t ino, time_t target_time)
 
 int version_manager_read_version_data(file_metadata_t *vmeta, char *buf, size_t size, off_t offset)
 {
-    if (!vmeta || !buf || !vmeta->version_handle)
+    if (!vmeta || !buf || vmeta->type != FT_VERSIONED)
+        return -EINVAL;
+
+    version_chain_t *chain = shard_map_get(versions_by_file, VERSION_INO_BASE(vmeta->ino));
+    if (!chain)
+        return -ESTALE;
+
+    /* 持有链读锁期间版本节点不会被释放；视图已失效说明版本已被删除 */
+    pthread_rwlock_rdlock(&chain->lock);
+    int ret = -ESTALE;
+    const version_node_t *vn = ((version_meta_entry_t *)vmeta)->ext.version_handle;
+    if (!((version_meta_entry_t *)vmeta)->stale && vn)
+        ret = version_manager_read_node_data(vn, buf, size, offset);
+    pthread_rwlock_unlock(&chain->lock);
+    return ret;
+}
+
+int version_manager_read_node_data(const version_node_t *vn, char *buf, size_t size, off_t offset)
+{
+    if (!vn || !buf)
         return -EINVAL;
 
-    version_node_t *vn = (version_node_t *)vmeta->version_handle;
     size_t fsize = vn->file_size;
     if (offset < 0 || (size_t)offset >= fsize)
         return 0;
@@ -844,7 +1055,7 @@ int version_manager_delete_version(uint64_t ino, uint64_t version_id)
     if (!version_id)
         return -EINVAL;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, ino);
     if (!chain)
         return -ENOENT;
 
@@ -877,7 +1088,7 @@ int version_manager_delete_version(uint64_t ino, uint64_t version_id)
 
 int version_manager_mark_important(uint64_t ino, uint64_t version_id, bool important)
 {
-    version_chain_t *chain = hash_table_get(versions_by_file, ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, ino);
     if (!chain)
         return -ENOENT;
     pthread_rwlock_wrlock(&chain->lock);
@@ -901,7 +1112,7 @@ int version_manager_diff(file_metadata_t *meta, uint64_t v1, uint64_t v2, char *
     if (!meta || !out_diff)
         return -EINVAL;
 
-    version_chain_t *chain = hash_table_get(versions_by_file, meta->ino);
+    version_chain_t *chain = shard_map_get(versions_by_file, meta->ino);
     if (!chain)
         return -ENOENT;
 
@@ -941,48 +1152,63 @@ int version_manager_diff(file_metadata_t *meta, uint64_t v1, uint64_t v2, char *
     return 0;
 }
 
+typedef struct {
+    version_chain_t **chains;
+    size_t cap;
+    size_t count;
+} chain_snapshot_t;
+
+static void snapshot_chain(uint64_t key, void *value, void *arg)
+{
+    (void)key;
+    chain_snapshot_t *snap = arg;
+    if (snap->count < snap->cap)
+        snap->chains[snap->count++] = value;
+}
+
 /* 后台清理线程函数 */
 static void *version_cleaner_thread_fn(void *arg)
 {
     (void)arg;
-    cleaner_running = 1;
-    while (cleaner_running)
+    while (__atomic_load_n(&cleaner_running, __ATOMIC_ACQUIRE))
     {
         /* 轮询所有文件的版本链，按保留策略删除过期版本 */
         time_t now = time(NULL);
-        pthread_mutex_lock(&versions_mutex);
-        for (size_t i = 0; i < versions_by_file->size; i++)
+
+        /* 先取出版本链快照再逐个处理：生成周期版本可能新建版本链（需要分片写锁），
+         * 不能在遍历持有分片读锁期间进行；版本链创建后直到卸载才释放，快照中的指针始终有效 */
+        chain_snapshot_t snap = {.cap = shard_map_size(versions_by_file), .count = 0};
+        snap.chains = snap.cap ? malloc(snap.cap * sizeof(version_chain_t *)) : NULL;
+        if (snap.chains)
+            shard_map_foreach(versions_by_file, snapshot_chain, &snap);
+
+        for (size_t i = 0; i < snap.count; i++)
         {
-            hash_node_t *node = versions_by_file->buckets[i];
-            while (node)
-            {
-                version_chain_t *chain = node->value;
-                if (chain)
-                {
-                    file_metadata_t *meta = lookup_inode(chain->file_ino);
-                    if (meta && meta->version_pinned)
-                    {
-                        node = node->next;
-                        continue;
-                    }
+            version_chain_t *chain = snap.chains[i];
+            file_metadata_t *meta = lookup_inode(chain->file_ino);
+            if (meta && file_meta_ext(meta)->version_pinned)
+                continue;
 
-                    if (meta)
-                        version_manager_create_periodic(meta, "periodic");
+            if (meta)
+                version_manager_create_periodic(meta, "periodic");
 
-                    pthread_rwlock_wrlock(&chain->lock);
-                    version_apply_retention_locked(chain, meta, now);
-                    pthread_rwlock_unlock(&chain->lock);
-                }
-                node = node->next;
-            }
+            pthread_rwlock_wrlock(&chain->lock);
+            version_apply_retention_locked(chain, meta, now);
+            pthread_rwlock_unlock(&chain->lock);
         }
-        pthread_mutex_unlock(&versions_mutex);
+        free(snap.chains);
 
         /* 刷新缓存脏页（复用清理调度周期） */
         cache_flush_l2_dirty();
 
-        /* 休眠一段时间后继续 */
-        sleep(fs_state.version_clean_interval ? fs_state.version_clean_interval : 3600);
+        /* 休眠一段时间后继续；卸载时立即唤醒 */
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += fs_state.version_clean_interval ? fs_state.version_clean_interval : 3600;
+        pthread_mutex_lock(&cleaner_wake_lock);
+        if (cleaner_running)
+            pthread_cond_timedwait(&cleaner_wake, &cleaner_wake_lock, &ts);
+        pthread_mutex_unlock(&cleaner_wake_lock);
     }
     return NULL;
 }
@@ -992,8 +1218,11 @@ int version_manager_start_cleaner(void)
     if (fs_state.version_cleaner_thread)
         return 0; /* 已启动 */
 
+    // 在线程外置位：线程尚未运行到循环时调用 stop 也不会错过停止标志
+    cleaner_running = 1;
     if (pthread_create(&fs_state.version_cleaner_thread, NULL, version_cleaner_thread_fn, NULL) != 0)
     {
+        cleaner_running = 0;
         return -errno;
     }
     return 0;
@@ -1003,7 +1232,10 @@ void version_manager_stop_cleaner(void)
 {
     if (!fs_state.version_cleaner_thread)
         return;
+    pthread_mutex_lock(&cleaner_wake_lock);
     cleaner_running = 0;
+    pthread_cond_signal(&cleaner_wake);
+    pthread_mutex_unlock(&cleaner_wake_lock);
     pthread_join(fs_state.version_cleaner_thread, NULL);
     fs_state.version_cleaner_thread = 0;
 }
@@ -103,6 +103,9 @@ int ac_adaptive_compress_block(data_block_t *block, dedup_config_t *cfg)
 {
     if (!block || !cfg)
         return -1;
+    /* 去重复用的块可能已压缩：data 中是压缩数据，既不能按 size 探测类型，也不再二次压缩 */
+    if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
+        return 0;
     size_t raw_before = block->size;
     ac_file_type_t type = ac_detect_file_type(block);
     double norm_load = sm_normalized_load();
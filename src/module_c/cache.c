@@ -1,5 +1,8 @@
 #include "module_c/cache.h"
 #include "dedup.h"
+#include "epoch.h"
+#include "slab.h"
+#include "worker_pool.h"
 #include "module_c/storage_monitor_basic.h"
 
 #include <stdlib.h>
@@ -14,14 +17,6 @@
 
 extern fs_state_t fs_state;
 
-/* hash_table_* provided by module A */
-hash_table_t *hash_table_create(size_t size);
-void hash_table_destroy(hash_table_t *table);
-int hash_table_set(hash_table_t *table, uint64_t key, void *value);
-void *hash_table_get(hash_table_t *table, uint64_t key);
-int hash_table_remove(hash_table_t *table, uint64_t key);
-size_t hash_table_size(hash_table_t *table);
-
 static multi_level_cache_t g_cache;
 typedef struct l3_entry
 {
@@ -47,14 +42,14 @@ static int g_flush_wakeup = 0;
 
 static data_block_t *l2_alloc_block(uint64_t block_id, size_t size)
 {
-    data_block_t *blk = calloc(1, sizeof(data_block_t));
+    data_block_t *blk = slab_zalloc(sizeof(data_block_t));
     if (!blk)
         return NULL;
     blk->block_id = block_id;
-    blk->data = malloc(size);
+    blk->data = slab_alloc(size);
     if (!blk->data)
     {
-        free(blk);
+        slab_free(blk);
         return NULL;
     }
     blk->size = size;
@@ -65,14 +60,14 @@ static data_block_t *l2_alloc_block(uint64_t block_id, size_t size)
     return blk;
 }
 
-static void l2_free_block(data_block_t *blk)
+static void l2_free_block(void *ptr)
 {
+    data_block_t *blk = ptr;
     if (!blk)
         return;
-    if (blk->data)
-        free(blk->data);
+    slab_free(blk->data);
     pthread_mutex_destroy(&blk->ref_lock);
-    free(blk);
+    slab_free(blk);
 }
 
 static size_t l1_block_size(data_block_t *blk)
@@ -140,6 +135,16 @@ static void l1_evict_until_fit(size_t incoming)
     }
 }
 
+// 插入或替换 L1 条目（持 L1 写锁）
+static void l1_insert_locked(data_block_t *block)
+{
+    size_t blk_sz = l1_block_size(block);
+    l1_remove_entry(block->block_id);
+    l1_evict_until_fit(blk_sz);
+    hash_table_set(g_cache.l1.table, block->block_id, block);
+    l1_track_insert(block->block_id, blk_sz);
+}
+
 static void l1_clear(void)
 {
     l1_entry_t *cur = g_cache.l1.head;
@@ -187,24 +192,48 @@ static void cache_stats_set_usage(void)
     smb_cache_set_usage(l1_bytes, l2_bytes, l3_bytes);
 }
 
+/* 摘除 L2 槽中的副本（持 L2 写锁）：L1 若引用该副本一并摘除；
+ * cache_get_block 的调用方可能仍在读取，副本待其离开纪元临界区后释放 */
+static void l2_release_slot(size_t slot)
+{
+    data_block_t *blk = g_cache.l2.slot_blocks[slot];
+    if (!blk)
+        return;
+    g_cache.l2.slot_blocks[slot] = NULL;
+
+    pthread_rwlock_wrlock(&g_cache.l1.lock);
+    if (hash_table_get(g_cache.l1.table, blk->block_id) == blk)
+    {
+        hash_table_remove(g_cache.l1.table, blk->block_id);
+        l1_remove_entry(blk->block_id);
+    }
+    pthread_rwlock_unlock(&g_cache.l1.lock);
+
+    epoch_retire(blk, l2_free_block);
+}
+
+/* 取块的原始数据：压缩块解压到线程私有缓冲，不为每次填充分配整块；失败返回NULL */
+static const char *cache_block_plain(data_block_t *block, size_t *size)
+{
+    *size = block->size;
+    if (block->compressed_size == 0 || block->compression == COMPRESSION_NONE)
+        return block->data;
+    char *plain = worker_scratch_block(block->size);
+    if (!plain || block_decompress_into(block, plain, block->size, size) != 0)
+        return NULL;
+    return plain;
+}
+
 /* Copy a block into an L2 slot, decompressing if needed. */
 static int l2_copy_into_slot(size_t slot, data_block_t *block)
 {
     if (!block)
         return -EINVAL;
 
-    char *src = block->data;
-    char *tmp = NULL;
-    size_t src_size = block->size;
-
-    if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
-    {
-        size_t plain_size = 0;
-        if (block_decompress(block, &tmp, &plain_size) != 0)
-            return -EIO;
-        src = tmp;
-        src_size = plain_size;
-    }
+    size_t src_size;
+    const char *src = cache_block_plain(block, &src_size);
+    if (!src)
+        return -EIO;
 
     size_t copy_sz = src_size < g_cache.l2.slot_size ? src_size : g_cache.l2.slot_size;
     if (g_cache.l2.slot_blocks[slot] == NULL)
@@ -224,9 +253,6 @@ static int l2_copy_into_slot(size_t slot, data_block_t *block)
         memcpy((char *)g_cache.l2.map + slot * g_cache.l2.slot_size, src, copy_sz);
     }
 
-    if (tmp)
-        free(tmp);
-
     return 0;
 }
 
@@ -317,6 +343,7 @@ static void l3_remove_entry(uint64_t block_id)
 {
     if (!g_cache.l3.index)
         return;
+    pthread_rwlock_wrlock(&g_cache.l3.lock);
     l3_entry_t *ent = (l3_entry_t *)hash_table_get(g_cache.l3.index, block_id);
     if (ent)
     {
@@ -328,6 +355,7 @@ static void l3_remove_entry(uint64_t block_id)
         hash_table_remove(g_cache.l3.index, block_id);
         free(ent);
     }
+    pthread_rwlock_unlock(&g_cache.l3.lock);
 }
 
 static int l3_init(size_t capacity_bytes)
@@ -359,21 +387,16 @@ static void l3_shutdown(void)
     {
         /* remove files best-effort */
         pthread_rwlock_wrlock(&g_cache.l3.lock);
-        for (size_t i = 0; i < g_cache.l3.index->size; i++)
+        hash_table_iter_t it;
+        void **value;
+        hash_table_iter_init(&it, g_cache.l3.index);
+        while ((value = hash_table_iter_next(&it, NULL)) != NULL)
         {
-            hash_node_t *node = g_cache.l3.index->buckets[i];
-            while (node)
-            {
-                l3_entry_t *ent = (l3_entry_t *)node->value;
-                if (ent)
-                {
-                    char path[512];
-                    snprintf(path, sizeof(path), "%s/%lu.bin", g_cache.l3.cache_dir, ent->block_id);
-                    unlink(path);
-                    free(ent);
-                }
-                node = node->next;
-            }
+            l3_entry_t *ent = (l3_entry_t *)*value;
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%lu.bin", g_cache.l3.cache_dir, ent->block_id);
+            unlink(path);
+            free(ent);
         }
         pthread_rwlock_unlock(&g_cache.l3.lock);
         hash_table_destroy(g_cache.l3.index);
@@ -383,16 +406,15 @@ static void l3_shutdown(void)
     g_cache.l3.current_bytes = 0;
 }
 
-static data_block_t *l3_load_entry(l3_entry_t *ent)
+/* 按块ID载入 L3 文件；不引用索引条目，条目可能在释放锁后被并发删除 */
+static data_block_t *l3_load_entry(uint64_t block_id)
 {
-    if (!ent)
-        return NULL;
     char path[512];
-    snprintf(path, sizeof(path), "%s/%lu.bin", g_cache.l3.cache_dir, ent->block_id);
+    snprintf(path, sizeof(path), "%s/%lu.bin", g_cache.l3.cache_dir, block_id);
     FILE *fp = fopen(path, "rb");
     if (!fp)
         return NULL;
-    data_block_t *blk = l2_alloc_block(ent->block_id, g_cache.l3.slot_size);
+    data_block_t *blk = l2_alloc_block(block_id, g_cache.l3.slot_size);
     if (!blk)
     {
         fclose(fp);
@@ -416,25 +438,23 @@ static void l3_evict_if_needed(size_t incoming_size)
         /* find oldest */
         l3_entry_t *oldest = NULL;
         pthread_rwlock_wrlock(&g_cache.l3.lock);
-        for (size_t i = 0; i < g_cache.l3.index->size; i++)
+        hash_table_iter_t it;
+        void **value;
+        hash_table_iter_init(&it, g_cache.l3.index);
+        while ((value = hash_table_iter_next(&it, NULL)) != NULL)
         {
-            hash_node_t *node = g_cache.l3.index->buckets[i];
-            while (node)
-            {
-                l3_entry_t *ent = (l3_entry_t *)node->value;
-                if (!oldest || (ent && ent->last_access < oldest->last_access))
-                    oldest = ent;
-                node = node->next;
-            }
+            l3_entry_t *ent = (l3_entry_t *)*value;
+            if (!oldest || ent->last_access < oldest->last_access)
+                oldest = ent;
         }
         if (!oldest)
         {
             pthread_rwlock_unlock(&g_cache.l3.lock);
             break;
         }
-        hash_table_remove(g_cache.l3.index, oldest->block_id);
+        uint64_t victim = oldest->block_id;
         pthread_rwlock_unlock(&g_cache.l3.lock);
-        l3_remove_entry(oldest->block_id);
+        l3_remove_entry(victim);
     }
 }
 
@@ -453,14 +473,13 @@ static data_block_t *l3_cache_get(uint64_t block_id)
     time_t now = time(NULL);
     if (g_cache.l3.expire_seconds && now - ent->last_access > (time_t)g_cache.l3.expire_seconds)
     {
-        hash_table_remove(g_cache.l3.index, block_id);
         pthread_rwlock_unlock(&g_cache.l3.lock);
         l3_remove_entry(block_id);
         return NULL;
     }
     ent->last_access = now;
     pthread_rwlock_unlock(&g_cache.l3.lock);
-    data_block_t *blk = l3_load_entry(ent);
+    data_block_t *blk = l3_load_entry(block_id);
     if (blk)
         smb_cache_update_hits(3, 1);
     return blk;
@@ -470,31 +489,47 @@ static int l3_cache_put(data_block_t *block)
 {
     if (!block || !g_cache.l3.index || g_cache.l3.capacity_bytes == 0)
         return 0;
-    size_t store_size = block->size < g_cache.l3.slot_size ? block->size : g_cache.l3.slot_size;
+    // L3 文件存放原始数据（l3_load_entry 按未压缩块载入），压缩块先解压
+    size_t plain_size;
+    const char *plain = cache_block_plain(block, &plain_size);
+    if (!plain)
+        return -EIO;
+    size_t store_size = plain_size < g_cache.l3.slot_size ? plain_size : g_cache.l3.slot_size;
     l3_evict_if_needed(store_size);
 
-    char path[512];
+    /* 先写临时文件再改名：并发的 l3_load_entry 只会读到完整的旧内容或新内容 */
+    char path[512], tmp[544];
     snprintf(path, sizeof(path), "%s/%lu.bin", g_cache.l3.cache_dir, block->block_id);
-    FILE *fp = fopen(path, "wb");
+    snprintf(tmp, sizeof(tmp), "%s.%lx.tmp", path, (unsigned long)pthread_self());
+    FILE *fp = fopen(tmp, "wb");
     if (!fp)
         return -errno;
-    fwrite(block->data, 1, store_size, fp);
-    fclose(fp);
+    size_t written = fwrite(plain, 1, store_size, fp);
+    if (fclose(fp) != 0 || written != store_size || rename(tmp, path) != 0)
+    {
+        unlink(tmp);
+        return -EIO;
+    }
 
+    pthread_rwlock_wrlock(&g_cache.l3.lock);
     l3_entry_t *ent = (l3_entry_t *)hash_table_get(g_cache.l3.index, block->block_id);
     if (!ent)
     {
         ent = calloc(1, sizeof(l3_entry_t));
-        if (!ent)
+        if (!ent || hash_table_set(g_cache.l3.index, block->block_id, ent) != 0)
+        {
+            pthread_rwlock_unlock(&g_cache.l3.lock);
+            free(ent);
             return -ENOMEM;
+        }
         ent->block_id = block->block_id;
-        hash_table_set(g_cache.l3.index, block->block_id, ent);
     }
     if (g_cache.l3.current_bytes >= ent->size)
         g_cache.l3.current_bytes -= ent->size;
     ent->size = store_size;
     ent->last_access = time(NULL);
     g_cache.l3.current_bytes += store_size;
+    pthread_rwlock_unlock(&g_cache.l3.lock);
     cache_stats_set_usage();
     return 0;
 }
@@ -517,18 +552,16 @@ static void l3_trim_expired(void)
     time_t now = time(NULL);
 
     pthread_rwlock_rdlock(&g_cache.l3.lock);
-    for (size_t i = 0; i < g_cache.l3.index->size; i++)
+    hash_table_iter_t it;
+    void **value;
+    hash_table_iter_init(&it, g_cache.l3.index);
+    while ((value = hash_table_iter_next(&it, NULL)) != NULL)
     {
-        hash_node_t *node = g_cache.l3.index->buckets[i];
-        while (node)
+        l3_entry_t *ent = (l3_entry_t *)*value;
+        if (now - ent->last_access > (time_t)g_cache.l3.expire_seconds)
         {
-            l3_entry_t *ent = (l3_entry_t *)node->value;
-            if (ent && now - ent->last_access > (time_t)g_cache.l3.expire_seconds)
-            {
-                if (n < cap)
-                    to_remove[n++] = ent->block_id;
-            }
-            node = node->next;
+            if (n < cap)
+                to_remove[n++] = ent->block_id;
         }
     }
     pthread_rwlock_unlock(&g_cache.l3.lock);
@@ -614,13 +647,18 @@ data_block_t *cache_get_block(uint64_t block_id)
         if (slot < g_cache.l2.slots && g_cache.l2.slot_ids[slot] == block_id)
             hit = g_cache.l2.slot_blocks[slot];
     }
+    if (hit)
+    {
+        /* promote to L1：在 L2 锁内完成，与 l2_release_slot 互斥，L1 不会留下已摘除的副本 */
+        pthread_rwlock_wrlock(&g_cache.l1.lock);
+        l1_insert_locked(hit);
+        pthread_rwlock_unlock(&g_cache.l1.lock);
+    }
     pthread_rwlock_unlock(&g_cache.l2.lock);
 
     if (hit)
     {
         smb_cache_update_hits(2, 1);
-        /* promote to L1 */
-        cache_put_block(hit);
         return hit;
     }
     smb_cache_update_hits(2, 0);
@@ -639,12 +677,8 @@ void cache_put_block(data_block_t *block)
 {
     if (!block)
         return;
-    size_t blk_sz = l1_block_size(block);
     pthread_rwlock_wrlock(&g_cache.l1.lock);
-    l1_remove_entry(block->block_id);
-    l1_evict_until_fit(blk_sz);
-    hash_table_set(g_cache.l1.table, block->block_id, block);
-    l1_track_insert(block->block_id, blk_sz);
+    l1_insert_locked(block);
     pthread_rwlock_unlock(&g_cache.l1.lock);
 
     /* L2 insert */
@@ -657,15 +691,17 @@ void cache_put_block(data_block_t *block)
         return;
     }
     size_t slot = block->block_id % g_cache.l2.slots;
+    if (g_cache.l2.slot_blocks[slot] == block)
+    {
+        /* L2 命中提升回 L1：块本身就是该槽的副本，不能先释放再拷贝 */
+        pthread_rwlock_unlock(&g_cache.l2.lock);
+        return;
+    }
     uint64_t old_id = g_cache.l2.slot_ids[slot];
     if (old_id)
     {
         hash_table_remove(g_cache.l2.index, old_id);
-        if (g_cache.l2.slot_blocks[slot])
-        {
-            l2_free_block(g_cache.l2.slot_blocks[slot]);
-            g_cache.l2.slot_blocks[slot] = NULL;
-        }
+        l2_release_slot(slot);
         l3_remove_entry(old_id);
     }
     g_cache.l2.slot_ids[slot] = block->block_id;
@@ -696,11 +732,7 @@ void cache_invalidate_block(uint64_t block_id)
         size_t slot = (size_t)(uintptr_t)slot_ptr;
         hash_table_remove(g_cache.l2.index, block_id);
         g_cache.l2.slot_ids[slot] = 0;
-        if (g_cache.l2.slot_blocks[slot])
-        {
-            l2_free_block(g_cache.l2.slot_blocks[slot]);
-            g_cache.l2.slot_blocks[slot] = NULL;
-        }
+        l2_release_slot(slot);
         if (g_cache.l2.dirty_flags)
             g_cache.l2.dirty_flags[slot] = 0;
     }
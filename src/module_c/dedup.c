@@ -2,6 +2,9 @@
 
 #include "dedup.h"
 #include "version_manager.h"
+#include "epoch.h"
+#include "slab.h"
+#include "worker_pool.h"
 #include "module_c/dedup_core.h"
 #include "module_c/adaptive_compress.h"
 #include "module_c/storage_monitor_basic.h"
@@ -26,13 +29,6 @@ static dedup_config_t g_config;
 static pthread_mutex_t g_cfg_lock = PTHREAD_MUTEX_INITIALIZER;
 static const char *DEDUP_CFG_PATH = "/tmp/smartbackupfs_dedup.conf";
 
-/* hash_table_* 由模块A实现，这里声明以避免头文件循环 */
-hash_table_t *hash_table_create(size_t size);
-void hash_table_destroy(hash_table_t *table);
-int hash_table_set(hash_table_t *table, uint64_t key, void *value);
-void *hash_table_get(hash_table_t *table, uint64_t key);
-int hash_table_remove(hash_table_t *table, uint64_t key);
-
 typedef struct
 {
     compress_func_t compress;
@@ -115,15 +111,13 @@ static int copy_on_write(data_block_t **slot)
     if (!newb)
         return -ENOMEM;
 
-    size_t plain_size = blk->size;
-    const char *plain = blk->data;
-    char *owned = NULL;
-    if (blk->compressed_size > 0 && blk->compression != COMPRESSION_NONE)
+    // 直接解压到副本的数据缓冲
+    size_t plain_size = 0;
+    if (block_decompress_into(blk, newb->data, blk->size, &plain_size) != 0)
     {
-        if (block_decompress(blk, &owned, &plain_size) == 0 && owned)
-            plain = owned;
+        dedup_release_block(newb);
+        return -EIO;
     }
-    memcpy(newb->data, plain, plain_size);
     newb->size = plain_size;
     newb->compressed_size = 0;
     newb->compression = COMPRESSION_NONE;
@@ -131,24 +125,28 @@ static int copy_on_write(data_block_t **slot)
     block_compute_hash(newb);
 
     dedup_release_block(blk);
-    *slot = newb;
-    if (owned)
-        free(owned);
+    __atomic_store_n(slot, newb, __ATOMIC_RELEASE);
     return 0;
 }
 
+int dedup_cow_block(data_block_t **slot)
+{
+    return copy_on_write(slot);
+}
+
 static void dedup_cow_version_blocks(version_node_t *version)
 {
     if (!version || !version->block_map)
         return;
     block_map_t *map = version->block_map;
-    pthread_rwlock_wrlock(&map->lock);
-    for (uint64_t i = 0; i < map->block_count; i++)
+    block_map_write_lock(map);
+    uint64_t i = 0;
+    while (block_map_next(map, &i))
     {
-        if (map->blocks && map->blocks[i])
-            copy_on_write(&map->blocks[i]);
+        copy_on_write(block_map_slot(map, i, false));
+        i++;
     }
-    pthread_rwlock_unlock(&map->lock);
+    block_map_write_unlock(map);
 }
 
 static const char *algo_name(compression_algorithm_t algo)
@@ -283,8 +281,7 @@ static void register_default_compressors(void)
 int dedup_init(const dedup_config_t *config)
 {
     memset(&g_dedup, 0, sizeof(g_dedup));
-    pthread_rwlock_init(&g_dedup.global_lock, NULL);
-    g_dedup.block_hash_index = hash_table_create(16384);
+    g_dedup.block_hash_index = shard_map_create(16384);
     if (!g_dedup.block_hash_index)
         return -1;
     register_default_compressors();
@@ -308,10 +305,9 @@ void dedup_shutdown(void)
 {
     if (g_dedup.block_hash_index)
     {
-        hash_table_destroy(g_dedup.block_hash_index);
+        shard_map_destroy(g_dedup.block_hash_index);
         g_dedup.block_hash_index = NULL;
     }
-    pthread_rwlock_destroy(&g_dedup.global_lock);
 }
 
 void block_compute_hash(data_block_t *block)
@@ -325,17 +321,14 @@ data_block_t *dedup_find_duplicate(const uint8_t hash[32])
 {
     if (!g_config.enable_deduplication || !g_dedup.block_hash_index)
         return NULL;
-    pthread_rwlock_rdlock(&g_dedup.global_lock);
+    /* 索引查找不取锁；候选块可能正被最后一个引用者释放，纪元临界区内其内存仍然有效，
+     * 引用计数已归零的块不再复用 */
+    if (!epoch_enter())
+        return NULL;
     data_block_t *cand = dedup_core_find(&g_dedup, hash);
-    if (cand && memcmp(cand->hash, hash, 32) == 0)
-    {
-        dedup_core_inc_ref(cand);
-    }
-    else
-    {
+    if (cand && (memcmp(cand->hash, hash, 32) != 0 || !dedup_core_try_ref(cand)))
         cand = NULL;
-    }
-    pthread_rwlock_unlock(&g_dedup.global_lock);
+    epoch_exit();
     return cand;
 }
 
@@ -343,14 +336,11 @@ int dedup_index_block(data_block_t *block)
 {
     if (!g_config.enable_deduplication || !block)
         return 0;
-    pthread_rwlock_wrlock(&g_dedup.global_lock);
-    if (!dedup_core_find(&g_dedup, block->hash))
+    if (dedup_core_index(&g_dedup, block) == 0)
     {
-        dedup_core_index(&g_dedup, block);
-        g_dedup.total_unique_blocks++;
+        __atomic_add_fetch(&g_dedup.total_unique_blocks, 1, __ATOMIC_RELAXED);
         smb_update_unique_block();
     }
-    pthread_rwlock_unlock(&g_dedup.global_lock);
     return 0;
 }
 
@@ -358,16 +348,11 @@ int dedup_remove_block(data_block_t *block)
 {
     if (!block || !g_dedup.block_hash_index)
         return 0;
-    pthread_rwlock_wrlock(&g_dedup.global_lock);
-    data_block_t *cand = dedup_core_find(&g_dedup, block->hash);
-    if (cand == block)
+    if (dedup_core_remove(&g_dedup, block) == 0)
     {
-        dedup_core_remove(&g_dedup, block->hash);
-        if (g_dedup.total_unique_blocks > 0)
-            g_dedup.total_unique_blocks--;
+        __atomic_sub_fetch(&g_dedup.total_unique_blocks, 1, __ATOMIC_RELAXED);
         smb_on_unique_block_removed();
     }
-    pthread_rwlock_unlock(&g_dedup.global_lock);
     return 0;
 }
 
@@ -434,7 +419,7 @@ int block_compress(data_block_t *block, dedup_config_t *config)
     }
 
     size_t bound = compression_bound(algo, block->size);
-    char *out = malloc(bound);
+    char *out = slab_alloc(bound);
     if (!out)
         return -1;
 
@@ -442,58 +427,103 @@ int block_compress(data_block_t *block, dedup_config_t *config)
     compress_func_t fn = g_compressors[algo].compress;
     if (!fn || fn(block->data, block->size, out, &out_size, cfg->compression_level) != 0)
     {
-        free(out);
+        slab_free(out);
         return -1;
     }
 
     if (out_size >= block->size)
     {
-        free(out);
+        slab_free(out);
         block->compressed_size = 0;
         block->compression = COMPRESSION_NONE;
         return 0;
     }
 
+    // 按压缩后的实际长度另取缓冲，常驻内存落入更小的尺寸类别
+    char *packed = slab_alloc(out_size);
+    if (!packed)
+    {
+        slab_free(out);
+        return -1;
+    }
+    memcpy(packed, out, out_size);
+    slab_free(out);
+
+    // 无锁读者可能仍在读取未压缩数据，旧缓冲延迟释放
     char *old = block->data;
-    block->data = out;
-    block->compressed_size = out_size;
-    block->compression = (uint8_t)algo;
+    block_data_update_begin(block);
+    __atomic_store_n(&block->data, packed, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->compressed_size, out_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->compression, (uint8_t)algo, __ATOMIC_RELAXED);
+    block_data_update_end(block);
 
-    pthread_rwlock_wrlock(&g_dedup.global_lock);
-    g_dedup.saved_space += (block->size - block->compressed_size);
-    pthread_rwlock_unlock(&g_dedup.global_lock);
+    __atomic_add_fetch(&g_dedup.saved_space, block->size - block->compressed_size, __ATOMIC_RELAXED);
 
-    free(old);
+    epoch_retire(old, slab_free);
     return 0;
 }
 
-int block_decompress(data_block_t *block, char **out_data, size_t *out_size)
+int block_decompress_into(data_block_t *block, char *out, size_t cap, size_t *out_size)
 {
-    if (!block || !out_data || !out_size)
+    if (!block || !out || !out_size || cap < block->size)
         return -1;
 
-    size_t expected = block->size;
-    *out_data = malloc(expected);
-    if (!*out_data)
-        return -1;
-
-    size_t buf_size = expected;
     if (block->compressed_size == 0 || block->compression == COMPRESSION_NONE)
     {
-        memcpy(*out_data, block->data, expected);
-        *out_size = expected;
+        memcpy(out, block->data, block->size);
+        *out_size = block->size;
         return 0;
     }
 
+    size_t buf_size = cap;
     decompress_func_t fn = g_compressors[block->compression].decompress;
-    if (!fn || fn(block->data, block->compressed_size, *out_data, &buf_size) != 0)
+    if (!fn || fn(block->data, block->compressed_size, out, &buf_size) != 0)
+        return -1;
+
+    *out_size = buf_size;
+    return 0;
+}
+
+// 整块请求直接解压到调用方缓冲；只要块内一段时解压到线程私有缓冲再拷出所需部分
+int block_decompress_range(data_block_t *block, char *out, size_t offset, size_t len)
+{
+    if (!block || !out)
+        return -1;
+
+    size_t plain_size = 0;
+    if (offset == 0 && len >= block->size)
+    {
+        if (block_decompress_into(block, out, len, &plain_size) != 0)
+            return -1;
+        return (int)plain_size;
+    }
+
+    char *plain = worker_scratch_block(block->size);
+    if (!plain || block_decompress_into(block, plain, block->size, &plain_size) != 0)
+        return -1;
+    if (offset >= plain_size)
+        return 0;
+    if (len > plain_size - offset)
+        len = plain_size - offset;
+    memcpy(out, plain + offset, len);
+    return (int)len;
+}
+
+int block_decompress(data_block_t *block, char **out_data, size_t *out_size)
+{
+    if (!block || !out_data || !out_size)
+        return -1;
+
+    *out_data = malloc(block->size);
+    if (!*out_data)
+        return -1;
+
+    if (block_decompress_into(block, *out_data, block->size, out_size) != 0)
     {
         free(*out_data);
         *out_data = NULL;
         return -1;
     }
-
-    *out_size = buf_size;
     return 0;
 }
 
@@ -518,25 +548,18 @@ int dedup_process_block_on_write(data_block_t **slot, dedup_config_t *config)
 
     block_compute_hash(blk);
 
-    if (cfg->enable_deduplication)
+    data_block_t *dup = cfg->enable_deduplication ? dedup_find_duplicate(blk->hash) : NULL;
+    if (dup && dup != blk)
     {
-        data_block_t *dup = dedup_find_duplicate(blk->hash);
-        if (dup && dup != blk)
-        {
-            dedup_release_block(blk);
-            *slot = dup;
-            pthread_rwlock_wrlock(&g_dedup.global_lock);
-            g_dedup.saved_space += dup->size;
-            pthread_rwlock_unlock(&g_dedup.global_lock);
-            smb_update_dedup_on_hit(dup->size);
-            blk = dup;
-        }
-        else if (!dup)
-        {
-            dedup_index_block(blk);
-        }
+        // 复用的块已被其他文件共享，保持原样（它入索引时已按需压缩）
+        dedup_release_block(blk);
+        __atomic_store_n(slot, dup, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&g_dedup.saved_space, dup->size, __ATOMIC_RELAXED);
+        smb_update_dedup_on_hit(dup->size);
+        return 0;
     }
 
+    // 先压缩再入索引：块进入去重索引后可能被其他文件共享，之后不再切换其数据缓冲
     if (cfg->enable_compression)
     {
         size_t before = blk->size;
@@ -544,11 +567,9 @@ int dedup_process_block_on_write(data_block_t **slot, dedup_config_t *config)
         if (blk->compressed_size > 0 && blk->compressed_size < before)
             smb_update_compress(before, blk->compressed_size);
     }
-    else
-    {
-        blk->compression = COMPRESSION_NONE;
-        blk->compressed_size = 0;
-    }
+
+    if (cfg->enable_deduplication && !dup)
+        dedup_index_block(blk);
 
     return 0;
 }
@@ -559,18 +580,16 @@ int dedup_process_diff_blocks(hash_table_t *diff_blocks, dedup_config_t *config)
         return -1;
 
     pthread_rwlock_wrlock(&diff_blocks->lock);
-    for (size_t i = 0; i < diff_blocks->size; i++)
+    hash_table_iter_t it;
+    void **value;
+    hash_table_iter_init(&it, diff_blocks);
+    while ((value = hash_table_iter_next(&it, NULL)) != NULL)
     {
-        hash_node_t *node = diff_blocks->buckets[i];
-        while (node)
+        data_block_t *b = (data_block_t *)*value;
+        if (b != (void *)1)
         {
-            data_block_t *b = (data_block_t *)node->value;
-            if (b && b != (void *)1)
-            {
-                dedup_process_block_on_write(&b, config ? config : &g_config);
-                node->value = b;
-            }
-            node = node->next;
+            dedup_process_block_on_write(&b, config ? config : &g_config);
+            *value = b;
         }
     }
     pthread_rwlock_unlock(&diff_blocks->lock);
@@ -584,20 +603,16 @@ ssize_t dedup_read_version_data(version_node_t *version, char *buf, size_t size,
 
     dedup_cow_version_blocks(version);
 
-    file_metadata_t vmeta = {0};
-    vmeta.version_handle = version;
-    vmeta.size = version->file_size;
-    vmeta.blocks = version->blocks;
-    return version_manager_read_version_data(&vmeta, buf, size, offset);
+    return version_manager_read_node_data(version, buf, size, offset);
 }
 
 void dedup_get_stats(global_dedup_state_t *out)
 {
     if (!out)
         return;
-    pthread_rwlock_rdlock(&g_dedup.global_lock);
-    *out = g_dedup;
-    pthread_rwlock_unlock(&g_dedup.global_lock);
+    out->block_hash_index = g_dedup.block_hash_index;
+    out->total_unique_blocks = __atomic_load_n(&g_dedup.total_unique_blocks, __ATOMIC_RELAXED);
+    out->saved_space = __atomic_load_n(&g_dedup.saved_space, __ATOMIC_RELAXED);
 }
 
 int dedup_update_config(bool enable_dedup, bool enable_comp, compression_algorithm_t algo, int level, size_t min_size)
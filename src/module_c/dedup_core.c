@@ -1,15 +1,11 @@
 #include "module_c/dedup_core.h"
+#include "dedup.h"
+#include "worker_pool.h"
 
 #include <openssl/sha.h>
+#include <errno.h>
 #include <string.h>
 
-/* 由模块A提供的哈希表接口声明，避免头文件循环 */
-hash_table_t *hash_table_create(size_t size);
-void hash_table_destroy(hash_table_t *table);
-int hash_table_set(hash_table_t *table, uint64_t key, void *value);
-void *hash_table_get(hash_table_t *table, uint64_t key);
-int hash_table_remove(hash_table_t *table, uint64_t key);
-
 static uint64_t hash_key_from_hash(const uint8_t hash[32])
 {
     uint64_t k = 0;
@@ -21,7 +17,17 @@ void dedup_core_calculate_hash(data_block_t *block, uint8_t out_hash[32])
 {
     if (!block)
         return;
-    SHA256((const unsigned char *)block->data, block->size, out_hash);
+    // 指纹按原始数据计算：压缩块先解压到线程私有缓冲（data 只有 compressed_size 字节）
+    const char *plain = block->data;
+    size_t plain_size = block->size;
+    if (block->compressed_size > 0 && block->compression != COMPRESSION_NONE)
+    {
+        char *scratch = worker_scratch_block(block->size);
+        if (!scratch || block_decompress_into(block, scratch, block->size, &plain_size) != 0)
+            return;
+        plain = scratch;
+    }
+    SHA256((const unsigned char *)plain, plain_size, out_hash);
     if (block->hash != out_hash)
         memcpy(block->hash, out_hash, 32);
 }
@@ -31,7 +37,7 @@ data_block_t *dedup_core_find(global_dedup_state_t *state, const uint8_t hash[32
     if (!state || !state->block_hash_index || !hash)
         return NULL;
     uint64_t key = hash_key_from_hash(hash);
-    return (data_block_t *)hash_table_get(state->block_hash_index, key);
+    return (data_block_t *)shard_map_get(state->block_hash_index, key);
 }
 
 int dedup_core_index(global_dedup_state_t *state, data_block_t *block)
@@ -39,15 +45,23 @@ int dedup_core_index(global_dedup_state_t *state, data_block_t *block)
     if (!state || !state->block_hash_index || !block)
         return -1;
     uint64_t key = hash_key_from_hash(block->hash);
-    return hash_table_set(state->block_hash_index, key, block);
+    hash_table_t *shard = shard_map_lock(state->block_hash_index, key);
+    int ret = hash_table_get_locked(shard, key) ? -EEXIST : hash_table_set_locked(shard, key, block);
+    shard_map_unlock(shard);
+    return ret;
 }
 
-int dedup_core_remove(global_dedup_state_t *state, const uint8_t hash[32])
+int dedup_core_remove(global_dedup_state_t *state, const data_block_t *block)
 {
-    if (!state || !state->block_hash_index || !hash)
+    if (!state || !state->block_hash_index || !block)
         return -1;
-    uint64_t key = hash_key_from_hash(hash);
-    return hash_table_remove(state->block_hash_index, key);
+    uint64_t key = hash_key_from_hash(block->hash);
+    hash_table_t *shard = shard_map_lock(state->block_hash_index, key);
+    int ret = -ENOENT;
+    if (hash_table_get_locked(shard, key) == block)
+        ret = hash_table_remove_locked(shard, key);
+    shard_map_unlock(shard);
+    return ret;
 }
 
 void dedup_core_inc_ref(data_block_t *block)
@@ -59,6 +73,18 @@ void dedup_core_inc_ref(data_block_t *block)
     pthread_mutex_unlock(&block->ref_lock);
 }
 
+bool dedup_core_try_ref(data_block_t *block)
+{
+    if (!block)
+        return false;
+    pthread_mutex_lock(&block->ref_lock);
+    bool ok = block->ref_count > 0;
+    if (ok)
+        block->ref_count++;
+    pthread_mutex_unlock(&block->ref_lock);
+    return ok;
+}
+
 void dedup_core_dec_ref(data_block_t *block)
 {
     if (!block)
@@ -1,4 +1,5 @@
 #include "module_c/module_d_adapter.h"
+#include "logger.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -81,6 +82,6 @@ void stop_integrity_scan(void)
 int handle_corrupted_block(data_block_t *block)
 {
     (void)block;
-    fprintf(stderr, "corrupted block detected\n");
+    SBFS_LOG_ERROR("corrupted block detected");
     return -1;
 }
@@ -0,0 +1,1639 @@
+/**
+ * 智能备份文件系统 - 模块C：日志结构的持久块存储
+ */
+
+#include "module_c/segment_store.h"
+#include "hash_table.h"
+#include "logger.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define SEG_FILE_MAGIC "SBFSSEG1"
+#define SEG_FILE_VERSION 1
+#define SEG_RECORD_MAGIC 0x52474553u          /* "SEGR" */
+#define SEG_BATCH_SIZE (1024 * 1024)          /* 批缓冲：攒满后一次顺序写出 */
+#define SEG_MAX_PAYLOAD (256 * 1024)          /* 单条记录载荷上限（块与 BLOCKS 记录都远小于此） */
+#define SEG_CLEAN_PER_ROLL 2                  /* 每次段滚动后后台最多清理的旧段数 */
+
+enum {
+    SEG_REC_DATA = 1,
+    SEG_REC_MAP,
+    SEG_REC_CKPT_BEGIN,
+    SEG_REC_NODE,
+    SEG_REC_BLOCKS,
+    SEG_REC_CKPT_END,
+};
+
+typedef struct seg_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t seg_no;
+} seg_file_header_t;
+
+/* 记录头，其后紧跟 length 字节载荷；crc 覆盖头部（crc 置0）与载荷 */
+typedef struct seg_record {
+    uint32_t magic;
+    uint16_t type;
+    uint8_t compression;
+    uint8_t reserved;
+    uint32_t length;
+    uint32_t crc;
+    uint64_t id;                 /* DATA:0  MAP:块ID  NODE:inode  CKPT_*:检查点序号 */
+    uint32_t size;               /* DATA：原始长度 */
+    uint32_t checksum;           /* DATA：原始数据校验和 */
+    uint8_t hash[32];            /* DATA/MAP：内容指纹 */
+} seg_record_t;
+
+_Static_assert(sizeof(seg_record_t) == 64, "segment record header must stay 64 bytes");
+
+/* NODE 载荷的定长部分，其后为名称与链接目标（均不含结尾0） */
+typedef struct seg_node_record {
+    uint64_t ino;
+    uint64_t parent_ino;
+    uint64_t nlink;
+    int64_t size;
+    int64_t blocks;
+    int64_t atime_sec;
+    int64_t mtime_sec;
+    int64_t ctime_sec;
+    uint32_t atime_nsec;
+    uint32_t mtime_nsec;
+    uint32_t ctime_nsec;
+    uint32_t type;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t name_len;
+    uint32_t target_len;
+    uint32_t pad;
+} seg_node_record_t;
+
+/* 一份落盘的块内容（按指纹去重） */
+typedef struct seg_extent {
+    uint8_t hash[32];
+    uint32_t seg;                /* DATA 记录所在段号与段内偏移 */
+    uint64_t offset;
+    uint32_t record_len;
+    uint32_t size;
+    uint32_t stored;
+    uint32_t checksum;
+    uint8_t compression;
+    uint32_t refs;               /* 指向它的存活块ID数 */
+    struct seg_extent *next;     /* 指纹前缀相同的链 */
+} seg_extent_t;
+
+/* 块ID的映射：存活条件为内存中的块仍在用，或被最新完整检查点引用 */
+typedef struct seg_map {
+    uint8_t hash[32];
+    seg_extent_t *extent;
+    uint32_t seg;                /* MAP 记录所在段号与段内偏移 */
+    uint64_t offset;
+    uint64_t pin_seq;            /* 最近一次引用它的检查点序号 */
+    bool in_use;
+} seg_map_t;
+
+typedef struct seg_file {
+    uint32_t no;
+    uint64_t bytes;              /* 段长（含批缓冲中尚未写出的部分） */
+    uint64_t live;               /* 存活记录字节数 */
+    uint64_t ckpt_bytes;         /* 其中属于最新完整检查点的字节数 */
+    uint64_t ckpt_pending;       /* 正在写的检查点在本段的字节数 */
+} seg_file_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_mutex_t sync_lock;   /* 串行化落盘：返回时先前被别人取走的旧段也已同步（先于 lock 取） */
+    pthread_cond_t worker_cond;  /* 唤醒后台线程（配合 lock） */
+    pthread_t worker;            /* 后台线程：滚动后的旧段落盘、清理 */
+    bool worker_running;
+    bool worker_wakeup;
+    int sync_error;              /* 后台落盘失败的错误，报告给下一个 store_sync 调用方 */
+    bool enabled;
+    bool cleaning;
+    char dir[PATH_MAX];
+    uint64_t segment_size;
+    unsigned clean_percent;
+    seg_file_t *segs;            /* 按段号升序，最后一个是当前追加的段 */
+    size_t seg_count;
+    size_t seg_cap;
+    int fd;                      /* 当前段 */
+    int *unsynced;               /* 已滚动出去、尚未 fdatasync 的旧段描述符 */
+    size_t unsynced_count;
+    size_t unsynced_cap;
+    char *buf;                   /* 批缓冲，对应当前段末尾 buf_len 字节 */
+    size_t buf_len;
+    int read_fd;                 /* 读旧段时缓存的描述符 */
+    uint32_t read_no;
+    hash_table_t *maps;          /* 块ID -> seg_map_t* */
+    hash_table_t *extents;       /* 指纹前8字节 -> seg_extent_t*（链头） */
+    size_t extent_count;
+    uint64_t max_block_id;
+    uint64_t ckpt_seq;           /* 最新完整检查点 */
+    uint32_t ckpt_seg;
+    uint64_t ckpt_offset;
+    bool ckpt_writing;
+    uint64_t ckpt_new_seq;
+    uint32_t ckpt_new_seg;
+    uint64_t ckpt_new_offset;
+    uint64_t appended_bytes;
+    uint64_t cleaned_segments;
+    uint64_t reclaimed_bytes;
+} g_store = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .sync_lock = PTHREAD_MUTEX_INITIALIZER,
+    .worker_cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+    .read_fd = -1,
+};
+
+static int store_roll_locked(void);
+
+/* ---------------------------------------------------------------------------
+ * 段文件 */
+
+static void seg_path(uint32_t no, char *out, size_t size)
+{
+    snprintf(out, size, "%s/seg-%08x.sbs", g_store.dir, no);
+}
+
+static seg_file_t *seg_find(uint32_t no)
+{
+    size_t lo = 0, hi = g_store.seg_count;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (g_store.segs[mid].no < no)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < g_store.seg_count && g_store.segs[lo].no == no) ? &g_store.segs[lo] : NULL;
+}
+
+static seg_file_t *seg_active(void)
+{
+    return g_store.seg_count ? &g_store.segs[g_store.seg_count - 1] : NULL;
+}
+
+static seg_file_t *seg_push(uint32_t no)
+{
+    if (g_store.seg_count == g_store.seg_cap)
+    {
+        size_t cap = g_store.seg_cap ? g_store.seg_cap * 2 : 16;
+        seg_file_t *segs = realloc(g_store.segs, cap * sizeof(seg_file_t));
+        if (!segs)
+            return NULL;
+        g_store.segs = segs;
+        g_store.seg_cap = cap;
+    }
+    seg_file_t *seg = &g_store.segs[g_store.seg_count++];
+    memset(seg, 0, sizeof(*seg));
+    seg->no = no;
+    return seg;
+}
+
+static void seg_add_live(uint32_t no, int64_t delta)
+{
+    seg_file_t *seg = seg_find(no);
+    if (seg)
+        seg->live += delta;
+}
+
+static int write_full(int fd, const char *data, size_t len, off_t off)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, data, len, off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        data += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, char *data, size_t len, off_t off)
+{
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, data, len, off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if (n == 0)
+            return -EIO;
+        data += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+static int store_flush_locked(void)
+{
+    seg_file_t *active = seg_active();
+    if (!active || g_store.buf_len == 0)
+        return 0;
+    int ret = write_full(g_store.fd, g_store.buf, g_store.buf_len,
+                         (off_t)(active->bytes - g_store.buf_len));
+    if (ret != 0)
+    {
+        SBFS_LOG_ERROR("段存储：写入段 %08x 失败: %s", active->no, strerror(-ret));
+        return ret;
+    }
+    g_store.buf_len = 0;
+    return 0;
+}
+
+/* 新建一个段文件并设为当前段 */
+static int store_create_segment_locked(uint32_t no)
+{
+    char path[PATH_MAX + 32];
+    seg_path(no, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -errno;
+    seg_file_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SEG_FILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = SEG_FILE_VERSION;
+    hdr.seg_no = no;
+    int ret = write_full(fd, (const char *)&hdr, sizeof(hdr), 0);
+    seg_file_t *seg = ret == 0 ? seg_push(no) : NULL;
+    if (!seg)
+    {
+        close(fd);
+        unlink(path);
+        return ret ? ret : -ENOMEM;
+    }
+    seg->bytes = sizeof(hdr);
+    if (g_store.fd >= 0)
+        close(g_store.fd);
+    g_store.fd = fd;
+    return 0;
+}
+
+/* 当前段写满：写出批缓冲后换到新段。旧段的 fdatasync 与清理交给后台线程，
+ * 调用方（封存块的写者）不在存储锁内等待落盘 */
+static int store_roll_locked(void)
+{
+    uint32_t next = seg_active()->no + 1;
+    int ret = store_flush_locked();
+    if (ret != 0)
+        return ret;
+    if (g_store.unsynced_count == g_store.unsynced_cap)
+    {
+        size_t cap = g_store.unsynced_cap ? g_store.unsynced_cap * 2 : 4;
+        int *fds = realloc(g_store.unsynced, cap * sizeof(int));
+        if (!fds)
+            return -ENOMEM;
+        g_store.unsynced = fds;
+        g_store.unsynced_cap = cap;
+    }
+    int old = g_store.fd;
+    g_store.fd = -1;
+    ret = store_create_segment_locked(next);
+    if (ret != 0)
+    {
+        g_store.fd = old;
+        return ret;
+    }
+    g_store.unsynced[g_store.unsynced_count++] = old;
+    g_store.worker_wakeup = true;
+    pthread_cond_signal(&g_store.worker_cond);
+    return 0;
+}
+
+/* 追加一条记录，返回其所在段号与偏移 */
+static int store_append_locked(seg_record_t *rec, const void *payload, size_t len,
+                               uint32_t *seg_no, uint64_t *offset)
+{
+    if (len > SEG_MAX_PAYLOAD)
+        return -EINVAL;
+    size_t rec_len = sizeof(*rec) + len;
+    seg_file_t *active = seg_active();
+    if (active->bytes + rec_len > g_store.segment_size && active->bytes > sizeof(seg_file_header_t))
+    {
+        int ret = store_roll_locked();
+        if (ret != 0)
+            return ret;
+        active = seg_active();
+    }
+    if (g_store.buf_len + rec_len > SEG_BATCH_SIZE)
+    {
+        int ret = store_flush_locked();
+        if (ret != 0)
+            return ret;
+    }
+
+    rec->magic = SEG_RECORD_MAGIC;
+    rec->length = (uint32_t)len;
+    rec->crc = 0;
+    uint32_t crc = (uint32_t)crc32(0, (const Bytef *)rec, sizeof(*rec));
+    if (len)
+        crc = (uint32_t)crc32(crc, (const Bytef *)payload, (uInt)len);
+    rec->crc = crc;
+
+    memcpy(g_store.buf + g_store.buf_len, rec, sizeof(*rec));
+    if (len)
+        memcpy(g_store.buf + g_store.buf_len + sizeof(*rec), payload, len);
+    g_store.buf_len += rec_len;
+
+    *seg_no = active->no;
+    *offset = active->bytes;
+    active->bytes += rec_len;
+    active->live += rec_len;
+    g_store.appended_bytes += rec_len;
+    if (g_store.ckpt_writing && rec->type != SEG_REC_DATA && rec->type != SEG_REC_MAP)
+        active->ckpt_pending += rec_len;
+    return 0;
+}
+
+/* 读取一条记录：仍在批缓冲中的直接拷贝，否则从段文件读取；payload 为NULL时只读头部 */
+static int store_read_record_locked(uint32_t no, uint64_t offset, seg_record_t *rec,
+                                    char *payload, size_t cap)
+{
+    seg_file_t *active = seg_active();
+    if (active && no == active->no && offset >= active->bytes - g_store.buf_len)
+    {
+        const char *src = g_store.buf + (offset - (active->bytes - g_store.buf_len));
+        memcpy(rec, src, sizeof(*rec));
+        if (payload)
+        {
+            if (rec->length > cap)
+                return -ERANGE;
+            memcpy(payload, src + sizeof(*rec), rec->length);
+        }
+        return 0;
+    }
+
+    int fd;
+    if (active && no == active->no)
+    {
+        fd = g_store.fd;
+    }
+    else
+    {
+        if (g_store.read_fd < 0 || g_store.read_no != no)
+        {
+            char path[PATH_MAX + 32];
+            seg_path(no, path, sizeof(path));
+            int nfd = open(path, O_RDONLY);
+            if (nfd < 0)
+                return -errno;
+            if (g_store.read_fd >= 0)
+                close(g_store.read_fd);
+            g_store.read_fd = nfd;
+            g_store.read_no = no;
+        }
+        fd = g_store.read_fd;
+    }
+    int ret = read_full(fd, (char *)rec, sizeof(*rec), (off_t)offset);
+    if (ret != 0)
+        return ret;
+    if (rec->magic != SEG_RECORD_MAGIC)
+        return -EIO;
+    if (!payload)
+        return 0;
+    if (rec->length > cap)
+        return -ERANGE;
+    return read_full(fd, payload, rec->length, (off_t)(offset + sizeof(*rec)));
+}
+
+/* ---------------------------------------------------------------------------
+ * 索引 */
+
+static uint64_t hash_prefix(const uint8_t hash[32])
+{
+    uint64_t key;
+    memcpy(&key, hash, sizeof(key));
+    return key;
+}
+
+static seg_extent_t *extent_find(const uint8_t hash[32])
+{
+    seg_extent_t *ext = hash_table_get(g_store.extents, hash_prefix(hash));
+    while (ext && memcmp(ext->hash, hash, 32) != 0)
+        ext = ext->next;
+    return ext;
+}
+
+static seg_extent_t *extent_create(const uint8_t hash[32])
+{
+    seg_extent_t *ext = calloc(1, sizeof(seg_extent_t));
+    if (!ext)
+        return NULL;
+    memcpy(ext->hash, hash, 32);
+    uint64_t key = hash_prefix(hash);
+    ext->next = hash_table_get(g_store.extents, key);
+    if (hash_table_set(g_store.extents, key, ext) != 0)
+    {
+        free(ext);
+        return NULL;
+    }
+    g_store.extent_count++;
+    return ext;
+}
+
+static void extent_set_location(seg_extent_t *ext, const seg_record_t *rec, uint32_t no,
+                                uint64_t offset)
+{
+    ext->seg = no;
+    ext->offset = offset;
+    ext->record_len = (uint32_t)(sizeof(*rec) + rec->length);
+    ext->size = rec->size;
+    ext->stored = rec->length;
+    ext->checksum = rec->checksum;
+    ext->compression = rec->compression;
+}
+
+/* 内容不再被任何块ID引用：DATA 记录成为垃圾 */
+static void extent_destroy(seg_extent_t *ext, bool count_dead)
+{
+    uint64_t key = hash_prefix(ext->hash);
+    seg_extent_t *head = hash_table_get(g_store.extents, key);
+    if (head == ext)
+    {
+        if (ext->next)
+            hash_table_set(g_store.extents, key, ext->next);
+        else
+            hash_table_remove(g_store.extents, key);
+    }
+    else
+    {
+        while (head && head->next != ext)
+            head = head->next;
+        if (head)
+            head->next = ext->next;
+    }
+    if (count_dead)
+        seg_add_live(ext->seg, -(int64_t)ext->record_len);
+    g_store.extent_count--;
+    free(ext);
+}
+
+static void map_unlink_extent(seg_map_t *map)
+{
+    seg_extent_t *ext = map->extent;
+    map->extent = NULL;
+    if (ext && --ext->refs == 0)
+        extent_destroy(ext, true);
+}
+
+static bool map_alive(const seg_map_t *map)
+{
+    return map->in_use || (g_store.ckpt_seq && map->pin_seq == g_store.ckpt_seq);
+}
+
+static void map_destroy(uint64_t block_id, seg_map_t *map)
+{
+    seg_add_live(map->seg, -(int64_t)sizeof(seg_record_t));
+    map_unlink_extent(map);
+    hash_table_remove(g_store.maps, block_id);
+    free(map);
+}
+
+/* 回收所有不再存活的块ID */
+static void store_sweep_maps_locked(void)
+{
+    size_t cap = hash_table_size(g_store.maps);
+    uint64_t *dead = cap ? malloc(cap * sizeof(uint64_t)) : NULL;
+    if (!dead)
+        return;
+    size_t n = 0;
+    hash_table_iter_t it;
+    void **value;
+    uint64_t key;
+    hash_table_iter_init(&it, g_store.maps);
+    while ((value = hash_table_iter_next(&it, &key)) != NULL && n < cap)
+    {
+        if (!map_alive(*value))
+            dead[n++] = key;
+    }
+    for (size_t i = 0; i < n; i++)
+        map_destroy(dead[i], hash_table_get(g_store.maps, dead[i]));
+    free(dead);
+}
+
+/* ---------------------------------------------------------------------------
+ * 落盘与段清理（不持有存储锁调用） */
+
+/* 让此前追加的全部记录落盘：在锁内写出批缓冲、取走滚动后尚未落盘的旧段，
+ * fdatasync 在锁外进行，期间其他线程照常追加 */
+static int store_sync(void)
+{
+    pthread_mutex_lock(&g_store.sync_lock);
+    pthread_mutex_lock(&g_store.lock);
+    int ret = g_store.enabled ? store_flush_locked() : 0;
+    if (ret == 0)
+        ret = g_store.sync_error;
+    g_store.sync_error = 0;
+    int fd = -1;
+    int *old = NULL;
+    size_t old_count = 0;
+    if (ret == 0 && g_store.enabled)
+    {
+        if ((fd = dup(g_store.fd)) < 0)
+            ret = -errno;
+        old = g_store.unsynced;
+        old_count = g_store.unsynced_count;
+        g_store.unsynced = NULL;
+        g_store.unsynced_count = g_store.unsynced_cap = 0;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+
+    for (size_t i = 0; i < old_count; i++)
+    {
+        if (fdatasync(old[i]) != 0 && ret == 0)
+            ret = -errno;
+        close(old[i]);
+    }
+    free(old);
+    if (fd >= 0)
+    {
+        if (fdatasync(fd) != 0 && ret == 0)
+            ret = -errno;
+        close(fd);
+    }
+    pthread_mutex_unlock(&g_store.sync_lock);
+    return ret;
+}
+
+/* 搬迁一条旧段中的记录：仍是该内容或该块ID的当前位置时追加到当前段 */
+static int store_move_record_locked(uint32_t no, uint64_t off, seg_record_t *rec, const char *payload)
+{
+    uint32_t new_no;
+    uint64_t new_off;
+    int ret = 0;
+    if (rec->type == SEG_REC_DATA)
+    {
+        seg_extent_t *ext = extent_find(rec->hash);
+        if (ext && ext->seg == no && ext->offset == off)
+        {
+            ret = store_append_locked(rec, payload, rec->length, &new_no, &new_off);
+            if (ret == 0)
+                extent_set_location(ext, rec, new_no, new_off);
+        }
+    }
+    else if (rec->type == SEG_REC_MAP)
+    {
+        seg_map_t *map = hash_table_get(g_store.maps, rec->id);
+        if (map && map->seg == no && map->offset == off)
+        {
+            ret = store_append_locked(rec, NULL, 0, &new_no, &new_off);
+            if (ret == 0)
+            {
+                map->seg = new_no;
+                map->offset = new_off;
+            }
+        }
+    }
+    return ret;
+}
+
+/* 清理一个旧段：旧段不再被追加，记录在锁外读出，只在判断存活与追加时取锁；
+ * 搬出的记录落盘后删除旧段。调用方已置 cleaning 标志 */
+static int store_clean_segment(uint32_t no)
+{
+    char path[PATH_MAX + 32];
+    seg_path(no, path, sizeof(path));
+    char *payload = malloc(SEG_MAX_PAYLOAD);
+    int fd = open(path, O_RDONLY);
+    int ret = fd < 0 ? -errno : (payload ? 0 : -ENOMEM);
+
+    pthread_mutex_lock(&g_store.lock);
+    seg_file_t *seg = seg_find(no);
+    uint64_t end = seg ? seg->bytes : 0;
+    pthread_mutex_unlock(&g_store.lock);
+    if (!seg && ret == 0)
+        ret = -ENOENT;
+
+    uint64_t off = sizeof(seg_file_header_t);
+    while (ret == 0 && off + sizeof(seg_record_t) <= end)
+    {
+        seg_record_t rec;
+        ret = read_full(fd, (char *)&rec, sizeof(rec), (off_t)off);
+        if (ret == 0 && (rec.magic != SEG_RECORD_MAGIC || rec.length > SEG_MAX_PAYLOAD))
+            ret = -EIO;
+        if (ret == 0 && rec.type == SEG_REC_DATA)
+            ret = read_full(fd, payload, rec.length, (off_t)(off + sizeof(rec)));
+        if (ret != 0)
+            break;
+        uint64_t rec_len = sizeof(rec) + rec.length;
+        pthread_mutex_lock(&g_store.lock);
+        ret = g_store.enabled ? store_move_record_locked(no, off, &rec, payload) : -ESHUTDOWN;
+        pthread_mutex_unlock(&g_store.lock);
+        off += rec_len;
+    }
+    free(payload);
+    if (fd >= 0)
+        close(fd);
+
+    /* 搬迁出的记录落盘后才能删除旧段 */
+    if (ret == 0)
+        ret = store_sync();
+    if (ret != 0)
+    {
+        SBFS_LOG_WARN("段存储：清理段 %08x 失败: %s", no, strerror(-ret));
+        return ret;
+    }
+
+    pthread_mutex_lock(&g_store.lock);
+    seg = g_store.enabled ? seg_find(no) : NULL;
+    if (seg)
+    {
+        if (g_store.read_fd >= 0 && g_store.read_no == no)
+        {
+            close(g_store.read_fd);
+            g_store.read_fd = -1;
+        }
+        size_t idx = (size_t)(seg - g_store.segs);
+        memmove(&g_store.segs[idx], &g_store.segs[idx + 1],
+                (g_store.seg_count - idx - 1) * sizeof(seg_file_t));
+        g_store.seg_count--;
+        g_store.cleaned_segments++;
+        g_store.reclaimed_bytes += end;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    if (seg)
+        unlink(path);
+    return 0;
+}
+
+/* 挑出存活比例最低、且低于阈值的旧段；当前段与含检查点记录的段不清理 */
+static seg_file_t *store_pick_victim_locked(void)
+{
+    seg_file_t *best = NULL;
+    for (size_t i = 0; i + 1 < g_store.seg_count; i++)
+    {
+        seg_file_t *seg = &g_store.segs[i];
+        if (seg->ckpt_bytes || seg->ckpt_pending)
+            continue;
+        if (seg->live * 100 >= seg->bytes * g_store.clean_percent)
+            continue;
+        if (!best || seg->live * best->bytes < best->live * seg->bytes)
+            best = seg;
+    }
+    return best;
+}
+
+static int store_clean(int max_segments)
+{
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.enabled || g_store.cleaning)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return 0;
+    }
+    g_store.cleaning = true;
+    int cleaned = 0;
+    seg_file_t *victim;
+    while (cleaned < max_segments && g_store.enabled && (victim = store_pick_victim_locked()) != NULL)
+    {
+        uint32_t no = victim->no;
+        pthread_mutex_unlock(&g_store.lock);
+        int ret = store_clean_segment(no);
+        pthread_mutex_lock(&g_store.lock);
+        if (ret != 0)
+            break;
+        cleaned++;
+    }
+    g_store.cleaning = false;
+    pthread_mutex_unlock(&g_store.lock);
+    return cleaned;
+}
+
+/* 后台线程：段滚动后把旧段落盘并清理至多 SEG_CLEAN_PER_ROLL 个旧段 */
+static void *store_worker_fn(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&g_store.lock);
+    while (g_store.worker_running)
+    {
+        if (!g_store.worker_wakeup)
+        {
+            pthread_cond_wait(&g_store.worker_cond, &g_store.lock);
+            continue;
+        }
+        g_store.worker_wakeup = false;
+        pthread_mutex_unlock(&g_store.lock);
+        int ret = store_sync();
+        if (ret != 0)
+        {
+            SBFS_LOG_ERROR("段存储：旧段落盘失败: %s", strerror(-ret));
+            pthread_mutex_lock(&g_store.lock);
+            g_store.sync_error = ret;
+            pthread_mutex_unlock(&g_store.lock);
+        }
+        store_clean(SEG_CLEAN_PER_ROLL);
+        pthread_mutex_lock(&g_store.lock);
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * 挂载时重放 */
+
+typedef struct replay_state {
+    uint64_t cur_seq;            /* 正在读的检查点（0 表示不在检查点中） */
+    uint32_t cur_seg;
+    uint64_t cur_offset;
+    uint64_t *cur_pins;          /* 正在读的检查点引用的块ID */
+    size_t cur_count;
+    size_t cur_cap;
+    uint64_t *pins;              /* 最新完整检查点引用的块ID */
+    size_t pin_count;
+    size_t pin_cap;
+} replay_state_t;
+
+static int replay_pin(replay_state_t *rs, const segment_block_ref_t *refs, size_t count)
+{
+    if (rs->cur_count + count > rs->cur_cap)
+    {
+        size_t cap = rs->cur_cap ? rs->cur_cap : 1024;
+        while (cap < rs->cur_count + count)
+            cap *= 2;
+        uint64_t *pins = realloc(rs->cur_pins, cap * sizeof(uint64_t));
+        if (!pins)
+            return -ENOMEM;
+        rs->cur_pins = pins;
+        rs->cur_cap = cap;
+    }
+    for (size_t i = 0; i < count; i++)
+        rs->cur_pins[rs->cur_count++] = refs[i].block_id;
+    return 0;
+}
+
+static int replay_record(replay_state_t *rs, seg_file_t *seg, uint64_t off, const seg_record_t *rec,
+                         const char *payload)
+{
+    uint64_t rec_len = sizeof(*rec) + rec->length;
+    switch (rec->type)
+    {
+    case SEG_REC_DATA:
+    {
+        /* 同一指纹后出现的 DATA 是清理搬迁后的新位置 */
+        seg_extent_t *ext = extent_find(rec->hash);
+        if (!ext && !(ext = extent_create(rec->hash)))
+            return -ENOMEM;
+        extent_set_location(ext, rec, seg->no, off);
+        return 0;
+    }
+    case SEG_REC_MAP:
+    {
+        seg_map_t *map = hash_table_get(g_store.maps, rec->id);
+        if (!map)
+        {
+            map = calloc(1, sizeof(seg_map_t));
+            if (!map || hash_table_set(g_store.maps, rec->id, map) != 0)
+            {
+                free(map);
+                return -ENOMEM;
+            }
+        }
+        memcpy(map->hash, rec->hash, 32);
+        map->seg = seg->no;
+        map->offset = off;
+        if (rec->id > g_store.max_block_id)
+            g_store.max_block_id = rec->id;
+        return 0;
+    }
+    case SEG_REC_CKPT_BEGIN:
+        for (size_t i = 0; i < g_store.seg_count; i++)
+            g_store.segs[i].ckpt_pending = 0;
+        rs->cur_seq = rec->id;
+        rs->cur_seg = seg->no;
+        rs->cur_offset = off;
+        rs->cur_count = 0;
+        seg->ckpt_pending += rec_len;
+        return 0;
+    case SEG_REC_NODE:
+        if (rs->cur_seq)
+            seg->ckpt_pending += rec_len;
+        return 0;
+    case SEG_REC_BLOCKS:
+        if (!rs->cur_seq)
+            return 0;
+        seg->ckpt_pending += rec_len;
+        return replay_pin(rs, (const segment_block_ref_t *)payload,
+                          rec->length / sizeof(segment_block_ref_t));
+    case SEG_REC_CKPT_END:
+        if (!rs->cur_seq || rec->id != rs->cur_seq)
+            return 0;
+        seg->ckpt_pending += rec_len;
+        for (size_t i = 0; i < g_store.seg_count; i++)
+        {
+            g_store.segs[i].ckpt_bytes = g_store.segs[i].ckpt_pending;
+            g_store.segs[i].ckpt_pending = 0;
+        }
+        g_store.ckpt_seq = rs->cur_seq;
+        g_store.ckpt_seg = rs->cur_seg;
+        g_store.ckpt_offset = rs->cur_offset;
+        {
+            /* 交换两组缓冲，旧的完整检查点的缓冲留给下一个检查点复用 */
+            uint64_t *tmp = rs->pins;
+            size_t tmp_cap = rs->pin_cap;
+            rs->pins = rs->cur_pins;
+            rs->pin_cap = rs->cur_cap;
+            rs->pin_count = rs->cur_count;
+            rs->cur_pins = tmp;
+            rs->cur_cap = tmp_cap;
+        }
+        rs->cur_count = 0;
+        rs->cur_seq = 0;
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* 读一个段的全部有效记录，返回有效长度；记录损坏或不完整时停在其前 */
+static int replay_segment(replay_state_t *rs, seg_file_t *seg, int fd, char *payload)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return -errno;
+    seg_file_header_t hdr;
+    if (st.st_size < (off_t)sizeof(hdr) || read_full(fd, (char *)&hdr, sizeof(hdr), 0) != 0 ||
+        memcmp(hdr.magic, SEG_FILE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != SEG_FILE_VERSION)
+        return -EINVAL;
+
+    uint64_t off = sizeof(hdr);
+    uint64_t size = (uint64_t)st.st_size;
+    while (off + sizeof(seg_record_t) <= size)
+    {
+        seg_record_t rec;
+        if (read_full(fd, (char *)&rec, sizeof(rec), (off_t)off) != 0 || rec.magic != SEG_RECORD_MAGIC ||
+            rec.length > SEG_MAX_PAYLOAD || off + sizeof(rec) + rec.length > size)
+            break;
+        if (rec.length && read_full(fd, payload, rec.length, (off_t)(off + sizeof(rec))) != 0)
+            break;
+        uint32_t crc = rec.crc;
+        rec.crc = 0;
+        uint32_t calc = (uint32_t)crc32(0, (const Bytef *)&rec, sizeof(rec));
+        if (rec.length)
+            calc = (uint32_t)crc32(calc, (const Bytef *)payload, rec.length);
+        rec.crc = crc;
+        if (calc != crc)
+            break;
+        int ret = replay_record(rs, seg, off, &rec, payload);
+        if (ret != 0)
+            return ret;
+        off += sizeof(rec) + rec.length;
+    }
+    if (off != size)
+        SBFS_LOG_WARN("段存储：段 %08x 在偏移 %llu 之后的 %llu 字节无效，已丢弃", seg->no,
+                      (unsigned long long)off, (unsigned long long)(size - off));
+    seg->bytes = off;
+    return 0;
+}
+
+static int u64_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* 重放结束：把块ID连到内容上，回收不存活的块ID与无人引用的内容，统计各段存活字节 */
+static void replay_finish(replay_state_t *rs)
+{
+    if (rs->pin_count)
+        qsort(rs->pins, rs->pin_count, sizeof(uint64_t), u64_cmp);
+    hash_table_iter_t it;
+    void **value;
+    uint64_t key;
+    hash_table_iter_init(&it, g_store.maps);
+    while ((value = hash_table_iter_next(&it, &key)) != NULL)
+    {
+        seg_map_t *map = *value;
+        if (rs->pin_count && bsearch(&key, rs->pins, rs->pin_count, sizeof(uint64_t), u64_cmp))
+            map->pin_seq = g_store.ckpt_seq;
+        map->extent = extent_find(map->hash);
+        if (map->extent && map_alive(map))
+        {
+            map->extent->refs++;
+            seg_add_live(map->seg, (int64_t)sizeof(seg_record_t));
+        }
+        else if (map_alive(map))
+        {
+            SBFS_LOG_WARN("段存储：块 %llu 的内容已丢失", (unsigned long long)key);
+        }
+    }
+
+    /* 不存活的块ID尚未计入存活字节，直接丢弃 */
+    size_t cap = hash_table_size(g_store.maps);
+    uint64_t *dead = cap ? malloc(cap * sizeof(uint64_t)) : NULL;
+    size_t n = 0;
+    hash_table_iter_init(&it, g_store.maps);
+    while (dead && (value = hash_table_iter_next(&it, &key)) != NULL && n < cap)
+    {
+        seg_map_t *map = *value;
+        if (!map->extent || !map_alive(map))
+            dead[n++] = key;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        seg_map_t *map = hash_table_get(g_store.maps, dead[i]);
+        hash_table_remove(g_store.maps, dead[i]);
+        free(map);
+    }
+    free(dead);
+
+    cap = g_store.extent_count;
+    seg_extent_t **orphans = cap ? malloc(cap * sizeof(seg_extent_t *)) : NULL;
+    n = 0;
+    hash_table_iter_init(&it, g_store.extents);
+    while (orphans && (value = hash_table_iter_next(&it, NULL)) != NULL)
+    {
+        for (seg_extent_t *ext = *value; ext; ext = ext->next)
+        {
+            if (ext->refs == 0 && n < cap)
+                orphans[n++] = ext;
+            else if (ext->refs)
+                seg_add_live(ext->seg, ext->record_len);
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+        extent_destroy(orphans[i], false);
+    free(orphans);
+
+    for (size_t i = 0; i < g_store.seg_count; i++)
+    {
+        g_store.segs[i].live += g_store.segs[i].ckpt_bytes;
+        g_store.segs[i].ckpt_pending = 0;
+    }
+}
+
+static int seg_no_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* 列出目录中的段号（升序） */
+static int list_segments(uint32_t **out, size_t *count)
+{
+    DIR *d = opendir(g_store.dir);
+    if (!d)
+        return -errno;
+    uint32_t *nos = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+    {
+        unsigned int no;
+        char tail;
+        if (sscanf(de->d_name, "seg-%8x.sb%c", &no, &tail) != 2 || tail != 's' ||
+            strlen(de->d_name) != strlen("seg-00000000.sbs"))
+            continue;
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            uint32_t *tmp = realloc(nos, cap * sizeof(uint32_t));
+            if (!tmp)
+            {
+                free(nos);
+                closedir(d);
+                return -ENOMEM;
+            }
+            nos = tmp;
+        }
+        nos[n++] = no;
+    }
+    closedir(d);
+    if (n)
+        qsort(nos, n, sizeof(uint32_t), seg_no_cmp);
+    *out = nos;
+    *count = n;
+    return 0;
+}
+
+static int store_replay_locked(void)
+{
+    uint32_t *nos = NULL;
+    size_t count = 0;
+    int ret = list_segments(&nos, &count);
+    if (ret != 0)
+        return ret;
+
+    replay_state_t rs;
+    memset(&rs, 0, sizeof(rs));
+    char *payload = malloc(SEG_MAX_PAYLOAD);
+    if (!payload)
+    {
+        free(nos);
+        return -ENOMEM;
+    }
+    for (size_t i = 0; i < count && ret == 0; i++)
+    {
+        char path[PATH_MAX + 32];
+        seg_path(nos[i], path, sizeof(path));
+        bool last = i + 1 == count;
+        int fd = open(path, last ? O_RDWR : O_RDONLY);
+        if (fd < 0)
+        {
+            ret = -errno;
+            break;
+        }
+        seg_file_t *seg = seg_push(nos[i]);
+        if (!seg)
+        {
+            close(fd);
+            ret = -ENOMEM;
+            break;
+        }
+        ret = replay_segment(&rs, seg, fd, payload);
+        if (ret == -EINVAL)
+        {
+            SBFS_LOG_WARN("段存储：%s 不是有效的段文件，已跳过", path);
+            g_store.seg_count--;
+            close(fd);
+            ret = 0;
+            continue;
+        }
+        if (ret == 0 && last)
+        {
+            /* 截掉末尾不完整的记录，继续在该段追加 */
+            if (ftruncate(fd, (off_t)seg->bytes) != 0)
+                ret = -errno;
+            g_store.fd = fd;
+        }
+        else
+        {
+            close(fd);
+        }
+    }
+    free(payload);
+    free(nos);
+    if (ret == 0)
+        replay_finish(&rs);
+    free(rs.pins);
+    free(rs.cur_pins);
+    return ret;
+}
+
+/* ---------------------------------------------------------------------------
+ * 对外接口 */
+
+static void store_release_locked(void)
+{
+    if (g_store.maps)
+    {
+        hash_table_iter_t it;
+        void **value;
+        hash_table_iter_init(&it, g_store.maps);
+        while ((value = hash_table_iter_next(&it, NULL)) != NULL)
+            free(*value);
+        hash_table_destroy(g_store.maps);
+        g_store.maps = NULL;
+    }
+    if (g_store.extents)
+    {
+        hash_table_iter_t it;
+        void **value;
+        hash_table_iter_init(&it, g_store.extents);
+        while ((value = hash_table_iter_next(&it, NULL)) != NULL)
+        {
+            seg_extent_t *ext = *value;
+            while (ext)
+            {
+                seg_extent_t *next = ext->next;
+                free(ext);
+                ext = next;
+            }
+        }
+        hash_table_destroy(g_store.extents);
+        g_store.extents = NULL;
+    }
+    if (g_store.fd >= 0)
+        close(g_store.fd);
+    if (g_store.read_fd >= 0)
+        close(g_store.read_fd);
+    for (size_t i = 0; i < g_store.unsynced_count; i++)
+        close(g_store.unsynced[i]);
+    free(g_store.unsynced);
+    free(g_store.segs);
+    free(g_store.buf);
+    pthread_mutex_t lock = g_store.lock;
+    pthread_mutex_t sync_lock = g_store.sync_lock;
+    pthread_cond_t worker_cond = g_store.worker_cond;
+    memset(&g_store, 0, sizeof(g_store));
+    g_store.lock = lock;
+    g_store.sync_lock = sync_lock;
+    g_store.worker_cond = worker_cond;
+    g_store.fd = -1;
+    g_store.read_fd = -1;
+}
+
+int segment_store_open(const char *dir, uint64_t segment_size, unsigned clean_percent)
+{
+    if (!dir || !*dir || strlen(dir) >= sizeof(g_store.dir))
+        return -EINVAL;
+
+    pthread_mutex_lock(&g_store.lock);
+    if (g_store.enabled)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return -EBUSY;
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+    {
+        int err = -errno;
+        pthread_mutex_unlock(&g_store.lock);
+        return err;
+    }
+    strcpy(g_store.dir, dir);
+    g_store.segment_size = segment_size ? segment_size : SEGMENT_DEFAULT_SIZE;
+    if (g_store.segment_size < 2 * SEG_BATCH_SIZE)
+        g_store.segment_size = 2 * SEG_BATCH_SIZE;
+    g_store.clean_percent = clean_percent <= 100 ? clean_percent : SEGMENT_DEFAULT_CLEAN_PERCENT;
+    g_store.buf = malloc(SEG_BATCH_SIZE);
+    g_store.maps = hash_table_create(4096);
+    g_store.extents = hash_table_create(4096);
+    int ret = (g_store.buf && g_store.maps && g_store.extents) ? 0 : -ENOMEM;
+    if (ret == 0)
+        ret = store_replay_locked();
+    if (ret == 0 && g_store.fd < 0)
+        ret = store_create_segment_locked(g_store.seg_count ? seg_active()->no + 1 : 1);
+    if (ret == 0)
+    {
+        g_store.worker_running = true;
+        ret = -pthread_create(&g_store.worker, NULL, store_worker_fn, NULL);
+        g_store.worker_running = ret == 0;
+    }
+    if (ret != 0)
+    {
+        SBFS_LOG_ERROR("段存储：打开 %s 失败: %s", dir, strerror(-ret));
+        store_release_locked();
+        pthread_mutex_unlock(&g_store.lock);
+        return ret;
+    }
+    g_store.enabled = true;
+    SBFS_LOG_INFO("段存储：%s，%zu 个段，%zu 个块，最新检查点 %llu", dir, g_store.seg_count,
+                  hash_table_size(g_store.maps), (unsigned long long)g_store.ckpt_seq);
+    pthread_mutex_unlock(&g_store.lock);
+    return 0;
+}
+
+void segment_store_close(void)
+{
+    pthread_mutex_lock(&g_store.lock);
+    bool worker = g_store.worker_running;
+    g_store.worker_running = false;
+    pthread_cond_signal(&g_store.worker_cond);
+    pthread_mutex_unlock(&g_store.lock);
+    if (worker)
+        pthread_join(g_store.worker, NULL);
+
+    store_sync();
+    pthread_mutex_lock(&g_store.lock);
+    if (g_store.enabled)
+        store_release_locked();
+    pthread_mutex_unlock(&g_store.lock);
+}
+
+bool segment_store_enabled(void)
+{
+    return __atomic_load_n(&g_store.enabled, __ATOMIC_ACQUIRE);
+}
+
+int segment_store_put(const data_block_t *block)
+{
+    if (!block || !block->data || block->size == 0 || !segment_store_enabled())
+        return 0;
+    const char *payload = block->data;
+    bool compressed = block->compressed_size > 0 && block->compression != 0;
+    size_t len = compressed ? block->compressed_size : block->size;
+
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.enabled)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return 0;
+    }
+    seg_map_t *map = hash_table_get(g_store.maps, block->block_id);
+    if (map && map->extent && memcmp(map->hash, block->hash, 32) == 0)
+    {
+        /* 去重共享的块或内容未变 */
+        map->in_use = true;
+        pthread_mutex_unlock(&g_store.lock);
+        return 0;
+    }
+
+    int ret = 0;
+    uint32_t no;
+    uint64_t off;
+    seg_extent_t *ext = extent_find(block->hash);
+    if (!ext)
+    {
+        seg_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = SEG_REC_DATA;
+        rec.compression = compressed ? block->compression : 0;
+        rec.size = (uint32_t)block->size;
+        rec.checksum = block->checksum;
+        memcpy(rec.hash, block->hash, 32);
+        ret = store_append_locked(&rec, payload, len, &no, &off);
+        if (ret == 0 && !(ext = extent_create(block->hash)))
+            ret = -ENOMEM;
+        if (ret == 0)
+            extent_set_location(ext, &rec, no, off);
+    }
+
+    if (ret == 0)
+    {
+        seg_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = SEG_REC_MAP;
+        rec.id = block->block_id;
+        memcpy(rec.hash, block->hash, 32);
+        ret = store_append_locked(&rec, NULL, 0, &no, &off);
+    }
+    if (ret == 0 && !map)
+    {
+        map = calloc(1, sizeof(seg_map_t));
+        if (!map || hash_table_set(g_store.maps, block->block_id, map) != 0)
+        {
+            free(map);
+            map = NULL;
+            ret = -ENOMEM;
+        }
+    }
+    if (ret == 0)
+    {
+        /* 块被原地改写：旧 MAP 记录与旧内容的引用作废 */
+        if (map->extent)
+        {
+            seg_add_live(map->seg, -(int64_t)sizeof(seg_record_t));
+            map_unlink_extent(map);
+        }
+        memcpy(map->hash, block->hash, 32);
+        map->extent = ext;
+        ext->refs++;
+        map->seg = no;
+        map->offset = off;
+        map->in_use = true;
+        if (block->block_id > g_store.max_block_id)
+            g_store.max_block_id = block->block_id;
+    }
+    else if (ext && ext->refs == 0)
+    {
+        extent_destroy(ext, true);
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    if (ret != 0)
+        SBFS_LOG_WARN("段存储：块 %llu 落盘失败: %s", (unsigned long long)block->block_id, strerror(-ret));
+    return ret;
+}
+
+void segment_store_release(uint64_t block_id)
+{
+    if (!segment_store_enabled())
+        return;
+    pthread_mutex_lock(&g_store.lock);
+    seg_map_t *map = g_store.enabled ? hash_table_get(g_store.maps, block_id) : NULL;
+    if (map)
+    {
+        map->in_use = false;
+        if (!map_alive(map))
+            map_destroy(block_id, map);
+    }
+    pthread_mutex_unlock(&g_store.lock);
+}
+
+int segment_store_read(uint64_t block_id, char *buf, size_t cap, segment_block_info_t *info)
+{
+    if (!segment_store_enabled())
+        return -ENODEV;
+    pthread_mutex_lock(&g_store.lock);
+    seg_map_t *map = g_store.enabled ? hash_table_get(g_store.maps, block_id) : NULL;
+    seg_extent_t *ext = map ? map->extent : NULL;
+    int ret;
+    if (!ext)
+    {
+        ret = -ENOENT;
+    }
+    else
+    {
+        if (info)
+        {
+            info->size = ext->size;
+            info->stored = ext->stored;
+            info->checksum = ext->checksum;
+            info->compression = ext->compression;
+            memcpy(info->hash, ext->hash, 32);
+        }
+        seg_record_t rec;
+        if (!buf || cap < ext->stored)
+            ret = -ERANGE;
+        else
+            ret = store_read_record_locked(ext->seg, ext->offset, &rec, buf, cap);
+        if (ret == 0)
+            ret = memcmp(rec.hash, ext->hash, 32) == 0 ? (int)rec.length : -EIO;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return ret;
+}
+
+int segment_store_sync(void)
+{
+    return segment_store_enabled() ? store_sync() : 0;
+}
+
+int segment_store_clean(void)
+{
+    return segment_store_enabled() ? store_clean(INT_MAX) : 0;
+}
+
+uint64_t segment_store_max_block_id(void)
+{
+    pthread_mutex_lock(&g_store.lock);
+    uint64_t id = g_store.max_block_id;
+    pthread_mutex_unlock(&g_store.lock);
+    return id;
+}
+
+int segment_store_checkpoint_begin(void)
+{
+    if (!segment_store_enabled())
+        return 0;
+    pthread_mutex_lock(&g_store.lock);
+    for (size_t i = 0; i < g_store.seg_count; i++)
+        g_store.segs[i].ckpt_pending = 0;
+    g_store.ckpt_writing = true;
+    g_store.ckpt_new_seq = g_store.ckpt_seq + 1;
+    seg_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = SEG_REC_CKPT_BEGIN;
+    rec.id = g_store.ckpt_new_seq;
+    int ret = store_append_locked(&rec, NULL, 0, &g_store.ckpt_new_seg, &g_store.ckpt_new_offset);
+    if (ret != 0)
+        g_store.ckpt_writing = false;
+    pthread_mutex_unlock(&g_store.lock);
+    return ret;
+}
+
+int segment_store_checkpoint_node(const segment_node_t *node)
+{
+    if (!segment_store_enabled())
+        return 0;
+    size_t name_len = node->name ? strlen(node->name) : 0;
+    size_t target_len = node->link_target ? strlen(node->link_target) : 0;
+    size_t len = sizeof(seg_node_record_t) + name_len + target_len;
+    if (len > SEG_MAX_PAYLOAD)
+        return -ENAMETOOLONG;
+    char *payload = malloc(len);
+    if (!payload)
+        return -ENOMEM;
+    seg_node_record_t nr = {
+        .ino = node->ino,
+        .parent_ino = node->parent_ino,
+        .nlink = node->nlink,
+        .size = node->size,
+        .blocks = node->blocks,
+        .atime_sec = node->atime.tv_sec,
+        .mtime_sec = node->mtime.tv_sec,
+        .ctime_sec = node->ctime.tv_sec,
+        .atime_nsec = (uint32_t)node->atime.tv_nsec,
+        .mtime_nsec = (uint32_t)node->mtime.tv_nsec,
+        .ctime_nsec = (uint32_t)node->ctime.tv_nsec,
+        .type = node->type,
+        .mode = node->mode,
+        .uid = node->uid,
+        .gid = node->gid,
+        .name_len = (uint32_t)name_len,
+        .target_len = (uint32_t)target_len,
+    };
+    memcpy(payload, &nr, sizeof(nr));
+    if (name_len)
+        memcpy(payload + sizeof(nr), node->name, name_len);
+    if (target_len)
+        memcpy(payload + sizeof(nr) + name_len, node->link_target, target_len);
+
+    pthread_mutex_lock(&g_store.lock);
+    int ret = -EINVAL;
+    if (g_store.ckpt_writing)
+    {
+        seg_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = SEG_REC_NODE;
+        rec.id = node->ino;
+        uint32_t no;
+        uint64_t off;
+        ret = store_append_locked(&rec, payload, len, &no, &off);
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    free(payload);
+    return ret;
+}
+
+int segment_store_checkpoint_blocks(const segment_block_ref_t *refs, size_t count)
+{
+    if (!segment_store_enabled())
+        return 0;
+    pthread_mutex_lock(&g_store.lock);
+    int ret = g_store.ckpt_writing ? 0 : -EINVAL;
+    while (ret == 0 && count > 0)
+    {
+        size_t n = count < SEGMENT_CKPT_BATCH ? count : SEGMENT_CKPT_BATCH;
+        seg_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = SEG_REC_BLOCKS;
+        uint32_t no;
+        uint64_t off;
+        ret = store_append_locked(&rec, refs, n * sizeof(*refs), &no, &off);
+        for (size_t i = 0; ret == 0 && i < n; i++)
+        {
+            seg_map_t *map = hash_table_get(g_store.maps, refs[i].block_id);
+            if (map)
+                map->pin_seq = g_store.ckpt_new_seq;
+        }
+        refs += n;
+        count -= n;
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return ret;
+}
+
+int segment_store_checkpoint_end(void)
+{
+    if (!segment_store_enabled())
+        return 0;
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.ckpt_writing)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return -EINVAL;
+    }
+    seg_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = SEG_REC_CKPT_END;
+    rec.id = g_store.ckpt_new_seq;
+    uint32_t no;
+    uint64_t off;
+    int ret = store_append_locked(&rec, NULL, 0, &no, &off);
+    pthread_mutex_unlock(&g_store.lock);
+
+    /* 落盘期间其他线程可以继续追加；本检查点的段仍有 ckpt_pending，不会被清理 */
+    if (ret == 0)
+        ret = store_sync();
+    pthread_mutex_lock(&g_store.lock);
+    g_store.ckpt_writing = false;
+    if (ret == 0 && g_store.enabled)
+    {
+        /* 新检查点生效：旧检查点的记录成为垃圾，只被旧检查点引用的块ID失效 */
+        for (size_t i = 0; i < g_store.seg_count; i++)
+        {
+            seg_file_t *seg = &g_store.segs[i];
+            seg->live -= seg->ckpt_bytes;
+            seg->ckpt_bytes = seg->ckpt_pending;
+            seg->ckpt_pending = 0;
+        }
+        g_store.ckpt_seq = g_store.ckpt_new_seq;
+        g_store.ckpt_seg = g_store.ckpt_new_seg;
+        g_store.ckpt_offset = g_store.ckpt_new_offset;
+        store_sweep_maps_locked();
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    return ret;
+}
+
+int segment_store_restore(segment_restore_fn fn, void *arg)
+{
+    if (!fn || !segment_store_enabled())
+        return 0;
+    pthread_mutex_lock(&g_store.lock);
+    if (!g_store.ckpt_seq)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return 0;
+    }
+    char *payload = malloc(SEG_MAX_PAYLOAD + 1);
+    if (!payload)
+    {
+        pthread_mutex_unlock(&g_store.lock);
+        return -ENOMEM;
+    }
+
+    /* 检查点所在的段不会被清理，记录从 CKPT_BEGIN 起连续排列到 CKPT_END */
+    int ret = 0;
+    bool done = false;
+    uint64_t off = g_store.ckpt_offset;
+    size_t idx = (size_t)(seg_find(g_store.ckpt_seg) - g_store.segs);
+    while (!done && ret == 0 && idx < g_store.seg_count)
+    {
+        seg_file_t *seg = &g_store.segs[idx];
+        if (off + sizeof(seg_record_t) > seg->bytes)
+        {
+            idx++;
+            off = sizeof(seg_file_header_t);
+            continue;
+        }
+        seg_record_t rec;
+        ret = store_read_record_locked(seg->no, off, &rec, payload, SEG_MAX_PAYLOAD);
+        if (ret != 0)
+            break;
+        off += sizeof(rec) + rec.length;
+        if (rec.type == SEG_REC_CKPT_END && rec.id == g_store.ckpt_seq)
+        {
+            done = true;
+        }
+        else if (rec.type == SEG_REC_NODE && rec.length >= sizeof(seg_node_record_t))
+        {
+            seg_node_record_t nr;
+            memcpy(&nr, payload, sizeof(nr));
+            if (sizeof(nr) + (size_t)nr.name_len + nr.target_len > rec.length)
+            {
+                ret = -EIO;
+                break;
+            }
+            /* 名称与链接目标就地加上结尾0：链接目标后移一字节 */
+            char *name = payload + sizeof(nr);
+            char *target = name + nr.name_len + 1;
+            memmove(target, name + nr.name_len, nr.target_len);
+            target[nr.target_len] = '\0';
+            name[nr.name_len] = '\0';
+            segment_node_t node = {
+                .ino = nr.ino,
+                .parent_ino = nr.parent_ino,
+                .nlink = nr.nlink,
+                .size = nr.size,
+                .blocks = nr.blocks,
+                .type = nr.type,
+                .mode = nr.mode,
+                .uid = nr.uid,
+                .gid = nr.gid,
+                .atime = {.tv_sec = nr.atime_sec, .tv_nsec = nr.atime_nsec},
+                .mtime = {.tv_sec = nr.mtime_sec, .tv_nsec = nr.mtime_nsec},
+                .ctime = {.tv_sec = nr.ctime_sec, .tv_nsec = nr.ctime_nsec},
+                .name = name,
+                .link_target = nr.target_len ? target : NULL,
+            };
+            /* 回调会读取块（segment_store_read），期间放开锁 */
+            pthread_mutex_unlock(&g_store.lock);
+            ret = fn(arg, &node, NULL, 0);
+            pthread_mutex_lock(&g_store.lock);
+        }
+        else if (rec.type == SEG_REC_BLOCKS)
+        {
+            const segment_block_ref_t *refs = (const segment_block_ref_t *)payload;
+            size_t count = rec.length / sizeof(segment_block_ref_t);
+            for (size_t i = 0; i < count; i++)
+            {
+                seg_map_t *map = hash_table_get(g_store.maps, refs[i].block_id);
+                if (map)
+                    map->in_use = true;
+            }
+            pthread_mutex_unlock(&g_store.lock);
+            ret = fn(arg, NULL, refs, count);
+            pthread_mutex_lock(&g_store.lock);
+        }
+    }
+    pthread_mutex_unlock(&g_store.lock);
+    free(payload);
+    if (ret == 0 && !done)
+        ret = -EIO;
+    return ret;
+}
+
+int segment_store_format_stats(char *buf, size_t buf_size)
+{
+    if (!buf || buf_size == 0)
+        return -1;
+    pthread_mutex_lock(&g_store.lock);
+    uint64_t bytes = 0, live = 0;
+    for (size_t i = 0; i < g_store.seg_count; i++)
+    {
+        bytes += g_store.segs[i].bytes;
+        live += g_store.segs[i].live;
+    }
+    int n = snprintf(buf, buf_size,
+                     "enabled=%d;segments=%zu;bytes=%llu;live_bytes=%llu;blocks=%zu;extents=%zu;"
+                     "appended=%llu;cleaned_segments=%llu;reclaimed=%llu;checkpoint=%llu",
+                     g_store.enabled ? 1 : 0, g_store.seg_count, (unsigned long long)bytes,
+                     (unsigned long long)live, g_store.maps ? hash_table_size(g_store.maps) : 0,
+                     g_store.extent_count, (unsigned long long)g_store.appended_bytes,
+                     (unsigned long long)g_store.cleaned_segments,
+                     (unsigned long long)g_store.reclaimed_bytes, (unsigned long long)g_store.ckpt_seq);
+    pthread_mutex_unlock(&g_store.lock);
+    return (n >= 0 && (size_t)n < buf_size) ? n : -1;
+}
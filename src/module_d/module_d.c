@@ -4,6 +4,7 @@
  */
 
 #include "module_d.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -136,7 +137,7 @@ int md_integrity_init(void) {
     }
     module_d_state.integrity_scan_running = false;
     
-    printf("模块D：数据完整性保护系统初始化完成（生产级）\n");
+    SBFS_LOG_INFO("模块D：数据完整性保护系统初始化完成（生产级）");
     return 0;
 }
 
@@ -144,7 +145,7 @@ void md_integrity_destroy(void) {
     // 停止完整性扫描
     md_stop_integrity_scan();
     
-    printf("模块D：数据完整性保护系统已销毁\n");
+    SBFS_LOG_INFO("模块D：数据完整性保护系统已销毁");
 }
 
 uint32_t md_calculate_checksum(const void *data, size_t size) {
@@ -168,13 +169,13 @@ int md_verify_block_integrity(data_block_t *block) {
         return -1;
     }
     
-    printf("验证块 %lu 的完整性...\n", block->block_id);
+    SBFS_LOG_DEBUG("验证块 %lu 的完整性...", block->block_id);
     
     // 使用模块C的适配器接口进行实际验证
     int result = verify_block_integrity(block);
     
     if (result != 0) {
-        printf("块 %lu 完整性验证失败\n", block->block_id);
+        SBFS_LOG_WARN("块 %lu 完整性验证失败", block->block_id);
         module_d_state.corrupted_blocks_found++;
         
         // 触发预警
@@ -183,7 +184,7 @@ int md_verify_block_integrity(data_block_t *block) {
         return -1;
     }
     
-    printf("块 %lu 完整性验证通过\n", block->block_id);
+    SBFS_LOG_DEBUG("块 %lu 完整性验证通过", block->block_id);
     return 0;
 }
 
@@ -192,7 +193,7 @@ int md_write_with_verification(data_block_t *block, const void *data, size_t siz
         return -1;
     }
     
-    printf("写入块 %lu，大小: %zu\n", block->block_id, size);
+    SBFS_LOG_DEBUG("写入块 %lu，大小: %zu", block->block_id, size);
     
     // 在实际实现中，这里会使用模块C的适配器接口写入数据
     // 同时设置完整性保护信息
@@ -211,22 +212,22 @@ int md_write_with_verification(data_block_t *block, const void *data, size_t siz
         memcpy(block->hash, &new_checksum, sizeof(uint32_t));
     }
     
-    printf("块 %lu 写入完成，新校验和: %08X，大小: %zu\n", 
+    SBFS_LOG_DEBUG("块 %lu 写入完成，新校验和: %08X，大小: %zu", 
            block->block_id, new_checksum, size);
     
     // 如果启用写时验证，立即验证
     if (module_d_state.enable_write_verification) {
-        printf("执行写时验证...\n");
+        SBFS_LOG_DEBUG("执行写时验证...");
         int result = md_verify_block_integrity(block);
         if (result != 0) {
-            printf("写时验证失败，块 %lu 数据可能已损坏\n", block->block_id);
+            SBFS_LOG_WARN("写时验证失败，块 %lu 数据可能已损坏", block->block_id);
             
             // 尝试重新写入数据
             // 在实际实现中，这里会进行重试或标记块为损坏
             
             md_add_alert(ALERT_ERROR, "写时验证", "数据写入后验证失败");
         } else {
-            printf("写时验证通过\n");
+            SBFS_LOG_DEBUG("写时验证通过");
         }
         return result;
     }
@@ -241,7 +242,7 @@ static void* integrity_scanner_thread(void *arg) {
     integrity_scan_context_t *context = (integrity_scan_context_t*)arg;
     int thread_id = context->thread_id;
     
-    printf("完整性扫描线程 %d 启动，扫描块范围: %lu - %lu\n", 
+    SBFS_LOG_INFO("完整性扫描线程 %d 启动，扫描块范围: %lu - %lu", 
            thread_id, context->start_block_id, context->end_block_id);
     
     // 扫描指定范围内的数据块
@@ -261,9 +262,9 @@ static void* integrity_scanner_thread(void *arg) {
             
             // 尝试修复损坏的数据块
             if (md_handle_corrupted_block(block) == 0) {
-                printf("线程 %d: 成功修复损坏块 %lu\n", thread_id, block_id);
+                SBFS_LOG_INFO("线程 %d: 成功修复损坏块 %lu", thread_id, block_id);
             } else {
-                printf("线程 %d: 无法修复损坏块 %lu\n", thread_id, block_id);
+                SBFS_LOG_WARN("线程 %d: 无法修复损坏块 %lu", thread_id, block_id);
             }
         }
         
@@ -271,7 +272,7 @@ static void* integrity_scanner_thread(void *arg) {
         
         // 每扫描100个块报告一次进度
         if (context->blocks_scanned % 100 == 0) {
-            printf("线程 %d: 已扫描 %lu 个块，发现 %lu 个损坏块\n", 
+            SBFS_LOG_DEBUG("线程 %d: 已扫描 %lu 个块，发现 %lu 个损坏块", 
                    thread_id, context->blocks_scanned, context->corrupted_blocks_found);
         }
         
@@ -279,7 +280,7 @@ static void* integrity_scanner_thread(void *arg) {
         usleep(1000); // 1ms
     }
     
-    printf("完整性扫描线程 %d 停止，扫描完成: %lu 个块，发现 %lu 个损坏块\n", 
+    SBFS_LOG_INFO("完整性扫描线程 %d 停止，扫描完成: %lu 个块，发现 %lu 个损坏块", 
            thread_id, context->blocks_scanned, context->corrupted_blocks_found);
     
     free(context);
@@ -288,7 +289,7 @@ static void* integrity_scanner_thread(void *arg) {
 
 int md_start_integrity_scan(void) {
     if (module_d_state.integrity_scan_running) {
-        printf("完整性扫描已经在运行中\n");
+        SBFS_LOG_WARN("完整性扫描已经在运行中");
         return 0;
     }
     
@@ -297,7 +298,7 @@ int md_start_integrity_scan(void) {
     // 获取系统中总数据块数
     uint64_t total_blocks = get_total_blocks_count();
     if (total_blocks == 0) {
-        printf("系统中没有数据块需要扫描\n");
+        SBFS_LOG_DEBUG("系统中没有数据块需要扫描");
         module_d_state.integrity_scan_running = false;
         return -1;
     }
@@ -310,7 +311,7 @@ int md_start_integrity_scan(void) {
     for (int i = 0; i < MAX_INTEGRITY_SCAN_THREADS; i++) {
         integrity_scan_context_t *context = malloc(sizeof(integrity_scan_context_t));
         if (!context) {
-            printf("内存分配失败，无法启动线程 %d\n", i);
+            SBFS_LOG_ERROR("内存分配失败，无法启动线程 %d", i);
             module_d_state.integrity_scan_running = false;
             return -1;
         }
@@ -329,13 +330,13 @@ int md_start_integrity_scan(void) {
         if (pthread_create(&module_d_state.integrity_scanner_threads[i], 
                           NULL, integrity_scanner_thread, context) != 0) {
             free(context);
-            printf("无法启动完整性扫描线程 %d\n", i);
+            SBFS_LOG_ERROR("无法启动完整性扫描线程 %d", i);
             module_d_state.integrity_scan_running = false;
             return -1;
         }
     }
     
-    printf("完整性扫描已启动，使用 %d 个线程，扫描 %lu 个数据块\n", 
+    SBFS_LOG_INFO("完整性扫描已启动，使用 %d 个线程，扫描 %lu 个数据块", 
            MAX_INTEGRITY_SCAN_THREADS, total_blocks);
     return 0;
 }
@@ -355,7 +356,7 @@ void md_stop_integrity_scan(void) {
         }
     }
     
-    printf("完整性扫描已停止\n");
+    SBFS_LOG_INFO("完整性扫描已停止");
 }
 
 int md_handle_corrupted_block(data_block_t *block) {
@@ -363,7 +364,7 @@ int md_handle_corrupted_block(data_block_t *block) {
         return -1;
     }
     
-    printf("处理损坏的数据块 %lu\n", block->block_id);
+    SBFS_LOG_WARN("处理损坏的数据块 %lu", block->block_id);
     
     // 尝试从备份恢复
     // 如果备份不可用，尝试修复或重建数据
@@ -372,13 +373,13 @@ int md_handle_corrupted_block(data_block_t *block) {
     int result = handle_corrupted_block(block);
     
     if (result == 0) {
-        printf("成功修复损坏块 %lu\n", block->block_id);
+        SBFS_LOG_INFO("成功修复损坏块 %lu", block->block_id);
         module_d_state.corrupted_blocks_found--;
         
         // 添加修复成功的预警
         md_add_alert(ALERT_INFO, "数据修复", "成功修复损坏的数据块");
     } else {
-        printf("无法修复损坏块 %lu，错误代码: %d\n", block->block_id, result);
+        SBFS_LOG_WARN("无法修复损坏块 %lu，错误代码: %d", block->block_id, result);
         
         // 添加修复失败的预警
         md_add_alert(ALERT_ERROR, "数据修复", "无法修复损坏的数据块");
@@ -411,13 +412,13 @@ static int md_write_wal_segment_to_file(wal_segment_t *segment) {
     
     int fd = open(filepath, O_CREAT | O_WRONLY | O_TRUNC, 0644);
     if (fd < 0) {
-        printf("无法创建WAL文件: %s\n", strerror(errno));
+        SBFS_LOG_ERROR("无法创建WAL文件: %s", strerror(errno));
         return -1;
     }
     
     ssize_t written = write(fd, segment->data, segment->size);
     if (written != (ssize_t)segment->size) {
-        printf("写入WAL文件失败: %s\n", strerror(errno));
+        SBFS_LOG_ERROR("写入WAL文件失败: %s", strerror(errno));
         close(fd);
         return -1;
     }
@@ -427,14 +428,14 @@ static int md_write_wal_segment_to_file(wal_segment_t *segment) {
     close(fd);
     
     segment->file_written = true;
-    printf("WAL段 %lu 已写入文件: %s (大小: %zu 字节)\n", segment->segment_id, filepath, segment->size);
+    SBFS_LOG_DEBUG("WAL段 %lu 已写入文件: %s (大小: %zu 字节)", segment->segment_id, filepath, segment->size);
     return 0;
 }
 
 int md_transaction_init(void) {
     // 初始化WAL互斥锁
     if (pthread_mutex_init(&module_d_state.wal_mutex, NULL) != 0) {
-        printf("无法初始化WAL互斥锁\n");
+        SBFS_LOG_ERROR("无法初始化WAL互斥锁");
         return -1;
     }
     
@@ -445,14 +446,14 @@ int md_transaction_init(void) {
     
     // 创建WAL目录
     if (mkdir(WAL_DIR_PATH, 0755) != 0 && errno != EEXIST) {
-        printf("无法创建WAL目录: %s\n", strerror(errno));
+        SBFS_LOG_ERROR("无法创建WAL目录: %s", strerror(errno));
         return -1;
     }
     
     // 尝试从上次崩溃中恢复
     md_crash_recovery();
     
-    printf("模块D：事务日志系统初始化完成（生产级），WAL目录: %s\n", WAL_DIR_PATH);
+    SBFS_LOG_INFO("模块D：事务日志系统初始化完成（生产级），WAL目录: %s", WAL_DIR_PATH);
     return 0;
 }
 
@@ -473,7 +474,7 @@ void md_transaction_destroy(void) {
     
     pthread_mutex_destroy(&module_d_state.wal_mutex);
     
-    printf("模块D：事务日志系统已销毁\n");
+    SBFS_LOG_INFO("模块D：事务日志系统已销毁");
 }
 
 uint64_t md_transaction_begin(transaction_type_t type) {
@@ -498,7 +499,7 @@ uint64_t md_transaction_begin(transaction_type_t type) {
     // 写入WAL
     md_transaction_log(tx_id, &header, sizeof(header));
     
-    printf("开始事务 %lu (类型: %d)\n", tx_id, type);
+    SBFS_LOG_DEBUG("开始事务 %lu (类型: %d)", tx_id, type);
     
     module_d_state.total_transactions++;
     return tx_id;
@@ -509,7 +510,7 @@ int md_transaction_commit(uint64_t tx_id) {
         return 0;
     }
     
-    printf("提交事务 %lu\n", tx_id);
+    SBFS_LOG_DEBUG("提交事务 %lu", tx_id);
     
     // 更新事务状态为已提交
     transaction_header_t header = {
@@ -535,7 +536,7 @@ int md_transaction_rollback(uint64_t tx_id) {
         return 0;
     }
     
-    printf("回滚事务 %lu\n", tx_id);
+    SBFS_LOG_DEBUG("回滚事务 %lu", tx_id);
     
     // 更新事务状态为已回滚
     transaction_header_t header = {
@@ -615,27 +616,27 @@ int md_transaction_log(uint64_t tx_id, const void *data, size_t size) {
 static int md_recover_from_wal_file(const char *filepath) {
     int fd = open(filepath, O_RDONLY);
     if (fd < 0) {
-        printf("无法打开WAL文件: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法打开WAL文件: %s", strerror(errno));
         return -1;
     }
     
     // 读取文件内容
     struct stat st;
     if (fstat(fd, &st) != 0) {
-        printf("无法获取WAL文件大小\n");
+        SBFS_LOG_WARN("无法获取WAL文件大小");
         close(fd);
         return -1;
     }
     
     char *data = malloc(st.st_size);
     if (!data) {
-        printf("内存分配失败\n");
+        SBFS_LOG_ERROR("内存分配失败");
         close(fd);
         return -1;
     }
     
     if (read(fd, data, st.st_size) != st.st_size) {
-        printf("读取WAL文件失败\n");
+        SBFS_LOG_WARN("读取WAL文件失败");
         free(data);
         close(fd);
         return -1;
@@ -651,10 +652,10 @@ static int md_recover_from_wal_file(const char *filepath) {
         transaction_header_t *header = (transaction_header_t*)current;
         
         if (header->state == TX_COMMITTED) {
-            printf("重新应用已提交事务 %lu (类型: %d)\n", header->tx_id, header->type);
+            SBFS_LOG_INFO("重新应用已提交事务 %lu (类型: %d)", header->tx_id, header->type);
             // 在实际实现中，这里会重新应用事务到文件系统
         } else if (header->state == TX_PENDING) {
-            printf("回滚未提交事务 %lu (类型: %d)\n", header->tx_id, header->type);
+            SBFS_LOG_INFO("回滚未提交事务 %lu (类型: %d)", header->tx_id, header->type);
             // 在实际实现中，这里会回滚事务
         }
         
@@ -669,12 +670,12 @@ static int md_recover_from_wal_file(const char *filepath) {
 }
 
 int md_crash_recovery(void) {
-    printf("执行崩溃恢复...\n");
+    SBFS_LOG_INFO("执行崩溃恢复...");
     
     // 扫描WAL目录，查找所有WAL文件
     DIR *dir = opendir(WAL_DIR_PATH);
     if (!dir) {
-        printf("无法打开WAL目录: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法打开WAL目录: %s", strerror(errno));
         return -1;
     }
     
@@ -686,7 +687,7 @@ int md_crash_recovery(void) {
             char filepath[512];
             snprintf(filepath, sizeof(filepath), "%s/%s", WAL_DIR_PATH, entry->d_name);
             
-            printf("恢复WAL文件: %s\n", filepath);
+            SBFS_LOG_INFO("恢复WAL文件: %s", filepath);
             if (md_recover_from_wal_file(filepath) == 0) {
                 recovered_files++;
             }
@@ -695,12 +696,12 @@ int md_crash_recovery(void) {
     
     closedir(dir);
     
-    printf("崩溃恢复完成，处理了 %d 个WAL文件\n", recovered_files);
+    SBFS_LOG_INFO("崩溃恢复完成，处理了 %d 个WAL文件", recovered_files);
     return 0;
 }
 
 int md_cleanup_committed_transactions(void) {
-    printf("清理已提交的事务日志...\n");
+    SBFS_LOG_INFO("清理已提交的事务日志...");
     
     // 删除已提交且不再需要的事务日志
     wal_segment_t *prev = NULL;
@@ -728,7 +729,7 @@ int md_cleanup_committed_transactions(void) {
         }
     }
     
-    printf("事务日志清理完成\n");
+    SBFS_LOG_INFO("事务日志清理完成");
     return 0;
 }
 
@@ -738,26 +739,26 @@ int md_cleanup_committed_transactions(void) {
 
 int md_backup_init(const char *storage_path) {
     if (!storage_path) {
-        printf("备份存储路径不能为空\n");
+        SBFS_LOG_WARN("备份存储路径不能为空");
         return -1;
     }
     
     // 创建备份存储目录
     if (mkdir(storage_path, 0755) != 0 && errno != EEXIST) {
-        printf("无法创建备份存储目录: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法创建备份存储目录: %s", strerror(errno));
         return -1;
     }
     
     module_d_state.backup_storage_path = strdup(storage_path);
     if (!module_d_state.backup_storage_path) {
-        printf("内存分配失败\n");
+        SBFS_LOG_ERROR("内存分配失败");
         return -1;
     }
     
     module_d_state.backup_list = NULL;
     module_d_state.backup_in_progress = false;
     
-    printf("模块D：备份恢复系统初始化完成（生产级），存储路径: %s\n", storage_path);
+    SBFS_LOG_INFO("模块D：备份恢复系统初始化完成（生产级），存储路径: %s", storage_path);
     return 0;
 }
 
@@ -783,7 +784,7 @@ void md_backup_destroy(void) {
     
     module_d_state.backup_list = NULL;
     
-    printf("模块D：备份恢复系统已销毁\n");
+    SBFS_LOG_INFO("模块D：备份恢复系统已销毁");
 }
 
 /**
@@ -792,7 +793,7 @@ void md_backup_destroy(void) {
 static void* backup_thread_func(void *arg) {
     backup_metadata_t *backup_meta = (backup_metadata_t*)arg;
     
-    printf("开始备份 %lu: %s\n", backup_meta->backup_id, 
+    SBFS_LOG_INFO("开始备份 %lu: %s", backup_meta->backup_id, 
            backup_meta->type == BACKUP_FULL ? "完整备份" : 
            backup_meta->type == BACKUP_INCREMENTAL ? "增量备份" : "差异备份");
     
@@ -812,7 +813,7 @@ static void* backup_thread_func(void *arg) {
     // 创建备份文件
     int backup_fd = open(backup_file_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
     if (backup_fd < 0) {
-        printf("无法创建备份文件: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法创建备份文件: %s", strerror(errno));
         backup_meta->state = BACKUP_FAILED;
         module_d_state.failed_backups++;
         module_d_state.backup_in_progress = false;
@@ -836,7 +837,7 @@ static void* backup_thread_func(void *arg) {
     header.header_checksum = md_calculate_checksum(&header, sizeof(header) - sizeof(uint32_t));
     
     if (write(backup_fd, &header, sizeof(header)) != sizeof(header)) {
-        printf("写入备份头部失败\n");
+        SBFS_LOG_WARN("写入备份头部失败");
         close(backup_fd);
         unlink(backup_file_path);
         backup_meta->state = BACKUP_FAILED;
@@ -860,7 +861,7 @@ static void* backup_thread_func(void *arg) {
     lseek(backup_fd, 0, SEEK_SET);
     ssize_t written = write(backup_fd, &header, sizeof(header));
     if (written != sizeof(header)) {
-        printf("更新备份头部失败\n");
+        SBFS_LOG_WARN("更新备份头部失败");
         close(backup_fd);
         backup_meta->state = BACKUP_FAILED;
         module_d_state.failed_backups++;
@@ -877,7 +878,7 @@ static void* backup_thread_func(void *arg) {
     
     module_d_state.successful_backups++;
     
-    printf("备份 %lu 完成，大小: %lu MB, 文件数: %lu\n", 
+    SBFS_LOG_INFO("备份 %lu 完成，大小: %lu MB, 文件数: %lu", 
            backup_meta->backup_id, 
            backup_meta->total_size / (1024 * 1024), 
            backup_meta->file_count);
@@ -888,7 +889,7 @@ static void* backup_thread_func(void *arg) {
 
 uint64_t md_create_full_backup(const char *description) {
     if (module_d_state.backup_in_progress) {
-        printf("已有备份正在进行中\n");
+        SBFS_LOG_WARN("已有备份正在进行中");
         return 0;
     }
     
@@ -898,7 +899,7 @@ uint64_t md_create_full_backup(const char *description) {
     // 创建备份元数据
     backup_metadata_t *backup_meta = malloc(sizeof(backup_metadata_t));
     if (!backup_meta) {
-        printf("内存分配失败\n");
+        SBFS_LOG_ERROR("内存分配失败");
         return 0;
     }
     
@@ -915,7 +916,7 @@ uint64_t md_create_full_backup(const char *description) {
     module_d_state.backup_in_progress = true;
     if (pthread_create(&module_d_state.backup_thread, NULL, 
                        backup_thread_func, backup_meta) != 0) {
-        printf("无法启动备份线程\n");
+        SBFS_LOG_ERROR("无法启动备份线程");
         module_d_state.backup_in_progress = false;
         return 0;
     }
@@ -924,7 +925,7 @@ uint64_t md_create_full_backup(const char *description) {
 }
 
 uint64_t md_create_incremental_backup(uint64_t base_backup_id, const char *description) {
-    printf("创建增量备份，基础备份ID: %lu\n", base_backup_id);
+    SBFS_LOG_DEBUG("创建增量备份，基础备份ID: %lu", base_backup_id);
     
     // 查找基础备份
     backup_metadata_t *base_backup = NULL;
@@ -939,14 +940,14 @@ uint64_t md_create_incremental_backup(uint64_t base_backup_id, const char *descr
     }
     
     if (!base_backup) {
-        printf("找不到基础备份 %lu\n", base_backup_id);
+        SBFS_LOG_WARN("找不到基础备份 %lu", base_backup_id);
         return 0;
     }
     
     // 创建增量备份元数据
     backup_metadata_t *backup_meta = malloc(sizeof(backup_metadata_t));
     if (!backup_meta) {
-        printf("内存分配失败\n");
+        SBFS_LOG_ERROR("内存分配失败");
         return 0;
     }
     
@@ -964,7 +965,7 @@ uint64_t md_create_incremental_backup(uint64_t base_backup_id, const char *descr
 }
 
 int md_restore_filesystem(uint64_t backup_id, const recovery_options_t *options) {
-    printf("恢复文件系统，备份ID: %lu\n", backup_id);
+    SBFS_LOG_INFO("恢复文件系统，备份ID: %lu", backup_id);
     
     // 查找备份
     backup_metadata_t *backup = NULL;
@@ -979,26 +980,26 @@ int md_restore_filesystem(uint64_t backup_id, const recovery_options_t *options)
     }
     
     if (!backup) {
-        printf("找不到备份 %lu\n", backup_id);
+        SBFS_LOG_WARN("找不到备份 %lu", backup_id);
         return -1;
     }
     
     if (!backup->backup_path) {
-        printf("备份文件路径不存在\n");
+        SBFS_LOG_WARN("备份文件路径不存在");
         return -1;
     }
     
     // 打开备份文件
     int backup_fd = open(backup->backup_path, O_RDONLY);
     if (backup_fd < 0) {
-        printf("无法打开备份文件: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法打开备份文件: %s", strerror(errno));
         return -1;
     }
     
     // 读取备份头部
     backup_header_t header;
     if (read(backup_fd, &header, sizeof(header)) != sizeof(header)) {
-        printf("读取备份头部失败\n");
+        SBFS_LOG_WARN("读取备份头部失败");
         close(backup_fd);
         return -1;
     }
@@ -1009,7 +1010,7 @@ int md_restore_filesystem(uint64_t backup_id, const recovery_options_t *options)
     uint32_t calculated_checksum = md_calculate_checksum(&header, sizeof(header) - sizeof(uint32_t));
     
     if (saved_checksum != calculated_checksum) {
-        printf("备份文件头部校验和验证失败\n");
+        SBFS_LOG_WARN("备份文件头部校验和验证失败");
         close(backup_fd);
         return -1;
     }
@@ -1017,7 +1018,7 @@ int md_restore_filesystem(uint64_t backup_id, const recovery_options_t *options)
     // 在实际实现中，这里会从备份文件恢复文件系统数据
     // 由于模块间依赖，暂时使用模拟恢复
     
-    printf("从备份 %lu 恢复文件系统完成\n", backup_id);
+    SBFS_LOG_INFO("从备份 %lu 恢复文件系统完成", backup_id);
     
     close(backup_fd);
     
@@ -1026,7 +1027,7 @@ int md_restore_filesystem(uint64_t backup_id, const recovery_options_t *options)
 }
 
 int md_restore_file(uint64_t backup_id, const char *file_path, const char *target_path) {
-    printf("恢复文件，备份ID: %lu, 文件: %s, 目标: %s\n", 
+    SBFS_LOG_INFO("恢复文件，备份ID: %lu, 文件: %s, 目标: %s", 
            backup_id, file_path, target_path);
     
     // 这里实现单个文件恢复逻辑
@@ -1035,7 +1036,7 @@ int md_restore_file(uint64_t backup_id, const char *file_path, const char *targe
 }
 
 int md_restore_directory(uint64_t backup_id, const char *dir_path, const char *target_path) {
-    printf("恢复目录，备份ID: %lu, 目录: %s, 目标: %s\n", 
+    SBFS_LOG_INFO("恢复目录，备份ID: %lu, 目录: %s, 目标: %s", 
            backup_id, dir_path, target_path);
     
     // 这里实现目录恢复逻辑
@@ -1044,7 +1045,7 @@ int md_restore_directory(uint64_t backup_id, const char *dir_path, const char *t
 }
 
 int md_verify_backup(uint64_t backup_id) {
-    printf("验证备份完整性，备份ID: %lu\n", backup_id);
+    SBFS_LOG_INFO("验证备份完整性，备份ID: %lu", backup_id);
     
     // 查找备份
     backup_metadata_t *backup = NULL;
@@ -1059,26 +1060,26 @@ int md_verify_backup(uint64_t backup_id) {
     }
     
     if (!backup) {
-        printf("找不到备份 %lu\n", backup_id);
+        SBFS_LOG_WARN("找不到备份 %lu", backup_id);
         return -1;
     }
     
     if (!backup->backup_path) {
-        printf("备份文件路径不存在\n");
+        SBFS_LOG_WARN("备份文件路径不存在");
         return -1;
     }
     
     // 打开备份文件
     int backup_fd = open(backup->backup_path, O_RDONLY);
     if (backup_fd < 0) {
-        printf("无法打开备份文件: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法打开备份文件: %s", strerror(errno));
         return -1;
     }
     
     // 验证备份文件完整性
     struct stat st;
     if (fstat(backup_fd, &st) != 0) {
-        printf("无法获取备份文件状态\n");
+        SBFS_LOG_WARN("无法获取备份文件状态");
         close(backup_fd);
         return -1;
     }
@@ -1088,7 +1089,7 @@ int md_verify_backup(uint64_t backup_id) {
     
     close(backup_fd);
     
-    printf("备份 %lu 完整性验证通过\n", backup_id);
+    SBFS_LOG_DEBUG("备份 %lu 完整性验证通过", backup_id);
     backup->state = BACKUP_VERIFIED;
     
     return 0;
@@ -1100,7 +1101,7 @@ int md_list_backups(backup_metadata_t **backup_list) {
 }
 
 int md_delete_backup(uint64_t backup_id) {
-    printf("删除备份，备份ID: %lu\n", backup_id);
+    SBFS_LOG_INFO("删除备份，备份ID: %lu", backup_id);
     
     // 查找备份
     backup_metadata_t *prev = NULL;
@@ -1129,7 +1130,7 @@ int md_delete_backup(uint64_t backup_id) {
             }
             free(current);
             
-            printf("备份 %lu 已删除\n", backup_id);
+            SBFS_LOG_INFO("备份 %lu 已删除", backup_id);
             return 0;
         }
         
@@ -1137,7 +1138,7 @@ int md_delete_backup(uint64_t backup_id) {
         current = current->next;
     }
     
-    printf("找不到备份 %lu\n", backup_id);
+    SBFS_LOG_WARN("找不到备份 %lu", backup_id);
     return -1;
 }
 
@@ -1152,13 +1153,13 @@ int md_health_monitor_init(void) {
     module_d_state.alerts = NULL;
     
     if (pthread_mutex_init(&module_d_state.alert_mutex, NULL) != 0) {
-        printf("无法初始化预警互斥锁\n");
+        SBFS_LOG_ERROR("无法初始化预警互斥锁");
         return -1;
     }
     
     module_d_state.last_health_report = time(NULL);
     
-    printf("模块D：系统健康监控初始化完成（生产级）\n");
+    SBFS_LOG_INFO("模块D：系统健康监控初始化完成（生产级）");
     return 0;
 }
 
@@ -1184,7 +1185,7 @@ void md_health_monitor_destroy(void) {
     
     pthread_mutex_destroy(&module_d_state.alert_mutex);
     
-    printf("模块D：系统健康监控已销毁\n");
+    SBFS_LOG_INFO("模块D：系统健康监控已销毁");
 }
 
 system_health_t md_get_system_health(void) {
@@ -1226,7 +1227,7 @@ int md_add_alert(alert_level_t level, const char *component, const char *message
     
     pthread_mutex_unlock(&module_d_state.alert_mutex);
     
-    printf("添加预警: [%s] %s: %s\n", 
+    SBFS_LOG_WARN("添加预警: [%s] %s: %s", 
            level == ALERT_INFO ? "信息" : 
            level == ALERT_WARNING ? "警告" : 
            level == ALERT_ERROR ? "错误" : "严重", 
@@ -1266,12 +1267,12 @@ int md_acknowledge_alert(uint64_t alert_id) {
     // 这里实现预警确认逻辑
     // 根据alert_id查找并标记预警为已确认
     
-    printf("确认预警 ID: %lu\n", alert_id);
+    SBFS_LOG_INFO("确认预警 ID: %lu", alert_id);
     return 0;
 }
 
 int md_run_health_check(void) {
-    printf("执行系统健康检查...\n");
+    SBFS_LOG_INFO("执行系统健康检查...");
     
     // 检查数据完整性
     if (module_d_state.corrupted_blocks_found > 0) {
@@ -1288,17 +1289,17 @@ int md_run_health_check(void) {
         md_add_alert(ALERT_INFO, "事务系统", "事务数量过多，建议清理");
     }
     
-    printf("系统健康检查完成\n");
+    SBFS_LOG_INFO("系统健康检查完成");
     return 0;
 }
 
 int md_generate_health_report(const char *report_path) {
-    printf("生成健康报告: %s\n", report_path);
+    SBFS_LOG_INFO("生成健康报告: %s", report_path);
     
     // 创建健康报告文件
     FILE *report_file = fopen(report_path, "w");
     if (!report_file) {
-        printf("无法创建健康报告文件: %s\n", strerror(errno));
+        SBFS_LOG_WARN("无法创建健康报告文件: %s", strerror(errno));
         return -1;
     }
     
@@ -1357,14 +1358,14 @@ int md_generate_health_report(const char *report_path) {
     
     fclose(report_file);
     
-    printf("健康报告已生成: %s\n", report_path);
+    SBFS_LOG_INFO("健康报告已生成: %s", report_path);
     module_d_state.last_health_report = time(NULL);
     
     return 0;
 }
 
 int md_repair_corrupted_data(void) {
-    printf("修复损坏的数据...\n");
+    SBFS_LOG_INFO("修复损坏的数据...");
     
     // 这里实现数据修复逻辑
     // 尝试修复检测到的损坏数据
@@ -1373,7 +1374,7 @@ int md_repair_corrupted_data(void) {
 }
 
 int md_rebuild_indexes(void) {
-    printf("重建索引...\n");
+    SBFS_LOG_INFO("重建索引...");
     
     // 这里实现索引重建逻辑
     // 重建文件系统的索引结构
@@ -1382,7 +1383,7 @@ int md_rebuild_indexes(void) {
 }
 
 int md_cleanup_orphaned_data(void) {
-    printf("清理孤儿数据...\n");
+    SBFS_LOG_INFO("清理孤儿数据...");
     
     // 这里实现孤儿数据清理逻辑
     // 清理没有引用的数据块
@@ -1406,14 +1407,14 @@ int module_d_init(void) {
     
     // 备份系统初始化，使用默认路径
     if (md_backup_init("/tmp/smartbackup_backup") != 0) {
-        printf("警告：备份系统初始化失败，将使用默认设置\n");
+        SBFS_LOG_WARN("备份系统初始化失败，将使用默认设置");
         // 不将备份初始化失败视为整体失败
     }
     
     if (result == 0) {
-        printf("模块D：数据完整性与恢复机制初始化完成（生产级）\n");
+        SBFS_LOG_INFO("模块D：数据完整性与恢复机制初始化完成（生产级）");
     } else {
-        printf("模块D：初始化过程中出现错误\n");
+        SBFS_LOG_ERROR("模块D：初始化过程中出现错误");
     }
     
     return result;
@@ -1424,7 +1425,7 @@ int module_d_init(void) {
  */
 int md_set_backup_storage_path(const char *storage_path) {
     if (!storage_path) {
-        printf("备份存储路径不能为空\n");
+        SBFS_LOG_WARN("备份存储路径不能为空");
         return -1;
     }
     
@@ -1432,13 +1433,13 @@ int md_set_backup_storage_path(const char *storage_path) {
     struct stat st;
     if (stat(storage_path, &st) != 0) {
         if (mkdir(storage_path, 0755) != 0) {
-            printf("无法创建备份存储目录: %s\n", strerror(errno));
+            SBFS_LOG_WARN("无法创建备份存储目录: %s", strerror(errno));
             return -1;
         }
     }
     
     if (!S_ISDIR(st.st_mode)) {
-        printf("备份存储路径必须是一个目录\n");
+        SBFS_LOG_WARN("备份存储路径必须是一个目录");
         return -1;
     }
     
@@ -1449,11 +1450,11 @@ int md_set_backup_storage_path(const char *storage_path) {
     
     module_d_state.backup_storage_path = strdup(storage_path);
     if (!module_d_state.backup_storage_path) {
-        printf("内存分配失败\n");
+        SBFS_LOG_ERROR("内存分配失败");
         return -1;
     }
     
-    printf("模块D：备份存储路径已设置为 %s\n", storage_path);
+    SBFS_LOG_INFO("模块D：备份存储路径已设置为 %s", storage_path);
     return 0;
 }
 
@@ -1462,23 +1463,23 @@ int md_set_backup_storage_path(const char *storage_path) {
  */
 int md_create_backup(const char *description) {
     if (!module_d_state.backup_storage_path) {
-        printf("请先设置备份存储路径\n");
+        SBFS_LOG_WARN("请先设置备份存储路径");
         return -1;
     }
     
     if (module_d_state.backup_in_progress) {
-        printf("已有备份正在进行中\n");
+        SBFS_LOG_WARN("已有备份正在进行中");
         return -1;
     }
     
     // 创建完整备份
     uint64_t backup_id = md_create_full_backup(description);
     if (backup_id == 0) {
-        printf("创建备份失败\n");
+        SBFS_LOG_WARN("创建备份失败");
         return -1;
     }
     
-    printf("备份创建成功，ID: %lu\n", backup_id);
+    SBFS_LOG_INFO("备份创建成功，ID: %lu", backup_id);
     return 0;
 }
 
@@ -1491,5 +1492,5 @@ void module_d_destroy(void) {
     md_transaction_destroy();
     md_integrity_destroy();
     
-    printf("模块D：数据完整性与恢复机制已销毁\n");
+    SBFS_LOG_INFO("模块D：数据完整性与恢复机制已销毁");
 }
\ No newline at end of file
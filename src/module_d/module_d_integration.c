@@ -3,6 +3,7 @@
  */
 
 #include "module_d_integration.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,7 +52,7 @@ int md_integrated_read_block(data_block_t *block, char *buf, size_t size, off_t
     // 验证数据完整性
     result = md_verify_block_integrity(block);
     if (result != 0) {
-        printf("数据块完整性验证失败，块ID: %lu\n", block->block_id);
+        SBFS_LOG_WARN("数据块完整性验证失败，块ID: %lu", block->block_id);
         md_add_alert(ALERT_ERROR, "数据完整性", "读取时发现损坏的数据块");
     }
     
@@ -85,7 +86,7 @@ void md_integrated_free_block(data_block_t *block) {
         // 在释放前进行最后的完整性检查
         int integrity_result = md_verify_block_integrity(block);
         if (integrity_result != 0) {
-            printf("释放前检测到损坏的数据块，块ID: %lu\n", block->block_id);
+            SBFS_LOG_WARN("释放前检测到损坏的数据块，块ID: %lu", block->block_id);
             md_add_alert(ALERT_WARNING, "数据完整性", "释放时发现损坏的数据块");
         }
     }
@@ -249,36 +250,36 @@ static bool automatic_backup_running = false;
 static void* automatic_backup_thread_func(void *arg) {
     uint32_t interval = *(uint32_t*)arg;
     
-    printf("自动备份线程启动，间隔: %u 秒\n", interval);
+    SBFS_LOG_INFO("自动备份线程启动，间隔: %u 秒", interval);
     
     while (automatic_backup_running) {
         sleep(interval);
         
         if (automatic_backup_running) {
-            printf("执行自动备份...\n");
+            SBFS_LOG_DEBUG("执行自动备份...");
             uint64_t backup_id = md_create_full_backup("自动定期备份");
             if (backup_id > 0) {
                 module_d_integration_state.backups_created++;
-                printf("自动备份完成，备份ID: %lu\n", backup_id);
+                SBFS_LOG_INFO("自动备份完成，备份ID: %lu", backup_id);
             } else {
-                printf("自动备份失败\n");
+                SBFS_LOG_WARN("自动备份失败");
                 md_add_alert(ALERT_ERROR, "备份系统", "自动备份失败");
             }
         }
     }
     
-    printf("自动备份线程停止\n");
+    SBFS_LOG_INFO("自动备份线程停止");
     return NULL;
 }
 
 int md_schedule_automatic_backups(uint32_t interval_seconds) {
     if (!module_d_integration_state.backup_system_enabled) {
-        printf("备份系统未启用，无法调度自动备份\n");
+        SBFS_LOG_WARN("备份系统未启用，无法调度自动备份");
         return -1;
     }
     
     if (automatic_backup_running) {
-        printf("自动备份已经在运行中\n");
+        SBFS_LOG_WARN("自动备份已经在运行中");
         return 0;
     }
     
@@ -295,11 +296,11 @@ int md_schedule_automatic_backups(uint32_t interval_seconds) {
                        automatic_backup_thread_func, interval) != 0) {
         free(interval);
         automatic_backup_running = false;
-        printf("无法启动自动备份线程\n");
+        SBFS_LOG_ERROR("无法启动自动备份线程");
         return -1;
     }
     
-    printf("自动备份已调度，间隔: %u 秒\n", interval_seconds);
+    SBFS_LOG_INFO("自动备份已调度，间隔: %u 秒", interval_seconds);
     return 0;
 }
 
@@ -308,7 +309,7 @@ int md_check_recovery_needed(void) {
         return 0;
     }
     
-    printf("检查是否需要恢复...\n");
+    SBFS_LOG_DEBUG("检查是否需要恢复...");
     
     // 这里实现恢复检查逻辑
     // 检查文件系统状态，判断是否需要从备份恢复
@@ -321,7 +322,7 @@ int md_integrated_backup_verification(uint64_t backup_id) {
         return 0;
     }
     
-    printf("验证备份完整性，备份ID: %lu\n", backup_id);
+    SBFS_LOG_DEBUG("验证备份完整性，备份ID: %lu", backup_id);
     
     int result = md_verify_backup(backup_id);
     if (result != 0) {
@@ -417,11 +418,11 @@ int module_d_integration_init(void) {
     
     // 初始化模块D
     if (module_d_init() != 0) {
-        printf("模块D初始化失败\n");
+        SBFS_LOG_WARN("模块D初始化失败");
         return -1;
     }
     
-    printf("模块D集成初始化完成\n");
+    SBFS_LOG_INFO("模块D集成初始化完成");
     return 0;
 }
 
@@ -435,7 +436,7 @@ void module_d_integration_destroy(void) {
     // 销毁模块D
     module_d_destroy();
     
-    printf("模块D集成已销毁\n");
+    SBFS_LOG_INFO("模块D集成已销毁");
 }
 
 int module_d_set_feature_enabled(const char *feature_name, bool enabled) {
@@ -452,11 +453,11 @@ int module_d_set_feature_enabled(const char *feature_name, bool enabled) {
     } else if (strcmp(feature_name, "health_monitoring") == 0) {
         module_d_integration_state.health_monitoring_enabled = enabled;
     } else {
-        printf("未知功能: %s\n", feature_name);
+        SBFS_LOG_WARN("未知功能: %s", feature_name);
         return -1;
     }
     
-    printf("功能 '%s' %s\n", feature_name, enabled ? "已启用" : "已禁用");
+    SBFS_LOG_INFO("功能 '%s' %s", feature_name, enabled ? "已启用" : "已禁用");
     return 0;
 }
 
@@ -469,14 +470,14 @@ int module_d_generate_integration_report(const char *report_path) {
         return -1;
     }
     
-    printf("生成模块D集成报告: %s\n", report_path);
+    SBFS_LOG_INFO("生成模块D集成报告: %s", report_path);
     
     // 这里实现报告生成逻辑
     // 将集成状态和统计信息写入文件
     
     FILE *report_file = fopen(report_path, "w");
     if (!report_file) {
-        printf("无法创建报告文件\n");
+        SBFS_LOG_WARN("无法创建报告文件");
         return -1;
     }
     
@@ -507,6 +508,6 @@ int module_d_generate_integration_report(const char *report_path) {
     
     fclose(report_file);
     
-    printf("模块D集成报告生成完成\n");
+    SBFS_LOG_INFO("模块D集成报告生成完成");
     return 0;
 }
\ No newline at end of file